@@ -47,11 +47,18 @@ typedef enum {
 
 static DUMPFLAGS dump = 0;
 
+/* Native code module C source output file */
+static const char *nativefile = NULL;
+
+/* Precompiled bank output file */
+static const char *bankfile = NULL;
+
 /* Configuration */
 static const char *audiodriver = "default";
 static int samplerate = 48000;
 static int channels = 2;
 static int audiobuf = 4096;
+static int workers = 0;
 static int a2flags = A2_TIMESTAMP;
 static const char *mididriver = NULL;
 
@@ -281,6 +288,46 @@ static void dump_exports(void)
 }
 
 
+/* Write native code module C source for the module */
+static int write_native(void)
+{
+	A2_errors res;
+	FILE *f = fopen(nativefile, "w");
+	if(!f)
+	{
+		fprintf(stderr, "a2play: Could not create \"%s\"!\n",
+				nativefile);
+		return 0;
+	}
+	res = a2_WriteNative(iface, module, f);
+	if(fclose(f) && !res)
+		res = A2_WRITE;
+	if(res)
+	{
+		fprintf(stderr, "a2play: Could not write native code! (%s)\n",
+				a2_ErrorString(res));
+		return 0;
+	}
+	fprintf(stderr, "Wrote native code to \"%s\"\n", nativefile);
+	return 1;
+}
+
+
+/* Save the module as a precompiled bank */
+static int save_bank(void)
+{
+	A2_errors res = a2_SaveBank(iface, module, bankfile);
+	if(res)
+	{
+		fprintf(stderr, "a2play: Could not save \"%s\"! (%s)\n",
+				bankfile, a2_ErrorString(res));
+		return 0;
+	}
+	fprintf(stderr, "Saved precompiled bank \"%s\"\n", bankfile);
+	return 1;
+}
+
+
 /*-------------------------------------------------------------------
 	Loading
 -------------------------------------------------------------------*/
@@ -465,6 +512,7 @@ static void usage(const char *exename)
 			"           -b<n>       Audio buffer size (frames)\n"
 			"           -r<n>       Audio sample rate (Hz)\n"
 			"           -c<n>       Number of audio channels\n"
+			"           -w<n>       Number of worker threads\n"
 			"           -m<name>[,opt[,opt[,...]]]\n"
 			"                       MIDI driver + options\n"
 			"           -s          Read input from stdin\n"
@@ -483,6 +531,12 @@ static void usage(const char *exename)
 			"           -xp         Dump with private symbols\n"
 			"           -xa         Dump with VM assembly code\n"
 			"           -xh         Dump with object handles\n"
+			"           -N          Load native code module (.a2n), "
+			"if available\n"
+			"           -n<file>    Write native code module C "
+			"source and exit\n"
+			"           -o<file>    Save module as precompiled "
+			"bank (.a2b) and exit\n"
 			"           -v          Print engine and header "
 			"versions\n"
 			"           -h          Help\n\n");
@@ -532,6 +586,11 @@ static void parse_args(int argc, const char *argv[])
 			channels = atoi(&argv[i][2]);
 			printf("[Audio channels: %d]\n", channels);
 		}
+		else if(strncmp(argv[i], "-w", 2) == 0)
+		{
+			workers = atoi(&argv[i][2]);
+			printf("[Worker threads: %d]\n", workers);
+		}
 		else if(strncmp(argv[i], "-m", 2) == 0)
 		{
 			mididriver = &argv[i][2];
@@ -573,6 +632,12 @@ static void parse_args(int argc, const char *argv[])
 			dump |= DF_MODULE | DF_ASM;
 		else if(strncmp(argv[i], "-xh", 3) == 0)
 			dump |= DF_MODULE | DF_HANDLES;
+		else if(strncmp(argv[i], "-N", 3) == 0)	/* No args! */
+			a2flags |= A2_NATIVE;
+		else if(strncmp(argv[i], "-n", 2) == 0)
+			nativefile = &argv[i][2];
+		else if(strncmp(argv[i], "-o", 2) == 0)
+			bankfile = &argv[i][2];
 		else if(strncmp(argv[i], "-h", 3) == 0)	/* No args! */
 		{
 			usage(argv[0]);
@@ -670,6 +735,7 @@ int main(int argc, const char *argv[])
 	if(!(cfg = a2_OpenConfig(samplerate, audiobuf, channels,
 			a2flags | A2_AUTOCLOSE)))
 		fail(a2_LastError());
+	cfg->workers = workers;
 	if(!(drv = a2_NewDriver(A2_AUDIODRIVER, audiodriver)))
 		fail(a2_LastError());
 	if(drv && a2_AddDriver(cfg, drv))
@@ -724,6 +790,18 @@ int main(int argc, const char *argv[])
 	/* Dump exports, code etc, if requested */
 	dump_exports();
 
+	/* Write native code and/or precompiled bank, if requested */
+	if(nativefile || bankfile)
+	{
+		int ok = 1;
+		if(nativefile)
+			ok &= write_native();
+		if(bankfile)
+			ok &= save_bank();
+		a2_Close(iface);
+		return ok ? 0 : 1;
+	}
+
 	/* Start playing! */
 	a2_TimestampReset(iface);
 	tcb = a2_SinkCallback(iface, a2_RootVoice(iface), sink_process, NULL);
@@ -57,6 +57,7 @@ struct A2_config
 	int		blockpool;	/* Initial block pool size */
 	int		voicepool;	/* Initial voice pool size */
 	int		eventpool;	/* Initial event pool size */
+	int		workers;	/* Voice processing worker threads */
 
 	/* Information (read-only; valid only after a2_Open()!) */
 	int		basepitch;	/* Middle C pitch (1.0/oct, 16:16) */
@@ -80,6 +81,18 @@ struct A2_config
  *	If left 0 (default), blockpool, voicepool, and eventpool are set to
  *	"reasonable" defaults automatically by a2_Open().
  *
+ *	'workers' (default 0) is the number of worker threads used for
+ *	processing the subvoices of the root voice in parallel. With 0, all
+ *	processing is done by the thread running the audio driver callback.
+ *
+ *	With workers, each subvoice of the root voice gets a random number
+ *	generator of its own, for 'rand' and noise, so that the output does
+ *	not depend on the number of workers. Songs using random numbers or
+ *	noise therefore sound slightly different with workers than without,
+ *	where all voices share the one generator of earlier versions. Set the
+ *	A2_TREERNG flag to use per subvoice generators without workers as
+ *	well, so that the output is the same with or without workers.
+ *
  *	Also, if a realtime audio driver is used, a2_Open() automatically
  *	transfers the A2_REALTIME flag to the configuration. Applications
  *	should only set the A2_REALTIME flag when using a normally
@@ -53,6 +53,11 @@ typedef enum A2_properties
 	A2_PAVAILABLE,		/* Items currently available for reading */
 	A2_PSPACE,		/* Space currently available for writing */
 
+	/*
+	 * Programs
+	 */
+	A2_PNATIVE,		/* Run native code, if loaded (0/1) */
+
 	/*
 	 * Global settings (state)
 	 */
@@ -69,6 +74,9 @@ typedef enum A2_properties
 	A2_PRANDSEED,		/* 'rand' instruction RNG seed/state */
 	A2_PNOISESEED,		/* 'wtosc' noise generator seed/state */
 	A2_PLOGLEVELS,		/* Loglevel (bit mask) */
+	A2_PWORKERS,		/* Voice processing worker threads */
+	A2_POFFLINETHREADS,	/* Offline rendering threads (0: one per core) */
+	A2_PWARMVOICES,		/* Max terminated voices kept for reuse */
 
 	/*
 	 * Statistics (state)
@@ -156,6 +156,7 @@ typedef enum {
   A2_DEFERR(INDEXRANGE,		"Index out of range")\
   A2_DEFERR(OUTOFREGS,		"Out of VM registers")\
   A2_DEFERR(LARGEFRAME,		"Function uses too many VM registers")\
+  A2_DEFERR(LARGEFUNC,		"Function has too much VM code")\
   \
   A2_DEFERR(NOTIMPLEMENTED,	"Operation or feature not implemented")\
   A2_DEFERR(OPEN,		"Error opening file")\
@@ -171,6 +172,7 @@ typedef enum {
   A2_DEFERR(STREAMCLOSED,	"Stream closed by the other party")\
   A2_DEFERR(WRONGTYPE,		"Wrong type of data or object")\
   A2_DEFERR(WRONGFORMAT,	"Wrong stream data format")\
+  A2_DEFERR(OUTOFDATE,		"File is out of date, or from another version")\
   A2_DEFERR(VOICEALLOC,		"Could not allocate voice")\
   A2_DEFERR(VOICEINIT,		"Could not initialize voice")\
   A2_DEFERR(VOICENEST,		"Subvoice nesting depth exceeded")\
@@ -298,6 +300,10 @@ typedef enum A2_initflags
 	A2_SILENT =	0x00001000,	/* Disable all log levels */
 	A2_RTSILENT =	0x00002000,	/* No engine context error messages */
 	A2_NOSHARED =	0x00004000,	/* No bank sharing (also a2_Load().)*/
+	A2_NOOPTIMIZE =	0x00008000,	/* Disable the VM code optimizer */
+	A2_NATIVE =	0x00010000,	/* Load native code modules (a2_vm.h) */
+	A2_NOCOMPILED =	0x00020000,	/* Don't load precompiled banks */
+	A2_TREERNG =	0x00040000,	/* RNG per root subvoice (see workers) */
 
 	A2_INITFLAGS =	0x000fff00,	/* Mask for the flags above */
 
@@ -307,6 +313,7 @@ typedef enum A2_initflags
 	A2_SUBSTATE =	0x00100000,	/* State is a substate */
 
 	/* Flags for drivers and configurations */
+	A2_THREADSAFE =	0x08000000,	/* Driver calls are thread safe */
 	A2_ISOPEN =	0x10000000,	/* Object is open/in use */
 	A2_AUTOCLOSE =	0x20000000,	/* Will be closed by parent object */
 	A2_NOREF =	0x40000000	/* Don't count as parent reference */
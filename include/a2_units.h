@@ -59,6 +59,7 @@ extern "C" {
 #endif
 
 typedef struct A2_unitdesc A2_unitdesc;
+typedef struct A2_unitdescx A2_unitdescx;
 typedef struct A2_unit A2_unit;
 typedef struct A2_crdesc A2_crdesc;
 typedef struct A2_codesc A2_codesc;
@@ -72,7 +73,8 @@ typedef enum A2_unitflags
 
 	/* A2_unitdesc flags */
 	A2_MATCHIO =		0x00010000,	/* ninputs == noutputs */
-	A2_XINSERT =		0x00020000	/* Supports xinsert APIs */
+	A2_XINSERT =		0x00020000,	/* Supports xinsert APIs */
+	A2_UNITDESCX =		0x00040000	/* Is an A2_unitdescx */
 } A2_unitflags;
 
 /*
@@ -141,6 +143,23 @@ typedef A2_errors (*A2_uinit_cb)(A2_unit *u, A2_vmstate *vms, void *statedata,
  */
 typedef void (*A2_udeinit_cb)(A2_unit *u);
 
+/*
+ * Reset callback (A2_unitdescx)
+ *
+ *	This OPTIONAL callback is used instead of Initialize() when a voice is
+ *	given the units of a recently terminated voice running the same
+ *	program, with the same output wiring. The A2_unit header, including
+ *	Process, is left as it was when that voice terminated, and only the
+ *	instance state and VM registers of the unit need to be reset. That is,
+ *	Reset() should leave the unit in the same state as Initialize() with
+ *	the same arguments would, but can skip anything that only depends on
+ *	the wiring or the engine state.
+ *
+ * NOTE:
+ *	Only voices where all units implement Reset(), and none of them
+ *	implement Deinitialize(), are recycled.
+ */
+
 /*
  * Shared state management
  *
@@ -242,7 +261,8 @@ struct A2_unitdesc
 	uint8_t		maxoutputs;	/* Maximum number of outputs */
 
 	/* Unit instantiation */
-	unsigned	instancesize;	/* Size of A2_unit instances (bytes) */
+	unsigned	instancesize;	/* Size of A2_unit instances (bytes; at
+					 * most A2_BLOCK_SIZE) */
 	A2_uinit_cb	Initialize;
 	A2_udeinit_cb	Deinitialize;
 
@@ -252,6 +272,24 @@ struct A2_unitdesc
 };
 
 
+/*
+ * Extended unit descriptor
+ *
+ *	Units that set A2_UNITDESCX in the 'flags' field of the descriptor
+ *	actually provide one of these, with the plain A2_unitdesc first, and
+ *	register that. 'size' is sizeof(A2_unitdescx) as the unit was built,
+ *	so that fields can be added at the end without breaking existing units.
+ */
+struct A2_unitdescx
+{
+	A2_unitdesc	d;		/* Plain descriptor */
+	unsigned	size;		/* sizeof(A2_unitdescx) */
+
+	/* Voice recycling */
+	A2_uinit_cb	Reset;
+};
+
+
 /* Control port */
 struct A2_cport
 {
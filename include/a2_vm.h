@@ -65,9 +65,59 @@ typedef struct A2_vmstate
 	uint8_t		state;		/* Current state */
 	uint8_t		func;		/* Current function index */
 	uint16_t	pc;		/* PC of calling instruction */
-	int		r[A2_REGISTERS];	/* VM registers */
+	int		*r;		/* VM registers */
 }  A2_vmstate;
 
+/*
+ * Native code modules
+ *
+ * Natively compiled VM functions, as generated by a2_WriteNative(). The
+ * generated C code is built into a shared object, which a2_Load() will pick
+ * up, if found next to the script file, with the extension ".a2n", provided
+ * the A2_NATIVE flag is set. As loading a module runs its code, this is off
+ * by default.
+ *
+ * A native function is entered with the VM PC of the next instruction, and
+ * executes instructions until it runs into one that it doesn't handle, or the
+ * VM instruction limit is about to be reached. It then returns the PC of that
+ * instruction, which is then executed by the VM.
+ *
+ * Native code only covers local flow control, register arithmetics and
+ * comparisons, and argument pushes. Anything that involves units, timing,
+ * messages, subvoices, random numbers or control register writes is always
+ * executed by the VM.
+ */
+#define	A2_NATIVEVERSION	1
+#define	A2_NATIVESYMBOL		"a2_nativemodule"
+
+/* VM state shared with native code */
+typedef struct A2_nativecontext
+{
+	int		*r;		/* VM registers */
+	int		*cargv;		/* Argument stack */
+	int		cargc;		/* Number of arguments on stack */
+	unsigned	inscount;	/* Instructions left before overload */
+} A2_nativecontext;
+
+typedef unsigned (*A2_nativefunc)(A2_nativecontext *nc, unsigned pc);
+
+/* Native version of a VM function, and the VM code it was generated from */
+typedef struct A2_nativeentry
+{
+	const uint32_t	*code;
+	unsigned	size;		/* Size of 'code' (32 bit words) */
+	A2_nativefunc	func;
+} A2_nativeentry;
+
+/* Exported by native code modules as A2_NATIVESYMBOL */
+typedef struct A2_nativemodule
+{
+	unsigned	version;	/* A2_NATIVEVERSION */
+	unsigned	opcodes;	/* Number of VM opcodes (for validation) */
+	unsigned	nentries;
+	const A2_nativeentry *entries;
+} A2_nativemodule;
+
 #ifdef __cplusplus
 };
 #endif
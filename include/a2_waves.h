@@ -89,6 +89,7 @@ typedef struct A2_wave_wave
 {
 	int16_t		*data[A2_MIPLEVELS];	/* One buffer per mip level */
 	unsigned	size[A2_MIPLEVELS];	/* Sizes EXCLUDING pre/post! */
+	int32_t		*coeffs[A2_MIPLEVELS];	/* Hermite coefficients, or NULL */
 } A2_wave_wave;
 
 /* A2_object: Waveform with mipmaps */
@@ -111,6 +112,7 @@ typedef enum A2_waveflags
 {
 	A2_LOOPED =	0x00000100,	/* Waveform is looped */
 	A2_NORMALIZE =	0x00010000,	/* Normalize waveform amplitude */
+	A2_FAST =	0x00020000,	/* Precalculate Hermite coefficients */
 	A2_XFADE =	0x00040000,	/* Crossfade to make seamless */
 	A2_REVMIX =	0x00080000,	/* Mix in reversed to make seemless */
 	A2_CLEAR =	0x00100000,	/* Clear (silence) the waveform */
@@ -132,6 +134,9 @@ typedef enum A2_waveflags
  *	A2_XFADE	Crossfade mix a copy offset by half the loop length.
  *	A2_REVMIX	Mix wave with a reversed version of itself.
  *	A2_CLEAR	Ignore 'data' (if any) and generate a silent waveform.
+ *	A2_FAST		Also store cubic Hermite coefficients for every sample,
+ *			for faster high quality playback. (Uses eight times
+ *			the memory of the plain wave data!)
  *
  * A2_XFADE and A2_REVMIX are intended for looped waves, although they (sort
  * of) work on one-shot waves as well.
@@ -206,6 +211,57 @@ A2_handle a2_RenderWave(A2_interface *i,
 		unsigned samplerate, unsigned length, A2_property *props,
 		A2_handle program, unsigned argc, int *argv);
 
+/* Job for a2_RenderWaves() */
+typedef struct A2_waverender
+{
+	/* Wave to create; as for a2_RenderWave() */
+	A2_wavetypes	type;
+	unsigned	period;
+	int		flags;
+
+	/* Rendering; as for a2_RenderWave() */
+	unsigned	samplerate;
+	unsigned	length;
+	A2_property	*props;
+	A2_handle	program;
+	unsigned	argc;
+	int		*argv;
+
+	/* Results */
+	A2_handle	wave;		/* Wave, or negated A2_errors code */
+	unsigned	frames;		/* Number of frames rendered */
+	unsigned	rendertime;	/* Render time (microseconds) */
+} A2_waverender;
+
+/*
+ * Render a batch of waves, as specified by the 'njobs' elements of 'jobs',
+ * each one as a2_RenderWave() would. The jobs are rendered in parallel, in
+ * separate offline substates, using up to A2_POFFLINETHREADS threads. Jobs
+ * that use the waves of other jobs (passed as arguments) are rendered after
+ * those waves are done.
+ *
+ * The resulting waves are returned in the 'wave' fields of the jobs. If a job
+ * fails, its 'wave' field is set to a negated A2_errors code, while other jobs
+ * are still rendered. 'rendertime' is the time spent rendering the job, or
+ * loading it from the wave render cache.
+ *
+ * Returns A2_OK, or an error code if the whole batch failed, in which case
+ * no waves are returned.
+ */
+A2_errors a2_RenderWaves(A2_interface *i, A2_waverender *jobs, unsigned njobs);
+
+/*
+ * Set the directory used for caching waves rendered by a2_RenderWave(),
+ * including those rendered by 'wave' definitions in scripts. When a wave is
+ * to be rendered, and there is a cache file for the same program, arguments
+ * and parameters, the wave is loaded from that file instead. The directory is
+ * not created if it does not exist. Passing NULL disables the cache, which is
+ * the default.
+ *
+ * The cache is shared by all substates of the state.
+ */
+A2_errors a2_SetWaveCache(A2_interface *i, const char *path);
+
 #ifdef __cplusplus
 };
 #endif
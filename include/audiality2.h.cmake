@@ -49,8 +49,17 @@ extern "C" {
 /* Maximum number of sample frames to process at a time */
 #define	A2_MAXFRAG		64
 
-/* Minimum size of the blocks allocated by a2_AllocBlock() */
-#define	A2_BLOCK_SIZE		384
+/*
+ * Maximum size of realtime memory blocks, such as unit instances.
+ *
+ * NOTE:
+ *	This used to be the one and only block size, 384 bytes, and thus also
+ *	the minimum size of all blocks. Blocks now come in several size classes,
+ *	and A2_BLOCK_SIZE is the size of the largest class; the upper limit for
+ *	A2_unitdesc.instancesize. Code that relied on every block being at least
+ *	A2_BLOCK_SIZE bytes must use the size it actually asked for instead.
+ */
+#define	A2_BLOCK_SIZE		2048
 
 /* Maximum number of audio channels supported */
 #define	A2_MAXCHANNELS		8
@@ -339,12 +348,46 @@ A2_handle a2_NewBank(A2_interface *i, const char *name, int flags);
  * specified name, before attempting to locate, load and compile it. To always
  * load a new instance of the specified bank, use the A2_NOSHARED flag.
  *
+ * If there is a precompiled bank file (see a2_SaveBank()) next to the script,
+ * that was compiled from the current versions of the script and its imports,
+ * with the same compiler flags, a2_Load() loads that instead of compiling the
+ * script. Use the A2_NOCOMPILED flag to always compile the script.
+ *
+ * With the A2_NATIVE flag (here, or in the config), a2_Load() also looks for
+ * a native code module (see a2_vm.h) next to the script. Native code modules
+ * are shared objects, so loading one runs arbitrary code; only use A2_NATIVE
+ * with trusted files.
+ *
  * Returns the handle of the resulting bank, or if the operation fails, a
  * negative error code. (Use (-result) to get the A2_errors code.)
  */
 A2_handle a2_LoadString(A2_interface *i, const char *code, const char *name);
 A2_handle a2_Load(A2_interface *i, const char *fn, unsigned flags);
 
+/*
+ * Save the compiled bank 'bank' as the precompiled bank file 'fn'. a2_Load()
+ * looks for these next to scripts, with the extension ".a2b".
+ *
+ * Precompiled bank files are specific to the engine version and to the
+ * A2_NOOPTIMIZE config flag. Objects from imported banks are referred to by
+ * name, so imported banks must be available under the same names as when the
+ * bank was compiled. Imports found next to the script are looked for next to
+ * the bank file instead, so the two can be moved together.
+ */
+A2_errors a2_SaveBank(A2_interface *i, A2_handle bank, const char *fn);
+
+/*
+ * Load precompiled bank file 'fn'. This fails with A2_OUTOFDATE if the file
+ * was written by another engine version or with other compiler flags, if the
+ * script the bank was compiled from (same path and name, extension ".a2s")
+ * exists and has been changed since, or if any scripts imported by the bank,
+ * directly or indirectly, have been changed since. Files with invalid code or
+ * voice structures are rejected with A2_BADFORMAT.
+ *
+ * Returns the handle of the bank, or a negative error code.
+ */
+A2_handle a2_LoadCompiled(A2_interface *i, const char *fn, unsigned flags);
+
 /*
  * Create a constant object of 'value'. Returns the handle of the constant
  * object, or a negative error code.
@@ -597,6 +640,13 @@ unsigned a2_Sleep(unsigned milliseconds);
 A2_errors a2_DumpCode(A2_interface *i, A2_handle h, FILE *stream,
 		const char *prefix);
 
+/*
+ * Write C source code for a native code module (see a2_vm.h), covering the
+ * VM code of the specified program, or of all programs in the specified bank.
+ * Only some instructions are translated; the rest are left to the VM.
+ */
+A2_errors a2_WriteNative(A2_interface *i, A2_handle h, FILE *stream);
+
 /*TODO*/
 /* Calculate size of converted data */
 int a2_ConvertSize(A2_interface *i, A2_sampleformats infmt,
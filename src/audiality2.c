@@ -182,27 +182,27 @@ static int a2_unlock_all(A2_state *st)
 /* Array of builtin units to register */
 static const A2_unitdesc *a2_core_units[] = {
 	&a2_inline_unitdesc,
-	&a2_wtosc_unitdesc,
-	&a2_panmix_unitdesc,
+	&a2_wtosc_unitdesc.d,
+	&a2_panmix_unitdesc.d,
 	&a2_xsink_unitdesc,
 	&a2_xsource_unitdesc,
 	&a2_xinsert_unitdesc,
 	&a2_dbgunit_unitdesc,
-	&a2_limiter_unitdesc,
+	&a2_limiter_unitdesc.d,
 	&a2_fbdelay_unitdesc,
-	&a2_filter12_unitdesc,
-	&a2_dcblock_unitdesc,
-	&a2_waveshaper_unitdesc,
-	&a2_fm1_unitdesc,
-	&a2_fm2_unitdesc,
-	&a2_fm3_unitdesc,
-	&a2_fm4_unitdesc,
-	&a2_fm3p_unitdesc,
-	&a2_fm4p_unitdesc,
-	&a2_fm2r_unitdesc,
-	&a2_fm4r_unitdesc,
-	&a2_dc_unitdesc,
-	&a2_env_unitdesc,
+	&a2_filter12_unitdesc.d,
+	&a2_dcblock_unitdesc.d,
+	&a2_waveshaper_unitdesc.d,
+	&a2_fm1_unitdesc.d,
+	&a2_fm2_unitdesc.d,
+	&a2_fm3_unitdesc.d,
+	&a2_fm4_unitdesc.d,
+	&a2_fm3p_unitdesc.d,
+	&a2_fm4p_unitdesc.d,
+	&a2_fm2r_unitdesc.d,
+	&a2_fm4r_unitdesc.d,
+	&a2_dc_unitdesc.d,
+	&a2_env_unitdesc.d,
 	NULL
 };
 
@@ -225,6 +225,15 @@ static A2_errors a2_OpenSharedState(A2_state *st)
 
 	st->ss->tabsize = 8;
 
+	st->ss->warmvoices = A2_WARMVOICES;
+
+	if((res = a2_MutexOpen(&st->ss->offlinemtx)))
+	{
+		free(st->ss);
+		st->ss = NULL;
+		return res;
+	}
+
 	/* Init handle manager */
 	if((res = (A2_errors)rchm_Init(&st->ss->hm, A2_INITHANDLES)))
 		return res;
@@ -322,6 +331,9 @@ static void a2_CloseSharedState(A2_state *st)
 		return;
 	type_registry_cleanup(st);
 	rchm_Cleanup(&st->ss->hm);
+	a2_CloseNative(st->ss);
+	free(st->ss->wavecache);
+	a2_MutexClose(&st->ss->offlinemtx);
 	free(st->ss->units);
 	free(st->ss);
 	st->ss = NULL;
@@ -402,11 +414,19 @@ static A2_state *a2_Open0(A2_config *config)
 }
 
 
+/*
+ * Initial size of each memory block pool, in 1/16ths of 'blockpool', so that
+ * 'blockpool' is the total number of blocks. (Must add up to 16!)
+ */
+static const int a2_slabinit[A2_SLABCLASSES] = {
+	2, 5, 5, 2, 1, 1
+};
+
 /* Initialize and start up the actual engine of state 'st'! */
 static A2_errors a2_Open2(A2_state *st)
 {
 	A2_errors res;
-	int i;
+	int i, c;
 
 	/* We set up initial pools by default for realtime states! */
 	if(st->config->flags & A2_REALTIME)
@@ -425,14 +445,20 @@ static A2_errors a2_Open2(A2_state *st)
 			st->config->eventpool = -1;
 	}
 
-	/* Prepare memory block pool */
-	for(i = 0; i < st->config->blockpool; ++i)
+	/* Prepare memory block pools */
+	for(c = 0; c < A2_SLABCLASSES; ++c)
 	{
-		A2_block *b = st->sys->RTAlloc(st->sys, sizeof(A2_block));
-		if(!b)
-			return A2_OOMEMORY;
-		b->next = st->blockpool;
-		st->blockpool = b;
+		A2_slab *s = st->slabs + c;
+		int n = st->config->blockpool * a2_slabinit[c] / 16;
+		for(i = 0; i < n; ++i)
+		{
+			A2_block *b = st->sys->RTAlloc(st->sys, a2_SlabSize(c));
+			if(!b)
+				return A2_OOMEMORY;
+			b->next = s->pool;
+			s->pool = b;
+			++s->count;
+		}
 	}
 
 	/* Set up master audio bus */
@@ -447,6 +473,7 @@ static A2_errors a2_Open2(A2_state *st)
 			return A2_OOMEMORY;
 		v->next = st->voicepool;
 		st->voicepool = v;
+		++st->nvoicepool;
 	}
 
 	/* Initialize the realtime control API */
@@ -500,10 +527,24 @@ static A2_errors a2_Open2(A2_state *st)
 	if((res = a2_init_root_voice(st)))
 		return res;
 
+	/* Set up worker pool and processing lanes, if requested */
+	if(st->config->workers > 0)
+		if((res = a2_OpenLanes(st, st->config->workers)))
+			return res;
+
 	/* Open remaining drivers, if any. */
 	if((res = a2_OpenDrivers(st->config, A2_AUTOCLOSE)))
 		return res;
 
+	/*
+	 * Keep the pools of realtime states topped up from a background
+	 * thread, provided the memory manager can deal with that.
+	 */
+	if((st->config->flags & A2_REALTIME) &&
+			(st->sys->driver.flags & A2_THREADSAFE))
+		if((res = a2_OpenHousekeeper(st)))
+			return res;
+
 	/* Install the master process callback! */
 	st->audio->Lock(st->audio);
 	st->audio->state = st;
@@ -574,7 +615,6 @@ A2_interface *a2_OpenVersion(A2_config *config, unsigned headerversion)
 		printf("A2_event:\t%d\n", (int)sizeof(A2_event));
 		printf("A2_apimessage:\t%d\n", (int)sizeof(A2_apimessage));
 		printf("A2_voice:\t%d\n", (int)sizeof(A2_voice));
-		printf("A2_block:\t%d\n", (int)sizeof(A2_block));
 		printf("A2_unit:\t%d\n", (int)sizeof(A2_unit));
 		printf("A2_unitdesc:\t%d\n", (int)sizeof(A2_unitdesc));
 		printf("A2_stream:\t%d\n", (int)sizeof(A2_stream));
@@ -735,6 +775,9 @@ static void a2_CloseState(A2_state *st)
 		}
 	}
 
+	/* Stop pool housekeeping, now that the engine is detached */
+	a2_CloseHousekeeper(st);
+
 	/* Master state? */
 	if(!(st->config->flags & A2_SUBSTATE) && st->ss)
 	{
@@ -770,6 +813,9 @@ static void a2_CloseState(A2_state *st)
 			a2_VoiceFree(st, (A2_voice **)&hi->d.data);
 		rchm_Free(&st->ss->hm, st->rootvoice);
 	}
+	if(st->lanes)
+		a2_CloseLanes(st);
+	a2_FlushWarmVoices(st, NULL);
 
 	/*
 	 * Must do this last thing, because destroying the root voice may
@@ -789,12 +835,13 @@ static void a2_CloseState(A2_state *st)
 		st->voicepool = v->next;
 		st->sys->RTFree(st->sys, v);
 	}
-	while(st->blockpool)
-	{
-		A2_block *b = st->blockpool;
-		st->blockpool = b->next;
-		st->sys->RTFree(st->sys, b);
-	}
+	for(j = 0; j < A2_SLABCLASSES; ++j)
+		while(st->slabs[j].pool)
+		{
+			A2_block *b = st->slabs[j].pool;
+			st->slabs[j].pool = b->next;
+			st->sys->RTFree(st->sys, b);
+		}
 
 	/* Close any unit shared state for this engine state */
 	if(st->unitstate)
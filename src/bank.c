@@ -75,6 +75,7 @@ static RCHM_errors a2_ProgramDestructor(RCHM_handleinfo *hi, void *ti,
 	for(i = 0; i < p->nfuncs; ++i)
 		free(p->funcs[i].code);
 	free(p->funcs);
+	free(p->relocs);
 	free(p);
 	return RCHM_OK;
 }
@@ -100,6 +101,65 @@ static RCHM_errors a2_StringDestructor(RCHM_handleinfo *hi, void *ti,
 	return RCHM_OK;
 }
 
+A2_errors a2_TranslateHandles(A2_program *p, unsigned func,
+		unsigned *code, int *argdefs, A2_handlemap_cb map,
+		void *userdata)
+{
+	unsigned pos, j;
+	unsigned size = p->funcs[func].size;
+	int v;
+	for(pos = 0; pos < size; )
+	{
+		A2_instruction *ins = (A2_instruction *)(code + pos);
+		if(ins->opcode >= A2_OPCODES)
+			return A2_BADFORMAT;
+		switch((A2_opcodes)ins->opcode)
+		{
+		  case OP_SPAWN:
+		  case OP_SPAWNV:
+		  case OP_SPAWND:
+		  case OP_SPAWNA:
+		  case OP_SIZEOF:
+		  case OP_SIZEOFC:
+			if((v = map(userdata, ins->a2)) < 0)
+				return -v;
+			if(v > 0xffff)
+				return A2_BADIMMARG;
+			if(v != ins->a2)
+				ins->a2 = v;
+			break;
+		  default:
+			break;
+		}
+		pos += a2_InsSize(ins->opcode);
+	}
+	for(j = 0; j < p->nrelocs; ++j)
+	{
+		A2_reloc *r = p->relocs + j;
+		int *x;
+		if(r->func != func)
+			continue;
+		if(r->arg)
+		{
+			if(r->arg > A2_MAXARGS)
+				return A2_BADFORMAT;
+			x = argdefs + r->arg - 1;
+		}
+		else
+		{
+			if(r->pos >= size)
+				return A2_BADFORMAT;
+			x = (int *)(code + r->pos);
+		}
+		if((v = map(userdata, (unsigned)*x >> 16)) < 0)
+			return -v;
+		if(v != (unsigned)*x >> 16)
+			*x = (unsigned)v << 16;
+	}
+	return A2_OK;
+}
+
+
 A2_errors a2_RegisterBankTypes(A2_state *st)
 {
 	A2_errors res = a2_RegisterType(st, A2_TBANK, "bank",
@@ -180,18 +240,24 @@ A2_handle a2_LoadString(A2_interface *i, const char *code, const char *name)
 
 A2_handle a2_Load(A2_interface *i, const char *fn, unsigned flags)
 {
+	A2_interface_i *ii = (A2_interface_i *)i;
+	A2_state *st = ii->state;
 	int res;
 	A2_handle h;
 	A2_compiler *c;
 	char *fnx = NULL;
+	const char *x = strrchr(fn, '.');
+	const char *slash = strrchr(fn, '/');
 	/* If there's no extension, add ".a2s" */
-	if(!strchr(fn, '.'))
+	if(!x || (slash && (x < slash)))
 	{
 		fnx = malloc(strlen(fn) + 4 + 1);
 		strcpy(fnx, fn);
 		strcpy(fnx + strlen(fn), ".a2s");
 		fn = fnx;
 	}
+	else if(!strcmp(x, ".a2b"))
+		return a2_LoadCompiled(i, fn, flags);
 #if 0
 	/* TODO: */
 	flags |= st->config->flags & A2_INITFLAGS;
@@ -201,6 +267,23 @@ A2_handle a2_Load(A2_interface *i, const char *fn, unsigned flags)
 
 	}
 #endif
+	if(!((flags | st->config->flags) & A2_NOCOMPILED))
+	{
+		/* Try to load a precompiled bank first */
+		if((h = a2_NewBank(i, fn, A2_APIOWNED)) < 0)
+		{
+			free(fnx);
+			return h;
+		}
+		if(a2_LoadPrecompiled(i, h, fn) == A2_OK)
+		{
+			if((flags | st->config->flags) & A2_NATIVE)
+				a2_LoadNative(st, h, fn);
+			free(fnx);
+			return h;
+		}
+		a2_Release(i, h);
+	}
 	if(!(c = a2_OpenCompiler(i, 0)))
 	{
 		free(fnx);
@@ -219,6 +302,9 @@ A2_handle a2_Load(A2_interface *i, const char *fn, unsigned flags)
 		a2_Release(i, h);
 		return -res;
 	}
+	/* Pick up native code for the bank, if available */
+	if((flags | st->config->flags) & A2_NATIVE)
+		a2_LoadNative(st, h, fn);
 	free(fnx);
 	a2_CloseCompiler(c);
 	return h;
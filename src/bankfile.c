@@ -0,0 +1,1335 @@
+/*
+ * bankfile.c - Audiality 2 precompiled bank files
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * A precompiled bank file (".a2b") is a snapshot of a compiled bank. It holds
+ * the objects of the bank in an object table, followed by the exports, private
+ * objects and dependencies of the bank, referring to objects by table index.
+ * Handles in VM code and argument defaults are translated into object indices
+ * as well, so that they can be translated back to handles when loading.
+ *
+ * Programs, strings, constants and rendered waves of the bank are stored in
+ * full. Imported banks are stored by name, and are loaded with a2_Load().
+ * Imports that were found next to the script are resolved relative to the bank
+ * file when loading. Objects exported by imported banks or the root bank
+ * (builtin waves, units etc) are stored as export names, and are looked up when
+ * loading. Units of voice structures are also stored by name.
+ *
+ * A bank file is only used with the engine version and compiler flags it was
+ * written with, and only if neither the script, nor any of the scripts it
+ * imports, directly or indirectly, have changed since. VM code and voice
+ * structures are validated when loading, so that a corrupt file cannot send
+ * the VM outside the code, registers or tables of a program.
+ *
+ * File layout (all values 32 bit, native byte order, unless noted):
+ *	"A2B\0"
+ *	A2_BANKFILEVERSION
+ *	A2_VERSION
+ *	A2_OPCODES
+ *	Compiler flags (A2_BANKFILEFLAGS)
+ *	Size of the script source code, or 0 if unknown
+ *	Hash of the script source code
+ *	Number of objects, followed by the objects
+ *	Number of exports, followed by <name, object index> items
+ *	Number of private objects, followed by <name, object index> items
+ *	Number of dependencies, followed by object indices
+ *
+ * Strings are stored as a length, followed by the characters, without a null
+ * terminator.
+ *
+ * Values are stored in native byte order, so a file written on a machine of
+ * different endianness will fail the version check, and be considered stale.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internals.h"
+
+#define	A2_BANKFILEVERSION	2
+
+/* A2_config flags that affect the code generated by the compiler */
+#define	A2_BANKFILEFLAGS	A2_NOOPTIMIZE
+
+/* Sanity limit for strings and names */
+#define	A2_BANKFILEMAXSTRING	0x1000000
+
+/* Import flags */
+#define	A2BF_LOCALIMPORT	0x00000001	/* Relative to the bank file */
+
+typedef enum A2_bfobjects
+{
+	A2BF_IMPORT = 0,	/* Imported bank; flags, name, hash of scripts */
+	A2BF_EXTERNAL,		/* Object index of bank (~0 for root), name */
+	A2BF_PROGRAM,		/* Program, as written by a2bf_WriteProgram() */
+	A2BF_STRING,		/* String */
+	A2BF_CONSTANT,		/* Constant; double */
+	A2BF_WAVE		/* Type, flags, period, size, int16_t data[size] */
+} A2_bfobjects;
+
+typedef struct A2_bankfile A2_bankfile;
+struct A2_bankfile
+{
+	A2_interface	*interface;
+	A2_state	*state;
+	A2_bank		*bank;
+	FILE		*f;
+	A2_errors	status;		/* First error, if any */
+	A2_handletab	objects;	/* Object table; index ==> handle */
+	A2_handletab	owned;		/* Objects created by the loader */
+	const char	*path;		/* Bank file name, when loading */
+};
+
+/*---------------------------------------------------------
+	Utilities
+---------------------------------------------------------*/
+
+static const char a2bf_magic[4] = { 'A', '2', 'B', 0 };
+
+
+/* "<path>/<name>.<anything>" ==> "<path>/<name><ext>" */
+static char *a2bf_SwapExtension(const char *fn, const char *ext)
+{
+	const char *x = strrchr(fn, '.');
+	const char *slash = strrchr(fn, '/');
+	char *path;
+	if(!x || (slash && (x < slash)))
+		x = fn + strlen(fn);
+	if(!(path = malloc((x - fn) + strlen(ext) + 1)))
+		return NULL;
+	memcpy(path, fn, x - fn);
+	strcpy(path + (x - fn), ext);
+	return path;
+}
+
+
+/* Length of the directory part of 'fn', or -1 if there is none */
+static int a2bf_DirLength(const char *fn)
+{
+	const char *slash = strrchr(fn, '/');
+#ifdef WIN32
+	const char *bslash = strrchr(fn, '\\');
+	if(bslash && (!slash || (bslash > slash)))
+		slash = bslash;
+#endif
+	return slash ? slash - fn : -1;
+}
+
+static inline int a2bf_IsSeparator(char c)
+{
+#ifdef WIN32
+	if(c == '\\')
+		return 1;
+#endif
+	return c == '/';
+}
+
+
+static inline void a2bf_HashAdd(uint32_t *hash, uint32_t v)
+{
+	int i;
+	for(i = 0; i < 4; ++i, v >>= 8)
+		*hash = (*hash ^ (v & 0xff)) * 16777619U;
+}
+
+
+/*
+ * Calculate size and hash (32 bit FNV-1a) of file 'fn'. Returns 0 if the file
+ * was read, or an error code.
+ */
+static A2_errors a2bf_HashFile(const char *fn, uint32_t *size, uint32_t *hash)
+{
+	unsigned char buf[4096];
+	size_t n, i;
+	FILE *f = fopen(fn, "rb");
+	if(!f)
+		return A2_OPEN;
+	*size = 0;
+	*hash = 2166136261U;
+	while((n = fread(buf, 1, sizeof(buf), f)))
+	{
+		for(i = 0; i < n; ++i)
+			*hash = (*hash ^ buf[i]) * 16777619U;
+		*size += n;
+	}
+	if(ferror(f))
+	{
+		fclose(f);
+		return A2_READ;
+	}
+	fclose(f);
+	return A2_OK;
+}
+
+
+/*
+ * Hash the script of bank 'bank', followed by the scripts of the banks it
+ * imports, recursively. Banks that weren't loaded from files add nothing.
+ */
+static void a2bf_HashBank(A2_bankfile *bf, A2_handle bank, uint32_t *hash)
+{
+	A2_bank *b = a2_GetBank(bf->state, bank);
+	uint32_t fsize, fhash;
+	unsigned j;
+	if(!b)
+		return;
+	if(!a2bf_HashFile(b->name, &fsize, &fhash))
+	{
+		a2bf_HashAdd(hash, fsize);
+		a2bf_HashAdd(hash, fhash);
+	}
+	for(j = 0; j < b->deps.nitems; ++j)
+		if(a2_TypeOf(bf->interface, b->deps.items[j]) == A2_TBANK)
+			a2bf_HashBank(bf, b->deps.items[j], hash);
+}
+
+
+static void a2bf_Write(A2_bankfile *bf, const void *data, size_t size)
+{
+	if(!bf->status && size && (fwrite(data, size, 1, bf->f) != 1))
+		bf->status = A2_WRITE;
+}
+
+static void a2bf_Write32(A2_bankfile *bf, uint32_t v)
+{
+	a2bf_Write(bf, &v, sizeof(v));
+}
+
+static void a2bf_WriteString(A2_bankfile *bf, const char *s)
+{
+	a2bf_Write32(bf, strlen(s));
+	a2bf_Write(bf, s, strlen(s));
+}
+
+
+static void a2bf_Read(A2_bankfile *bf, void *data, size_t size)
+{
+	if(bf->status)
+		memset(data, 0, size);
+	else if(size && (fread(data, size, 1, bf->f) != 1))
+	{
+		memset(data, 0, size);
+		bf->status = A2_READ;
+	}
+}
+
+static uint32_t a2bf_Read32(A2_bankfile *bf)
+{
+	uint32_t v;
+	a2bf_Read(bf, &v, sizeof(v));
+	return v;
+}
+
+/* Read string into a new buffer. Returns NULL if the operation fails. */
+static char *a2bf_ReadString(A2_bankfile *bf)
+{
+	char *s;
+	uint32_t len = a2bf_Read32(bf);
+	if(bf->status)
+		return NULL;
+	if(len > A2_BANKFILEMAXSTRING)
+	{
+		bf->status = A2_BADFORMAT;
+		return NULL;
+	}
+	if(!(s = malloc(len + 1)))
+	{
+		bf->status = A2_OOMEMORY;
+		return NULL;
+	}
+	a2bf_Read(bf, s, len);
+	s[len] = 0;
+	if(bf->status)
+	{
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+
+/*---------------------------------------------------------
+	Saving
+---------------------------------------------------------*/
+
+/* Return the name 'h' is exported as from bank 'bank', or NULL */
+static const char *a2bf_ExportName(A2_bankfile *bf, A2_handle bank,
+		A2_handle h)
+{
+	int x;
+	A2_bank *b = a2_GetBank(bf->state, bank);
+	if(!b || ((x = a2nt_FindItemByHandle(&b->exports, h)) < 0))
+		return NULL;
+	return b->exports.items[x].name;
+}
+
+
+/*
+ * Figure out how object 'h' is to be stored. For A2BF_EXTERNAL, the object
+ * index of the exporting bank (-1 for the root bank) and the export name are
+ * returned via 'bank' and 'name'. Returns -1 if the object can't be stored.
+ */
+static int a2bf_Kind(A2_bankfile *bf, A2_handle h, int *bank,
+		const char **name)
+{
+	A2_bank *b = bf->bank;
+	A2_otypes type = a2_TypeOf(bf->interface, h);
+	unsigned j;
+	if(a2ht_FindItem(&b->deps, h) >= 0)
+		switch(type)
+		{
+		  case A2_TBANK:	return A2BF_IMPORT;
+		  case A2_TPROGRAM:	return A2BF_PROGRAM;
+		  case A2_TSTRING:	return A2BF_STRING;
+		  default:		break;
+		}
+
+	/* Exported by the root bank, or by an imported bank? */
+	if((*name = a2bf_ExportName(bf, A2_ROOTBANK, h)))
+	{
+		*bank = -1;
+		return A2BF_EXTERNAL;
+	}
+	for(j = 0; j < b->deps.nitems; ++j)
+	{
+		A2_handle dh = b->deps.items[j];
+		if(a2_TypeOf(bf->interface, dh) != A2_TBANK)
+			continue;
+		if((*name = a2bf_ExportName(bf, dh, h)))
+		{
+			*bank = a2ht_FindItem(&bf->objects, dh);
+			return A2BF_EXTERNAL;
+		}
+	}
+
+	/* Local object, not listed as a dependency */
+	switch(type)
+	{
+	  case A2_TPROGRAM:	return A2BF_PROGRAM;
+	  case A2_TSTRING:	return A2BF_STRING;
+	  case A2_TCONSTANT:	return A2BF_CONSTANT;
+	  case A2_TWAVE:	return A2BF_WAVE;
+	  default:		return -1;
+	}
+}
+
+
+/* Add 'h' to the object table, unless it's already in there */
+static int a2bf_AddObject(void *userdata, A2_handle h)
+{
+	A2_bankfile *bf = (A2_bankfile *)userdata;
+	int res;
+	if(a2ht_FindItem(&bf->objects, h) >= 0)
+		return h;
+	if((res = a2ht_AddItem(&bf->objects, h)) < 0)
+		return res;
+	return h;
+}
+
+
+/* Handle to object index */
+static int a2bf_HandleIndex(void *userdata, A2_handle h)
+{
+	A2_bankfile *bf = (A2_bankfile *)userdata;
+	int x = a2ht_FindItem(&bf->objects, h);
+	if(x < 0)
+		return -A2_INTERNAL;
+	return x;
+}
+
+
+/*
+ * Build the object table. Imported banks go first, so that external objects
+ * can always refer back to the banks they're exported from.
+ */
+static A2_errors a2bf_CollectObjects(A2_bankfile *bf)
+{
+	A2_bank *b = bf->bank;
+	unsigned j, k;
+	int res;
+	for(j = 0; j < b->deps.nitems; ++j)
+		if(a2_TypeOf(bf->interface, b->deps.items[j]) == A2_TBANK)
+			if((res = a2bf_AddObject(bf, b->deps.items[j])) < 0)
+				return -res;
+	for(j = 0; j < b->deps.nitems; ++j)
+		if((res = a2bf_AddObject(bf, b->deps.items[j])) < 0)
+			return -res;
+	for(j = 0; j < b->exports.nitems; ++j)
+		if((res = a2bf_AddObject(bf, b->exports.items[j].handle)) < 0)
+			return -res;
+	for(j = 0; j < b->private.nitems; ++j)
+		if((res = a2bf_AddObject(bf, b->private.items[j].handle)) < 0)
+			return -res;
+
+	/* Add objects referenced by programs, as we go */
+	for(j = 0; j < bf->objects.nitems; ++j)
+	{
+		A2_handle h = bf->objects.items[j];
+		A2_program *p = a2_GetProgram(bf->state, h);
+		int bank;
+		const char *name;
+		if(!p || (a2bf_Kind(bf, h, &bank, &name) != A2BF_PROGRAM))
+			continue;
+		for(k = 0; k < p->nfuncs; ++k)
+		{
+			A2_function *fn = p->funcs + k;
+			int argdefs[A2_MAXARGS];
+			unsigned *code = malloc(fn->size * sizeof(unsigned));
+			if(!code)
+				return A2_OOMEMORY;
+			memcpy(code, fn->code, fn->size * sizeof(unsigned));
+			memcpy(argdefs, fn->argdefs, sizeof(argdefs));
+			res = a2_TranslateHandles(p, k, code, argdefs,
+					a2bf_AddObject, bf);
+			free(code);
+			if(res)
+				return res;
+		}
+	}
+	return A2_OK;
+}
+
+
+static A2_errors a2bf_WriteProgram(A2_bankfile *bf, A2_program *p)
+{
+	A2_structitem *si;
+	unsigned j, n;
+	A2_errors res;
+	a2bf_Write(bf, p->eps, sizeof(p->eps));
+	a2bf_Write32(bf, p->vflags);
+	a2bf_Write32(bf, p->buffers);
+	a2bf_Write32(bf, p->nfuncs);
+	for(j = 0; j < p->nfuncs; ++j)
+	{
+		A2_function *fn = p->funcs + j;
+		int argdefs[A2_MAXARGS];
+		unsigned *code = malloc(fn->size * sizeof(unsigned));
+		if(!code)
+			return A2_OOMEMORY;
+		memcpy(code, fn->code, fn->size * sizeof(unsigned));
+		memcpy(argdefs, fn->argdefs, sizeof(argdefs));
+		if((res = a2_TranslateHandles(p, j, code, argdefs,
+				a2bf_HandleIndex, bf)))
+		{
+			free(code);
+			return res;
+		}
+		a2bf_Write32(bf, fn->size);
+		a2bf_Write32(bf, fn->argv);
+		a2bf_Write32(bf, fn->argc);
+		a2bf_Write32(bf, fn->topreg);
+		a2bf_Write(bf, argdefs, sizeof(argdefs));
+		a2bf_Write(bf, code, fn->size * sizeof(unsigned));
+		free(code);
+	}
+
+	/* Units by name, as unit indices depend on registration order */
+	for(n = 0, si = p->units; si; si = si->next)
+		++n;
+	a2bf_Write32(bf, n);
+	for(si = p->units; si; si = si->next)
+	{
+		a2bf_WriteString(bf, bf->state->ss->units[si->kind]->name);
+		a2bf_Write32(bf, si->p.unit.flags);
+		a2bf_Write32(bf, si->p.unit.ninputs);
+		a2bf_Write32(bf, si->p.unit.noutputs);
+	}
+	for(n = 0, si = p->wires; si; si = si->next)
+		++n;
+	a2bf_Write32(bf, n);
+	for(si = p->wires; si; si = si->next)
+	{
+		a2bf_Write32(bf, si->kind);
+		a2bf_Write32(bf, si->p.wire.from_unit);
+		a2bf_Write32(bf, si->p.wire.from_output);
+		a2bf_Write32(bf, si->p.wire.to_register);
+	}
+
+	a2bf_Write32(bf, p->nrelocs);
+	a2bf_Write(bf, p->relocs, p->nrelocs * sizeof(A2_reloc));
+	return bf->status;
+}
+
+
+static A2_errors a2bf_WriteWave(A2_bankfile *bf, A2_handle h)
+{
+	A2_wave *w = a2_GetWave(bf->interface, h);
+	unsigned size = 0;
+	if(!w)
+		return A2_BADWAVE;
+	switch(w->type)
+	{
+	  case A2_WWAVE:
+	  case A2_WMIPWAVE:
+		size = w->d.wave.size[0];
+		break;
+	  default:
+		break;
+	}
+	a2bf_Write32(bf, w->type);
+	a2bf_Write32(bf, w->flags);
+	a2bf_Write32(bf, w->period);
+	a2bf_Write32(bf, size);
+	if(size)
+		a2bf_Write(bf, w->d.wave.data[0] + A2_WAVEPRE,
+				size * sizeof(int16_t));
+	return bf->status;
+}
+
+
+/*
+ * Write import 'h'. The compiler looks for imports next to the script first, so
+ * names starting with the directory of the script are stored relative to that.
+ */
+static void a2bf_WriteImport(A2_bankfile *bf, A2_handle h)
+{
+	const char *name = a2_GetBank(bf->state, h)->name;
+	int dirlen = a2bf_DirLength(bf->bank->name);
+	uint32_t hash = 2166136261U;
+	unsigned flags = 0;
+	if(dirlen < 0)
+	{
+		if(!a2bf_IsSeparator(name[0]))
+			flags |= A2BF_LOCALIMPORT;
+	}
+	else if(!strncmp(name, bf->bank->name, dirlen) &&
+			a2bf_IsSeparator(name[dirlen]))
+	{
+		flags |= A2BF_LOCALIMPORT;
+		name += dirlen + 1;
+	}
+	a2bf_HashBank(bf, h, &hash);
+	a2bf_Write32(bf, flags);
+	a2bf_WriteString(bf, name);
+	a2bf_Write32(bf, hash);
+}
+
+
+static A2_errors a2bf_WriteObject(A2_bankfile *bf, A2_handle h)
+{
+	int bank = -1;
+	const char *name = NULL;
+	int kind = a2bf_Kind(bf, h, &bank, &name);
+	if(kind < 0)
+	{
+		A2_LOG_ERR(bf->interface, "Cannot save object %d (%s) of bank "
+				"\"%s\"!", h, a2_TypeName(bf->interface,
+				a2_TypeOf(bf->interface, h)), bf->bank->name);
+		return A2_NOTIMPLEMENTED;
+	}
+	a2bf_Write32(bf, kind);
+	switch((A2_bfobjects)kind)
+	{
+	  case A2BF_IMPORT:
+		a2bf_WriteImport(bf, h);
+		break;
+	  case A2BF_EXTERNAL:
+		a2bf_Write32(bf, bank);
+		a2bf_WriteString(bf, name);
+		break;
+	  case A2BF_PROGRAM:
+		return a2bf_WriteProgram(bf, a2_GetProgram(bf->state, h));
+	  case A2BF_STRING:
+		a2bf_WriteString(bf, a2_String(bf->interface, h));
+		break;
+	  case A2BF_CONSTANT:
+	  {
+		double v = a2_Value(bf->interface, h);
+		a2bf_Write(bf, &v, sizeof(v));
+		break;
+	  }
+	  case A2BF_WAVE:
+		return a2bf_WriteWave(bf, h);
+	}
+	return bf->status;
+}
+
+
+static void a2bf_WriteNametab(A2_bankfile *bf, A2_nametab *nt)
+{
+	unsigned j;
+	a2bf_Write32(bf, nt->nitems);
+	for(j = 0; j < nt->nitems; ++j)
+	{
+		a2bf_WriteString(bf, nt->items[j].name);
+		a2bf_Write32(bf, a2ht_FindItem(&bf->objects,
+				nt->items[j].handle));
+	}
+}
+
+
+A2_errors a2_SaveBank(A2_interface *i, A2_handle bank, const char *fn)
+{
+	A2_bankfile bf;
+	A2_bank *b;
+	uint32_t size, hash;
+	unsigned j;
+	memset(&bf, 0, sizeof(bf));
+	bf.interface = i;
+	bf.state = ((A2_interface_i *)i)->state;
+	if(!(b = bf.bank = a2_GetBank(bf.state, bank)))
+		return A2_BADBANK;
+	if((bf.status = a2bf_CollectObjects(&bf)))
+	{
+		a2ht_Cleanup(&bf.objects);
+		return bf.status;
+	}
+	if(!(bf.f = fopen(fn, "wb")))
+	{
+		a2ht_Cleanup(&bf.objects);
+		return A2_OPEN;
+	}
+
+	/* The bank name is the script file name, unless loaded from string */
+	if(a2bf_HashFile(b->name, &size, &hash))
+		size = hash = 0;
+
+	a2bf_Write(&bf, a2bf_magic, sizeof(a2bf_magic));
+	a2bf_Write32(&bf, A2_BANKFILEVERSION);
+	a2bf_Write32(&bf, A2_VERSION);
+	a2bf_Write32(&bf, A2_OPCODES);
+	a2bf_Write32(&bf, bf.state->config->flags & A2_BANKFILEFLAGS);
+	a2bf_Write32(&bf, size);
+	a2bf_Write32(&bf, hash);
+	a2bf_Write32(&bf, bf.objects.nitems);
+	for(j = 0; (j < bf.objects.nitems) && !bf.status; ++j)
+		bf.status = a2bf_WriteObject(&bf, bf.objects.items[j]);
+	a2bf_WriteNametab(&bf, &b->exports);
+	a2bf_WriteNametab(&bf, &b->private);
+	a2bf_Write32(&bf, b->deps.nitems);
+	for(j = 0; j < b->deps.nitems; ++j)
+		a2bf_Write32(&bf, a2ht_FindItem(&bf.objects,
+				b->deps.items[j]));
+
+	if(fclose(bf.f) && !bf.status)
+		bf.status = A2_WRITE;
+	if(bf.status)
+		remove(fn);
+	a2ht_Cleanup(&bf.objects);
+	return bf.status;
+}
+
+
+/*---------------------------------------------------------
+	Loading
+---------------------------------------------------------*/
+
+/* Object index to handle */
+static int a2bf_IndexHandle(void *userdata, int x)
+{
+	A2_bankfile *bf = (A2_bankfile *)userdata;
+	if((x < 0) || (x >= (int)bf->objects.nitems))
+		return -A2_BADFORMAT;
+	return bf->objects.items[x];
+}
+
+
+/* Find unit by name. Returns the unit index, or -1 if not found. */
+static int a2bf_FindUnit(A2_bankfile *bf, const char *name)
+{
+	A2_sharedstate *ss = bf->state->ss;
+	int j;
+	for(j = 0; j < ss->nunits; ++j)
+		if(!strcmp(ss->units[j]->name, name))
+			return j;
+	return -1;
+}
+
+
+static A2_structitem *a2bf_ReadStructItems(A2_bankfile *bf, int units)
+{
+	A2_structitem *list = NULL;
+	A2_structitem **last = &list;
+	uint32_t n = a2bf_Read32(bf);
+	while(n-- && !bf->status)
+	{
+		A2_structitem *si = calloc(1, sizeof(A2_structitem));
+		if(!si)
+		{
+			bf->status = A2_OOMEMORY;
+			break;
+		}
+		*last = si;
+		last = &si->next;
+		if(units)
+		{
+			char *name = a2bf_ReadString(bf);
+			if(!name)
+				break;
+			if((si->kind = a2bf_FindUnit(bf, name)) < 0)
+			{
+				A2_LOG_ERR(bf->interface, "Unit '%s' not found!",
+						name);
+				bf->status = A2_NOTFOUND;
+			}
+			free(name);
+			si->p.unit.flags = a2bf_Read32(bf);
+			si->p.unit.ninputs = a2bf_Read32(bf);
+			si->p.unit.noutputs = a2bf_Read32(bf);
+		}
+		else
+		{
+			si->kind = a2bf_Read32(bf);
+			si->p.wire.from_unit = a2bf_Read32(bf);
+			si->p.wire.from_output = a2bf_Read32(bf);
+			si->p.wire.to_register = a2bf_Read32(bf);
+		}
+	}
+	return list;
+}
+
+
+/* Register operands of VM instructions */
+#define	A2BF_A1REG	0x01
+#define	A2BF_A2REG	0x02
+
+static unsigned a2bf_RegOperands(A2_opcodes op)
+{
+	switch(a2_PlainVariant(op))
+	{
+	  case OP_LOOP:
+	  case OP_JZ:
+	  case OP_JNZ:
+	  case OP_JG:
+	  case OP_JL:
+	  case OP_JGE:
+	  case OP_JLE:
+	  case OP_DELAYR:
+	  case OP_TDELAYR:
+	  case OP_LOAD:
+	  case OP_ADD:
+	  case OP_MUL:
+	  case OP_MOD:
+	  case OP_QUANT:
+	  case OP_RAND:
+	  case OP_SET:
+	  case OP_RAMP:
+	  case OP_RAMPALLR:
+	  case OP_PUSHR:
+	  case OP_SPAWNDR:
+	  case OP_SPAWNV:
+	  case OP_SPAWNAR:
+	  case OP_SENDR:
+	  case OP_KILLR:
+	  case OP_DETACHR:
+	  case OP_DEBUGR:
+	  case OP_SIZEOF:
+	  case OP_LDSET:
+	  case OP_ADDSET:
+	  case OP_LDRAMP:
+		return A2BF_A1REG;
+	  case OP_SUBR:
+	  case OP_DIVR:
+	  case OP_P2DR:
+	  case OP_NEGR:
+	  case OP_LOADR:
+	  case OP_ADDR:
+	  case OP_MULR:
+	  case OP_MODR:
+	  case OP_QUANTR:
+	  case OP_RANDR:
+	  case OP_GR:
+	  case OP_LR:
+	  case OP_GER:
+	  case OP_LER:
+	  case OP_EQR:
+	  case OP_NER:
+	  case OP_ANDR:
+	  case OP_ORR:
+	  case OP_XORR:
+	  case OP_NOTR:
+	  case OP_RAMPR:
+	  case OP_SPAWNVR:
+	  case OP_SIZEOFR:
+	  case OP_LDRSET:
+	  case OP_LDRRAMP:
+	  case OP_GRJZ:
+	  case OP_LRJZ:
+	  case OP_GERJZ:
+	  case OP_LERJZ:
+	  case OP_EQRJZ:
+	  case OP_NERJZ:
+		return A2BF_A1REG | A2BF_A2REG;
+	  case OP_SPAWNR:
+		return A2BF_A2REG;
+	  default:
+		return 0;
+	}
+}
+
+
+/*
+ * Mark the instruction start positions of function 'fn' in 'starts', which is
+ * 'fn->size' bytes. Fails if there are invalid opcodes, if the last instruction
+ * doesn't fit, or if execution can run off the end of the function.
+ */
+static A2_errors a2bf_MarkInstructions(A2_function *fn, uint8_t *starts)
+{
+	unsigned pc = 0;
+	A2_opcodes op = OP_END;
+	while(pc < fn->size)
+	{
+		unsigned size;
+		op = ((A2_instruction *)(fn->code + pc))->opcode;
+		if(op >= A2_OPCODES)
+			return A2_BADFORMAT;
+		if((size = a2_InsSize(op)) > fn->size - pc)
+			return A2_BADFORMAT;
+		starts[pc] = 1;
+		pc += size;
+	}
+	if((op != OP_END) && (op != OP_RETURN) && (op != OP_JUMP))
+		return A2_BADFORMAT;
+	return A2_OK;
+}
+
+
+/*
+ * Check that register, function and entry point operands of the code of
+ * function 'fn' of 'p' are in range, and that branches land on instructions.
+ * 'starts' and 'mainstarts' are the instruction starts of 'fn' and of the main
+ * function, which WAKE and FORCE branch into. Handle operands are checked by
+ * a2_TranslateHandles().
+ */
+static A2_errors a2bf_CheckCode(A2_program *p, A2_function *fn,
+		const uint8_t *starts, const uint8_t *mainstarts)
+{
+	A2_instruction *ins;
+	unsigned pc;
+	if((fn->argc > A2_MAXARGS) || (fn->argv + fn->argc > p->nregs))
+		return A2_BADFORMAT;
+	for(pc = 0; pc < fn->size; pc += a2_InsSize(ins->opcode))
+	{
+		unsigned regs;
+		int target = -1;
+		ins = (A2_instruction *)(fn->code + pc);
+		regs = a2bf_RegOperands(ins->opcode);
+		if(((regs & A2BF_A1REG) && (ins->a1 >= p->nregs)) ||
+				((regs & A2BF_A2REG) && (ins->a2 >= p->nregs)))
+			return A2_BADFORMAT;
+		switch(ins->opcode)
+		{
+		  case OP_CALL:
+			if(ins->a2 >= p->nfuncs)
+				return A2_BADFORMAT;
+			break;
+		  case OP_WAKE:
+		  case OP_FORCE:
+			if((ins->a2 >= p->funcs[0].size) ||
+					!mainstarts[ins->a2])
+				return A2_BADFORMAT;
+			break;
+		  case OP_SEND:
+		  case OP_SENDR:
+		  case OP_SENDA:
+		  case OP_SENDS:
+			if(ins->a2 >= A2_MAXEPS)
+				return A2_BADFORMAT;
+			break;
+		  case OP_GRJZ:
+		  case OP_LRJZ:
+		  case OP_GERJZ:
+		  case OP_LERJZ:
+		  case OP_EQRJZ:
+		  case OP_NERJZ:
+			target = (int)pc + ins->a3;
+			break;
+		  default:
+			if(a2_IsBranch(ins->opcode))
+				target = (int)pc + (int16_t)ins->a2;
+			break;
+		}
+		if((target != -1) && ((target < 0) || (target >= fn->size) ||
+				!starts[target]))
+			return A2_BADFORMAT;
+	}
+	return A2_OK;
+}
+
+
+/* Check the code of all functions of 'p' */
+static A2_errors a2bf_CheckFunctions(A2_program *p)
+{
+	A2_errors res = A2_OK;
+	uint8_t *starts[256];
+	unsigned j;
+	memset(starts, 0, sizeof(starts));
+	for(j = 0; (j < p->nfuncs) && !res; ++j)
+		if(!(starts[j] = calloc(p->funcs[j].size, 1)))
+			res = A2_OOMEMORY;
+		else
+			res = a2bf_MarkInstructions(p->funcs + j, starts[j]);
+	for(j = 0; (j < p->nfuncs) && !res; ++j)
+		res = a2bf_CheckCode(p, p->funcs + j, starts[j], starts[0]);
+	for(j = 0; j < p->nfuncs; ++j)
+		free(starts[j]);
+	return res;
+}
+
+
+/*
+ * Check that the units of 'p' are given channel counts that their descriptors
+ * and the voice scratch buffers can handle, and that wires are of known kinds.
+ */
+static A2_errors a2bf_CheckStruct(A2_bankfile *bf, A2_program *p)
+{
+	A2_structitem *si;
+	int buffers = p->buffers < 0 ? -p->buffers : p->buffers;
+	if(buffers > A2_MAXCHANNELS)
+		return A2_BADFORMAT;
+	for(si = p->units; si; si = si->next)
+	{
+		const A2_unitdesc *ud = bf->state->ss->units[si->kind];
+		int ni = si->p.unit.ninputs;
+		int no = si->p.unit.noutputs;
+		if(ni == A2_IO_MATCHOUT)
+		{
+			if(p->buffers >= 0)
+				return A2_BADFORMAT;
+		}
+		else if((ni < ud->mininputs) || (ni > ud->maxinputs) ||
+				(ni > buffers))
+			return A2_BADFORMAT;
+		if(no == A2_IO_MATCHOUT)
+		{
+			if(p->buffers >= 0)
+				return A2_BADFORMAT;
+		}
+		else if(no != A2_IO_WIREOUT)
+		{
+			if((no < 0) || (no > ud->maxoutputs) || (no > buffers))
+				return A2_BADFORMAT;
+			if(!(ud->flags & A2_MATCHIO) && (no < ud->minoutputs))
+				return A2_BADFORMAT;
+		}
+	}
+	for(si = p->wires; si; si = si->next)
+		if((si->kind != A2_SI_CONTROL_WIRE) &&
+				(si->kind != A2_SI_AUDIO_WIRE))
+			return A2_BADFORMAT;
+	return A2_OK;
+}
+
+
+/*
+ * Read program into 'p', which is registered with the engine, so that the
+ * destructor can clean up if this fails. Handle operands are translated later,
+ * when all objects are loaded.
+ */
+static A2_errors a2bf_ReadProgram(A2_bankfile *bf, A2_program *p)
+{
+	A2_errors res;
+	unsigned j, nfuncs;
+	p->nregs = A2_FIXEDREGS;
+	a2bf_Read(bf, p->eps, sizeof(p->eps));
+	p->vflags = a2bf_Read32(bf);
+	p->buffers = a2bf_Read32(bf);
+	nfuncs = a2bf_Read32(bf);
+	if(bf->status)
+		return bf->status;
+	if(!nfuncs || (nfuncs > 255) || (p->vflags & ~A2_SUBINLINE))
+		return A2_BADFORMAT;
+	if(!(p->funcs = calloc(nfuncs, sizeof(A2_function))))
+		return A2_OOMEMORY;
+	for(p->nfuncs = 0; p->nfuncs < nfuncs; ++p->nfuncs)
+	{
+		A2_function *fn = p->funcs + p->nfuncs;
+		uint32_t size = a2bf_Read32(bf);
+		uint32_t topreg;
+		fn->argv = a2bf_Read32(bf);
+		fn->argc = a2bf_Read32(bf);
+		fn->topreg = topreg = a2bf_Read32(bf);
+		a2bf_Read(bf, fn->argdefs, sizeof(fn->argdefs));
+		if(bf->status)
+			return bf->status;
+		if(!size || (size > 0xffff) || (topreg >= A2_REGISTERS))
+			return A2_BADFORMAT;
+		if(topreg >= p->nregs)
+			p->nregs = topreg + 1;
+		if(!(fn->code = malloc(size * sizeof(unsigned))))
+			return A2_OOMEMORY;
+		fn->size = size;
+		a2bf_Read(bf, fn->code, size * sizeof(unsigned));
+	}
+	for(j = 0; j < A2_MAXEPS; ++j)
+		if(p->eps[j] >= (int)p->nfuncs)
+			return A2_BADFORMAT;
+
+	p->units = a2bf_ReadStructItems(bf, 1);
+	p->wires = a2bf_ReadStructItems(bf, 0);
+
+	p->nrelocs = a2bf_Read32(bf);
+	if(bf->status)
+		return bf->status;
+	if((res = a2bf_CheckStruct(bf, p)))
+		return res;
+	if((res = a2_PrepareVoiceTemplate(bf->state, p)))
+		return res;
+	if((res = a2bf_CheckFunctions(p)))
+		return res;
+	if(p->nrelocs > nfuncs * (0xffff + A2_MAXARGS))
+		return A2_BADFORMAT;
+	if(p->nrelocs && !(p->relocs = malloc(p->nrelocs * sizeof(A2_reloc))))
+		return A2_OOMEMORY;
+	a2bf_Read(bf, p->relocs, p->nrelocs * sizeof(A2_reloc));
+	for(j = 0; j < p->nrelocs; ++j)
+		if(p->relocs[j].func >= nfuncs)
+			return A2_BADFORMAT;
+	return bf->status;
+}
+
+
+static A2_handle a2bf_ReadWave(A2_bankfile *bf)
+{
+	A2_wavetypes wt = a2bf_Read32(bf);
+	unsigned flags = a2bf_Read32(bf);
+	unsigned period = a2bf_Read32(bf);
+	uint32_t size = a2bf_Read32(bf);
+	int16_t *data = NULL;
+	A2_handle h;
+	if(bf->status)
+		return -bf->status;
+	if(size > 0x7fffffff / sizeof(int16_t))
+		return -A2_BADFORMAT;
+	if(size)
+	{
+		if(!(data = malloc(size * sizeof(int16_t))))
+			return -A2_OOMEMORY;
+		a2bf_Read(bf, data, size * sizeof(int16_t));
+		if(bf->status)
+		{
+			free(data);
+			return -bf->status;
+		}
+	}
+
+	/* The data is already processed, so we only need padding and mipmaps */
+	h = a2_UploadWave(bf->interface, wt, period, flags &
+			~(A2_NORMALIZE | A2_XFADE | A2_REVMIX | A2_CLEAR),
+			A2_I16, data, size * sizeof(int16_t));
+	free(data);
+	if(h >= 0)
+		a2_GetWave(bf->interface, h)->flags = flags;
+	return h;
+}
+
+
+/*
+ * Load an imported bank, and check that its scripts are the same as when the
+ * bank file was written.
+ */
+static A2_handle a2bf_ReadImport(A2_bankfile *bf)
+{
+	unsigned flags = a2bf_Read32(bf);
+	char *name = a2bf_ReadString(bf);
+	uint32_t hash = a2bf_Read32(bf);
+	uint32_t h2 = 2166136261U;
+	int dirlen = a2bf_DirLength(bf->path);
+	char *path = name;
+	A2_handle h;
+	if(!name)
+		return -bf->status;
+	if(bf->status)
+	{
+		free(name);
+		return -bf->status;
+	}
+	if((flags & A2BF_LOCALIMPORT) && (dirlen >= 0))
+	{
+		if(!(path = malloc(dirlen + 1 + strlen(name) + 1)))
+		{
+			free(name);
+			return -A2_OOMEMORY;
+		}
+		memcpy(path, bf->path, dirlen + 1);
+		strcpy(path + dirlen + 1, name);
+	}
+	if((h = a2_Load(bf->interface, path, 0)) < 0)
+		A2_LOG_ERR(bf->interface, "Could not import \"%s\"! (%s)",
+				path, a2_ErrorString(-h));
+	else
+	{
+		a2bf_HashBank(bf, h, &h2);
+		if(h2 != hash)
+		{
+			a2_Release(bf->interface, h);
+			h = -A2_OUTOFDATE;
+		}
+	}
+	if(path != name)
+		free(path);
+	free(name);
+	return h;
+}
+
+
+/*
+ * Read an object, returning its handle, or a negative error code. '*owned' is
+ * set if the object was created by this call, rather than looked up.
+ */
+static A2_handle a2bf_ReadObject(A2_bankfile *bf, int *owned)
+{
+	A2_handle h;
+	char *s;
+	uint32_t kind = a2bf_Read32(bf);
+	*owned = 1;
+	if(bf->status)
+		return -bf->status;
+	if(kind > A2BF_WAVE)
+		return -A2_BADFORMAT;
+	switch((A2_bfobjects)kind)
+	{
+	  case A2BF_IMPORT:
+		return a2bf_ReadImport(bf);
+	  case A2BF_EXTERNAL:
+	  {
+		int x = a2bf_Read32(bf);
+		A2_bank *b;
+		*owned = 0;
+		if(!(s = a2bf_ReadString(bf)))
+			return -bf->status;
+		if(x == -1)
+			b = a2_GetBank(bf->state, A2_ROOTBANK);
+		else if((x = a2bf_IndexHandle(bf, x)) >= 0)
+			b = a2_GetBank(bf->state, x);
+		else
+			b = NULL;
+		if(!b || ((h = a2nt_FindItem(&b->exports, s)) < 0))
+			h = -A2_NOTFOUND;
+		free(s);
+		return h;
+	  }
+	  case A2BF_PROGRAM:
+	  {
+		A2_errors res;
+		A2_program *p = calloc(1, sizeof(A2_program));
+		if(!p)
+			return -A2_OOMEMORY;
+		if((h = rchm_New(&bf->state->ss->hm, p, A2_TPROGRAM)) < 0)
+		{
+			free(p);
+			return h;
+		}
+		if((res = a2bf_ReadProgram(bf, p)))
+		{
+			a2_Release(bf->interface, h);
+			return -res;
+		}
+		return h;
+	  }
+	  case A2BF_STRING:
+		if(!(s = a2bf_ReadString(bf)))
+			return -bf->status;
+		h = a2_NewString(bf->interface, s);
+		free(s);
+		return h;
+	  case A2BF_CONSTANT:
+	  {
+		double v;
+		a2bf_Read(bf, &v, sizeof(v));
+		if(bf->status)
+			return -bf->status;
+		return a2_NewConstant(bf->interface, v);
+	  }
+	  case A2BF_WAVE:
+		return a2bf_ReadWave(bf);
+	}
+	return bf->status ? -bf->status : -A2_BADFORMAT;
+}
+
+
+static A2_errors a2bf_ReadNametab(A2_bankfile *bf, A2_nametab *nt)
+{
+	uint32_t n = a2bf_Read32(bf);
+	while(n-- && !bf->status)
+	{
+		A2_handle h;
+		char *name = a2bf_ReadString(bf);
+		if(!name)
+			break;
+		if((h = a2bf_IndexHandle(bf, a2bf_Read32(bf))) < 0)
+			bf->status = -h;
+		else if((h = a2nt_AddItem(nt, name, h)) < 0)
+			bf->status = -h;
+		free(name);
+	}
+	return bf->status;
+}
+
+
+static A2_errors a2bf_ReadBank(A2_bankfile *bf, const char *source)
+{
+	A2_bank *b = bf->bank;
+	char magic[sizeof(a2bf_magic)];
+	uint32_t n, size, hash, ssize, shash;
+	unsigned j, k;
+	A2_errors res;
+
+	/* Header */
+	a2bf_Read(bf, magic, sizeof(magic));
+	if(bf->status)
+		return bf->status;
+	if(memcmp(magic, a2bf_magic, sizeof(magic)))
+		return A2_BADFORMAT;
+	if((a2bf_Read32(bf) != A2_BANKFILEVERSION) ||
+			(a2bf_Read32(bf) != A2_VERSION) ||
+			(a2bf_Read32(bf) != A2_OPCODES) ||
+			(a2bf_Read32(bf) != (bf->state->config->flags &
+			A2_BANKFILEFLAGS)))
+		return bf->status ? bf->status : A2_OUTOFDATE;
+	size = a2bf_Read32(bf);
+	hash = a2bf_Read32(bf);
+	if(bf->status)
+		return bf->status;
+	if(source && !a2bf_HashFile(source, &ssize, &shash) &&
+			((ssize != size) || (shash != hash)))
+		return A2_OUTOFDATE;
+
+	/* Objects */
+	n = a2bf_Read32(bf);
+	while(n-- && !bf->status)
+	{
+		int owned;
+		A2_handle h = a2bf_ReadObject(bf, &owned);
+		if(h < 0)
+			return -h;
+		if((res = a2ht_AddItem(&bf->objects, h)) < 0)
+		{
+			if(owned)
+				a2_Release(bf->interface, h);
+			return -res;
+		}
+		if(owned && ((res = a2ht_AddItem(&bf->owned, h)) < 0))
+		{
+			a2_Release(bf->interface, h);
+			return -res;
+		}
+	}
+	if(bf->status)
+		return bf->status;
+
+	/* Now that we have all handles, translate the programs we loaded */
+	for(j = 0; j < bf->owned.nitems; ++j)
+	{
+		A2_program *p = a2_GetProgram(bf->state, bf->owned.items[j]);
+		if(!p)
+			continue;
+		for(k = 0; k < p->nfuncs; ++k)
+			if((res = a2_TranslateHandles(p, k, p->funcs[k].code,
+					p->funcs[k].argdefs,
+					a2bf_IndexHandle, bf)))
+				return res;
+	}
+
+	if((res = a2bf_ReadNametab(bf, &b->exports)) ||
+			(res = a2bf_ReadNametab(bf, &b->private)))
+		return res;
+
+	/* Dependencies; the bank takes over our references */
+	n = a2bf_Read32(bf);
+	while(n-- && !bf->status)
+	{
+		A2_handle h = a2bf_IndexHandle(bf, a2bf_Read32(bf));
+		if(h < 0)
+			return -h;
+		if(a2ht_FindItem(&bf->owned, h) < 0)
+			a2_Retain(bf->interface, h);
+		if((res = a2ht_AddItem(&b->deps, h)) < 0)
+		{
+			if(a2ht_FindItem(&bf->owned, h) < 0)
+				a2_Release(bf->interface, h);
+			return -res;
+		}
+	}
+	return bf->status;
+}
+
+
+/*
+ * Load bank file 'fn' into the empty bank 'bank'. If 'source' is not NULL,
+ * and the script file it names exists, the bank file is considered stale
+ * unless it was compiled from that exact version of the script.
+ */
+static A2_errors a2bf_Load(A2_interface *i, A2_handle bank, const char *fn,
+		const char *source)
+{
+	A2_bankfile bf;
+	unsigned j;
+	memset(&bf, 0, sizeof(bf));
+	bf.interface = i;
+	bf.state = ((A2_interface_i *)i)->state;
+	bf.path = fn;
+	if(!(bf.bank = a2_GetBank(bf.state, bank)))
+		return A2_BADBANK;
+	if(!(bf.f = fopen(fn, "rb")))
+		return A2_OPEN;
+	if((bf.status = a2bf_ReadBank(&bf, source)))
+	{
+		/* Anything in the deps table is released with the bank */
+		for(j = 0; j < bf.owned.nitems; ++j)
+			if(a2ht_FindItem(&bf.bank->deps,
+					bf.owned.items[j]) < 0)
+				a2_Release(i, bf.owned.items[j]);
+	}
+	fclose(bf.f);
+	a2ht_Cleanup(&bf.objects);
+	a2ht_Cleanup(&bf.owned);
+	return bf.status;
+}
+
+
+A2_handle a2_LoadCompiled(A2_interface *i, const char *fn, unsigned flags)
+{
+	A2_state *st = ((A2_interface_i *)i)->state;
+	A2_errors res;
+	A2_handle h;
+	char *source = a2bf_SwapExtension(fn, ".a2s");
+	if(!source)
+		return -A2_OOMEMORY;
+	if((h = a2_NewBank(i, fn, A2_APIOWNED)) < 0)
+	{
+		free(source);
+		return h;
+	}
+	if((res = a2bf_Load(i, h, fn, source)))
+	{
+		free(source);
+		a2_Release(i, h);
+		return -res;
+	}
+	if((flags | st->config->flags) & A2_NATIVE)
+		a2_LoadNative(st, h, source);
+	free(source);
+	return h;
+}
+
+
+A2_errors a2_LoadPrecompiled(A2_interface *i, A2_handle bank, const char *fn)
+{
+	A2_errors res;
+	char *path = a2bf_SwapExtension(fn, ".a2b");
+	if(!path)
+		return A2_OOMEMORY;
+	res = a2bf_Load(i, bank, path, fn);
+	free(path);
+	return res;
+}
@@ -25,9 +25,6 @@ WARNING: Calls with the a2c_ prefix MUST ONLY be used with a2_Try()!
 ===============================================================================
  */
 
-/* Define to dump compiled banks to "out.a2b" */
-#undef	A2_OUT_A2B
-
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -124,7 +121,25 @@ unsigned a2_InsSize(A2_opcodes op)
 	  case OP_DEBUG:
 	  case OP_RAMP:
 	  case OP_RAMPALL:
+	  case OP_LOADC:
+	  case OP_ADDC:
+	  case OP_MULC:
+	  case OP_MODC:
+	  case OP_QUANTC:
+	  case OP_RANDC:
+	  case OP_LDSET:
+	  case OP_ADDSET:
+	  case OP_LDRRAMP:
+	  case OP_GRJZ:
+	  case OP_LRJZ:
+	  case OP_GERJZ:
+	  case OP_LERJZ:
+	  case OP_EQRJZ:
+	  case OP_NERJZ:
 		return 2;
+	  case OP_PUSH2:
+	  case OP_LDRAMP:
+		return 3;
 	  default:
 		return 1;
 	}
@@ -147,8 +162,11 @@ void a2_DumpIns(unsigned *code, unsigned pc, FILE *stream)
 	  case OP_SETALL:
 	  case A2_OPCODES:	/* (Warning eliminator) */
 		break;
-	  /* <integer(a2)> */
+	  /* <branch(a2)> */
 	  case OP_JUMP:
+		fprintf(stream, "%d", pc + (int16_t)ins->a2);
+		break;
+	  /* <integer(a2)> */
 	  case OP_WAKE:
 	  case OP_FORCE:
 	  case OP_SENDA:
@@ -157,6 +175,7 @@ void a2_DumpIns(unsigned *code, unsigned pc, FILE *stream)
 	  case OP_SPAWND:
 	  case OP_SPAWNA:
 	  case OP_SIZEOF:
+	  case OP_SIZEOFC:
 		fprintf(stream, "%d", ins->a2);
 		break;
 	  /* <16:16(a3)> */
@@ -174,6 +193,7 @@ void a2_DumpIns(unsigned *code, unsigned pc, FILE *stream)
 	  case OP_SET:
 	  case OP_DEBUGR:
 	  case OP_SIZEOFR:
+	  case OP_SIZEOFRC:
 	  case OP_KILLR:
 	  case OP_DETACHR:
 	  case OP_SPAWNDR:
@@ -181,18 +201,56 @@ void a2_DumpIns(unsigned *code, unsigned pc, FILE *stream)
 	  case OP_RAMPALLR:
 		a2_PrintRegName(ins->a1, stream);
 		break;
+	  /* <16:16(a3), 16:16(word 2)> */
+	  case OP_PUSH2:
+		fprintf(stream, "%f %f", ins->a3 / 65536.0f,
+				(int)code[pc + 2] / 65536.0f);
+		break;
+	  /* <register(a1), 16:16(a3), 16:16(word 2)> */
+	  case OP_LDRAMP:
+		a2_PrintRegName(ins->a1, stream);
+		fprintf(stream, " %f %f", ins->a3 / 65536.0f,
+				(int)code[pc + 2] / 65536.0f);
+		break;
+	  /* <register(a1), register(a2), 16:16(a3)> */
+	  case OP_LDRRAMP:
+		a2_PrintRegName(ins->a1, stream);
+		fprintf(stream, " ");
+		a2_PrintRegName(ins->a2, stream);
+		fprintf(stream, " %f", ins->a3 / 65536.0f);
+		break;
+	  /* <register(a1), register(a2), branch(a3)> */
+	  case OP_GRJZ:
+	  case OP_LRJZ:
+	  case OP_GERJZ:
+	  case OP_LERJZ:
+	  case OP_EQRJZ:
+	  case OP_NERJZ:
+		a2_PrintRegName(ins->a1, stream);
+		fprintf(stream, " ");
+		a2_PrintRegName(ins->a2, stream);
+		fprintf(stream, " %d", pc + ins->a3);
+		break;
 	  /* <register(a1), 16:16(a3)> */
+	  case OP_LDSET:
+	  case OP_ADDSET:
 	  case OP_LOAD:
+	  case OP_LOADC:
 	  case OP_ADD:
+	  case OP_ADDC:
 	  case OP_MUL:
+	  case OP_MULC:
 	  case OP_MOD:
+	  case OP_MODC:
 	  case OP_QUANT:
+	  case OP_QUANTC:
 	  case OP_RAND:
+	  case OP_RANDC:
 	  case OP_RAMP:
 		a2_PrintRegName(ins->a1, stream);
 		fprintf(stream, " %f", ins->a3 / 65536.0f);
 		break;
-	  /* <register(a1), integer(a2)> */
+	  /* <register(a1), branch(a2)> */
 	  case OP_LOOP:
 	  case OP_JZ:
 	  case OP_JNZ:
@@ -200,6 +258,10 @@ void a2_DumpIns(unsigned *code, unsigned pc, FILE *stream)
 	  case OP_JL:
 	  case OP_JGE:
 	  case OP_JLE:
+		a2_PrintRegName(ins->a1, stream);
+		fprintf(stream, " %d", pc + (int16_t)ins->a2);
+		break;
+	  /* <register(a1), integer(a2)> */
 	  case OP_SPAWNV:
 		a2_PrintRegName(ins->a1, stream);
 		fprintf(stream, " %d", ins->a2);
@@ -217,29 +279,50 @@ void a2_DumpIns(unsigned *code, unsigned pc, FILE *stream)
 		break;
 	  /* <register(a1), register(a2)> */
 	  case OP_LOADR:
+	  case OP_LOADRC:
 	  case OP_ADDR:
+	  case OP_ADDRC:
 	  case OP_SUBR:
+	  case OP_SUBRC:
 	  case OP_MULR:
+	  case OP_MULRC:
 	  case OP_DIVR:
+	  case OP_DIVRC:
 	  case OP_MODR:
+	  case OP_MODRC:
 	  case OP_QUANTR:
+	  case OP_QUANTRC:
 	  case OP_RANDR:
+	  case OP_RANDRC:
 	  case OP_SPAWNR:
 	  case OP_SPAWNVR:
 	  case OP_SENDR:
 	  case OP_P2DR:
+	  case OP_P2DRC:
 	  case OP_NEGR:
+	  case OP_NEGRC:
 	  case OP_GR:
+	  case OP_GRC:
 	  case OP_LR:
+	  case OP_LRC:
 	  case OP_GER:
+	  case OP_GERC:
 	  case OP_LER:
+	  case OP_LERC:
 	  case OP_EQR:
+	  case OP_EQRC:
 	  case OP_NER:
+	  case OP_NERC:
 	  case OP_ANDR:
+	  case OP_ANDRC:
 	  case OP_ORR:
+	  case OP_ORRC:
 	  case OP_XORR:
+	  case OP_XORRC:
 	  case OP_NOTR:
+	  case OP_NOTRC:
 	  case OP_RAMPR:
+	  case OP_LDRSET:
 		a2_PrintRegName(ins->a1, stream);
 		fprintf(stream, " ");
 		a2_PrintRegName(ins->a2, stream);
@@ -537,6 +620,324 @@ static void a2c_PushCoder(A2_compiler *c, A2_program *p, unsigned func)
 }
 
 
+/*---------------------------------------------------------
+	Peephole optimizer
+---------------------------------------------------------*/
+
+/* Decoded instruction, as seen by the peephole optimizer */
+typedef struct A2_optins
+{
+	unsigned	pos;		/* Original position */
+	unsigned	target;		/* Original branch target, if any */
+	uint8_t		op;
+	uint8_t		a1;
+	uint16_t	a2;
+	int32_t		a3;
+	int32_t		a4;		/* Third word of 3 word instructions */
+	uint8_t		reloc;		/* a3 (1) and/or a4 (2) are handles */
+	uint8_t		leader;		/* Branch target; no merging into this */
+	uint8_t		dead;		/* Removed by the optimizer */
+} A2_optins;
+
+
+static int a2c_OptHasTarget(unsigned op)
+{
+	switch((A2_opcodes)op)
+	{
+	  case OP_GRJZ:
+	  case OP_LRJZ:
+	  case OP_GERJZ:
+	  case OP_LERJZ:
+	  case OP_EQRJZ:
+	  case OP_NERJZ:
+		return 1;
+	  default:
+		return a2_IsBranch(op);
+	}
+}
+
+
+static A2_opcodes a2c_OptCompareJZ(unsigned op)
+{
+	switch((A2_opcodes)op)
+	{
+	  case OP_GR:	return OP_GRJZ;
+	  case OP_LR:	return OP_LRJZ;
+	  case OP_GER:	return OP_GERJZ;
+	  case OP_LER:	return OP_LERJZ;
+	  case OP_EQR:	return OP_EQRJZ;
+	  case OP_NER:	return OP_NERJZ;
+	  default:	return OP_END;
+	}
+}
+
+
+static int a2c_OptIsLoad(unsigned op)
+{
+	switch((A2_opcodes)op)
+	{
+	  case OP_LOAD:
+	  case OP_LOADR:
+	  case OP_LOADC:
+	  case OP_LOADRC:
+		return 1;
+	  default:
+		return 0;
+	}
+}
+
+
+/*
+ * Try to fold, eliminate or fuse the adjacent instructions 'a' and 'b'. 'b'
+ * is never a branch target. Returns 1 if anything was changed, in which case
+ * either 'a' or 'b' is now dead.
+ */
+static int a2c_OptPair(A2_optins *a, A2_optins *b)
+{
+	if((a->op == OP_PUSH) && (b->op == OP_PUSH))
+	{
+		a->op = OP_PUSH2;
+		a->a4 = b->a3;
+		a->reloc |= b->reloc << 1;
+		b->dead = 1;
+		return 1;
+	}
+
+	if(a->a1 != b->a1)
+		return 0;
+
+	/* Constant folding (but not of handles, as they need relocation!) */
+	if(!a->reloc && (((a->op == OP_LOAD) && (b->op == OP_ADD)) ||
+			((a->op == OP_LOADC) && (b->op == OP_ADDC))))
+	{
+		a->a3 = (uint32_t)a->a3 + (uint32_t)b->a3;
+		b->dead = 1;
+		return 1;
+	}
+	if(!a->reloc && (((a->op == OP_LOAD) && (b->op == OP_MUL)) ||
+			((a->op == OP_LOADC) && (b->op == OP_MULC))))
+	{
+		a->a3 = (int64_t)a->a3 * b->a3 >> 16;
+		b->dead = 1;
+		return 1;
+	}
+
+	/*
+	 * Dead stores. (A *C write can only be dropped if the overwriting
+	 * instruction is also a *C, or the write would not be tracked!)
+	 */
+	if(a2c_OptIsLoad(a->op) && a2c_OptIsLoad(b->op) &&
+			(a2_ControlVariant(a->op) != a->op ||
+			a2_PlainVariant(b->op) != b->op))
+	{
+		if(((b->op == OP_LOADR) || (b->op == OP_LOADRC)) &&
+				(b->a2 == b->a1))
+			return 0;
+		b->leader |= a->leader;
+		a->dead = 1;
+		return 1;
+	}
+
+	/* Load-and-set, load-and-ramp */
+	if(b->op == OP_SET)
+	{
+		switch((A2_opcodes)a->op)
+		{
+		  case OP_LOADC:	a->op = OP_LDSET;	break;
+		  case OP_ADDC:		a->op = OP_ADDSET;	break;
+		  case OP_LOADRC:	a->op = OP_LDRSET;	break;
+		  default:
+			return 0;
+		}
+		b->dead = 1;
+		return 1;
+	}
+	if(b->op == OP_RAMP)
+	{
+		switch((A2_opcodes)a->op)
+		{
+		  case OP_LOADC:
+			a->op = OP_LDRAMP;
+			a->a4 = b->a3;
+			a->reloc |= b->reloc << 1;
+			break;
+		  case OP_LOADRC:
+			a->op = OP_LDRRAMP;
+			a->a3 = b->a3;
+			a->reloc = b->reloc;
+			break;
+		  default:
+			return 0;
+		}
+		b->dead = 1;
+		return 1;
+	}
+
+	/* Compare-and-branch */
+	if((b->op == OP_JZ) && a2c_OptCompareJZ(a->op))
+	{
+		a->op = a2c_OptCompareJZ(a->op);
+		a->target = b->target;
+		b->dead = 1;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Peephole optimize the code of the current coder, before it's popped.
+ *
+ * Constant LOAD+ADD/MUL sequences are folded, LOADs that are immediately
+ * overwritten are dropped, and some frequent instruction pairs are fused into
+ * superinstructions. The code is then compacted, and branches are relocated.
+ *
+ * NOTE:
+ *	WAKE and FORCE use absolute targets in the code of some other
+ *	function, so functions are left alone if any of their handlers use
+ *	those instructions.
+ */
+static void a2c_Optimize(A2_compiler *c)
+{
+	A2_coder *cdr = c->coder;
+	A2_program *p = cdr->program;
+	unsigned end = cdr->pos;
+	unsigned *code = cdr->code;
+	unsigned *map;
+	A2_optins *oi;
+	unsigned i, j, n, pos;
+	if(!c->optimize || !end)
+		return;
+	for(i = 0; i < p->nfuncs; ++i)
+	{
+		A2_function *fn = p->funcs + i;
+		if((i == cdr->func) || !fn->code)
+			continue;
+		for(pos = 0; pos < fn->size; )
+		{
+			A2_instruction *ins = (A2_instruction *)(fn->code + pos);
+			if((ins->opcode == OP_WAKE) || (ins->opcode == OP_FORCE))
+				return;
+			pos += a2_InsSize(ins->opcode);
+		}
+	}
+
+	/* Decode, and build position to instruction map */
+	map = (unsigned *)calloc(end + 1, sizeof(unsigned));
+	oi = (A2_optins *)calloc(end, sizeof(A2_optins));
+	if(!map || !oi)
+	{
+		free(map);
+		free(oi);
+		a2c_Throw(c, A2_OOMEMORY);
+	}
+	for(n = 0, pos = 0; pos < end; ++n)
+	{
+		A2_instruction *ins = (A2_instruction *)(code + pos);
+		unsigned inssize = a2_InsSize(ins->opcode);
+		oi[n].pos = pos;
+		oi[n].op = ins->opcode;
+		oi[n].a1 = ins->a1;
+		oi[n].a2 = ins->a2;
+		if(inssize >= 2)
+			oi[n].a3 = ins->a3;
+		if(a2_IsBranch(ins->opcode))
+			oi[n].target = pos + (int16_t)ins->a2;
+		map[pos] = n;
+		pos += inssize;
+	}
+	for(i = 0; i < n; ++i)
+		if(a2_IsBranch(oi[i].op) && (oi[i].target < end))
+			oi[map[oi[i].target]].leader = 1;
+
+	/*
+	 * Take the handle operands of this function out of the relocation
+	 * table, marking the instructions instead. (Before optimization, these
+	 * are all a3 operands.)
+	 */
+	for(i = j = 0; i < p->nrelocs; ++i)
+	{
+		A2_reloc *r = p->relocs + i;
+		if((r->func == cdr->func) && !r->arg)
+			oi[map[r->pos - 1]].reloc = 1;
+		else
+			p->relocs[j++] = *r;
+	}
+	p->nrelocs = j;
+
+	/* Optimize adjacent instruction pairs until nothing changes */
+	for(i = 0; i < n; )
+	{
+		for(j = i + 1; (j < n) && oi[j].dead; ++j)
+			;
+		if((j >= n) || oi[j].leader || !a2c_OptPair(oi + i, oi + j))
+		{
+			i = j;
+			continue;
+		}
+		if(oi[i].dead)
+		{
+			/* Back up, to see if the previous one matches now */
+			while(i && oi[i].dead)
+				--i;
+			if(oi[i].dead)
+				i = j;
+		}
+	}
+
+	/* Calculate new positions, and map dead ones to the next live one */
+	for(i = 0, pos = 0; i < n; ++i)
+		if(!oi[i].dead)
+		{
+			map[oi[i].pos] = pos;
+			pos += a2_InsSize(oi[i].op);
+		}
+	map[end] = pos;
+	for(i = n, pos = map[end]; i--; )
+		if(oi[i].dead)
+			map[oi[i].pos] = pos;
+		else
+			pos = map[oi[i].pos];
+
+	/* Emit, relocating branches */
+	for(i = 0; i < n; ++i)
+	{
+		A2_instruction *ins;
+		unsigned inssize = a2_InsSize(oi[i].op);
+		if(oi[i].dead)
+			continue;
+		pos = map[oi[i].pos];
+		ins = (A2_instruction *)(code + pos);
+		ins->opcode = oi[i].op;
+		ins->a1 = oi[i].a1;
+		ins->a2 = oi[i].a2;
+		if(a2_IsBranch(oi[i].op))
+			ins->a2 = (map[oi[i].target] - pos) & 0xffff;
+		if(inssize >= 2)
+			ins->a3 = oi[i].a3;
+		if(a2c_OptHasTarget(oi[i].op) && !a2_IsBranch(oi[i].op))
+			ins->a3 = map[oi[i].target] - pos;
+		if(inssize >= 3)
+			code[pos + 2] = oi[i].a4;
+
+		/* (Never more handles than before, so there's room for these!) */
+		for(j = 0; j < 2; ++j)
+			if(oi[i].reloc & (1 << j))
+			{
+				A2_reloc *r = p->relocs + p->nrelocs++;
+				r->func = cdr->func;
+				r->arg = 0;
+				r->pos = pos + 1 + j;
+			}
+	}
+	DUMPCODE(A2_DLOG("OPTIMIZED: %d ==> %d\n", end, map[end]);)
+	cdr->pos = map[end];
+	free(map);
+	free(oi);
+}
+
+
 /* Pop current coder, transfering the code to the program it was assigned to */
 static void a2c_PopCoder(A2_compiler *c)
 {
@@ -555,6 +956,8 @@ static void a2c_PopCoder(A2_compiler *c)
 	fn->topreg = cdr->topreg;
 	if(fn->topreg - fn->argv > A2_MAXSAVEREGS)
 		a2c_Throw(c, A2_LARGEFRAME);
+	if(fn->topreg >= cdr->program->nregs)
+		cdr->program->nregs = fn->topreg + 1;
 	c->coder = cdr->prev;
 	free(cdr);
 }
@@ -572,6 +975,9 @@ static void a2c_Code(A2_compiler *c, unsigned op, unsigned reg, int arg)
 	unsigned inssize = a2_InsSize(op);
 	if(c->nocode)
 		a2c_Throw(c, A2_NOCODE);
+	/* A2_function 'size' is 16 bits, and has to cover the final END too */
+	if(cdr->pos + inssize >= 0xffff)
+		a2c_Throw(c, A2_LARGEFUNC);
 	if(cdr->pos + 3 >= cdr->size)
 	{
 		int i, ns = cdr->size;
@@ -654,6 +1060,9 @@ static void a2c_Code(A2_compiler *c, unsigned op, unsigned reg, int arg)
 				a2c_Throw(c, A2_INFLOOP);
 			if(arg > cdr->pos)
 				a2c_Throw(c, A2_BADJUMP);
+			if(cdr->pos - arg > 0x8000)
+				a2c_Throw(c, A2_BADJUMP);
+			arg = (arg - cdr->pos) & 0xffff;
 		}
 		break;
 	  case OP_SPAWN:
@@ -736,7 +1145,55 @@ static void a2c_Code(A2_compiler *c, unsigned op, unsigned reg, int arg)
 		/* No extra checks */
 	  case A2_OPCODES:	/* (Not an OP-code) */
 		break;
+	  case OP_SUBRC:
+	  case OP_DIVRC:
+	  case OP_P2DRC:
+	  case OP_NEGRC:
+	  case OP_LOADC:
+	  case OP_LOADRC:
+	  case OP_ADDC:
+	  case OP_ADDRC:
+	  case OP_MULC:
+	  case OP_MULRC:
+	  case OP_MODC:
+	  case OP_MODRC:
+	  case OP_QUANTC:
+	  case OP_QUANTRC:
+	  case OP_RANDC:
+	  case OP_RANDRC:
+	  case OP_GRC:
+	  case OP_LRC:
+	  case OP_GERC:
+	  case OP_LERC:
+	  case OP_EQRC:
+	  case OP_NERC:
+	  case OP_ANDRC:
+	  case OP_ORRC:
+	  case OP_XORRC:
+	  case OP_NOTRC:
+	  case OP_SIZEOFC:
+	  case OP_SIZEOFRC:
+		/* Only selected below, via a2_ControlVariant()! */
+	  case OP_PUSH2:
+	  case OP_LDSET:
+	  case OP_ADDSET:
+	  case OP_LDRSET:
+	  case OP_LDRAMP:
+	  case OP_LDRRAMP:
+	  case OP_GRJZ:
+	  case OP_LRJZ:
+	  case OP_GERJZ:
+	  case OP_LERJZ:
+	  case OP_EQRJZ:
+	  case OP_NERJZ:
+		/* Only generated by a2c_Optimize()! */
+		a2c_Throw(c, A2_BADOPCODE);
 	}
+
+	/* Track writes to registers that may drive unit control inputs */
+	if((a2_ControlVariant(op) != op) && (c->regmap[reg] == A2RT_CONTROL))
+		op = a2_ControlVariant(op);
+
 	ins->opcode = op;
 	ins->a1 = reg;
 	if(inssize == 2)
@@ -761,15 +1218,58 @@ static void a2c_Codef(A2_compiler *c, unsigned op, unsigned reg, double arg)
 }
 
 
+/*
+ * Register a handle operand of function 'func' of the current program. 'arg'
+ * is 1 + the index of an argument default value, or 0 for the operand word at
+ * code position 'pos'.
+ */
+static void a2c_AddReloc(A2_compiler *c, unsigned func, unsigned arg,
+		unsigned pos)
+{
+	A2_program *p = c->coder->program;
+	A2_reloc *r = (A2_reloc *)realloc(p->relocs,
+			(p->nrelocs + 1) * sizeof(A2_reloc));
+	if(!r)
+		a2c_Throw(c, A2_OOMEMORY);
+	p->relocs = r;
+	r += p->nrelocs++;
+	r->func = func;
+	r->arg = arg;
+	r->pos = pos;
+}
+
+
+/* Issue VM instruction 'op' with register 'reg' and handle 'h' as operand. */
+static void a2c_CodeH(A2_compiler *c, unsigned op, unsigned reg, A2_handle h)
+{
+	a2c_Code(c, op, reg, h << 16);
+	a2c_AddReloc(c, c->coder->func, 0, c->coder->pos - 1);
+}
+
+
+/*
+ * Set the 'a2' field of the instruction at 'pos'. If the instruction is a
+ * branch, 'val' is an absolute target position, which is translated into an
+ * offset relative to the branch.
+ */
 static inline void a2c_SetA2(A2_compiler *c, int pos, int val)
 {
-	if((val < 0) || (val > 0xffff))
-		a2c_Throw(c, A2_BADIMMARG);
+	A2_instruction *ins;
 #ifdef DEBUG
 	if((pos < 0) || (pos >= c->coder->size))
 		a2c_Throw(c, A2_INTERNAL + 104);	/* Bad code position! */
 #endif
-	((A2_instruction *)(c->coder->code + pos))->a2 = val;
+	ins = (A2_instruction *)(c->coder->code + pos);
+	if(a2_IsBranch(ins->opcode))
+	{
+		if((val < 0) || (val - pos < -0x8000) || (val - pos > 0x7fff))
+			a2c_Throw(c, A2_BADJUMP);
+		ins->a2 = (val - pos) & 0xffff;
+		return;
+	}
+	if((val < 0) || (val > 0xffff))
+		a2c_Throw(c, A2_BADIMMARG);
+	ins->a2 = val;
 }
 
 
@@ -1823,7 +2323,7 @@ static void a2c_code_op_h(A2_compiler *c, A2_opcodes op, int to, unsigned h)
 		a2c_Code(c, op, to, h);
 		break;
 	  case OP_LOAD:
-		a2c_Code(c, op, to, h << 16);
+		a2c_CodeH(c, op, to, h);
 		break;
 	  default:
 		a2c_Throw(c, A2_INTERNAL + 105);
@@ -2204,8 +2704,7 @@ static void a2c_Arguments(A2_compiler *c, int maxargc)
 		if(a2_IsValue(c->l[0].token))
 			a2c_Codef(c, OP_PUSH, 0, a2c_GetValue(c, c->l));
 		else if(a2_IsHandle(c->l[0].token))
-			a2c_Code(c, OP_PUSH, 0,
-					a2c_GetHandle(c, c->l) << 16);
+			a2c_CodeH(c, OP_PUSH, 0, a2c_GetHandle(c, c->l));
 		else if(a2_IsRegister(c->l[0].token))
 		{
 			int r = a2c_GetIndex(c, c->l);
@@ -2672,7 +3171,10 @@ static void a2c_ArgList(A2_compiler *c, A2_function *fn)
 			if(a2_IsValue(c->l[0].token))
 				v = a2c_Num2VM(c, a2c_GetValue(c, c->l));
 			else if(a2_IsHandle(c->l[0].token))
+			{
 				v = a2c_GetHandle(c, c->l) << 16;
+				a2c_AddReloc(c, c->coder->func, *argc + 1, 0);
+			}
 			else
 				a2c_Throw(c, A2_EXPVALUEHANDLE);
 			fn->argdefs[*argc] = v;
@@ -3169,6 +3671,10 @@ static void a2c_StructDef(A2_compiler *c)
 			p->buffers = -1;
 	}
 
+	/* Lay out the voice unit image */
+	if(a2_PrepareVoiceTemplate(c->state, p))
+		a2c_Throw(c, A2_INTERNAL + 113);
+
 #if DUMPSTRUCT(1)+0
 	for(si = p->wires; si; si = si->next)
 	{
@@ -3215,6 +3721,7 @@ static void a2c_ProgDef(A2_compiler *c, A2_symbol *s, int export)
 		a2c_Throw(c, A2_OOMEMORY);
 	for(i = 0; i < A2_MAXEPS; ++i)
 		p->eps[i] = -1;
+	p->nregs = A2_FIXEDREGS;
 	if((s->v.i = rchm_New(&c->state->ss->hm, p, A2_TPROGRAM)) < 0)
 	{
 		free(p);
@@ -3244,6 +3751,7 @@ static void a2c_ProgDef(A2_compiler *c, A2_symbol *s, int export)
 	if(!c->nocode)
 		a2c_Code(c, OP_END, 0, 0);
 	a2c_EndScope(c, &sc);
+	a2c_Optimize(c);
 	a2c_PopCoder(c);
 	c->nocode = 1;
 }
@@ -3270,6 +3778,7 @@ static void a2c_FuncDef(A2_compiler *c, A2_symbol *s)
 	a2c_Body(c);
 	a2c_Code(c, OP_RETURN, 0, 0);
 	a2c_EndScope(c, &sc);
+	a2c_Optimize(c);
 	a2c_PopCoder(c);
 }
 
@@ -3295,6 +3804,7 @@ static void a2c_MsgDef(A2_compiler *c, unsigned ep)
 	a2c_Code(c, OP_RETURN, 0, 0);
 	c->inhandler = 0;
 	a2c_EndScope(c, &sc);
+	a2c_Optimize(c);
 	a2c_PopCoder(c);
 	c->nocode = 1;
 }
@@ -3331,23 +3841,25 @@ static void a2c_wd_flagattr(A2_compiler *c, A2_wavedef *wd, unsigned flag)
 }
 
 
+/*
+ * Create the wave, and queue it for rendering. Waves are rendered in parallel
+ * by a2c_RenderWaves() at the end of compilation.
+ */
 static void a2c_wd_render(A2_compiler *c, A2_wavedef *wd,
 		A2_tokens terminator)
 {
-	A2_property props[] = {
-		{ A2_PRANDSEED,		wd->randseed	},
-		{ A2_PNOISESEED,	wd->noiseseed	},
-		{ 0, 0 }
-	};
 	int maxargc;
+	A2_pendingwave *pw;
 	if(wd->duration)
 		wd->length = wd->duration * wd->samplerate;
 	wd->program = a2c_GetHandle(c, c->l);
 	maxargc = (a2_GetProgram(c->state, wd->program))->funcs[0].argc;
 	wd->argc = a2c_ConstArguments(c, maxargc, wd->argv);
+	if(!wd->period)
+		wd->period = wd->samplerate / A2_MIDDLEC;
 	RENDERDBG(
 		A2_DLOG(".--------------------------------\n");
-		A2_DLOG("| Rendering wave %s...\n", wd->symbol->name);
+		A2_DLOG("| Queueing wave %s...\n", wd->symbol->name);
 		A2_DLOG("|        type: %d\n", wd->type);
 		A2_DLOG("|       flags: %x\n", wd->flags);
 		A2_DLOG("|      period: %d\n", wd->period);
@@ -3356,14 +3868,26 @@ static void a2c_wd_render(A2_compiler *c, A2_wavedef *wd,
 		A2_DLOG("|    randseed: %d\n", wd->randseed);
 		A2_DLOG("|   noiseseed: %d\n", wd->noiseseed);
 	)
-	if((wd->symbol->v.i = a2_RenderWave(c->interface,
-			wd->type, wd->period, wd->flags,
-			wd->samplerate, wd->length, props,
-			wd->program, wd->argc, wd->argv)) < 0)
-		a2c_Throw(c, -wd->symbol->v.i);
-	if(wd->symbol->v.i < 0)
-		a2c_Throw(c, -wd->symbol->v.i);
-	RENDERDBG(printf("|  DONE!\n");)
+	if(!(pw = (A2_pendingwave *)calloc(1, sizeof(A2_pendingwave))))
+		a2c_Throw(c, A2_OOMEMORY);
+	pw->next = c->waves;
+	c->waves = pw;
+	if(!(pw->name = strdup(wd->symbol->name)))
+		a2c_Throw(c, A2_OOMEMORY);
+	pw->props[0].property = A2_PRANDSEED;
+	pw->props[0].value = wd->randseed;
+	pw->props[1].property = A2_PNOISESEED;
+	pw->props[1].value = wd->noiseseed;
+	pw->job.samplerate = wd->samplerate;
+	pw->job.length = wd->length;
+	pw->job.props = pw->props;
+	pw->job.program = wd->program;
+	pw->job.argc = wd->argc;
+	memcpy(pw->job.argv, wd->argv, sizeof(wd->argv));
+	if((pw->job.wave = a2_NewWave(c->interface, wd->type, wd->period,
+			wd->flags)) < 0)
+		a2c_Throw(c, -pw->job.wave);
+	wd->symbol->v.i = pw->job.wave;
 
 	/* We expect this to be the last statement in the wavedef! */
 	while(a2c_Lex(c, A2_LEX_WHITENEWLINE) != terminator)
@@ -3373,6 +3897,52 @@ static void a2c_wd_render(A2_compiler *c, A2_wavedef *wd,
 }
 
 
+static void a2c_FreeWaves(A2_compiler *c)
+{
+	while(c->waves)
+	{
+		A2_pendingwave *pw = c->waves;
+		c->waves = pw->next;
+		free(pw->name);
+		free(pw);
+	}
+}
+
+
+/* Render all queued waves */
+static void a2c_RenderWaves(A2_compiler *c)
+{
+	A2_pendingwave *pw;
+	A2_renderjob *jobs;
+	A2_errors res;
+	unsigned n, j;
+	for(n = 0, pw = c->waves; pw; pw = pw->next)
+		++n;
+	if(!n)
+		return;
+	if(!(jobs = (A2_renderjob *)malloc(n * sizeof(A2_renderjob))))
+		a2c_Throw(c, A2_OOMEMORY);
+	for(j = n, pw = c->waves; pw; pw = pw->next)
+		jobs[--j] = pw->job;
+	RENDERDBG(A2_DLOG("Rendering %d waves...\n", n);)
+	res = a2_RenderWaveJobs(c->interface, jobs, n);
+	for(j = n, pw = c->waves; pw; pw = pw->next)
+	{
+		int r = jobs[--j].result;
+		if(!res && (r < 0))
+		{
+			A2_LOG_ERR(c->interface, "Could not render wave "
+					"\"%s\"!", pw->name);
+			res = -r;
+		}
+	}
+	free(jobs);
+	a2c_FreeWaves(c);
+	if(res)
+		a2c_Throw(c, res);
+}
+
+
 static int a2c_WaveDefStatement(A2_compiler *c, A2_wavedef *wd,
 		A2_tokens terminator)
 {
@@ -3457,6 +4027,7 @@ static struct
 	{ "normalize",	AT_FLAG,	A2_NORMALIZE	},
 	{ "xfade",	AT_FLAG,	A2_XFADE	},
 	{ "revmix",	AT_FLAG,	A2_REVMIX	},
+	{ "fast",	AT_FLAG,	A2_FAST		},
 
 	{ "OFF",	TK_WAVETYPE,	A2_WOFF		},
 	{ "NOISE",	TK_WAVETYPE,	A2_WNOISE	},
@@ -4023,6 +4594,7 @@ A2_compiler *a2_OpenCompiler(A2_interface *i, int flags)
 	c->interface = i;
 	c->state = ((A2_interface_i *)i)->state;
 	flags |= c->state->config->flags & A2_INITFLAGS;
+	c->optimize = !(flags & A2_NOOPTIMIZE);
 	c->lexbufpos = 0;
 	c->lexbufsize = 64;
 	if(!(c->lexbuf = (char *)malloc(c->lexbufsize)))
@@ -4099,6 +4671,7 @@ void a2_CloseCompiler(A2_compiler *c)
 	}
 	while(c->coder)
 		a2c_PopCoder(c);
+	a2c_FreeWaves(c);
 	a2ht_Cleanup(&c->imports);
 	free(c->lexbuf);
 	if(c->path)
@@ -4109,11 +4682,13 @@ void a2_CloseCompiler(A2_compiler *c)
 
 static void a2_Compile(A2_compiler *c, A2_scope *sc, const char *source)
 {
+	A2_errors err;
 	a2c_Try(c)
 	{
 		a2c_BeginScope(c, sc);
 		c->canexport = 1;
 		a2c_Statements(c, TK_EOF);
+		a2c_RenderWaves(c);
 		a2c_EndScope(c, sc);
 		return;
 	}
@@ -4161,7 +4736,12 @@ static void a2_Compile(A2_compiler *c, A2_scope *sc, const char *source)
 			a2_DumpLine(c, c->l[0].pos, 1, stderr);
 		}
 	}
-	/* Try to avoid dangling wires and stuff... */
+	/*
+	 * Try to avoid dangling wires and stuff... (a2c_Try() clears the error
+	 * code, so we need to hang on to it.)
+	 */
+	err = c->error;
+	a2c_FreeWaves(c);
 	a2c_Try(c)
 	{
 		while(c->coder)
@@ -4191,6 +4771,7 @@ static void a2_Compile(A2_compiler *c, A2_scope *sc, const char *source)
 		A2_LOG_INT("Emergency finalization 2: %s",
 				a2_ErrorString(c->error));
 	}
+	c->error = err;
 }
 
 
@@ -4252,22 +4833,5 @@ A2_errors a2_CompileFile(A2_compiler *c, A2_handle bank, const char *fn)
 	}
 	res = a2_CompileString(c, bank, code, fn);
 	free(code);
-#ifdef A2_OUT_A2B
-	{
-		A2_bank *b = a2_GetBank(c->state, bank);
-		if(!b)
-			return A2_INVALIDHANDLE;
-		A2_symbol *s = b->exports;
-		f = fopen("out.a2b", "wb");
-		fwrite(&b->end, 1, 3, f);
-		fwrite(bank->code, b->end, sizeof(unsigned), f);
-		for( ; s; s = s->next)
-		{
-			fwrite(s->name, 1, strlen(s->name) + 1, f);
-			fwrite(&s->value, 1, 3, f);
-		}
-		fclose(f);
-	}
-#endif
 	return res;
 }
@@ -264,6 +264,16 @@ typedef struct A2_lexvalue
 	Compiler state
 ---------------------------------------------------------*/
 
+/* 'wave' definition waiting to be rendered */
+typedef struct A2_pendingwave A2_pendingwave;
+struct A2_pendingwave
+{
+	A2_pendingwave	*next;
+	char		*name;		/* Wave name, for error messages */
+	A2_renderjob	job;
+	A2_property	props[3];	/* Seeds for the render substate */
+};
+
 struct A2_compiler
 {
 	A2_state	*state;		/* Parent engine state */
@@ -283,6 +293,8 @@ struct A2_compiler
 	int		canexport;	/* Current context allows exports! */
 	int		inhandler;	/* Disallow timing, RUN, SLEEP ,... */
 	int		nocode;		/* Disallow code in current context  */
+	int		optimize;	/* Run the peephole optimizer */
+	A2_pendingwave	*waves;		/* Waves to render; newest first */
 	A2_jumpbuf	jumpbuf;	/* Buffer for a2c_Try()/a2c_Throw() */
 	A2_errors	error;		/* Error from a2c_Throw() */
 #ifdef THROWSOURCE
@@ -104,7 +104,10 @@
 #define	A2_MINEVENTS		256
 #define	A2_TIMEEVENTS		1000
 
-/* Quality for wavetable oscillators */
+/*
+ * Default 'quality' for wavetable oscillators.
+ * (A2_HIFI selects Hermite interpolation for 'wtosc'; otherwise linear.)
+ */
 #define	A2_HIFI
 #undef	A2_LOFI
 
@@ -118,16 +121,88 @@
  */
 #define A2_INSLIMIT		1000
 
+/*
+ * Use threaded VM dispatch (GCC "labels as values") where available. Undefine
+ * to force the portable switch() dispatch loop.
+ */
+#if defined(__GNUC__)
+#	define	A2_THREADED
+#endif
+
+/*
+ * Use SSE2 kernels for oscillator inner loops where available. (SSE2 is part of
+ * the x86-64 baseline, so there is no need for run-time detection there.)
+ * Undefine to force the portable C code.
+ */
+#if defined(__SSE2__)
+#	define	A2_SSE2
+#endif
+
 /*
  * Maximum allowed child voice nesting depth. (Recursive explosion inhibitor.)
  */
 #define	A2_NESTLIMIT		255
 
+/*
+ * Terminated voices whose units all support reset are kept populated and wired
+ * in a per-state cache of up to A2_MAXWARM entries, for reuse by new voices
+ * running the same program. A2_WARMVOICES is the default size (A2_PWARMVOICES)
+ * of the cache. Set to 0 to disable recycling by default.
+ */
+#define	A2_WARMVOICES		16
+#define	A2_MAXWARM		32
+
 /* Default initial pool sizes for A2_REALTIME states */
 #define	A2_INITHANDLES		256
 #define	A2_INITVOICES		256
 #define	A2_INITBLOCKS		512
 
+/*
+ * Realtime memory blocks come in A2_SLABCLASSES power of two size classes,
+ * starting at A2_SLABMIN bytes, and ending at A2_BLOCK_SIZE.
+ */
+#define	A2_SLABMIN		64
+#define	A2_SLABCLASSES		6
+
+/* Alignment of units and control output arrays within voice unit images */
+#define	A2_IMAGEALIGN(x)	(((x) + 15) & ~15)
+
+/*
+ * Pool housekeeping for A2_REALTIME states. Each pool has a target size, which
+ * is its initial size, but at least A2_HKMINPOOL items. When a pool drops below
+ * 1/A2_HKLOWDIV of its target size, it is refilled to the target size by the
+ * housekeeping thread. When it grows beyond A2_HKHIGHMUL times the target
+ * size, it is trimmed back, at most A2_HKMAXTRIM items per audio callback.
+ * The housekeeping thread checks for requests every A2_HKPERIOD ms.
+ */
+#define	A2_HKMINPOOL		8
+#define	A2_HKLOWDIV		4
+#define	A2_HKHIGHMUL		2
+#define	A2_HKMAXTRIM		64
+#define	A2_HKPERIOD		5
+
+/*
+ * Voice processing lanes, used when the state has a worker pool. Subvoices of
+ * the root voice are distributed over the lanes, and the lanes are handed out
+ * to the workers, so this should be a few times the number of cores used.
+ *
+ * NOTE: Lane assignment, and thus the order in which voices draw from the
+ *       'rand' and noise generators, depends only on this value, and not on
+ *       the number of worker threads.
+ */
+#define	A2_LANES		32
+
+/*
+ * Pool items lent to each lane with voices to process, for every processing
+ * pass. Lanes allocating beyond this fall back to the system driver.
+ */
+#define	A2_LANEBLOCKS		16
+#define	A2_LANEEVENTS		8
+#define	A2_LANEVOICES		4
+
+/* Size of the per-lane engine->API message buffers (messages) */
+#define	A2_LANEMESSAGES		32
+
 /* Size of temporary string buffers (bytes) */
 #define	A2_TMPSTRINGSIZE	256
 
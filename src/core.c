@@ -92,9 +92,17 @@ void a2_FlushEventQueue(A2_state *st, A2_event **eq, A2_handle h)
 static inline A2_errors a2_VoicePush(A2_state *st, A2_voice *v, int firstreg,
 		int topreg, int interrupt)
 {
-	A2_stackentry *se = &a2_AllocBlock(st)->stackentry;
 	int saveregs = topreg - firstreg + 1;
-	if(!se)
+	A2_stackentry *se;
+#ifdef DEBUG
+	if(saveregs > A2_MAXSAVEREGS)
+	{
+		A2_LOG_INT("A2S compiler bug: Too large stack frame! "
+				"%d (max: %d)", saveregs, A2_MAXSAVEREGS);
+		return A2_INTERNAL + 401;
+	}
+#endif
+	if(!(se = a2_AllocBlock(st, A2_STACKENTRYSIZE(saveregs))))
 		return A2_OOMEMORY;
 	se->prev = v->stack;
 	v->stack = se;
@@ -105,15 +113,6 @@ static inline A2_errors a2_VoicePush(A2_state *st, A2_voice *v, int firstreg,
 	se->waketime = v->s.waketime;
 	se->firstreg = firstreg;
 	se->topreg = topreg;
-#ifdef DEBUG
-	if(saveregs > A2_MAXSAVEREGS)
-	{
-		a2_FreeBlock(st, se);
-		A2_LOG_INT("A2S compiler bug: Too large stack frame! "
-				"%d (max: %d)", saveregs, A2_MAXSAVEREGS);
-		return A2_INTERNAL + 401;
-	}
-#endif
 	memcpy(se->r, v->s.r + firstreg, sizeof(int) * saveregs);
 	return A2_OK;
 }
@@ -135,7 +134,7 @@ static inline int a2_VoicePop(A2_state *st, A2_voice *v)
 		v->s.pc = se->pc + 1;
 	memcpy(v->s.r + se->firstreg, se->r, sizeof(int) * saveregs);
 	v->stack = se->prev;
-	a2_FreeBlock(st, se);
+	a2_FreeBlock(st, se, A2_STACKENTRYSIZE(saveregs));
 	return inter;
 }
 
@@ -149,6 +148,107 @@ static inline void a2_VoiceControl(A2_state *st, A2_voice *v, unsigned reg,
 }
 
 
+/* Size of the control output array of units described by 'ud' */
+static inline unsigned a2_COutputsSize(const A2_unitdesc *ud)
+{
+	unsigned n = 0;
+	while(ud->coutputs[n].name)
+		++n;
+	return n * sizeof(A2_cport);
+}
+
+
+/*
+ * Free the memory blocks of unit 'u', unless it's part of the voice unit image
+ * 'image'.
+ */
+static inline void a2_FreeUnitBlocks(A2_state *st, A2_unit *u, char *image)
+{
+	const A2_unitdesc *ud = u->descriptor;
+	if(image)
+		return;
+	if(u->coutputs)
+		a2_FreeBlock(st, u->coutputs, a2_COutputsSize(ud));
+	a2_FreeBlock(st, u, ud->instancesize);
+}
+
+
+A2_errors a2_PrepareVoiceTemplate(A2_state *st, A2_program *p)
+{
+	A2_structitem *si, *usi;
+	unsigned size = 0;
+	unsigned nregs = p->nfuncs ? p->funcs->argv + p->funcs->argc : 0;
+	int recycle = 1;
+	p->imagesize = 0;
+	p->recycle = 0;
+
+	/* Lay out units and control output arrays */
+	for(si = p->units; si; si = si->next)
+	{
+		const A2_unitdesc *ud = st->ss->units[si->kind];
+		if(ud->registers)
+		{
+			int j;
+			for(j = 0; ud->registers[j].name; ++j)
+				++nregs;
+		}
+		if(!a2_UnitReset(ud) || ud->Deinitialize)
+			recycle = 0;
+		si->p.unit.offset = size;
+		size = A2_IMAGEALIGN(size + ud->instancesize);
+		if(ud->coutputs)
+		{
+			si->p.unit.coffset = size;
+			size = A2_IMAGEALIGN(size + a2_COutputsSize(ud));
+		}
+		else
+			si->p.unit.coffset = 0;
+	}
+
+	/* Make sure the register frame has room for all control registers */
+	if(nregs > A2_REGISTERS)
+		return A2_BADFORMAT;
+	if(nregs > p->nregs)
+		p->nregs = nregs;
+	p->ncregs = nregs;
+
+	/* Resolve control wires to control output offsets */
+	for(si = p->wires; si; si = si->next)
+	{
+		const A2_unitdesc *ud;
+		int i;
+		if(si->kind != A2_SI_CONTROL_WIRE)
+			continue;
+		if((si->p.wire.to_register < 0) ||
+				(si->p.wire.to_register >= nregs))
+			return A2_BADFORMAT;
+		usi = si->p.wire.from_unit >= 0 ? p->units : NULL;
+		for(i = 0; usi && (i < si->p.wire.from_unit); ++i)
+			usi = usi->next;
+		if(!usi)
+			return A2_BADFORMAT;
+		ud = st->ss->units[usi->kind];
+		if(!ud->coutputs || (si->p.wire.from_output < 0) ||
+				(si->p.wire.from_output * sizeof(A2_cport) >=
+				a2_COutputsSize(ud)))
+			return A2_BADFORMAT;
+		si->p.wire.coffset = usi->p.unit.coffset +
+				si->p.wire.from_output * sizeof(A2_cport);
+	}
+
+	/*
+	 * Voices can be recycled if they have a unit image, and all units can
+	 * be reset, with nothing to clean up in between.
+	 */
+	if(p->units && (size <= A2_BLOCK_SIZE))
+	{
+		p->imagesize = size;
+		p->recycle = recycle;
+	}
+	return A2_OK;
+}
+
+
 /*
  * Instantiate, initialize and wire a unit as described by descriptor 'ud',
  * and add it at the end of the chain in voice 'v'.
@@ -162,11 +262,12 @@ static inline void a2_VoiceControl(A2_state *st, A2_voice *v, unsigned reg,
  */
 static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
 		A2_voice *v, A2_unit *lastunit, int32_t **scratch,
-		unsigned noutputs, int32_t **outputs)
+		unsigned noutputs, int32_t **outputs, char *image)
 {
 	DBG(A2_interface *i = &st->interfaces->interface;)
 	A2_errors res;
 	int minoutputs, maxoutputs, ninputs;
+	unsigned flags = si->p.unit.flags;
 	A2_unit *u;
 	const A2_unitdesc *ud = st->ss->units[si->kind];
 	A2_unitstate *us = st->unitstate + si->kind;
@@ -178,11 +279,15 @@ static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
 		return NULL;
 	}
 
-	if(!(u = &a2_AllocBlock(st)->unit))
+	if(image)
+		u = (A2_unit *)(image + si->p.unit.offset);
+	else if(!(u = (A2_unit *)a2_AllocBlock(st, ud->instancesize)))
 	{
 		a2r_Error(st, A2_OOMEMORY, "a2_AddUnit()[2]");
 		return NULL;
 	}
+	u->descriptor = ud;
+	u->coutputs = NULL;
 
 	DUMPSTRUCTRT(A2_DLOG("Wiring %s... ", ud->name);)
 
@@ -193,7 +298,7 @@ static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
 		ninputs = noutputs;
 		if(ninputs < ud->mininputs)
 		{
-			a2_FreeBlock(st, u);
+			a2_FreeUnitBlocks(st, u, image);
 			A2_LOG_DBG(i, "Voice %p has too few channels for "
 					"unit '%s'!", v, ud->name);
 			a2r_Error(st, A2_FEWCHANNELS, "a2_AddUnit()[3]");
@@ -224,7 +329,7 @@ static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
 		u->noutputs = noutputs;
 		if(u->noutputs < minoutputs)
 		{
-			a2_FreeBlock(st, u);
+			a2_FreeUnitBlocks(st, u, image);
 			A2_LOG_DBG(i, "Voice %p has too few channels for "
 					"unit '%s'!", v, ud->name);
 			a2r_Error(st, A2_FEWCHANNELS, "a2_AddUnit()[4]");
@@ -238,12 +343,25 @@ static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
 		break;
 	}
 	if(si->p.unit.noutputs == A2_IO_WIREOUT)
+	{
 		u->outputs = outputs;
+
+		/*
+		 * The root voice is the only writer of the master bus, so if
+		 * the first unit to write it covers all channels, it can do
+		 * so in replacing mode, and the master bus needs no clearing.
+		 */
+		if(!v->nestlevel && !(v->flags & A2_REPLACEOUT) &&
+				(u->noutputs == noutputs))
+		{
+			flags &= ~A2_PROCADD;
+			v->flags |= A2_REPLACEOUT;
+		}
+	}
 	else
 		u->outputs = scratch;
 
 	/* Initialize instance struct and wire any control registers */
-	u->descriptor = ud;
 	u->registers = v->s.r + v->ncregs;
 	if(ud->registers)
 	{
@@ -263,23 +381,22 @@ static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
 	if(ud->coutputs)
 	{
 		int j;
-/*HACK*/
-		if(!(u->coutputs = (A2_cport *)a2_AllocBlock(st)))
+		if(image)
+			u->coutputs = (A2_cport *)(image + si->p.unit.coffset);
+		else if(!(u->coutputs = (A2_cport *)a2_AllocBlock(st,
+				a2_COutputsSize(ud))))
 		{
-			a2_FreeBlock(st, u);
+			a2_FreeUnitBlocks(st, u, image);
 			a2r_Error(st, A2_OOMEMORY, "a2_AddUnit()[5]");
 			return NULL;
 		}
-/*/HACK*/
 		for(j = 0; ud->coutputs[j].name; ++j)
 			u->coutputs[j].write = NULL;
 	}
-	else
-		u->coutputs = NULL;
 
 	if((ud->flags & A2_MATCHIO) && (u->ninputs != u->noutputs))
 	{
-		a2_FreeBlock(st, u);
+		a2_FreeUnitBlocks(st, u, image);
 		A2_LOG_DBG(i, "Unit '%s' needs to have matching input/output "
 				"counts!", ud->name);
 		a2r_Error(st, A2_IODONTMATCH, "a2_AddUnit()[6]");
@@ -287,9 +404,9 @@ static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
 	}
 
 	/* Initialize the unit instance itself! */
-	if((res = ud->Initialize(u, &v->s, us->statedata, si->p.unit.flags)))
+	if((res = ud->Initialize(u, &v->s, us->statedata, flags)))
 	{
-		a2_FreeBlock(st, u);
+		a2_FreeUnitBlocks(st, u, image);
 		A2_LOG_DBG(i, "Unit '%s' on voice %p failed to initialize! "
 				"(%s)", ud->name, v, a2_ErrorString(res));
 		a2r_Error(st, res, "a2_AddUnit()[7]");
@@ -315,28 +432,29 @@ static inline A2_unit *a2_AddUnit(A2_state *st, const A2_structitem *si,
  *	This does NOT remove the unit from the voice unit chain! The unit must
  *	be detached from the list before destroyed with this function.
  */
-static inline void a2_DestroyUnit(A2_state *st, A2_unit *u)
+static inline void a2_DestroyUnit(A2_state *st, A2_unit *u, char *image)
 {
 	if(u->descriptor->Deinitialize)
 		u->descriptor->Deinitialize(u);
-/*HACK*/
-	if(u->coutputs)
-		a2_FreeBlock(st, u->coutputs);
-/*/HACK*/
-	a2_FreeBlock(st, u);
+	a2_FreeUnitBlocks(st, u, image);
 }
 
 
 static inline A2_errors a2_ControlWire(A2_state *st, const A2_structitem *si,
 		A2_voice *v)
 {
-	/* Find the unit with the control output */
-	int i;
 	A2_cport *co, *cr;
-	A2_unit *u = v->units;
-	for(i = 0; i < si->p.wire.from_unit; ++i)
-		u = u->next;
-	co = &u->coutputs[si->p.wire.from_output];
+	if(v->image)
+		co = (A2_cport *)(v->image + si->p.wire.coffset);
+	else
+	{
+		/* Find the unit with the control output */
+		int i;
+		A2_unit *u = v->units;
+		for(i = 0; i < si->p.wire.from_unit; ++i)
+			u = u->next;
+		co = &u->coutputs[si->p.wire.from_output];
+	}
 	cr = &v->cregs[si->p.wire.to_register];
 	co->unit = cr->unit;
 	co->write = cr->write;
@@ -344,6 +462,47 @@ static inline A2_errors a2_ControlWire(A2_state *st, const A2_structitem *si,
 }
 
 
+/*
+ * Returns 1 if voice 'v', running program 'p', can be recycled when it
+ * terminates. Subvoices of the root voice are started by the master state,
+ * but with workers, they're processed and freed by the lanes, so those are
+ * never recycled. (The root voice itself is never recycled.)
+ */
+static inline int a2_CanRecycle(A2_state *st, const A2_program *p,
+		A2_voice *v)
+{
+	return p->recycle && (v->nestlevel > (st->nlanes ? 1 : 0));
+}
+
+
+/*
+ * Reset the units of the recycled voice 'v', which are already in place and
+ * wired as described by program 'p'.
+ */
+static inline A2_errors a2_ResetVoice(A2_state *st, const A2_program *p,
+		A2_voice *v)
+{
+	A2_structitem *si;
+	A2_unit *u;
+	v->units = (A2_unit *)v->image;
+	v->ncregs = p->ncregs;
+	for(si = p->units, u = v->units; si; si = si->next, u = u->next)
+	{
+		A2_errors res = a2_UnitReset(u->descriptor)(u, &v->s,
+				st->unitstate[si->kind].statedata,
+				si->p.unit.flags);
+		if(res)
+		{
+			v->units = NULL;
+			a2r_Error(st, res, "a2_ResetVoice()");
+			return A2_VOICEINIT;
+		}
+	}
+	v->flags |= A2_RECYCLE;
+	return A2_OK;
+}
+
+
 /*
  * Populate voice 'v' with units as described by program 'p'.
  */
@@ -394,10 +553,22 @@ static inline A2_errors a2_PopulateVoice(A2_state *st, const A2_program *p,
 		scratch = (*b)->buffers;
 	}
 
+	/* Recycled voice? Then the units are already there, and wired. */
+	if(v->image && !v->units)
+		return a2_ResetVoice(st, p, v);
+
+	/* Grab a unit image, if the program has a template for one */
+	if(p->imagesize)
+	{
+		if(!(v->image = a2_AllocBlock(st, p->imagesize)))
+			return A2_OOMEMORY;
+		v->imagesize = p->imagesize;
+	}
+
 	/* Add and wire the voice units! */
 	for(si = p->units; si; si = si->next)
 		if(!(lastu = a2_AddUnit(st, si, v, lastu, scratch,
-				noutputs, outputs)))
+				noutputs, outputs, v->image)))
 			return A2_VOICEINIT;
 
 	for(si = p->wires; si; si = si->next)
@@ -416,6 +587,8 @@ static inline A2_errors a2_PopulateVoice(A2_state *st, const A2_program *p,
 			return A2_INTERNAL + 402;
 		}
 
+	if(a2_CanRecycle(st, p, v))
+		v->flags |= A2_RECYCLE;
 	return A2_OK;
 }
 
@@ -424,25 +597,131 @@ static inline A2_errors a2_PopulateVoice(A2_state *st, const A2_program *p,
  * WARNING: These are tuned for minimal init/cleanup overhead! Be careful...
  *===========================================================================*/
 
-A2_voice *a2_VoiceAlloc(A2_state *st)
+void a2_VoiceInit(A2_voice *v)
 {
-	A2_voice *v = (A2_voice *)st->sys->RTAlloc(st->sys, sizeof(A2_voice));
-	if(!v)
-	{
-		a2r_Error(st, A2_OOMEMORY, "a2_VoiceAlloc()");
-		return NULL;
-	}
 	v->sub = NULL;
 	v->stack = NULL;
 	v->program = NULL;
 	v->events = NULL;
 	v->units = NULL;
+	v->image = NULL;
+	v->s.r = NULL;
+	v->cregs = NULL;
+	v->nregs = 0;
 	v->ncregs = A2_FIXEDREGS;	/* Start at the first free register */
 	v->handle = -1;
 #if A2_SV_LUT_SIZE
 	memset(v->sv, 0, sizeof(v->sv));
 #endif
-	memset(v->cregs, 0, sizeof(v->cregs));
+}
+
+
+/* Free the unit image and register frame of warm voice 'wv' */
+static inline void a2_FreeWarmVoice(A2_state *st, A2_warmvoice *wv)
+{
+	a2_FreeBlock(st, wv->image, wv->imagesize);
+	a2_FreeBlock(st, wv->frame, A2_FRAMESIZE(wv->nregs));
+}
+
+
+/*
+ * Hand the units and register frame of a voice that ran program 'p', with
+ * the same outputs as a new subvoice of 'parent' would get, to voice 'v'.
+ * Returns 1 if there was such a voice in the warm voice cache, otherwise 0.
+ */
+static inline int a2_GetWarmVoice(A2_state *st, A2_voice *v,
+		A2_voice *parent, const A2_program *p)
+{
+	int i;
+	if(!p->recycle)
+		return 0;
+	for(i = st->nwarm - 1; i >= 0; --i)
+	{
+		A2_warmvoice *wv = st->warm + i;
+		if((wv->program != p) || (wv->outputs != parent->outputs) ||
+				(wv->noutputs != parent->noutputs) ||
+				(wv->nestlevel != parent->nestlevel + 1))
+			continue;
+		v->nregs = wv->nregs;
+		v->s.r = wv->frame;
+		v->cregs = (A2_cport *)((char *)wv->frame +
+				A2_FRAMEREGSSIZE(wv->nregs));
+		v->image = wv->image;
+		v->imagesize = wv->imagesize;
+		--st->nwarm;
+		memmove(wv, wv + 1, (st->nwarm - i) * sizeof(A2_warmvoice));
+		return 1;
+	}
+	return 0;
+}
+
+
+/*
+ * Keep the units and register frame of the terminating voice 'v' in the warm
+ * voice cache, evicting the oldest voices as needed.
+ */
+static inline void a2_PutWarmVoice(A2_state *st, A2_voice *v)
+{
+	A2_warmvoice *wv;
+	while(st->nwarm >= st->ss->warmvoices)
+	{
+		a2_FreeWarmVoice(st, st->warm);
+		--st->nwarm;
+		memmove(st->warm, st->warm + 1,
+				st->nwarm * sizeof(A2_warmvoice));
+	}
+	wv = st->warm + st->nwarm++;
+	wv->program = v->program;
+	wv->outputs = v->outputs;
+	wv->noutputs = v->noutputs;
+	wv->nestlevel = v->nestlevel;
+	wv->image = v->image;
+	wv->imagesize = v->imagesize;
+	wv->frame = v->s.r;
+	wv->nregs = v->nregs;
+	v->units = NULL;
+	v->image = NULL;
+	v->s.r = NULL;
+	v->cregs = NULL;
+}
+
+
+void a2_FlushWarmVoices(A2_state *st, const A2_program *p)
+{
+	unsigned i, n = 0;
+	for(i = 0; i < st->nwarm; ++i)
+		if(!p || (st->warm[i].program == p))
+			a2_FreeWarmVoice(st, st->warm + i);
+		else
+			st->warm[n++] = st->warm[i];
+	st->nwarm = n;
+}
+
+
+/* Allocate and clear a register frame for program 'p' */
+static inline A2_errors a2_VoiceFrame(A2_state *st, A2_voice *v,
+		const A2_program *p)
+{
+	char *frame = a2_AllocBlock(st, A2_FRAMESIZE(p->nregs));
+	if(!frame)
+		return A2_OOMEMORY;
+	v->nregs = p->nregs;
+	v->s.r = (int *)frame;
+	v->cregs = (A2_cport *)(frame + A2_FRAMEREGSSIZE(p->nregs));
+	memset(v->cregs, 0, p->nregs * sizeof(A2_cport));
+	return A2_OK;
+}
+
+
+A2_voice *a2_VoiceAlloc(A2_state *st)
+{
+	A2_voice *v = (A2_voice *)st->sys->RTAlloc(st->sys, sizeof(A2_voice));
+	if(!v)
+	{
+		a2r_Error(st, A2_OOMEMORY, "a2_VoiceAlloc()");
+		return NULL;
+	}
+	a2_VoiceInit(v);
 	++st->totalvoices;
 #ifdef DEBUG
 	if(st->audio && st->audio->Process &&
@@ -454,7 +733,8 @@ A2_voice *a2_VoiceAlloc(A2_state *st)
 }
 
 
-A2_voice *a2_VoiceNew(A2_state *st, A2_voice *parent, unsigned when)
+A2_voice *a2_VoiceNew(A2_state *st, A2_voice *parent, A2_program *p,
+		unsigned when)
 {
 	A2_voice *v = st->voicepool;
 	if(parent->nestlevel >= A2_NESTLIMIT - 1)
@@ -464,9 +744,20 @@ A2_voice *a2_VoiceNew(A2_state *st, A2_voice *parent, unsigned when)
 		return NULL;
 	}
 	if(v)
+	{
 		st->voicepool = v->next;
+		--st->nvoicepool;
+	}
 	else if(!(v = a2_VoiceAlloc(st)))
 		return NULL;
+	if(!a2_GetWarmVoice(st, v, parent, p) && a2_VoiceFrame(st, v, p))
+	{
+		v->next = st->voicepool;
+		st->voicepool = v;
+		++st->nvoicepool;
+		a2r_Error(st, A2_OOMEMORY, "a2_VoiceNew()");
+		return NULL;
+	}
 	++st->activevoices;
 	if(st->activevoices > st->activevoicesmax)
 		st->activevoicesmax = st->activevoices;
@@ -477,7 +768,36 @@ A2_voice *a2_VoiceNew(A2_state *st, A2_voice *parent, unsigned when)
 	v->s.r[R_TICK] = parent->s.r[R_TICK];
 	v->s.r[R_TRANSPOSE] = parent->s.r[R_TRANSPOSE];
 	v->noutputs = parent->noutputs;
-	v->outputs = parent->outputs;
+	if(!parent->nestlevel &&
+			(st->nlanes || (st->config->flags & A2_TREERNG)))
+	{
+		/*
+		 * With workers, every subvoice tree of the root voice has an
+		 * RNG of its own, seeded from the state RNG as it's started.
+		 * That way, the random numbers a voice sees don't depend on
+		 * the order in which the trees are processed, or on which
+		 * lanes. Without workers, all voices share the state RNG, as
+		 * before, unless A2_TREERNG is set.
+		 */
+		v->noise = a2_Noise(&st->noisestate) << 16;
+		v->noise |= a2_Noise(&st->noisestate);
+		v->noisestate = &v->noise;
+	}
+	else
+		v->noisestate = parent->noisestate;
+	if(!parent->nestlevel && st->nlanes)
+	{
+		/* Subvoice of the root voice; assign to the next lane */
+		v->lane = st->nextlane + 1;
+		v->outputs = st->lanes[st->nextlane].bus->buffers;
+		if(++st->nextlane >= st->nlanes)
+			st->nextlane = 0;
+	}
+	else
+	{
+		v->lane = parent->lane;
+		v->outputs = parent->outputs;
+	}
 	return v;
 }
 
@@ -501,6 +821,12 @@ A2_errors a2_init_root_voice(A2_state *st)
 		return A2_INTERNAL + 400;
 	if(!(v = a2_VoiceAlloc(st)))
 		return A2_OOMEMORY;
+	if((res = a2_VoiceFrame(st, v, rootdriver)))
+	{
+		st->sys->RTFree(st->sys, v);
+		--st->totalvoices;
+		return res;
+	}
 	st->rootvoice = rchm_NewEx(&st->ss->hm, v, A2_TVOICE, A2_LOCKED, 1);
 	if(st->rootvoice < 0)
 		return -st->rootvoice;
@@ -509,11 +835,13 @@ A2_errors a2_init_root_voice(A2_state *st)
 	if(st->activevoices > st->activevoicesmax)
 		st->activevoicesmax = st->activevoices;
 	v->nestlevel = 0;
+	v->lane = 0;
 	v->flags = A2_ATTACHED | A2_APIHANDLE;
 	v->s.waketime = st->now_fragstart;
 	v->next = NULL;
 	v->s.r[R_TICK] = A2_DEFAULTTICK;
 	v->s.r[R_TRANSPOSE] = 0;
+	v->noisestate = &st->noisestate;
 	v->noutputs = st->master->channels;
 	v->outputs = st->master->buffers;
 	for(j = A2_FIRSTCONTROLREG; j < v->ncregs; ++j)
@@ -531,11 +859,11 @@ A2_errors a2_init_root_voice(A2_state *st)
 /* Instantly kill and free voice and any subvoices recursively. */
 void a2_VoiceFree(A2_state *st, A2_voice **head)
 {
-	unsigned i;
 	A2_voice *v = *head;
 	*head = v->next;
 	v->next = st->voicepool;
 	st->voicepool = v;
+	++st->nvoicepool;
 	--st->activevoices;
 
 	if(v->flags & A2_APIHANDLE)
@@ -555,15 +883,36 @@ void a2_VoiceFree(A2_state *st, A2_voice **head)
 	memset(v->sv, 0, sizeof(v->sv));
 #endif
 
+	while(v->stack)
+		a2_VoicePop(st, v);
+
+	/*
+	 * Only recycle into the state that processed the voice, as the units
+	 * are wired to the scratch buses of that state.
+	 */
+	if((v->flags & A2_RECYCLE) && v->units && st->ss->warmvoices &&
+			(a2_VoiceState(st, v) == st))
+		a2_PutWarmVoice(st, v);
+
 	while(v->units)
 	{
 		A2_unit *u = v->units;
 		v->units = u->next;
-		a2_DestroyUnit(st, u);
+		a2_DestroyUnit(st, u, v->image);
+	}
+	/* NOTE: The program may be gone already, if we're closing the state! */
+	if(v->image)
+	{
+		a2_FreeBlock(st, v->image, v->imagesize);
+		v->image = NULL;
 	}
 
-	while(v->stack)
-		a2_VoicePop(st, v);
+	if(v->s.r)
+	{
+		a2_FreeBlock(st, v->s.r, A2_FRAMESIZE(v->nregs));
+		v->s.r = NULL;
+		v->cregs = NULL;
+	}
 
 	v->program = st->ss->terminator;
 	v->s.func = 0;
@@ -571,8 +920,6 @@ void a2_VoiceFree(A2_state *st, A2_voice **head)
 	v->s.state = A2_RUNNING;
 	v->flags = 0;
 	v->program = NULL;
-	for(i = A2_FIXEDREGS; i < v->ncregs; ++i)
-		v->cregs[i].write = NULL;
 	v->ncregs = A2_FIXEDREGS;
 }
 
@@ -794,7 +1141,7 @@ static A2_errors a2_VoiceSpawn(A2_state *st, A2_voice *v, int vid,
 	a2_DetachSubvoice(v, vid);
 	if(!p)
 		return A2_BADPROGRAM;
-	if(!(nv = a2_VoiceNew(st, v, v->s.waketime)))
+	if(!(nv = a2_VoiceNew(st, v, p, v->s.waketime)))
 		return v->nestlevel < A2_NESTLIMIT ?
 				A2_VOICEALLOC : A2_VOICENEST;
 	nv->flags = 0;
@@ -826,7 +1173,7 @@ static inline A2_errors a2_event_play(A2_state *st, A2_voice *parent,
 	A2_program *p = a2_GetProgram(st, eb->play.program);
 	if(!p)
 		return A2_BADPROGRAM;
-	if(!(v = a2_VoiceNew(st, parent, eb->common.timestamp)))
+	if(!(v = a2_VoiceNew(st, parent, p, eb->common.timestamp)))
 		return parent->nestlevel < A2_NESTLIMIT ?
 				A2_VOICEALLOC : A2_VOICENEST;
 	v->flags = 0;
@@ -845,7 +1192,7 @@ static inline A2_errors a2_event_start(A2_state *st, A2_voice *parent,
 	A2_program *p = a2_GetProgram(st, eb->start.program);
 	if(!p)
 		return A2_BADPROGRAM;
-	if(!(v = a2_VoiceNew(st, parent, eb->common.timestamp)))
+	if(!(v = a2_VoiceNew(st, parent, p, eb->common.timestamp)))
 		return parent->nestlevel < A2_NESTLIMIT ?
 				A2_VOICEALLOC : A2_VOICENEST;
 	/*
@@ -1003,7 +1350,7 @@ static inline A2_errors a2_VoiceProcessEvents(A2_state *st, A2_voice *v)
 				break;
 			}
 			v->s.waketime = e->b.common.timestamp;
-			v->events = e->next;
+			a2_UnlinkEvent(&v->events);
 			a2_FreeEvent(st, e);
 			return A2_OK;	/* Spin the VM to process message! */
 		  }
@@ -1025,7 +1372,7 @@ static inline A2_errors a2_VoiceProcessEvents(A2_state *st, A2_voice *v)
 			{
 				/* Turn into non-SUB event! */
 				--e->b.common.action;
-				v->events = e->next;
+				a2_UnlinkEvent(&v->events);
 				a2_event_subforward(st, v, e);
 				continue;	/* The event is reused! */
 			}
@@ -1051,7 +1398,7 @@ static inline A2_errors a2_VoiceProcessEvents(A2_state *st, A2_voice *v)
 			a2_VoiceDetach(v, e->b.common.timestamp);
 			break;
 		}
-		v->events = e->next;
+		a2_UnlinkEvent(&v->events);
 		a2_FreeEvent(st, e);
 	}
 	return A2_OK;
@@ -1151,46 +1498,150 @@ static int a2_sizeof_object(A2_state *st, int handle)
 	return ((int64_t)(w->d.wave.size[0]) << 16) / w->period;
 }
 
+
+/* Native code for the current function of 'v', if loaded and enabled */
+static inline A2_nativefunc a2_NativeFunc(A2_voice *v)
+{
+	if(!v->program->native)
+		return NULL;
+	return v->program->funcs[v->s.func].native;
+}
+
 /*
  * Execute VM instructions until a timing instruction is executed, or the
  * program ends. Returns A2_OK as long as the VM program wants to keep running.
  *
  * NOTE: 'limit' is the number of 256th frames to process.
+ *
+ * NOTE:
+ *	The PC is kept in a local pointer while running, and is only written
+ *	back to v->s.pc when leaving the VM, or before calls that push or pop
+ *	VM state. Branch targets are signed 16 bit word offsets, relative to
+ *	the branch instruction.
+ *
+ * NOTE:
+ *	With A2_THREADED, each instruction handler dispatches the next
+ *	instruction directly, via a GCC "labels as values" jump table.
+ *	Otherwise, a plain switch() loop is used.
+ *
+ * NOTE:
+ *	The *C versions of register writing instructions mark the target
+ *	register for a2_RTApply(), and then fall through into the plain
+ *	versions, which only write the register.
+ *
+ * NOTE:
+ *	The dispatch table, or opcode map without A2_THREADED, is selected
+ *	whenever a function is entered. For functions with native code, the
+ *	instructions that native code implements dispatch to the NATIVE
+ *	handler, which runs the native code from there. The native code
+ *	returns the PC of the first instruction it does not handle, which is
+ *	then executed by the VM. Functions without native code use the plain
+ *	table, and never look at native code.
  */
 #define	A2_VMABORT(e, m)					\
 	{							\
+		v->s.pc = pc - code;				\
 		st->instructions += A2_INSLIMIT - inscount;	\
 		a2r_Error(st, e, m);				\
 		return e;					\
 	}
+#define	A2_VMFETCH						\
+	{							\
+		ins = (A2_instruction *)pc;			\
+		DUMPCODERT(					\
+			A2_DLOG("%p: ", v);			\
+			a2_DumpIns(code, pc - code, stderr);	\
+		)						\
+		if(!--inscount)					\
+			A2_VMABORT(A2_OVERLOAD, "VM");		\
+	}
+#define	A2_VMFUNC						\
+	{							\
+		code = v->program->funcs[v->s.func].code;	\
+		nf = a2_NativeFunc(v);				\
+		ops = nf ? a2_vmnops : a2_vmops;		\
+	}
+#ifdef A2_THREADED
+#  define	A2_VMOP(x)	op_##x:
+#  define	A2_VMDISPATCH	{ A2_VMFETCH goto *ops[ins->opcode]; }
+#  define	A2_VMPLAIN	goto *a2_vmops[ins->opcode]
+#else
+/* Opcode map entries are offset by one, so that 0 marks illegal opcodes */
+#  define	A2_VMOP(x)	case OP_##x + 1:
+#  define	A2_VMDISPATCH	continue
+#  define	A2_VMPLAIN	{ op = a2_vmops[ins->opcode]; goto dispatch; }
+#endif
+#define	A2_VMNEXT(n)	{ pc += (n); A2_VMDISPATCH; }
+#define	A2_VMBRANCH	{ pc += (int16_t)ins->a2; A2_VMDISPATCH; }
 static inline A2_errors a2_VoiceProcessVM(A2_state *st, A2_voice *v)
 {
 	int res;
+	unsigned dt;
 	int cargc = 0, cargv[A2_MAXARGS];	/* run/spawn argument stack */
-	unsigned *code = v->program->funcs[v->s.func].code;
+	unsigned *code;
+	unsigned *pc;
+	A2_instruction *ins;
 	int *r = v->s.r;
 	unsigned inscount = A2_INSLIMIT;
 	A2_regtracker rt;
+	A2_nativefunc nf;
+	A2_nativecontext nc;
+#ifdef A2_THREADED
+#  define	A2_DI(x)	[OP_##x] = &&op_##x,
+#  define	A2_NI(x)	[OP_##x] = &&op_NATIVE,
+	static const void *const a2_vmops[256] = {
+		[0 ... 255] = &&op_ILLEGAL,
+		[OP_END] = &&op_END,
+		A2_ALLINSTRUCTIONS
+	};
+	static const void *const a2_vmnops[256] = {
+		[0 ... 255] = &&op_ILLEGAL,
+		[OP_END] = &&op_END,
+		A2_ALLINSTRUCTIONS
+		A2_NATIVEINSTRUCTIONS
+	};
+	const void *const *ops;
+#else
+#  define	A2_DI(x)	[OP_##x] = OP_##x + 1,
+#  define	A2_NI(x)	[OP_##x] = A2_OPCODES + 1,
+	static const uint8_t a2_vmops[256] = {
+		[OP_END] = OP_END + 1,
+		A2_ALLINSTRUCTIONS
+	};
+	static const uint8_t a2_vmnops[256] = {
+		[OP_END] = OP_END + 1,
+		A2_ALLINSTRUCTIONS
+		A2_NATIVEINSTRUCTIONS
+	};
+	const uint8_t *ops;
+	unsigned op;
+#endif
+#undef	A2_NI
+#undef	A2_DI
+	A2_VMFUNC
+	pc = code + v->s.pc;
 	if(v->s.state == A2_WAITING)
 		v->s.state = A2_RUNNING;
 	a2_RTInit(&rt);
+	nc.r = r;
+	nc.cargv = cargv;
 	while(1)
 	{
-		unsigned dt;
-		A2_instruction *ins = (A2_instruction *)(code + v->s.pc);
-		DUMPCODERT(
-			A2_DLOG("%p: ", v);
-			a2_DumpIns(code, v->s.pc);
-		)
-		if(!--inscount)
-			A2_VMABORT(A2_OVERLOAD, "VM");
-		switch((A2_opcodes)ins->opcode)
+		A2_VMFETCH
+#ifdef A2_THREADED
+		goto *ops[ins->opcode];
+#else
+		op = ops[ins->opcode];
+	  dispatch:
+		switch(op)
+#endif
 		{
 
 		/* Program flow control */
-		  case OP_END:
+		  A2_VMOP(END)
 		  {
 		  	unsigned now = v->s.waketime;
+			v->s.pc = pc - code;
 			a2_RTApply(&rt, st, v, v->s.waketime, 0);
 			v->s.waketime += 1000000;
 			if(v->s.state == A2_FINALIZING)
@@ -1234,15 +1685,16 @@ static inline A2_errors a2_VoiceProcessVM(A2_state *st, A2_voice *v)
 					v);)
 			return A2_OK;
 		  }
-		  case OP_RETURN:
+		  A2_VMOP(RETURN)
 		  {
 			unsigned now = v->s.waketime;
 			if(a2_VoicePop(st, v))
 			{
 				/* Return from interrupt */
-				code = v->program->funcs[v->s.func].code;
+				A2_VMFUNC
+				pc = code + v->s.pc;
 				if(v->s.state >= A2_ENDING)
-					continue;
+					A2_VMDISPATCH;
 				dt = v->s.waketime - now;
 				v->s.waketime = now;
 				goto timing_interrupt;
@@ -1250,11 +1702,12 @@ static inline A2_errors a2_VoiceProcessVM(A2_state *st, A2_voice *v)
 			else
 			{
 				/* Return from local function */
-				code = v->program->funcs[v->s.func].code;
-				continue;
+				A2_VMFUNC
+				pc = code + v->s.pc;
+				A2_VMDISPATCH;
 			}
 		  }
-		  case OP_CALL:
+		  A2_VMOP(CALL)
 		  {
 #ifdef DEBUG
 			A2_interface *i = &st->interfaces->interface;
@@ -1264,289 +1717,300 @@ static inline A2_errors a2_VoiceProcessVM(A2_state *st, A2_voice *v)
 				A2_LOG_DBG(i, "Function index %d out of "
 						"range!", ins->a2);
 #endif
+			v->s.pc = pc - code;
 			if((res = a2_VoiceCall(st, v, ins->a2, cargc, cargv,
 					0)))
 				A2_VMABORT(res, "VM:CALL");
-			code = v->program->funcs[v->s.func].code;
+			A2_VMFUNC
+			pc = code + v->s.pc;
 			cargc = 0;
-			continue;
+			A2_VMDISPATCH;
 		  }
 
 		/* Local flow control */
-		  case OP_JUMP:
-			v->s.pc = ins->a2;
-			continue;
-		  case OP_LOOP:
+		  A2_VMOP(JUMP)
+			A2_VMBRANCH;
+		  A2_VMOP(LOOP)
 			r[ins->a1] -= 65536;
 			if(r[ins->a1] <= 0)
-				break;
-			v->s.pc = ins->a2;
-			continue;
-		  case OP_JZ:
+				A2_VMNEXT(1);
+			A2_VMBRANCH;
+		  A2_VMOP(JZ)
 			if(r[ins->a1])
-				break;
-			v->s.pc = ins->a2;
-			continue;
-		  case OP_JNZ:
+				A2_VMNEXT(1);
+			A2_VMBRANCH;
+		  A2_VMOP(JNZ)
 			if(!r[ins->a1])
-				break;
-			v->s.pc = ins->a2;
-			continue;
-		  case OP_JG:
+				A2_VMNEXT(1);
+			A2_VMBRANCH;
+		  A2_VMOP(JG)
 			if(r[ins->a1] <= 0)
-				break;
-			v->s.pc = ins->a2;
-			continue;
-		  case OP_JL:
+				A2_VMNEXT(1);
+			A2_VMBRANCH;
+		  A2_VMOP(JL)
 			if(r[ins->a1] >= 0)
-				break;
-			v->s.pc = ins->a2;
-			continue;
-		  case OP_JGE:
+				A2_VMNEXT(1);
+			A2_VMBRANCH;
+		  A2_VMOP(JGE)
 			if(r[ins->a1] < 0)
-				break;
-			v->s.pc = ins->a2;
-			continue;
-		  case OP_JLE:
+				A2_VMNEXT(1);
+			A2_VMBRANCH;
+		  A2_VMOP(JLE)
 			if(r[ins->a1] > 0)
-				break;
-			v->s.pc = ins->a2;
-			continue;
+				A2_VMNEXT(1);
+			A2_VMBRANCH;
 
 		/* Timing */
-		  case OP_DELAY:
+		  A2_VMOP(DELAY)
 			dt = a2_ms2t(st, ins->a3);
-			++v->s.pc;
+			++pc;
 			goto timing;
-		  case OP_DELAYR:
+		  A2_VMOP(DELAYR)
 			dt = a2_ms2t(st, r[ins->a1]);
 			goto timing;
-		  case OP_TDELAY:
+		  A2_VMOP(TDELAY)
 			dt = a2_ticks2t(st, v, ins->a3);
-			++v->s.pc;
+			++pc;
 			goto timing;
-		  case OP_TDELAYR:
+		  A2_VMOP(TDELAYR)
 			dt = a2_ticks2t(st, v, r[ins->a1]);
 			goto timing;
 
 		/* Arithmetics */
-		  case OP_SUBR:
+		  A2_VMOP(SUBRC)
+			a2_RTMark(&rt, ins->a1);
+		  A2_VMOP(SUBR)
 			r[ins->a1] -= r[ins->a2];
+			A2_VMNEXT(1);
+		  A2_VMOP(DIVRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_DIVR:
+		  A2_VMOP(DIVR)
 			if(!r[ins->a2])
 				A2_VMABORT(A2_DIVBYZERO, "VM:DIVR");
 			r[ins->a1] = ((int64_t)r[ins->a1] << 16) / r[ins->a2];
+			A2_VMNEXT(1);
+		  A2_VMOP(P2DRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_P2DR:
+		  A2_VMOP(P2DR)
 			r[ins->a1] = A2_1K_DIV_MIDDLEC / a2_P2I(r[ins->a2]);
+			A2_VMNEXT(1);
+		  A2_VMOP(NEGRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_NEGR:
+		  A2_VMOP(NEGR)
 			r[ins->a1] = -r[ins->a2];
+			A2_VMNEXT(1);
+		  A2_VMOP(LOADC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_LOAD:
+		  A2_VMOP(LOAD)
 			r[ins->a1] = ins->a3;
+			A2_VMNEXT(2);
+		  A2_VMOP(LOADRC)
 			a2_RTMark(&rt, ins->a1);
-			++v->s.pc;
-			break;
-		  case OP_LOADR:
+		  A2_VMOP(LOADR)
 			r[ins->a1] = r[ins->a2];
+			A2_VMNEXT(1);
+		  A2_VMOP(ADDC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_ADD:
+		  A2_VMOP(ADD)
 			r[ins->a1] += ins->a3;
+			A2_VMNEXT(2);
+		  A2_VMOP(ADDRC)
 			a2_RTMark(&rt, ins->a1);
-			++v->s.pc;
-			break;
-		  case OP_ADDR:
+		  A2_VMOP(ADDR)
 			r[ins->a1] += r[ins->a2];
+			A2_VMNEXT(1);
+		  A2_VMOP(MULC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_MUL:
+		  A2_VMOP(MUL)
 			r[ins->a1] = (int64_t)r[ins->a1] * ins->a3 >> 16;
+			A2_VMNEXT(2);
+		  A2_VMOP(MULRC)
 			a2_RTMark(&rt, ins->a1);
-			++v->s.pc;
-			break;
-		  case OP_MULR:
+		  A2_VMOP(MULR)
 			r[ins->a1] = (int64_t)r[ins->a1] * r[ins->a2] >> 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(MODC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_MOD:
+		  A2_VMOP(MOD)
 			r[ins->a1] %= ins->a3;
+			A2_VMNEXT(2);
+		  A2_VMOP(MODRC)
 			a2_RTMark(&rt, ins->a1);
-			++v->s.pc;
-			break;
-		  case OP_MODR:
+		  A2_VMOP(MODR)
 			if(!r[ins->a2])
 				A2_VMABORT(A2_DIVBYZERO, "VM:MODR");
 			r[ins->a1] %= r[ins->a2];
+			A2_VMNEXT(1);
+		  A2_VMOP(QUANTC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_QUANT:
+		  A2_VMOP(QUANT)
 			r[ins->a1] = r[ins->a1] / ins->a3 * ins->a3;
+			A2_VMNEXT(2);
+		  A2_VMOP(QUANTRC)
 			a2_RTMark(&rt, ins->a1);
-			++v->s.pc;
-			break;
-		  case OP_QUANTR:
+		  A2_VMOP(QUANTR)
 			if(!r[ins->a2])
 				A2_VMABORT(A2_DIVBYZERO, "VM:QUANTR");
 			r[ins->a1] = r[ins->a1] / r[ins->a2] * r[ins->a2];
+			A2_VMNEXT(1);
+		  A2_VMOP(RANDC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_RAND:
-			r[ins->a1] = (int64_t)a2_Noise(&st->noisestate) *
+		  A2_VMOP(RAND)
+			r[ins->a1] = (int64_t)a2_Noise(v->noisestate) *
 					ins->a3 >> 16;
+			A2_VMNEXT(2);
+		  A2_VMOP(RANDRC)
 			a2_RTMark(&rt, ins->a1);
-			++v->s.pc;
-			break;
-		  case OP_RANDR:
-			r[ins->a1] = (int64_t)a2_Noise(&st->noisestate) *
+		  A2_VMOP(RANDR)
+			r[ins->a1] = (int64_t)a2_Noise(v->noisestate) *
 					r[ins->a2] >> 16;
-			a2_RTMark(&rt, ins->a1);
-			break;
+			A2_VMNEXT(1);
 
 		/* Comparison operators */
 /*TODO: Versions with an immediate second operand! */
-		  case OP_GR:
+		  A2_VMOP(GRC)
+			a2_RTMark(&rt, ins->a1);
+		  A2_VMOP(GR)
 			r[ins->a1] = (r[ins->a1] > r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(LRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_LR:
+		  A2_VMOP(LR)
 			r[ins->a1] = (r[ins->a1] < r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(GERC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_GER:
+		  A2_VMOP(GER)
 			r[ins->a1] = (r[ins->a1] >= r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(LERC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_LER:
+		  A2_VMOP(LER)
 			r[ins->a1] = (r[ins->a1] <= r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(EQRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_EQR:
+		  A2_VMOP(EQR)
 			r[ins->a1] = (r[ins->a1] == r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(NERC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_NER:
+		  A2_VMOP(NER)
 			r[ins->a1] = (r[ins->a1] != r[ins->a2]) << 16;
-			a2_RTMark(&rt, ins->a1);
-			break;
+			A2_VMNEXT(1);
 
 		/* Boolean operators */
-		  case OP_ANDR:
+		  A2_VMOP(ANDRC)
+			a2_RTMark(&rt, ins->a1);
+		  A2_VMOP(ANDR)
 			r[ins->a1] = (r[ins->a1] && r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(ORRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_ORR:
+		  A2_VMOP(ORR)
 			r[ins->a1] = (r[ins->a1] || r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(XORRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_XORR:
+		  A2_VMOP(XORR)
 			r[ins->a1] = (!r[ins->a1] != !r[ins->a2]) << 16;
+			A2_VMNEXT(1);
+		  A2_VMOP(NOTRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_NOTR:
+		  A2_VMOP(NOTR)
 			r[ins->a1] = (!r[ins->a2]) << 16;
-			a2_RTMark(&rt, ins->a1);
-			break;
+			A2_VMNEXT(1);
 
 		/* Unit control */
-		  case OP_SET:
+		  A2_VMOP(SET)
 			a2_VoiceControl(st, v, ins->a1, v->s.waketime, 0);
 			a2_RTUnmark(&rt, ins->a1);
-			break;
+			A2_VMNEXT(1);
 
-		  case OP_SETALL:
+		  A2_VMOP(SETALL)
 			a2_RTSetAll(&rt, st, v, v->s.waketime);
-			break;
+			A2_VMNEXT(1);
 
-		  case OP_RAMP:
+		  A2_VMOP(RAMP)
 			a2_VoiceControl(st, v, ins->a1, v->s.waketime,
 					a2_ms2t(st, ins->a3));
 			a2_RTUnmark(&rt, ins->a1);
-			++v->s.pc;
-			break;
-		  case OP_RAMPR:
+			A2_VMNEXT(2);
+		  A2_VMOP(RAMPR)
 			a2_VoiceControl(st, v, ins->a1, v->s.waketime,
 					a2_ms2t(st, r[ins->a2]));
 			a2_RTUnmark(&rt, ins->a1);
-			break;
+			A2_VMNEXT(1);
 
-		  case OP_RAMPALL:
+		  A2_VMOP(RAMPALL)
 			a2_RTApply(&rt, st, v, v->s.waketime,
 					a2_ms2t(st, ins->a3));
 			a2_RTInit(&rt);
-			++v->s.pc;
-			break;
-		  case OP_RAMPALLR:
+			A2_VMNEXT(2);
+		  A2_VMOP(RAMPALLR)
 			a2_RTApply(&rt, st, v, v->s.waketime,
 					a2_ms2t(st, r[ins->a1]));
 			a2_RTInit(&rt);
-			break;
+			A2_VMNEXT(1);
 
 		/* Subvoice control */
-		  case OP_PUSH:
+		  A2_VMOP(PUSH)
 			if(cargc >= A2_MAXARGS)
 				A2_VMABORT(A2_MANYARGS, "VM:PUSH");
 			cargv[cargc++] = ins->a3;
-			++v->s.pc;
-			break;
-		  case OP_PUSHR:
+			A2_VMNEXT(2);
+		  A2_VMOP(PUSHR)
 			if(cargc >= A2_MAXARGS)
 				A2_VMABORT(A2_MANYARGS, "VM:PUSHR");
 			cargv[cargc++] = r[ins->a1];
-			break;
-		  case OP_SPAWNVR:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWNVR)
 			a2_VoiceSpawn(st, v, r[ins->a1] >> 16,
 					r[ins->a2] >> 16, cargc, cargv);
 			cargc = 0;
-			break;
-		  case OP_SPAWNV:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWNV)
 			a2_VoiceSpawn(st, v, r[ins->a1] >> 16,
 					ins->a2, cargc, cargv);
 			cargc = 0;
-			break;
-		  case OP_SPAWNR:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWNR)
 			a2_VoiceSpawn(st, v, ins->a1, r[ins->a2] >> 16,
 					cargc, cargv);
 			cargc = 0;
-			break;
-		  case OP_SPAWN:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWN)
 			a2_VoiceSpawn(st, v, ins->a1, ins->a2, cargc, cargv);
 			cargc = 0;
-			break;
-		  case OP_SPAWNDR:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWNDR)
 			a2_VoiceSpawn(st, v, -1, r[ins->a1] >> 16, cargc,
 					cargv);
 			cargc = 0;
-			break;
-		  case OP_SPAWND:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWND)
 			a2_VoiceSpawn(st, v, -1, ins->a2, cargc, cargv);
 			cargc = 0;
-			break;
-		  case OP_SPAWNAR:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWNAR)
 			a2_VoiceSpawn(st, v, -2, r[ins->a1] >> 16, cargc,
 					cargv);
 			cargc = 0;
-			break;
-		  case OP_SPAWNA:
+			A2_VMNEXT(1);
+		  A2_VMOP(SPAWNA)
 			a2_VoiceSpawn(st, v, -2, ins->a2, cargc, cargv);
 			cargc = 0;
-			break;
-		  case OP_SENDR:
+			A2_VMNEXT(1);
+		  A2_VMOP(SENDR)
 		  {
 			A2_voice *sv;
 			if((sv = a2_FindSubvoice(v, r[ins->a1] >> 16)))
 				a2_VoiceSend(st, sv, v->s.waketime, ins->a2,
 						cargc, cargv);
 			cargc = 0;
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_SEND:
+		  A2_VMOP(SEND)
 		  {
 			A2_voice *sv;
 #ifdef DEBUG
@@ -1558,53 +2022,57 @@ static inline A2_errors a2_VoiceProcessVM(A2_state *st, A2_voice *v)
 				a2_VoiceSend(st, sv, v->s.waketime, ins->a2,
 						cargc, cargv);
 			cargc = 0;
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_SENDA:
+		  A2_VMOP(SENDA)
 		  {
 			A2_voice *sv;
 			for(sv = v->sub; sv; sv = sv->next)
 				a2_VoiceSend(st, sv, v->s.waketime, ins->a2,
 						cargc, cargv);
 			cargc = 0;
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_SENDS:
+		  A2_VMOP(SENDS)
 		  {
 			int ep = v->program->eps[ins->a2];
 			if(ep < 0)
 				A2_VMABORT(A2_BADENTRY, "VM:SENDS");
+			/* Interrupt returns to the instruction after SENDS! */
+			v->s.pc = pc + 1 - code;
 			if((res = a2_VoiceCall(st, v, ep, cargc, cargv, 1)))
 				A2_VMABORT(res, "VM:SENDS");
-			code = v->program->funcs[v->s.func].code;
+			A2_VMFUNC
+			pc = code + v->s.pc;
 			cargc = 0;
-			break;
+			A2_VMDISPATCH;
 		  }
-		  case OP_WAIT:
+		  A2_VMOP(WAIT)
 		  {
 			A2_voice *sv = a2_FindSubvoice(v, ins->a1);
 			if(!sv)
-				break;	/* No voice to wait for! */
+				A2_VMNEXT(1);	/* No voice to wait for! */
 			/* NOTE: This only waits with fragment granularity! */
 			if(sv->s.state >= A2_ENDING)
-				break;	/* Done! */
+				A2_VMNEXT(1);	/* Done! */
 			a2_RTApply(&rt, st, v, v->s.waketime, 0);
 			v->s.waketime = st->now_fragstart + (A2_MAXFRAG << 8);
 			v->s.state = A2_WAITING;
+			v->s.pc = pc - code;
 			st->instructions += A2_INSLIMIT - inscount;
 			DUMPCODERT(A2_DLOG("%p: [waiting]\n", v);)
 			return A2_OK;
 		  }
-		  case OP_KILLR:
+		  A2_VMOP(KILLR)
 		  {
 			unsigned vid = r[ins->a1] >> 16;
 			a2_KillSubvoice(st, v, vid);
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_KILL:
+		  A2_VMOP(KILL)
 			a2_KillSubvoice(st, v, ins->a1);
-			break;
-		  case OP_KILLA:
+			A2_VMNEXT(1);
+		  A2_VMOP(KILLA)
 		  {
 			A2_voice *sv;
 			for(sv = v->sub; sv; sv = sv->next)
@@ -1612,18 +2080,18 @@ static inline A2_errors a2_VoiceProcessVM(A2_state *st, A2_voice *v)
 #if A2_SV_LUT_SIZE
 			memset(v->sv, 0, sizeof(v->sv));
 #endif
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_DETACHR:
+		  A2_VMOP(DETACHR)
 		  {
 			unsigned vid = r[ins->a1] >> 16;
 			a2_DetachSubvoice(v, vid);
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_DETACH:
+		  A2_VMOP(DETACH)
 			a2_DetachSubvoice(v, ins->a1);
-			break;
-		  case OP_DETACHA:
+			A2_VMNEXT(1);
+		  A2_VMOP(DETACHA)
 		  {
 			A2_voice *sv;
 			for(sv = v->sub; sv; sv = sv->next)
@@ -1631,13 +2099,14 @@ static inline A2_errors a2_VoiceProcessVM(A2_state *st, A2_voice *v)
 #if A2_SV_LUT_SIZE
 			memset(v->sv, 0, sizeof(v->sv));
 #endif
-			break;
+			A2_VMNEXT(1);
 		  }
 
 		/* Message handling */
-		  case OP_SLEEP:
+		  A2_VMOP(SLEEP)
 			a2_RTApply(&rt, st, v, v->s.waketime, 0);
 			v->s.state = A2_ENDING;
+			v->s.pc = pc - code;
 			st->instructions += A2_INSLIMIT - inscount;
 			v->s.waketime += 1000000;
 			return A2_OK;
@@ -1661,19 +2130,19 @@ TODO:
 			break;
 		  }
 #endif
-		  case OP_WAKE:
+		  A2_VMOP(WAKE)
 		  {
 			A2_stackentry *se = v->stack;
 			while(se->prev && (se->state == A2_INTERRUPT))
 				se = se->prev;
 			if(se->state < A2_ENDING)
-				break;
+				A2_VMNEXT(1);
 			se->pc = ins->a2;
 			se->state = A2_RUNNING;
 			se->waketime = v->s.waketime;
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_FORCE:
+		  A2_VMOP(FORCE)
 		  {
 			A2_stackentry *se = v->stack;
 			while(se->prev && (se->state == A2_INTERRUPT))
@@ -1681,55 +2150,150 @@ TODO:
 			se->pc = ins->a2;
 			se->state = A2_RUNNING;
 			se->waketime = v->s.waketime;
-			break;
+			A2_VMNEXT(1);
 		  }
 
 		/* Debugging */
-		  case OP_DEBUGR:
+		  A2_VMOP(DEBUGR)
 		  {
 			A2_interface *i = &st->interfaces->interface;
 			A2_LOG_MSG(i, "debug R%d=%f\t(%p)", ins->a1,
 					r[ins->a1] * (1.0f / 65536.0f), v);
-			break;
+			A2_VMNEXT(1);
 		  }
-		  case OP_DEBUG:
+		  A2_VMOP(DEBUG)
 		  {
 			A2_interface *i = &st->interfaces->interface;
 			A2_LOG_MSG(i, "debug %f\t(%p)",
 					ins->a3 * (1.0f / 65536.0f), v);
-			++v->s.pc;
-			break;
+			A2_VMNEXT(2);
 		  }
 
 		/* Special instructions */
-		  case OP_INITV:
+		  A2_VMOP(INITV)
 			if((res = a2_PopulateVoice(st, v->program, v)))
 			{
+				v->s.pc = pc - code;
 				st->instructions += A2_INSLIMIT - inscount;
 				return res;
 			}
-			break;
-		  case OP_SIZEOF:
+			A2_VMNEXT(1);
+		  A2_VMOP(SIZEOFC)
+			a2_RTMark(&rt, ins->a1);
+		  A2_VMOP(SIZEOF)
 			if((res = a2_sizeof_object(st, ins->a2) < 0))
 				A2_VMABORT(-res >> 16, "VM:SIZEOF");
 			r[ins->a1] = res;
+			A2_VMNEXT(1);
+		  A2_VMOP(SIZEOFRC)
 			a2_RTMark(&rt, ins->a1);
-			break;
-		  case OP_SIZEOFR:
+		  A2_VMOP(SIZEOFR)
 			if((res = a2_sizeof_object(st, r[ins->a2] >> 16)) < 0)
 				A2_VMABORT(-res >> 16, "VM:SIZEOFR");
 			r[ins->a1] = res;
-			a2_RTMark(&rt, ins->a1);
-			break;
+			A2_VMNEXT(1);
 
-		  case A2_OPCODES:
+		/* Superinstructions */
+		  A2_VMOP(PUSH2)
+			if(cargc + 2 > A2_MAXARGS)
+				A2_VMABORT(A2_MANYARGS, "VM:PUSH2");
+			cargv[cargc++] = ins->a3;
+			cargv[cargc++] = (int32_t)pc[2];
+			A2_VMNEXT(3);
+		  A2_VMOP(LDSET)
+			r[ins->a1] = ins->a3;
+			a2_VoiceControl(st, v, ins->a1, v->s.waketime, 0);
+			a2_RTUnmark(&rt, ins->a1);
+			A2_VMNEXT(2);
+		  A2_VMOP(ADDSET)
+			r[ins->a1] += ins->a3;
+			a2_VoiceControl(st, v, ins->a1, v->s.waketime, 0);
+			a2_RTUnmark(&rt, ins->a1);
+			A2_VMNEXT(2);
+		  A2_VMOP(LDRSET)
+			r[ins->a1] = r[ins->a2];
+			a2_VoiceControl(st, v, ins->a1, v->s.waketime, 0);
+			a2_RTUnmark(&rt, ins->a1);
+			A2_VMNEXT(1);
+		  A2_VMOP(LDRAMP)
+			r[ins->a1] = ins->a3;
+			a2_VoiceControl(st, v, ins->a1, v->s.waketime,
+					a2_ms2t(st, (int32_t)pc[2]));
+			a2_RTUnmark(&rt, ins->a1);
+			A2_VMNEXT(3);
+		  A2_VMOP(LDRRAMP)
+			r[ins->a1] = r[ins->a2];
+			a2_VoiceControl(st, v, ins->a1, v->s.waketime,
+					a2_ms2t(st, ins->a3));
+			a2_RTUnmark(&rt, ins->a1);
+			A2_VMNEXT(2);
+		  A2_VMOP(GRJZ)
+			r[ins->a1] = (r[ins->a1] > r[ins->a2]) << 16;
+			if(r[ins->a1])
+				A2_VMNEXT(2);
+			pc += ins->a3;
+			A2_VMDISPATCH;
+		  A2_VMOP(LRJZ)
+			r[ins->a1] = (r[ins->a1] < r[ins->a2]) << 16;
+			if(r[ins->a1])
+				A2_VMNEXT(2);
+			pc += ins->a3;
+			A2_VMDISPATCH;
+		  A2_VMOP(GERJZ)
+			r[ins->a1] = (r[ins->a1] >= r[ins->a2]) << 16;
+			if(r[ins->a1])
+				A2_VMNEXT(2);
+			pc += ins->a3;
+			A2_VMDISPATCH;
+		  A2_VMOP(LERJZ)
+			r[ins->a1] = (r[ins->a1] <= r[ins->a2]) << 16;
+			if(r[ins->a1])
+				A2_VMNEXT(2);
+			pc += ins->a3;
+			A2_VMDISPATCH;
+		  A2_VMOP(EQRJZ)
+			r[ins->a1] = (r[ins->a1] == r[ins->a2]) << 16;
+			if(r[ins->a1])
+				A2_VMNEXT(2);
+			pc += ins->a3;
+			A2_VMDISPATCH;
+		  A2_VMOP(NERJZ)
+			r[ins->a1] = (r[ins->a1] != r[ins->a2]) << 16;
+			if(r[ins->a1])
+				A2_VMNEXT(2);
+			pc += ins->a3;
+			A2_VMDISPATCH;
+
+		/* Native code (see A2_NATIVEINSTRUCTIONS) */
+#ifdef A2_THREADED
+		  op_NATIVE:
+#else
+		  case A2_OPCODES + 1:
+#endif
+		  {
+			unsigned npc;
+			/* Undo the fetch; native code counts for itself */
+			nc.inscount = inscount + 1;
+			nc.cargc = cargc;
+			npc = nf(&nc, pc - code);
+			if(code + npc == pc)
+				A2_VMPLAIN;	/* Not even this one! */
+			inscount = nc.inscount;
+			cargc = nc.cargc;
+			pc = code + npc;
+			A2_VMFETCH
+			A2_VMPLAIN;
+		  }
+
+#ifdef A2_THREADED
+		  op_ILLEGAL:
+#else
 		  default:
+#endif
 			A2_VMABORT(A2_ILLEGALOP, "VM:ILLEGALOP");
 		}
-		++v->s.pc;
-		continue;
 	  timing:
-		++v->s.pc;
+		++pc;
 	  timing_interrupt:
 		a2_RTApply(&rt, st, v, v->s.waketime, dt);
 		if(!dt)
@@ -1737,20 +2301,57 @@ TODO:
 		DUMPCODERT(A2_DLOG("%p: [reschedule; dt=%f]\n",
 				v, dt / 256.0f);)
 		v->s.state = A2_WAITING;
+		v->s.pc = pc - code;
 		st->instructions += A2_INSLIMIT - inscount;
 		v->s.waketime += dt;
 		return A2_OK;
 	}
 }
+#undef	A2_VMBRANCH
+#undef	A2_VMNEXT
+#undef	A2_VMPLAIN
+#undef	A2_VMDISPATCH
+#undef	A2_VMOP
+#undef	A2_VMFUNC
+#undef	A2_VMFETCH
 #undef	A2_VMABORT
 
 
-/* Wrapper for recursive calls to a2_ProcessVoices() */
+static void a2_ProcessLanes(A2_state *st, A2_voice *v, unsigned offset,
+		unsigned frames, int replace);
+
+/* Clear the specified subfragment of the outputs of voice 'v' */
+static inline void a2_ClearOutputs(A2_voice *v, unsigned offset,
+		unsigned frames)
+{
+	int i;
+	for(i = 0; i < v->noutputs; ++i)
+		memset(v->outputs[i] + offset, 0, frames * sizeof(int32_t));
+}
+
+/*
+ * Wrapper for recursive calls to a2_ProcessVoices()
+ *
+ * If 'replace' is set, the outputs of 'v' are overwritten rather than added
+ * to. Where possible, this is done by having the first writer replace, rather
+ * than by clearing the outputs first.
+ */
 static inline void a2_ProcessSubvoices(A2_state *st, A2_voice *v,
-		unsigned offset, unsigned frames)
+		unsigned offset, unsigned frames, int replace)
 {
 	if(!v->sub)
+	{
+		if(replace)
+			a2_ClearOutputs(v, offset, frames);
 		return;
+	}
+	if(!v->nestlevel && st->nlanes)
+	{
+		a2_ProcessLanes(st, v, offset, frames, replace);
+		return;
+	}
+	if(replace)
+		a2_ClearOutputs(v, offset, frames);
 	a2_ProcessVoices(st, &v->sub, offset, frames);
 	if(!v->sub)
 		if(v->s.state >= A2_ENDING)
@@ -1763,16 +2364,13 @@ static inline void a2_ProcessSubvoices(A2_state *st, A2_voice *v,
 void a2_inline_ProcessAdd(A2_unit *u, unsigned offset, unsigned frames)
 {
 	A2_inline *il = a2_inline_cast(u);
-	a2_ProcessSubvoices(il->state, il->voice, offset, frames);
+	a2_ProcessSubvoices(il->state, il->voice, offset, frames, 0);
 }
 
 void a2_inline_Process(A2_unit *u, unsigned offset, unsigned frames)
 {
 	A2_inline *il = a2_inline_cast(u);
-	int i;
-	for(i = 0; i < u->noutputs; ++i)
-		memset(u->outputs[i] + offset, 0, frames * sizeof(int));
-	a2_ProcessSubvoices(il->state, il->voice, offset, frames);
+	a2_ProcessSubvoices(il->state, il->voice, offset, frames, 1);
 }
 
 
@@ -1880,14 +2478,30 @@ static inline A2_errors a2_VoiceProcess(A2_state *st, A2_voice *v,
 }
 
 
+/*
+ * Voices without units, that have no events pending, and are not waking up in
+ * this fragment (group voices, control programs, long delays...) have nothing
+ * to do in a2_VoiceProcess(). The voice loops test this before calling it, so
+ * that idle voices only cost us the first cache line of the voice.
+ */
+static inline int a2_VoiceIdle(A2_state *st, A2_voice *v, unsigned offset,
+		unsigned frames)
+{
+	return !v->units && !v->events && (a2_TSDiff(v->s.waketime,
+			st->now_fragstart + ((offset + frames) << 8)) >= 0);
+}
+
+
 void a2_ProcessVoices(A2_state *st, A2_voice **head, unsigned offset,
 		unsigned frames)
 {
 	while(*head)
 	{
-		A2_errors res = a2_VoiceProcess(st, *head, offset, &frames);
+		A2_errors res = A2_OK;
+		if(!a2_VoiceIdle(st, *head, offset, frames))
+			res = a2_VoiceProcess(st, *head, offset, &frames);
 		if(!((*head)->flags & A2_SUBINLINE))
-			a2_ProcessSubvoices(st, *head, offset, frames);
+			a2_ProcessSubvoices(st, *head, offset, frames, 0);
 		if(res)
 			a2_VoiceFree(st, head);
 		else
@@ -1896,12 +2510,391 @@ void a2_ProcessVoices(A2_state *st, A2_voice **head, unsigned offset,
 }
 
 
+/*---------------------------------------------------------
+	Parallel voice processing
+---------------------------------------------------------*/
+
+typedef struct A2_lanepass
+{
+	A2_state	*state;		/* Master state */
+	unsigned	offset;
+	unsigned	frames;
+	unsigned	nlanes;		/* Number of lanes with voices */
+	uint8_t		lanes[A2_LANES];	/* Indices of those lanes */
+} A2_lanepass;
+
+
+/* Process the voices of one lane. (Runs on any thread of the pool!) */
+static void a2_lane_process(void *userdata, unsigned item)
+{
+	A2_lanepass *lp = (A2_lanepass *)userdata;
+	A2_lane *l = lp->state->lanes + lp->lanes[item];
+	A2_state *lst = l->state;
+	A2_voice *v;
+	a2_ClearBus(l->bus, lp->offset, lp->frames);
+	for(v = l->voices; v; v = v->lanenext)
+	{
+		unsigned frames = lp->frames;
+		A2_errors res = A2_OK;
+		if(!a2_VoiceIdle(lst, v, lp->offset, frames))
+			res = a2_VoiceProcess(lst, v, lp->offset, &frames);
+		if(!(v->flags & A2_SUBINLINE))
+			a2_ProcessSubvoices(lst, v, lp->offset, frames, 0);
+		if(res)
+		{
+			/*
+			 * The voice list belongs to the root voice, so we
+			 * leave the voice to be freed after the pass.
+			 */
+			v->flags |= A2_LANEEND;
+			++l->ended;
+		}
+	}
+}
+
+
+/*
+ * Lend up to 'count' items from LIFO pool 'from' to the empty pool 'to'.
+ * Returns the number of items lent.
+ */
+static inline unsigned a2_lend_pool(void **from, void **to, unsigned count)
+{
+	unsigned n = 0;
+	while(*from && (n < count))
+	{
+		void **item = (void **)*from;
+		*from = *item;
+		*item = *to;
+		*to = item;
+		++n;
+	}
+	return n;
+}
+
+/* Return all items of LIFO pool 'from' to pool 'to' */
+static inline void a2_return_pool(void **from, void **to)
+{
+	void **last;
+	if(!*from)
+		return;
+	for(last = (void **)*from; *last; last = (void **)*last)
+		;
+	*last = *to;
+	*to = *from;
+	*from = NULL;
+}
+
+/* Return all memory blocks of state 'from' to state 'to' */
+static inline void a2_return_slabs(A2_state *from, A2_state *to)
+{
+	unsigned c;
+	for(c = 0; c < A2_SLABCLASSES; ++c)
+	{
+		a2_return_pool((void **)&from->slabs[c].pool,
+				(void **)&to->slabs[c].pool);
+		to->slabs[c].count += from->slabs[c].count;
+		from->slabs[c].count = 0;
+	}
+}
+
+
+/*
+ * Forward any messages the lane has posted for the API. This is done in lane
+ * order after each pass, so the API sees the same message order regardless of
+ * thread timing.
+ */
+static inline void a2_lane_forward_messages(A2_state *st, A2_state *lst)
+{
+	char buf[sizeof(A2_apimessage)];
+	int used = sfifo_Used(lst->toapi);
+	if(!used)
+		return;
+	if(sfifo_Space(st->toapi) < used)
+	{
+		sfifo_Flush(lst->toapi);
+		a2r_Error(st, A2_MSGOVERFLOW, "a2_lane_forward_messages()");
+		return;
+	}
+	while(used)
+	{
+		int n = used > (int)sizeof(buf) ? (int)sizeof(buf) : used;
+		sfifo_Read(lst->toapi, buf, n);
+		sfifo_Write(st->toapi, buf, n);
+		used -= n;
+	}
+}
+
+
+/*
+ * Update the shadow state 'lst' of a lane with the current state of 'st',
+ * keeping the pools, buffers, statistics and other resources that are private
+ * to the lane.
+ */
+static void a2_lane_sync(A2_state *st, A2_state *lst)
+{
+	A2_state priv;
+	memcpy(&priv, lst, sizeof(A2_state));
+	memcpy(lst, st, sizeof(A2_state));
+	lst->next = priv.next;
+	lst->fromapi = priv.fromapi;
+	lst->toapi = priv.toapi;
+	lst->eocevents = priv.eocevents;
+	lst->voicepool = priv.voicepool;
+	lst->nvoicepool = priv.nvoicepool;
+	lst->totalvoices = priv.totalvoices;
+	lst->activevoices = priv.activevoices;
+	memcpy(lst->slabs, priv.slabs, sizeof(lst->slabs));
+	lst->eventpool = priv.eventpool;
+	lst->neventpool = priv.neventpool;
+	lst->housekeeper = priv.housekeeper;
+	lst->instructions = priv.instructions;
+	lst->last_rt_error = priv.last_rt_error;
+	lst->master = priv.master;
+	memcpy(lst->scratch, priv.scratch, sizeof(lst->scratch));
+	memcpy(lst->warm, priv.warm, priv.nwarm * sizeof(A2_warmvoice));
+	lst->nwarm = priv.nwarm;
+	lst->workers = priv.workers;
+}
+
+
+/*
+ * Process the subvoices of the root voice 'v', which are distributed over the
+ * lanes of 'st', using the worker pool.
+ *
+ * The lane buses are added to the root voice outputs in lane order, and the
+ * voices of each lane are always processed in the same order, by one thread
+ * at a time, so the result does not depend on the number of workers, or on
+ * which worker happens to pick up which lane.
+ */
+static void a2_ProcessLanes(A2_state *st, A2_voice *v, unsigned offset,
+		unsigned frames, int replace)
+{
+	A2_lanepass lp;
+	A2_voice **tails[A2_LANES];
+	A2_voice *sv, **svp;
+	unsigned i, c, ended = 0;
+
+	/* Sort the subvoices into lanes, keeping the order within each lane */
+	for(i = 0; i < st->nlanes; ++i)
+		tails[i] = &st->lanes[i].voices;
+	for(sv = v->sub; sv; sv = sv->next)
+	{
+		*tails[sv->lane - 1] = sv;
+		tails[sv->lane - 1] = &sv->lanenext;
+	}
+
+	/* Prepare the lanes that have voices to process */
+	lp.state = st;
+	lp.offset = offset;
+	lp.frames = frames;
+	lp.nlanes = 0;
+	for(i = 0; i < st->nlanes; ++i)
+	{
+		A2_lane *l = st->lanes + i;
+		A2_state *lst = l->state;
+		*tails[i] = NULL;
+		if(!l->voices)
+			continue;
+		l->ended = 0;
+		a2_lane_sync(st, lst);
+		for(c = 0; c < A2_SLABCLASSES; ++c)
+		{
+			A2_slab *s = st->slabs + c;
+			A2_slab *ls = lst->slabs + c;
+			ls->count = a2_lend_pool((void **)&s->pool,
+					(void **)&ls->pool, A2_LANEBLOCKS);
+			s->count -= ls->count;
+		}
+		lst->neventpool = a2_lend_pool((void **)&st->eventpool,
+				(void **)&lst->eventpool, A2_LANEEVENTS);
+		lst->nvoicepool = a2_lend_pool((void **)&st->voicepool,
+				(void **)&lst->voicepool, A2_LANEVOICES);
+		st->neventpool -= lst->neventpool;
+		st->nvoicepool -= lst->nvoicepool;
+		lp.lanes[lp.nlanes++] = i;
+	}
+
+	a2_RunWorkers(st->workers, a2_lane_process, &lp, lp.nlanes);
+
+	/* Mix, in lane order. In replacing mode, the first lane is copied. */
+	if(replace && !lp.nlanes)
+		a2_ClearOutputs(v, offset, frames);
+	for(i = 0; i < lp.nlanes; ++i)
+	{
+		A2_lane *l = st->lanes + lp.lanes[i];
+		int ch;
+		for(ch = 0; ch < v->noutputs; ++ch)
+		{
+			int32_t *in = l->bus->buffers[ch] + offset;
+			int32_t *out = v->outputs[ch] + offset;
+			unsigned s;
+			if(replace && !i)
+				memcpy(out, in, frames * sizeof(int32_t));
+			else
+				for(s = 0; s < frames; ++s)
+					out[s] += in[s];
+		}
+		ended += l->ended;
+	}
+
+	/* Free voices that ended, into the states of their lanes */
+	for(svp = &v->sub; ended && *svp; )
+		if((*svp)->flags & A2_LANEEND)
+		{
+			a2_VoiceFree(a2_VoiceState(st, *svp), svp);
+			--ended;
+		}
+		else
+			svp = &(*svp)->next;
+
+	/* Collect statistics, pool items and API messages */
+	for(i = 0; i < lp.nlanes; ++i)
+	{
+		A2_state *lst = st->lanes[lp.lanes[i]].state;
+		st->instructions += lst->instructions;
+		st->activevoices += lst->activevoices;
+		st->totalvoices += lst->totalvoices;
+		lst->instructions = lst->activevoices = lst->totalvoices = 0;
+		if(lst->last_rt_error)
+		{
+			st->last_rt_error = lst->last_rt_error;
+			lst->last_rt_error = A2_OK;
+		}
+		a2_return_slabs(lst, st);
+		a2_return_pool((void **)&lst->eventpool,
+				(void **)&st->eventpool);
+		a2_return_pool((void **)&lst->voicepool,
+				(void **)&st->voicepool);
+		st->neventpool += lst->neventpool;
+		st->nvoicepool += lst->nvoicepool;
+		lst->neventpool = lst->nvoicepool = 0;
+		a2_lane_forward_messages(st, lst);
+	}
+	if(st->activevoices > st->activevoicesmax)
+		st->activevoicesmax = st->activevoices;
+}
+
+
+A2_errors a2_OpenLanes(A2_state *st, unsigned workers)
+{
+	int i, channels = st->config->channels;
+	if(channels < 2)
+		channels = 2;	/* The root driver mixes stereo internally! */
+	if(!(st->lanes = (A2_lane *)calloc(A2_LANES, sizeof(A2_lane))))
+		return A2_OOMEMORY;
+	for(i = 0; i < A2_LANES; ++i)
+	{
+		A2_lane *l = st->lanes + i;
+		A2_state *lst = (A2_state *)calloc(1, sizeof(A2_state));
+		if(!lst)
+			return A2_OOMEMORY;
+		l->state = lst;
+		++st->nlanes;
+
+		/* Private resources start out empty, and are kept by syncs */
+		a2_lane_sync(st, lst);
+		if(!(lst->toapi = sfifo_Open(A2_LANEMESSAGES *
+				sizeof(A2_apimessage))))
+			return A2_OOMEMORY;
+		if(!(l->bus = a2_AllocBus(st, channels)))
+			return A2_OOMEMORY;
+	}
+	if(!(st->workers = a2_OpenWorkers(workers)))
+		return A2_OOMEMORY;
+	return A2_OK;
+}
+
+
+/*
+ * NOTE: The root voice must be gone before this is called, as subvoices may
+ *       still reference the lane buses and states!
+ */
+void a2_CloseLanes(A2_state *st)
+{
+	int i, j;
+	if(st->workers)
+	{
+		a2_CloseWorkers(st->workers);
+		st->workers = NULL;
+	}
+	for(i = 0; i < st->nlanes; ++i)
+	{
+		A2_lane *l = st->lanes + i;
+		A2_state *lst = l->state;
+		if(l->bus)
+			a2_FreeBus(st, l->bus);
+		for(j = 0; j < A2_NESTLIMIT; ++j)
+			if(lst->scratch[j])
+				a2_FreeBus(st, lst->scratch[j]);
+		a2_FlushWarmVoices(lst, NULL);
+		a2_return_slabs(lst, st);
+		a2_return_pool((void **)&lst->eventpool,
+				(void **)&st->eventpool);
+		a2_return_pool((void **)&lst->voicepool,
+				(void **)&st->voicepool);
+		st->neventpool += lst->neventpool;
+		st->nvoicepool += lst->nvoicepool;
+		st->totalvoices += lst->totalvoices;
+		st->activevoices += lst->activevoices;
+		if(lst->toapi)
+		{
+			/* Voices torn down via the master state may post here */
+			a2_lane_forward_messages(st, lst);
+			sfifo_Close(lst->toapi);
+		}
+		free(lst);
+	}
+	free(st->lanes);
+	st->lanes = NULL;
+	st->nlanes = 0;
+}
+
+
 /* Pack the fragments from the master bus into the driver output buffers! */
+/*
+ * Convert the (mono) master output directly to 16 bit wave data, and track
+ * 'lastpeak' for silence detection in the same pass. The peak scan is kept
+ * branch free, so the loop can be vectorized, and we only look for the actual
+ * position of the last peak if there is one.
+ */
+static void a2_ProcessRenderOut(A2_state *st, unsigned frames)
+{
+	int s;
+	int32_t *in = st->master->buffers[0];
+	int16_t *out = st->renderout;
+	int32_t level = st->silencelevel;
+	int32_t peak = level;
+	for(s = 0; s < frames; ++s)
+	{
+		int32_t v = in[s];
+		int32_t nv = (int32_t)(0u - (uint32_t)v);
+		out[s] = v >> 8;
+		peak = v > peak ? v : peak;
+		peak = nv > peak ? nv : peak;
+	}
+	st->renderout += frames;
+	if(peak == level)
+	{
+		st->lastpeak += frames;
+		return;
+	}
+	for(s = frames - 1; s >= 0; --s)
+		if((in[s] > level) || (-in[s] > level))
+			break;
+	st->lastpeak = frames - s;
+}
+
+
 static void a2_ProcessMaster(A2_state *st, unsigned offset, unsigned frames)
 {
 	int c;
 	int32_t **in = st->master->buffers;
 	int32_t **bufs = st->audio->buffers;
+	if(st->renderout)
+	{
+		a2_ProcessRenderOut(st, frames);
+		return;
+	}
 	for(c = 0; c < st->config->channels; ++c)
 		memcpy(bufs[c] + offset, in[c], frames * sizeof(int32_t));
 }
@@ -1960,11 +2953,16 @@ void a2_AudioCallback(A2_audiodriver *driver, unsigned frames)
 	/* MIDI input processing */
 	a2_PollMIDI(st, frames);
 
+	/* Pool refills and trimming */
+	if(st->housekeeper)
+		a2_Housekeeping(st);
+
 	/* Audio processing */
 	while(remain)
 	{
 		unsigned frag = remain > A2_MAXFRAG ? A2_MAXFRAG : remain;
-		a2_ClearBus(st->master, 0, frag);
+		if(!rootvoice || !(rootvoice->flags & A2_REPLACEOUT))
+			a2_ClearBus(st->master, 0, frag);
 		a2_ProcessVoices(st, &rootvoice, 0, frag);
 		a2_ProcessMaster(st, offset, frag);
 		offset += frag;
@@ -2056,11 +3054,15 @@ void a2_KillVoicesUsingProgram(A2_state *st, A2_handle program)
 		st = st->parent;
 	for( ; st; st = st->next)
 	{
-		hi = rchm_Get(&st->ss->hm, st->rootvoice);
-		if(!hi || (hi->typecode != A2_TVOICE) || (!hi->d.data))
-			continue;	/* Wut? Root voice died...? */
+		int j;
 		st->audio->Lock(st->audio);
-		a2_kill_subvoices_using_program(st, (A2_voice *)hi->d.data, p);
+		hi = rchm_Get(&st->ss->hm, st->rootvoice);
+		if(hi && (hi->typecode == A2_TVOICE) && hi->d.data)
+			a2_kill_subvoices_using_program(st,
+					(A2_voice *)hi->d.data, p);
+		a2_FlushWarmVoices(st, p);
+		for(j = 0; j < st->nlanes; ++j)
+			a2_FlushWarmVoices(st->lanes[j].state, p);
 		st->audio->Unlock(st->audio);
 	}
 }
@@ -29,6 +29,7 @@
 
 /* Builtin system drivers */
 #include "mallocdrv.h"
+#include "arenadrv.h"
 
 /* Builtin audio drivers */
 #include "sdldrv.h"
@@ -79,6 +80,7 @@ void a2_DumpConfig(A2_config *c)
 	printf("     blockpool: %d\n", c->blockpool);
 	printf("     voicepool: %d\n", c->voicepool);
 	printf("   eventpool: %d\n", c->eventpool);
+	printf("       workers: %d\n", c->workers);
 	printf("       drivers:\n");
 	while(d)
 	{
@@ -311,6 +313,7 @@ struct A2_regdriver
 static A2_regdriver a2_builtin_drivers[] = {
 	{ NULL, A2_SYSDRIVER, 1, "default", A2_DEFAULT_SYSDRIVER },
 	{ NULL, A2_SYSDRIVER, 1, "malloc", a2_malloc_sysdriver },
+	{ NULL, A2_SYSDRIVER, 1, "arena", a2_arena_sysdriver },
 /*FIXME*/{ NULL, A2_SYSDRIVER, 1, "realtime", a2_malloc_sysdriver },
 	{ NULL, A2_AUDIODRIVER, 1, "default", A2_DEFAULT_AUDIODRIVER },
 #ifdef A2_DEFAULT_MIDIDRIVER
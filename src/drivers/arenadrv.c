@@ -0,0 +1,384 @@
+/*
+ * arenadrv.c - Audiality 2 arena system driver
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * The arena driver reserves one contiguous memory region when opened, and
+ * serves RTAlloc()/RTFree() from that, via segregated size class free lists.
+ *
+ * The region is split into chunks, each of which is dedicated to a single size
+ * class the first time an item of that size is needed. Size classes are
+ * multiples of ARENA_GRANULE bytes, so items are cache line aligned, and the
+ * A2_block, A2_event and A2_voice pools each get their own tightly packed
+ * chunks. Requests that don't fit in any class, or in the remaining space of
+ * the region, are passed on to the system allocator, still cache line aligned.
+ *
+ * The free lists are lock-free LIFO stacks, so the audio thread never waits
+ * for the pool housekeeper, or any other thread. List heads are 32 bit words
+ * holding the (1 based) granule index of the first item, and a tag that is
+ * bumped on every update, to avoid ABA problems. Items are linked through the
+ * granule index in their first word. A class that runs dry grabs a whole new
+ * chunk, which is carved up and pushed onto the free list in one go.
+ *
+ * Options (given as "arena,<option>,...")
+ *	hugepages	Back the region with huge pages, if possible
+ *	lock		Lock the region into physical memory
+ *
+ * The region size is taken from A2_config.poolsize, or ARENA_DEFSIZE, if that
+ * is not set, and is limited to ARENA_MAXSIZE, to leave room for the tags.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/mman.h>
+#endif
+#include "arenadrv.h"
+#include "platform.h"
+#include "a2_log.h"
+
+#define	ARENA_DEFSIZE	(16 << 20)	/* Default region size */
+#define	ARENA_HUGEPAGE	(2 << 20)	/* Huge page size for rounding */
+#define	ARENA_CHUNK	(64 << 10)	/* Size class chunk size */
+#define	ARENA_GRANULE	64		/* Size class granularity */
+#define	ARENA_CLASSES	64		/* Up to 4096 bytes */
+
+#define	ARENA_NOCLASS	0xff
+
+#define	ARENA_TAGBITS	8		/* Minimum free list tag size */
+#define	ARENA_MAXSIZE	((((size_t)1 << (32 - ARENA_TAGBITS)) - 1) * \
+				ARENA_GRANULE & ~(size_t)(ARENA_HUGEPAGE - 1))
+
+/* Extended A2_sysdriver struct */
+typedef struct ARENA_sysdriver
+{
+	A2_sysdriver	sd;
+	char		*base;		/* Region */
+	size_t		size;
+	int		locked;		/* Region was successfully locked */
+	unsigned	nchunks;
+	A2_atomic	nextchunk;	/* First chunk never handed out */
+	unsigned char	*chunkclass;	/* Size class of each chunk */
+	unsigned	idxmask;	/* Index part of free list heads */
+	A2_atomic	free[ARENA_CLASSES];	/* Free list heads */
+	A2_atomic	fallbacks;	/* malloc() fallbacks */
+} ARENA_sysdriver;
+
+
+static inline void **arenasd_item(ARENA_sysdriver *ad, unsigned index)
+{
+	return (void **)(ad->base + (size_t)(index - 1) * ARENA_GRANULE);
+}
+
+static inline unsigned arenasd_index(ARENA_sysdriver *ad, void **item)
+{
+	return ((char *)item - ad->base) / ARENA_GRANULE + 1;
+}
+
+/* Next item link, in the first word of a free item */
+static inline volatile uint32_t *arenasd_link(void **item)
+{
+	return (volatile uint32_t *)item;
+}
+
+/* Head word for list 'index', replacing 'head', with the tag bumped */
+static inline int arenasd_head(ARENA_sysdriver *ad, unsigned head,
+		unsigned index)
+{
+	return (int)(((head | ad->idxmask) + 1) | index);
+}
+
+
+/* Pop an item off the free list of class 'c'. Returns NULL if it's empty. */
+static void **arenasd_pop(ARENA_sysdriver *ad, unsigned c)
+{
+	while(1)
+	{
+		unsigned head = (unsigned)a2_AtomicAdd(&ad->free[c], 0);
+		unsigned index = head & ad->idxmask;
+		void **item;
+		if(!index)
+			return NULL;
+		item = arenasd_item(ad, index);
+		if(a2_AtomicCAS(&ad->free[c], (int)head,
+				arenasd_head(ad, head, *arenasd_link(item))))
+			return item;
+	}
+}
+
+/* Push the chain 'first'...'last' onto the free list of class 'c' */
+static void arenasd_push(ARENA_sysdriver *ad, unsigned c, void **first,
+		void **last)
+{
+	unsigned index = arenasd_index(ad, first);
+	while(1)
+	{
+		unsigned head = (unsigned)a2_AtomicAdd(&ad->free[c], 0);
+		*arenasd_link(last) = head & ad->idxmask;
+		if(a2_AtomicCAS(&ad->free[c], (int)head,
+				arenasd_head(ad, head, index)))
+			return;
+	}
+}
+
+/*
+ * Grab a new chunk for size class 'c', keep the first item, and put the rest
+ * on the free list. Returns NULL if the region is full.
+ */
+static void **arenasd_newchunk(ARENA_sysdriver *ad, unsigned c)
+{
+	unsigned csize = (c + 1) * ARENA_GRANULE;
+	unsigned chunk, i, n = ARENA_CHUNK / csize;
+	char *p;
+	if((unsigned)a2_AtomicAdd(&ad->nextchunk, 0) >= ad->nchunks)
+		return NULL;
+	if((chunk = a2_AtomicAdd(&ad->nextchunk, 1)) >= ad->nchunks)
+		return NULL;
+	ad->chunkclass[chunk] = c;
+	p = ad->base + (size_t)chunk * ARENA_CHUNK;
+	for(i = 1; i < n - 1; ++i)
+		*arenasd_link((void **)(p + i * csize)) =
+				arenasd_index(ad, (void **)(p + (i + 1) * csize));
+	if(n > 1)
+		arenasd_push(ad, c, (void **)(p + csize),
+				(void **)(p + (n - 1) * csize));
+	return (void **)p;
+}
+
+static void *arenasd_RTAlloc(A2_sysdriver *driver, unsigned size)
+{
+	ARENA_sysdriver *ad = (ARENA_sysdriver *)driver;
+	unsigned c = size ? (size - 1) / ARENA_GRANULE : 0;
+	void **item;
+	if(c >= ARENA_CLASSES)
+	{
+		a2_AtomicAdd(&ad->fallbacks, 1);
+		return a2_AlignedAlloc(size, ARENA_GRANULE);
+	}
+	if((item = arenasd_pop(ad, c)) || (item = arenasd_newchunk(ad, c)))
+		return item;
+	a2_AtomicAdd(&ad->fallbacks, 1);
+	return a2_AlignedAlloc(size, ARENA_GRANULE);
+}
+
+static void arenasd_RTFree(A2_sysdriver *driver, void *block)
+{
+	ARENA_sysdriver *ad = (ARENA_sysdriver *)driver;
+	void **item = (void **)block;
+	if(((char *)block < ad->base) ||
+			((char *)block >= ad->base + ad->size))
+	{
+		a2_AlignedFree(block);
+		return;
+	}
+	arenasd_push(ad, ad->chunkclass[((char *)block - ad->base) /
+			ARENA_CHUNK], item, item);
+}
+
+
+/*---------------------------------------------------------
+	Region management
+---------------------------------------------------------*/
+
+#ifdef _WIN32
+
+static char *arenasd_map(A2_interface *i, size_t size, int hugepages)
+{
+	return (char *)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE,
+			PAGE_READWRITE);
+}
+
+static void arenasd_unmap(char *base, size_t size)
+{
+	VirtualFree(base, 0, MEM_RELEASE);
+}
+
+static int arenasd_mlock(char *base, size_t size)
+{
+	return VirtualLock(base, size) ? 0 : -1;
+}
+
+static void arenasd_munlock(char *base, size_t size)
+{
+	VirtualUnlock(base, size);
+}
+
+#else	/* _WIN32 */
+
+# if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  define MAP_ANONYMOUS	MAP_ANON
+# endif
+
+static char *arenasd_map(A2_interface *i, size_t size, int hugepages)
+{
+	void *p;
+# ifdef MAP_HUGETLB
+	if(hugepages)
+	{
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+				-1, 0);
+		if(p != MAP_FAILED)
+			return (char *)p;
+		A2_LOG_DBG(i, "arena: MAP_HUGETLB failed. Trying "
+				"transparent huge pages.");
+	}
+# endif
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(p == MAP_FAILED)
+		return NULL;
+# ifdef MADV_HUGEPAGE
+	if(hugepages)
+		madvise(p, size, MADV_HUGEPAGE);
+# endif
+	return (char *)p;
+}
+
+static void arenasd_unmap(char *base, size_t size)
+{
+	munmap(base, size);
+}
+
+static int arenasd_mlock(char *base, size_t size)
+{
+	return mlock(base, size);
+}
+
+static void arenasd_munlock(char *base, size_t size)
+{
+	munlock(base, size);
+}
+
+#endif	/* _WIN32 */
+
+
+/*---------------------------------------------------------
+	Open/Close
+---------------------------------------------------------*/
+
+static void arenasd_Close(A2_driver *driver)
+{
+	ARENA_sysdriver *ad = (ARENA_sysdriver *)driver;
+	A2_interface *i = driver->config->interface;
+	if(ad->fallbacks)
+		A2_LOG_INFO(i, "arena: %u allocations were passed on to "
+				"malloc()", (unsigned)ad->fallbacks);
+	if(ad->base)
+	{
+		if(ad->locked)
+			arenasd_munlock(ad->base, ad->size);
+		arenasd_unmap(ad->base, ad->size);
+	}
+	free(ad->chunkclass);
+	memset((void *)ad->free, 0, sizeof(ad->free));
+	ad->base = NULL;
+	ad->size = 0;
+	ad->locked = 0;
+	ad->chunkclass = NULL;
+	ad->nchunks = ad->nextchunk = 0;
+	ad->fallbacks = 0;
+	ad->sd.RTAlloc = NULL;
+	ad->sd.RTFree = NULL;
+}
+
+static A2_errors arenasd_Open(A2_driver *driver)
+{
+	ARENA_sysdriver *ad = (ARENA_sysdriver *)driver;
+	A2_config *cfg = driver->config;
+	A2_interface *i = cfg->interface;
+	int hugepages = 0;
+	int lock = 0;
+	int c;
+
+	for(c = 0; c < driver->optc; ++c)
+		if(!strcmp(driver->optv[c], "hugepages"))
+			hugepages = 1;
+		else if(!strcmp(driver->optv[c], "lock"))
+			lock = 1;
+		else
+			A2_LOG_WARN(i, "arena: Unknown option '%s'!",
+					driver->optv[c]);
+
+	/* Round up to whole chunks, or whole huge pages */
+	ad->size = cfg->poolsize > 0 ? cfg->poolsize : ARENA_DEFSIZE;
+	if(ad->size > ARENA_MAXSIZE)
+	{
+		A2_LOG_WARN(i, "arena: Region size limited to %u bytes!",
+				(unsigned)ARENA_MAXSIZE);
+		ad->size = ARENA_MAXSIZE;
+	}
+	if(hugepages)
+		ad->size = (ad->size + ARENA_HUGEPAGE - 1) &
+				~(size_t)(ARENA_HUGEPAGE - 1);
+	else
+		ad->size = (ad->size + ARENA_CHUNK - 1) &
+				~(size_t)(ARENA_CHUNK - 1);
+	ad->nchunks = ad->size / ARENA_CHUNK;
+	ad->nextchunk = 0;
+	for(ad->idxmask = 1; ad->idxmask <= ad->size / ARENA_GRANULE;
+			ad->idxmask = (ad->idxmask << 1) | 1)
+		;
+	if(!(ad->chunkclass = (unsigned char *)malloc(ad->nchunks)))
+		return A2_OOMEMORY;
+	memset(ad->chunkclass, ARENA_NOCLASS, ad->nchunks);
+
+	if(!(ad->base = arenasd_map(i, ad->size, hugepages)))
+	{
+		A2_LOG_ERR(i, "arena: Could not map %u byte region!",
+				(unsigned)ad->size);
+		arenasd_Close(driver);
+		return A2_OOMEMORY;
+	}
+	if(lock)
+	{
+		if(arenasd_mlock(ad->base, ad->size))
+			A2_LOG_WARN(i, "arena: Could not lock %u byte region "
+					"into memory!", (unsigned)ad->size);
+		else
+			ad->locked = 1;
+	}
+
+	/* Touch all pages now, rather than in the audio thread */
+	if(!ad->locked)
+		memset(ad->base, 0, ad->size);
+
+	ad->sd.RTAlloc = arenasd_RTAlloc;
+	ad->sd.RTFree = arenasd_RTFree;
+	return A2_OK;
+}
+
+A2_driver *a2_arena_sysdriver(A2_drivertypes type, const char *name)
+{
+	ARENA_sysdriver *ad = calloc(1, sizeof(ARENA_sysdriver));
+	A2_driver *d = &ad->sd.driver;
+	if(!ad)
+		return NULL;
+	d->type = A2_SYSDRIVER;
+	d->name = "arena";
+	d->flags = A2_THREADSAFE;
+	d->Open = arenasd_Open;
+	d->Close = arenasd_Close;
+	return d;
+}
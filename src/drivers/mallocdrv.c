@@ -23,19 +23,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "mallocdrv.h"
+#include "platform.h"
 #include "a2_log.h"
 
+/*
+ * Blocks are cache line aligned, like those of the arena driver, so that the
+ * realtime memory blocks of the engine never share cache lines. In debug
+ * builds, the owning driver is stored in a header before the block, which is
+ * padded to keep the block aligned.
+ */
+#define	MALLOC_ALIGN	64
+
 
 static void *mallocsd_RTAlloc(A2_sysdriver *driver, unsigned size)
 {
 #ifdef DEBUG
-	A2_sysdriver **b = malloc(size + sizeof(A2_sysdriver *));
+	char *b = a2_AlignedAlloc(size + MALLOC_ALIGN, MALLOC_ALIGN);
 	if(!b)
 		return NULL;
-	b[0] = driver;
-	return b + 1;
+	b += MALLOC_ALIGN;
+	((A2_sysdriver **)b)[-1] = driver;
+	return b;
 #else
-	return (void *)malloc(size);
+	return a2_AlignedAlloc(size, MALLOC_ALIGN);
 #endif
 }
 
@@ -45,13 +55,13 @@ static void mallocsd_RTFree(A2_sysdriver *driver, void *block)
 	A2_interface *i = driver->driver.config->interface;
 	A2_sysdriver **b = ((A2_sysdriver **)block) - 1;
 	if(b[0] == driver)
-		free(b);
+		a2_AlignedFree((char *)block - MALLOC_ALIGN);
 	else
 		A2_LOG_DBG(i, "defaultsd_RTFree(): Attempted to free block "
 				"%p with driver %p, but the block belongs to "
 				"driver %p!", block, driver, b[0]);
 #else
-	free(block);
+	a2_AlignedFree(block);
 #endif
 }
 
@@ -78,6 +88,7 @@ A2_driver *a2_malloc_sysdriver(A2_drivertypes type, const char *name)
 		return NULL;
 	d->type = A2_SYSDRIVER;
 	d->name = "malloc";
+	d->flags = A2_THREADSAFE;
 	d->Open = mallocsd_Open;
 	d->Close = mallocsd_Close;
 	return d;
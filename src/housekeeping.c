@@ -0,0 +1,336 @@
+/*
+ * housekeeping.c - Audiality 2 realtime pool housekeeping thread
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdlib.h>
+#include "internals.h"
+#include "fbdelay.h"
+
+/*
+ * The engine and the housekeeping thread talk over two lock-free FIFOs, passing
+ * chains of pool items. Pool items are all linked through their first field,
+ * so they can be handled as generic 'void **' chains here.
+ */
+
+typedef enum A2_hkpools
+{
+	A2_HKEVENTS = 0,
+	A2_HKVOICES,
+	A2_HKBLOCKS,	/* One pool per block size class from here on */
+	A2_HKPOOLS = A2_HKBLOCKS + A2_SLABCLASSES
+} A2_hkpools;
+
+/* Message in either direction */
+typedef struct A2_hkmessage
+{
+	unsigned	pool;		/* A2_hkpools */
+	unsigned	request;	/* Items requested */
+	unsigned	count;		/* Items in chain */
+	void		**head;		/* Chain, or NULL */
+	void		**tail;
+} A2_hkmessage;
+
+/* Enough for one message per pool in transit, and then some */
+#define	A2_HKMESSAGES	(A2_HKPOOLS * 2)
+
+struct A2_housekeeper
+{
+	A2_state	*state;
+	A2_thread	thread;
+	A2_atomic	quit;
+	SFIFO		*refills;	/* Housekeeper -> engine */
+	SFIFO		*requests;	/* Engine -> housekeeper */
+
+	/* Housekeeper side */
+	void		*fbdelay;	/* Delay buffer pool of 'fbdelay' */
+
+	/* Engine side */
+	unsigned	target[A2_HKPOOLS];	/* Target pool sizes */
+	unsigned	pending[A2_HKPOOLS];	/* Requested; not received */
+};
+
+
+static inline unsigned a2_hk_itemsize(unsigned pool)
+{
+	switch(pool)
+	{
+	  case A2_HKEVENTS:
+		return sizeof(A2_event);
+	  case A2_HKVOICES:
+		return sizeof(A2_voice);
+	  default:
+		return a2_SlabSize(pool - A2_HKBLOCKS);
+	}
+}
+
+
+/* Get the LIFO stack and item count of pool 'pool' of 'st' */
+static inline void **a2_hk_pool(A2_state *st, unsigned pool, unsigned **count)
+{
+	switch(pool)
+	{
+	  case A2_HKEVENTS:
+		*count = &st->neventpool;
+		return (void **)&st->eventpool;
+	  case A2_HKVOICES:
+		*count = &st->nvoicepool;
+		return (void **)&st->voicepool;
+	  default:
+		*count = &st->slabs[pool - A2_HKBLOCKS].count;
+		return (void **)&st->slabs[pool - A2_HKBLOCKS].pool;
+	}
+}
+
+
+/*---------------------------------------------------------
+	Housekeeping thread
+---------------------------------------------------------*/
+
+static void a2_hk_free(A2_state *st, void **head)
+{
+	while(head)
+	{
+		void **next = (void **)*head;
+		st->sys->RTFree(st->sys, head);
+		head = next;
+	}
+}
+
+
+/* Allocate a chain of items for 'am', which is turned into a refill message */
+static void a2_hk_alloc(A2_state *st, A2_hkmessage *am)
+{
+	am->head = am->tail = NULL;
+	for(am->count = 0; am->count < am->request; ++am->count)
+	{
+		void **item = st->sys->RTAlloc(st->sys,
+				a2_hk_itemsize(am->pool));
+		if(!item)
+			break;
+		if(am->pool == A2_HKVOICES)
+			a2_VoiceInit((A2_voice *)item);
+		*item = am->head;
+		am->head = item;
+		if(!am->tail)
+			am->tail = item;
+	}
+}
+
+
+static void a2_hk_thread(void *userdata)
+{
+	A2_housekeeper *hk = (A2_housekeeper *)userdata;
+	A2_state *st = hk->state;
+	if(hk->fbdelay)
+		a2_fbdelay_Housekeeping(hk->fbdelay);
+	while(!a2_AtomicAdd(&hk->quit, 0))
+	{
+		A2_hkmessage am;
+		a2_Sleep(A2_HKPERIOD);
+		if(hk->fbdelay)
+			a2_fbdelay_Housekeeping(hk->fbdelay);
+		while(sfifo_Used(hk->requests) >= sizeof(am))
+		{
+			sfifo_Read(hk->requests, &am, sizeof(am));
+			if(am.head)
+			{
+				/* Surplus from the engine */
+				a2_hk_free(st, am.head);
+				continue;
+			}
+			a2_hk_alloc(st, &am);
+			if(sfifo_Write(hk->refills, &am, sizeof(am)) !=
+					sizeof(am))
+			{
+				/* Can't happen, unless the engine is stuck */
+				a2_hk_free(st, am.head);
+			}
+		}
+	}
+}
+
+
+/*---------------------------------------------------------
+	Engine side
+---------------------------------------------------------*/
+
+/* Pick up any refills, and add them to the pools */
+static void a2_hk_refill(A2_state *st)
+{
+	A2_housekeeper *hk = st->housekeeper;
+	A2_hkmessage am;
+	while(sfifo_Used(hk->refills) >= sizeof(am))
+	{
+		unsigned *count;
+		void **pool;
+		sfifo_Read(hk->refills, &am, sizeof(am));
+		hk->pending[am.pool] -= am.request;
+		if(!am.head)
+			continue;
+		pool = a2_hk_pool(st, am.pool, &count);
+		*am.tail = *pool;
+		*pool = am.head;
+		*count += am.count;
+		if(am.pool == A2_HKVOICES)
+			st->totalvoices += am.count;
+		EVLEAKTRACK(if(am.pool == A2_HKEVENTS)
+			st->numevents += am.count;)
+	}
+}
+
+
+/* Detach up to A2_HKMAXTRIM items above the target size, and send them off */
+static void a2_hk_trim(A2_state *st, unsigned p)
+{
+	A2_housekeeper *hk = st->housekeeper;
+	A2_hkmessage am;
+	unsigned *count;
+	void **pool = a2_hk_pool(st, p, &count);
+	unsigned i;
+	am.pool = p;
+	am.request = 0;
+	am.count = *count - hk->target[p];
+	if(am.count > A2_HKMAXTRIM)
+		am.count = A2_HKMAXTRIM;
+	am.head = am.tail = (void **)*pool;
+	for(i = 1; i < am.count; ++i)
+		am.tail = (void **)*am.tail;
+	*pool = *am.tail;
+	*am.tail = NULL;
+	*count -= am.count;
+	if(p == A2_HKVOICES)
+		st->totalvoices -= am.count;
+	EVLEAKTRACK(if(p == A2_HKEVENTS)
+		st->numevents -= am.count;)
+	sfifo_Write(hk->requests, &am, sizeof(am));
+}
+
+
+void a2_Housekeeping(A2_state *st)
+{
+	A2_housekeeper *hk = st->housekeeper;
+	unsigned p;
+	a2_hk_refill(st);
+	for(p = 0; p < A2_HKPOOLS; ++p)
+	{
+		unsigned *count;
+		unsigned n;
+		a2_hk_pool(st, p, &count);
+		n = *count + hk->pending[p];
+		if(sfifo_Space(hk->requests) < sizeof(A2_hkmessage))
+			return;
+		if(n * A2_HKLOWDIV < hk->target[p])
+		{
+			A2_hkmessage am;
+			am.pool = p;
+			am.request = hk->target[p] - n;
+			am.count = 0;
+			am.head = am.tail = NULL;
+			sfifo_Write(hk->requests, &am, sizeof(am));
+			hk->pending[p] += am.request;
+		}
+		else if(*count > hk->target[p] * A2_HKHIGHMUL)
+			a2_hk_trim(st, p);
+	}
+}
+
+
+/*---------------------------------------------------------
+	Open/close
+---------------------------------------------------------*/
+
+A2_errors a2_OpenHousekeeper(A2_state *st)
+{
+	A2_housekeeper *hk = (A2_housekeeper *)calloc(1,
+			sizeof(A2_housekeeper));
+	A2_errors res;
+	unsigned p;
+	if(!hk)
+		return A2_OOMEMORY;
+	hk->state = st;
+	hk->refills = sfifo_Open(A2_HKMESSAGES * sizeof(A2_hkmessage));
+	hk->requests = sfifo_Open(A2_HKMESSAGES * sizeof(A2_hkmessage));
+	if(!hk->refills || !hk->requests)
+	{
+		if(hk->refills)
+			sfifo_Close(hk->refills);
+		if(hk->requests)
+			sfifo_Close(hk->requests);
+		free(hk);
+		return A2_OOMEMORY;
+	}
+
+	/*
+	 * Whatever we have now is what we try to keep around, but we keep a
+	 * few items in every pool, including any that started out empty.
+	 */
+	for(p = 0; p < A2_HKPOOLS; ++p)
+	{
+		unsigned *count;
+		a2_hk_pool(st, p, &count);
+		hk->target[p] = *count;
+		if(hk->target[p] < A2_HKMINPOOL)
+			hk->target[p] = A2_HKMINPOOL;
+	}
+
+	/* Units with buffer pools of their own */
+	for(p = 0; p < st->ss->nunits; ++p)
+		if((st->ss->units[p] == &a2_fbdelay_unitdesc) &&
+				!st->unitstate[p].status)
+			hk->fbdelay = st->unitstate[p].statedata;
+
+	st->housekeeper = hk;
+	if((res = a2_ThreadStart(&hk->thread, a2_hk_thread, hk)))
+	{
+		st->housekeeper = NULL;
+		sfifo_Close(hk->refills);
+		sfifo_Close(hk->requests);
+		free(hk);
+		return res;
+	}
+	return A2_OK;
+}
+
+
+void a2_CloseHousekeeper(A2_state *st)
+{
+	A2_housekeeper *hk = st->housekeeper;
+	A2_hkmessage am;
+	if(!hk)
+		return;
+	a2_AtomicAdd(&hk->quit, 1);
+	a2_ThreadJoin(&hk->thread);
+
+	/* Refills go into the pools, to be freed with them */
+	a2_hk_refill(st);
+
+	/* Surplus not yet dealt with */
+	while(sfifo_Used(hk->requests) >= sizeof(am))
+	{
+		sfifo_Read(hk->requests, &am, sizeof(am));
+		a2_hk_free(st, am.head);
+	}
+
+	sfifo_Close(hk->refills);
+	sfifo_Close(hk->requests);
+	free(hk);
+	st->housekeeper = NULL;
+}
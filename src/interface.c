@@ -60,6 +60,7 @@ A2_errors a2_OpenAPI(A2_state *st)
 		}
 		e->next = st->eventpool;
 		st->eventpool = e;
+		++st->neventpool;
 	}
 	EVLEAKTRACK(A2_DLOG("Allocated %d events.\n", st->numevents);)
 	return A2_OK;
@@ -52,6 +52,10 @@ typedef struct A2_stream A2_stream;
 typedef struct A2_wahp_entry A2_wahp_entry;
 typedef struct A2_interface_i A2_interface_i;
 typedef struct A2_state A2_state;
+typedef struct A2_workers A2_workers;
+typedef struct A2_housekeeper A2_housekeeper;
+typedef struct A2_nativelib A2_nativelib;
+typedef struct A2_lane A2_lane;
 
 
 /*
@@ -194,7 +198,23 @@ void a2_DumpConfig(A2_config *c);
 	A2_DI(DEBUG)	A2_DI(DEBUGR)					\
 									\
 	/* Special instructions */					\
-	A2_DI(INITV)	A2_DI(SIZEOF)	A2_DI(SIZEOFR)
+	A2_DI(INITV)	A2_DI(SIZEOF)	A2_DI(SIZEOFR)			\
+									\
+	/* Control register write variants (see a2_ControlVariant()) */	\
+	A2_DI(SUBRC)	A2_DI(DIVRC)	A2_DI(P2DRC)	A2_DI(NEGRC)	\
+	A2_DI(LOADC)	A2_DI(LOADRC)	A2_DI(ADDC)	A2_DI(ADDRC)	\
+	A2_DI(MULC)	A2_DI(MULRC)	A2_DI(MODC)	A2_DI(MODRC)	\
+	A2_DI(QUANTC)	A2_DI(QUANTRC)	A2_DI(RANDC)	A2_DI(RANDRC)	\
+	A2_DI(GRC)	A2_DI(LRC)	A2_DI(GERC)	A2_DI(LERC)	\
+	A2_DI(EQRC)	A2_DI(NERC)					\
+	A2_DI(ANDRC)	A2_DI(ORRC)	A2_DI(XORRC)	A2_DI(NOTRC)	\
+	A2_DI(SIZEOFC)	A2_DI(SIZEOFRC)					\
+									\
+	/* Superinstructions (only generated by the code optimizer) */	\
+	A2_DI(PUSH2)	A2_DI(LDSET)	A2_DI(ADDSET)	A2_DI(LDRSET)	\
+	A2_DI(LDRAMP)	A2_DI(LDRRAMP)					\
+	A2_DI(GRJZ)	A2_DI(LRJZ)	A2_DI(GERJZ)	A2_DI(LERJZ)	\
+	A2_DI(EQRJZ)	A2_DI(NERJZ)
 
 #define	A2_DI(x)	OP_##x,
 typedef enum A2_opcodes
@@ -205,6 +225,25 @@ typedef enum A2_opcodes
 } A2_opcodes;
 #undef	A2_DI
 
+/*
+ * VM instructions that native code modules implement. (See native.c.) Others
+ * are always executed by the VM.
+ */
+#define A2_NATIVEINSTRUCTIONS						\
+	A2_NI(JUMP)	A2_NI(LOOP)	A2_NI(JZ)	A2_NI(JNZ)	\
+	A2_NI(JG)	A2_NI(JL)	A2_NI(JGE)	A2_NI(JLE)	\
+	A2_NI(SUBR)	A2_NI(DIVR)	A2_NI(NEGR)			\
+	A2_NI(LOAD)	A2_NI(LOADR)	A2_NI(ADD)	A2_NI(ADDR)	\
+	A2_NI(MUL)	A2_NI(MULR)	A2_NI(MOD)	A2_NI(MODR)	\
+	A2_NI(QUANT)	A2_NI(QUANTR)					\
+	A2_NI(GR)	A2_NI(LR)	A2_NI(GER)	A2_NI(LER)	\
+	A2_NI(EQR)	A2_NI(NER)					\
+	A2_NI(ANDR)	A2_NI(ORR)	A2_NI(XORR)	A2_NI(NOTR)	\
+	A2_NI(PUSH)	A2_NI(PUSHR)					\
+	A2_NI(PUSH2)							\
+	A2_NI(GRJZ)	A2_NI(LRJZ)	A2_NI(GERJZ)	A2_NI(LERJZ)	\
+	A2_NI(EQRJZ)	A2_NI(NERJZ)
+
 /* First VM register that may have a write callback */
 #define	A2_FIRSTCONTROLREG	A2_FIXEDREGS
 
@@ -223,6 +262,43 @@ typedef struct A2_instruction
 } A2_instruction;
 
 unsigned a2_InsSize(A2_opcodes op);
+
+/*
+ * Branch instructions have a signed 16 bit target offset in 'a2', relative to
+ * the position of the branch instruction itself.
+ *
+ * NOTE: This relies on JUMP through JLE being consecutive opcodes!
+ */
+static inline int a2_IsBranch(A2_opcodes op)
+{
+	return (op >= OP_JUMP) && (op <= OP_JLE);
+}
+
+/*
+ * Register writing instructions come in two versions: the plain ones, for
+ * temporary, variable and argument registers, and the *C versions, that also
+ * track the write for a2_RTApply(), for registers that may be wired to unit
+ * control inputs. a2c_Code() selects the variant based on the register type.
+ *
+ * NOTE: The *C opcodes MUST mirror SUBR through NOTR, SIZEOF and SIZEOFR!
+ */
+static inline A2_opcodes a2_ControlVariant(A2_opcodes op)
+{
+	if((op >= OP_SUBR) && (op <= OP_NOTR))
+		return op - OP_SUBR + OP_SUBRC;
+	if((op == OP_SIZEOF) || (op == OP_SIZEOFR))
+		return op - OP_SIZEOF + OP_SIZEOFC;
+	return op;
+}
+
+static inline A2_opcodes a2_PlainVariant(A2_opcodes op)
+{
+	if((op >= OP_SUBRC) && (op <= OP_NOTRC))
+		return op - OP_SUBRC + OP_SUBR;
+	if((op == OP_SIZEOFC) || (op == OP_SIZEOFRC))
+		return op - OP_SIZEOFC + OP_SIZEOF;
+	return op;
+}
 void a2_DumpIns(unsigned *code, unsigned pc, FILE *stream);
 
 
@@ -335,6 +411,16 @@ void a2_UnitCloseState(A2_state *st, unsigned uindex);
 
 A2_errors a2_RegisterUnitTypes(A2_state *st);
 
+/* Get the Reset() callback of a unit, if it has one */
+static inline A2_uinit_cb a2_UnitReset(const A2_unitdesc *ud)
+{
+	const A2_unitdescx *udx = (const A2_unitdescx *)ud;
+	if(!(ud->flags & A2_UNITDESCX) || (udx->size <
+			offsetof(A2_unitdescx, Reset) + sizeof(A2_uinit_cb)))
+		return NULL;
+	return udx->Reset;
+}
+
 
 /*---------------------------------------------------------
 	Engine structures
@@ -396,6 +482,8 @@ struct A2_structitem
 			unsigned	flags;		/* A2_unitflags */
 			int16_t		ninputs;	/* Count/A2_iocodes */
 			int16_t		noutputs;	/* Count/A2_iocodes */
+			uint16_t	offset;		/* Offset in unit image */
+			uint16_t	coffset;	/* Control outputs offset */
 		} unit;
 		struct {
 			int16_t		from_unit;
@@ -410,6 +498,7 @@ TODO: registers in future versions!
 #else
 			int		to_register;
 #endif
+			uint16_t	coffset;	/* Output offset in image */
 		} wire;
 	} p;
 };
@@ -417,6 +506,7 @@ TODO: registers in future versions!
 typedef struct A2_function
 {
 	unsigned	*code;		/* VM code */
+	A2_nativefunc	native;		/* Native code, if loaded */
 	int		argdefs[A2_MAXARGS];	/* Argument default values */
 	uint16_t	size;		/* Size of 'code' (32 bit words) */
 	uint8_t		argv;		/* First register of argument list */
@@ -424,15 +514,35 @@ typedef struct A2_function
 	uint8_t		topreg;		/* Highest register used */
 } A2_function;
 
+/*
+ * Location of a handle operand in the VM code or argument defaults of a
+ * program. These are needed for translating handles when saving and loading
+ * compiled banks. (The a2 operands of the SPAWN* and SIZEOF* instructions are
+ * always handles, so they are not listed here.)
+ */
+typedef struct A2_reloc
+{
+	uint8_t		func;		/* Function index */
+	uint8_t		arg;		/* 1 + argument default index, or 0 */
+	uint16_t	pos;		/* Code position of the operand word */
+} A2_reloc;
+
 struct A2_program
 {
 	A2_function	*funcs;		/* Function and handler entry points */
 	A2_structitem	*units;		/* Voice structure: units */
 	A2_structitem	*wires;		/* Voice structure: wires */
+	A2_reloc	*relocs;	/* Handle operands */
+	unsigned	nrelocs;
 	int8_t		eps[A2_MAXEPS];	/* Message to funcs index map */
 	uint16_t	vflags;		/* Extra voice flags (A2_voiceflags) */
 	int8_t		buffers;	/* Number of scratch buffers needed */
 	uint8_t		nfuncs;		/* Number of local functions */
+	uint8_t		native;		/* Use native code (A2_PNATIVE) */
+	uint16_t	imagesize;	/* Voice unit image size, or 0 */
+	uint8_t		nregs;		/* Register frame size */
+	uint8_t		ncregs;		/* Number of wired regs */
+	uint8_t		recycle;	/* Voices can be recycled (warm) */
 };
 
 /*
@@ -451,9 +561,20 @@ struct A2_stackentry
 	int		r[1];		/* Saved registers */
 };
 
-/* Actual size of A2_stackentry.r */
-#define	A2_MAXSAVEREGS	\
-	((sizeof(A2_block) - offsetof(A2_stackentry, r)) / sizeof(int))
+/* Maximum number of registers saved by a stack entry */
+#define	A2_MAXSAVEREGS	A2_REGISTERS
+
+/*
+ * Size of a voice register frame with 'nregs' registers; the VM registers,
+ * followed by the control register write info array.
+ */
+#define	A2_FRAMEREGSSIZE(nregs)	A2_IMAGEALIGN((nregs) * sizeof(int))
+#define	A2_FRAMESIZE(nregs)	\
+	(A2_FRAMEREGSSIZE(nregs) + (nregs) * sizeof(A2_cport))
+
+/* Size of a stack entry saving 'saveregs' registers */
+#define	A2_STACKENTRYSIZE(saveregs)	\
+	(offsetof(A2_stackentry, r) + (saveregs) * sizeof(int))
 
 /*
  * Internal event struct - sent directly to voice event queues
@@ -543,6 +664,7 @@ typedef union A2_eventbody
 struct A2_event
 {
 	A2_event	*next;		/* Next event en queue */
+	A2_event	*last;		/* Last event en queue (first event only) */
 	A2_eventbody	b;
 	NUMMSGS(unsigned number;)
 	MSGTRACK(const char *source;)
@@ -552,37 +674,49 @@ typedef enum A2_voiceflags
 {
 	A2_SUBINLINE =	0x0100,	/* Subvoices as inline unit */
 	A2_ATTACHED =	0x0200,	/* Voice attached to handle or parent */
-	A2_APIHANDLE =	0x0400	/* 'handle' field is a valid API handle */
+	A2_APIHANDLE =	0x0400,	/* 'handle' field is a valid API handle */
+	A2_LANEEND =	0x0800,	/* Ended in a lane; to be freed after pass */
+	A2_REPLACEOUT =	0x1000,	/* Output bus is replaced, not added to */
+	A2_RECYCLE =	0x2000	/* Keep units and frame when freed */
 } A2_voiceflags;
 
-/* Voice - node of the processing tree graph */
+/*
+ * Voice - node of the processing tree graph
+ *
+ *	The fields touched by every voice in every fragment come first, so
+ *	that they share the first cache line. The VM registers and control
+ *	register write info are kept in a separate register frame block, sized
+ *	after the register count of the program (A2_program.nregs).
+ */
 struct A2_voice
 {
+	/* Hot: Voice processing */
 	A2_voice	*next;		/* Next voice in list */
 	A2_event	*events;	/* Event queue */
-	A2_stackentry	*stack;		/* VM call stack */
-
-	/* VM state */
-	A2_program	*program;	/* Currently executing VM program */
-	A2_vmstate	s;		/* Control, special and work regs */
-
-	A2_handle	handle;		/* Handle, if wired to the API */
+	A2_vmstate	s;		/* Timing, state and register frame */
+	A2_unit		*units;		/* Chain of voice units */
+	A2_voice	*sub;		/* List of all subvoices */
 	uint16_t	flags;		/* A2_voiceflags */
 	uint8_t		nestlevel;	/* Nest level, for scratch buffers */
+	uint8_t		lane;		/* Processing lane + 1, or 0 */
+	A2_voice	*lanenext;	/* Next voice in lane, current pass */
+	A2_program	*program;	/* Currently executing VM program */
 
-	/* Units and control registers */
-	uint8_t		ncregs;			/* Number of wired regs */
-	A2_cport	cregs[A2_REGISTERS];	/* Register write info */
-	A2_unit		*units;			/* Chain of voice units */
-
-	/* Sub-voices */
-	A2_voice	*sub;			/* List of all subvoices */
+	/* Cold: VM calls, control registers, wiring etc */
+	A2_stackentry	*stack;		/* VM call stack */
+	A2_cport	*cregs;		/* Register write info (in frame) */
+	uint8_t		nregs;		/* Register frame size */
+	uint8_t		ncregs;		/* Number of wired regs */
+	uint16_t	imagesize;	/* Size of 'image' */
+	A2_handle	handle;		/* Handle, if wired to the API */
+	char		*image;		/* Unit image block, if any */
+	uint32_t	*noisestate;	/* RAND*, 'wtosc' noise RNG state */
+	uint32_t	noise;		/* RNG state of root subvoice trees */
+	unsigned	noutputs;
+	int32_t		**outputs;
 #if A2_SV_LUT_SIZE
 	A2_voice	*sv[A2_SV_LUT_SIZE];	/* Quick subvoice LUT */
 #endif
-
-	unsigned	noutputs;
-	int32_t		**outputs;
 };
 
 /* Audio bus */
@@ -592,18 +726,49 @@ struct A2_bus
 	int32_t		*buffers[A2_MAXCHANNELS];
 };
 
-/* Block - allocation unit for A2_stackentry and mixing buffers */
-typedef union A2_block A2_block;
-union A2_block
+/*
+ * Block - realtime allocation unit for stack entries, unit instances, control
+ * port arrays, audio buffers and buses. Blocks come in A2_SLABCLASSES size
+ * classes, doubling from A2_SLABMIN up to A2_BLOCK_SIZE bytes, and each class
+ * has a pool of its own.
+ */
+typedef struct A2_block A2_block;
+struct A2_block
 {
-	A2_block	*next;			/* Free list link */
-	A2_stackentry	stackentry;		/* VM stack entry */
-	A2_unit		unit;			/* Voice unit instance */
-	int32_t		buffer[A2_MAXFRAG];	/* Audio buffer */
-	A2_bus		bus;			/* Audio bus */
-	char		minsize[A2_BLOCK_SIZE];
+	A2_block	*next;		/* Free list link */
 };
 
+#if (A2_SLABMIN << (A2_SLABCLASSES - 1)) != A2_BLOCK_SIZE
+# error A2_SLABMIN and A2_SLABCLASSES do not match A2_BLOCK_SIZE!
+#endif
+
+/* Block size class pool */
+typedef struct A2_slab
+{
+	A2_block	*pool;		/* LIFO stack of memory blocks */
+	unsigned	count;		/* Number of blocks in pool */
+} A2_slab;
+
+/*
+ * Unit image and register frame of a terminated voice, still populated and
+ * wired, kept for reuse by a new voice running the same program, with the
+ * same outputs. 'program' is only used as a key, and is never dereferenced.
+ */
+typedef struct A2_warmvoice
+{
+	const A2_program *program;
+	int32_t		**outputs;	/* Output buffers the units are wired to */
+	char		*image;		/* Unit image */
+	int		*frame;		/* Register frame */
+	uint16_t	imagesize;
+	uint8_t		nregs;		/* Register frame size */
+	uint8_t		nestlevel;	/* For scratch buffers */
+	unsigned	noutputs;
+} A2_warmvoice;
+
+/* Size of audio buffer blocks */
+#define	A2_BUFFERSIZE	(A2_MAXFRAG * sizeof(int32_t))
+
 /* State resources that are shared by master states and substates */
 struct A2_sharedstate
 {
@@ -613,6 +778,10 @@ struct A2_sharedstate
 	char		strbuf[A2_TMPSTRINGSIZE]; /* For API return strings */
 
 	unsigned	offlinebuffer;	/* A2_POFFLINEBUFFER */
+	unsigned	offlinethreads;	/* A2_POFFLINETHREADS */
+	unsigned	warmvoices;	/* A2_PWARMVOICES */
+	A2_mutex	offlinemtx;	/* For offline substate setup/cleanup */
+	char		*wavecache;	/* Render cache path, or NULL */
 
 	unsigned	silencelevel;	/* A2_PSILENCELEVEL */
 	unsigned	silencewindow;	/* A2_PSILENCEWINDOW */
@@ -622,6 +791,8 @@ struct A2_sharedstate
 
 	unsigned	nunits;		/* Number of registered units */
 	const A2_unitdesc **units;	/* All registered units */
+
+	A2_nativelib	*nativelibs;	/* Loaded native code modules */
 };
 
 /* Interface implementation */
@@ -668,11 +839,16 @@ struct A2_state
 	A2_event	*eocevents;	/* To be sent to API at end of cycle */
 
 	A2_voice	*voicepool;	/* LIFO stack of voices */
+	unsigned	nvoicepool;	/* Number of voices in pool */
 	unsigned	totalvoices;	/* Number of voices in use + pool */
 	unsigned	activevoices;	/* Number of voices in use */
 
-	A2_block	*blockpool;	/* LIFO stack of memory blocks */
+	A2_slab		slabs[A2_SLABCLASSES];	/* Memory block pools */
+	A2_warmvoice	warm[A2_MAXWARM];	/* Recycled voices, oldest first */
+	unsigned	nwarm;		/* Number of recycled voices */
 	A2_event	*eventpool;	/* LIFO stack of event structs */
+	unsigned	neventpool;	/* Number of events in pool */
+	A2_housekeeper	*housekeeper;	/* Pool refill thread, if any */
 	unsigned	now_fragstart;	/* For internal message timing */
 	NUMMSGS(unsigned msgnum;)
 	EVLEAKTRACK(unsigned numevents;)
@@ -708,9 +884,35 @@ struct A2_state
 	int		tsmin;		/* Minimum TS deadline margin (24:8) */
 	int		tsmax;		/* Maximum TS deadline margin (24:8) */
 
+	/* Direct off-line output; replaces the audio driver buffers */
+	int16_t		*renderout;	/* Next output frame, or NULL */
+	int		silencelevel;	/* Peak threshold for 'lastpeak' */
+	unsigned	lastpeak;	/* Frames since last peak */
+
 	/* Global audio buffers */
 	A2_bus		*master;		/* Master outputs */
 	A2_bus		*scratch[A2_NESTLIMIT];	/* Intermediate buffers */
+
+	/* Parallel processing of the root voice subvoices */
+	A2_workers	*workers;	/* Worker thread pool, if any */
+	A2_lane		*lanes;		/* Voice processing lanes */
+	unsigned	nlanes;		/* Number of lanes (0 if disabled) */
+	unsigned	nextlane;	/* Round-robin lane assignment */
+};
+
+/*
+ * Voice processing lane. Each subvoice of the root voice is assigned to a lane
+ * as it is started, and stays there. Lanes are processed in parallel by the
+ * worker pool, each with a private shadow engine state, providing pools and
+ * scratch buffers, and a private mixing bus, which is added to the root voice
+ * output in lane order once all lanes are done.
+ */
+struct A2_lane
+{
+	A2_state	*state;		/* Shadow state for this lane */
+	A2_bus		*bus;		/* Partial mix of the lane voices */
+	A2_voice	*voices;	/* Voices to process in current pass */
+	unsigned	ended;		/* Voices that ended in current pass */
 };
 
 
@@ -766,6 +968,22 @@ static inline A2_errors a2_GetStream(A2_state *st, A2_handle handle,
 	return A2_OK;
 }
 
+/*
+ * Handle translation callback for a2_TranslateHandles(). Returns what 'h' is
+ * to be replaced with, or a negated A2_errors error code.
+ */
+typedef int (*A2_handlemap_cb)(void *userdata, A2_handle h);
+
+/*
+ * Pass the handle operands of function 'func' of 'p' through 'map'. The code
+ * and argument defaults are read from, and written to, 'code' and 'argdefs',
+ * which may be copies, or the ones of the function. Operands are only written
+ * if 'map' changes them.
+ */
+A2_errors a2_TranslateHandles(A2_program *p, unsigned func,
+		unsigned *code, int *argdefs, A2_handlemap_cb map,
+		void *userdata);
+
 /* Kill any voices using 'program' */
 void a2_KillVoicesUsingProgram(A2_state *st, A2_handle program);
 
@@ -782,33 +1000,57 @@ int a2_UnlockAllStates(A2_state *st);
 	Realtime block memory manager
 ---------------------------------------------------------*/
 
-static inline A2_block *a2_NewBlock(A2_state *st)
+/* Size class of blocks of 'size' bytes. ('size' must be <= A2_BLOCK_SIZE!) */
+static inline unsigned a2_SlabClass(unsigned size)
+{
+	unsigned c = 0;
+	while((A2_SLABMIN << c) < size)
+		++c;
+	return c;
+}
+
+/* Size of the blocks of size class 'c' */
+static inline unsigned a2_SlabSize(unsigned c)
+{
+	return A2_SLABMIN << c;
+}
+
+static inline A2_block *a2_NewBlock(A2_state *st, unsigned c)
 {
-	A2_block *b = st->sys->RTAlloc(st->sys, sizeof(A2_block));
+	A2_block *b = st->sys->RTAlloc(st->sys, a2_SlabSize(c));
 	if(!b)
 		return NULL;
 #ifdef DEBUG
 	if(st->config->flags & A2_REALTIME)
-		A2_LOG_DBG(&st->interfaces->interface, "Block pool exhausted! "
-				"Allocated new block %p.", b);
+		A2_LOG_DBG(&st->interfaces->interface, "Block pool %d "
+				"exhausted! Allocated new block %p.", c, b);
 #endif
 	return b;
 }
 
-static inline A2_block *a2_AllocBlock(A2_state *st)
+/* Allocate a block of at least 'size' bytes */
+static inline void *a2_AllocBlock(A2_state *st, unsigned size)
 {
-	A2_block *b = st->blockpool;
+	unsigned c = a2_SlabClass(size);
+	A2_slab *s = st->slabs + c;
+	A2_block *b = s->pool;
 	if(b)
-		st->blockpool = b->next;
+	{
+		s->pool = b->next;
+		--s->count;
+	}
 	else
-		b = a2_NewBlock(st);
+		b = a2_NewBlock(st, c);
 	return b;
 }
 
-static inline void a2_FreeBlock(A2_state *st, void *block)
+/* Free a block allocated with a2_AllocBlock(), passing the same 'size' */
+static inline void a2_FreeBlock(A2_state *st, void *block, unsigned size)
 {
-	((A2_block *)block)->next = st->blockpool;
-	st->blockpool = (A2_block *)block;
+	A2_slab *s = st->slabs + a2_SlabClass(size);
+	((A2_block *)block)->next = s->pool;
+	s->pool = (A2_block *)block;
+	++s->count;
 }
 
 
@@ -820,16 +1062,17 @@ static inline void a2_FreeBlock(A2_state *st, void *block)
 static inline A2_bus *a2_AllocBus(A2_state *st, unsigned channels)
 {
 	int i;
-	A2_bus *b = (A2_bus *)a2_AllocBlock(st);
+	A2_bus *b = (A2_bus *)a2_AllocBlock(st, sizeof(A2_bus));
 	if(!b)
 		return NULL;
 	b->channels = channels;
 	for(i = 0; i < channels; ++i)
-		if(!(b->buffers[i] = (int32_t *)a2_AllocBlock(st)))
+		if(!(b->buffers[i] = (int32_t *)a2_AllocBlock(st,
+				A2_BUFFERSIZE)))
 		{
 			while(--i >= 0)
-				a2_FreeBlock(st, b->buffers[i]);
-			a2_FreeBlock(st, b);
+				a2_FreeBlock(st, b->buffers[i], A2_BUFFERSIZE);
+			a2_FreeBlock(st, b, sizeof(A2_bus));
 			return NULL;
 		}
 	return b;
@@ -839,7 +1082,8 @@ static inline A2_bus *a2_AllocBus(A2_state *st, unsigned channels)
 static inline int a2_ReallocBus(A2_state *st, A2_bus *bus, unsigned channels)
 {
 	for( ; bus->channels < channels; ++bus->channels)
-		if(!(bus->buffers[bus->channels] = (int32_t *)a2_AllocBlock(st)))
+		if(!(bus->buffers[bus->channels] = (int32_t *)a2_AllocBlock(st,
+				A2_BUFFERSIZE)))
 			return 0;
 	return 1;
 }
@@ -857,8 +1101,8 @@ static inline void a2_FreeBus(A2_state *st, A2_bus *bus)
 {
 	int i;
 	for(i = 0; i < bus->channels; ++i)
-		a2_FreeBlock(st, bus->buffers[i]);
-	a2_FreeBlock(st, bus);
+		a2_FreeBlock(st, bus->buffers[i], A2_BUFFERSIZE);
+	a2_FreeBlock(st, bus, sizeof(A2_bus));
 }
 
 
@@ -879,7 +1123,10 @@ static inline A2_event *a2_AllocEvent(A2_state *st)
 {
 	A2_event *e = st->eventpool;
 	if(e)
+	{
 		st->eventpool = e->next;
+		--st->neventpool;
+	}
 	else
 	{
 		e = a2_NewEvent(st);
@@ -899,6 +1146,7 @@ static inline void a2_FreeEvent(A2_state *st, A2_event *e)
 {
 	e->next = st->eventpool;
 	st->eventpool = e;
+	++st->neventpool;
 }
 
 /*
@@ -924,25 +1172,56 @@ static inline A2_event **a2_GetEventQueue(A2_state *st, A2_handle handle)
 	}
 }
 
+/*
+ * Insert event 'e' into the timestamp ordered event queue 'q', after any
+ * events with the same timestamp.
+ *
+ * The first event of a queue keeps track of the last one, so that events
+ * arriving in timestamp order, as they do from sequencers and most scripts,
+ * are appended without scanning the queue.
+ */
 static inline void a2_SendEvent(A2_event **q, A2_event *e)
 {
 	A2_event *pe = *q;
-	if(!pe || (a2_TSDiff(pe->b.common.timestamp,
-			e->b.common.timestamp) > 0))
+	if(!pe)
+	{
+		e->next = NULL;
+		e->last = e;
+		*q = e;
+	}
+	else if(a2_TSDiff(pe->last->b.common.timestamp,
+			e->b.common.timestamp) <= 0)
+	{
+		e->next = NULL;
+		pe->last->next = e;
+		pe->last = e;
+	}
+	else if(a2_TSDiff(pe->b.common.timestamp,
+			e->b.common.timestamp) > 0)
 	{
 		e->next = pe;
+		e->last = pe->last;
 		*q = e;
 	}
 	else
 	{
-		while(pe->next && (a2_TSDiff(pe->next->b.common.timestamp,
-				e->b.common.timestamp) <= 0))
+		/* Somewhere in between; the last event is later than 'e' */
+		while(a2_TSDiff(pe->next->b.common.timestamp,
+				e->b.common.timestamp) <= 0)
 			pe = pe->next;
 		e->next = pe->next;
 		pe->next = e;
 	}
 }
 
+/* Remove the first event from event queue 'q' */
+static inline void a2_UnlinkEvent(A2_event **q)
+{
+	A2_event *e = *q;
+	if((*q = e->next))
+		(*q)->last = e->last;
+}
+
 /*
  * Flush a queue of rejected events, cleaning up any "limbo" data that the
  * events may be carrying. 'h' is the voice handle, or -1 if there isn't one.
@@ -955,14 +1234,35 @@ void a2_FlushEventQueue(A2_state *st, A2_event **eq, A2_handle h);
 ---------------------------------------------------------*/
 
 A2_voice *a2_VoiceAlloc(A2_state *st);
+
+/* Initialize newly allocated voice memory for the voice pool */
+void a2_VoiceInit(A2_voice *v);
 A2_errors a2_init_root_voice(A2_state *st);
-A2_voice *a2_VoiceNew(A2_state *st, A2_voice *parent, unsigned when);
+A2_voice *a2_VoiceNew(A2_state *st, A2_voice *parent, A2_program *p,
+		unsigned when);
 A2_errors a2_VoiceStart(A2_state *st, A2_voice *v,
 		A2_program *p, int argc, int *argv);
 A2_errors a2_VoiceCall(A2_state *st, A2_voice *v, unsigned func,
 		int argc, int *argv, int interrupt);
 void a2_VoiceFree(A2_state *st, A2_voice **head);
 
+/*
+ * Build the voice template of program 'p', laying out all units and control
+ * output arrays of its voices in one memory block, the "unit image," and
+ * resolving control wires to offsets into that. Programs with images larger
+ * than A2_BLOCK_SIZE get no template, and one block per unit instead. The
+ * register frame size of 'p' is extended to cover all control registers.
+ *
+ * Returns A2_BADFORMAT if the voice structure has invalid wiring.
+ */
+A2_errors a2_PrepareVoiceTemplate(A2_state *st, A2_program *p);
+
+/*
+ * Free the recycled voices of program 'p' (of all programs if NULL) from the
+ * warm voice cache of 'st'.
+ */
+void a2_FlushWarmVoices(A2_state *st, const A2_program *p);
+
 static inline void a2_VoiceDetach(A2_voice *v, unsigned when)
 {
 	v->flags &= ~A2_ATTACHED;
@@ -983,6 +1283,65 @@ static inline A2_voice *a2_voice_from_vms(A2_vmstate *vms)
 	return (A2_voice *)(void *)((char *)vms - offsetof(A2_voice, s));
 }
 
+/*
+ * Get the engine state that processes voice 'v'; the lane shadow state if the
+ * voice belongs to a lane, otherwise 'st'.
+ */
+static inline A2_state *a2_VoiceState(A2_state *st, A2_voice *v)
+{
+	return v->lane ? st->lanes[v->lane - 1].state : st;
+}
+
+/* Set up/close the voice processing lanes and worker pool of state 'st' */
+A2_errors a2_OpenLanes(A2_state *st, unsigned workers);
+void a2_CloseLanes(A2_state *st);
+
+
+/*---------------------------------------------------------
+	Worker thread pool
+---------------------------------------------------------*/
+
+typedef void (*A2_workfunc)(void *userdata, unsigned item);
+
+/* Open a pool of 'nthreads' worker threads */
+A2_workers *a2_OpenWorkers(unsigned nthreads);
+
+/* Stop and close worker pool 'wk' */
+void a2_CloseWorkers(A2_workers *wk);
+
+/*
+ * Run 'func' for items [0, nitems) on the worker pool, with the calling thread
+ * participating. Returns when all items have been processed. If 'wk' is NULL,
+ * all items are processed in order by the calling thread.
+ */
+void a2_RunWorkers(A2_workers *wk, A2_workfunc func, void *userdata,
+		unsigned nitems);
+
+
+/*---------------------------------------------------------
+	Pool housekeeping
+---------------------------------------------------------*/
+
+/*
+ * Start a thread that keeps the block, event and voice pools of the realtime
+ * state 'st' topped up, and takes care of surplus items after bursts, so the
+ * engine doesn't need to allocate or free memory in the audio context. The
+ * thread also looks after the delay buffer pool of the 'fbdelay' unit.
+ */
+A2_errors a2_OpenHousekeeper(A2_state *st);
+
+/*
+ * Stop the housekeeping thread of 'st', if any, and put any items in transit
+ * back in the pools.
+ */
+void a2_CloseHousekeeper(A2_state *st);
+
+/*
+ * Engine side housekeeping; pick up refills, and post requests and surplus.
+ * Called from the audio callback.
+ */
+void a2_Housekeeping(A2_state *st);
+
 
 /*---------------------------------------------------------
 	Internal DSP callbacks
@@ -1005,6 +1364,22 @@ A2_errors a2_RegisterXICTypes(A2_state *st);
 A2_errors a2_InitWaves(A2_interface *i, A2_handle bank);
 A2_errors a2_RegisterWaveTypes(A2_state *st);
 
+/*
+ * Prepare the unprepared wave 'w', using 'data' as mip level 0, instead of
+ * writing via a stream. 'data' is a malloc()ed buffer of A2_WAVEPRE + 'length'
+ * + A2_WAVEPOST samples, with the wave data starting at A2_WAVEPRE. The wave
+ * takes ownership of 'data', also if the call fails. A2_NORMALIZE waves need
+ * the original data, and cannot be prepared this way.
+ */
+A2_errors a2_PrepareWave(A2_wave *w, int16_t *data, unsigned length);
+
+/*
+ * Allocate and calculate the Hermite coefficients of A2_FAST wave 'w', for
+ * waves that get their mip levels from elsewhere, such as the wave cache. Does
+ * nothing for waves without the A2_FAST flag.
+ */
+A2_errors a2_PrepareCoeffs(A2_wave *w);
+
 
 /*---------------------------------------------------------
 	Async API message gateway
@@ -1137,6 +1512,86 @@ A2_errors a2_XinsertAddClient(A2_state *st, A2_voice *v,
 A2_errors a2_XinsertRemoveClient(A2_xinsert_client *xic);
 
 
+/*---------------------------------------------------------
+	Native code modules
+---------------------------------------------------------*/
+
+struct A2_nativelib
+{
+	A2_nativelib	*next;
+	void		*handle;	/* dlopen() handle */
+};
+
+/*
+ * Load the native code module for 'bank', if one is found next to the script
+ * file 'fn', and attach any matching functions to the programs of the bank.
+ */
+A2_errors a2_LoadNative(A2_state *st, A2_handle bank, const char *fn);
+
+/* Unload all native code modules of 'ss' */
+void a2_CloseNative(A2_sharedstate *ss);
+
+
+/*---------------------------------------------------------
+	Precompiled banks
+---------------------------------------------------------*/
+
+/*
+ * Load the precompiled bank file for the script file 'fn' into the empty bank
+ * 'bank', if there is one, and it was compiled from the current version of
+ * the script.
+ */
+A2_errors a2_LoadPrecompiled(A2_interface *i, A2_handle bank, const char *fn);
+
+
+/*---------------------------------------------------------
+	Offline rendering
+---------------------------------------------------------*/
+
+/* Job for a2_RenderWaveJobs() */
+typedef struct A2_renderjob
+{
+	A2_handle	wave;		/* Target wave (new, unprepared) */
+	unsigned	samplerate;
+	unsigned	length;		/* Frames, or 0 to stop on silence */
+	A2_property	*props;		/* Substate properties, or NULL */
+	A2_handle	program;
+	unsigned	argc;
+	int		argv[A2_MAXARGS];
+	int		result;		/* Frames, or negated A2_errors code */
+	unsigned	rendertime;	/* Microseconds */
+} A2_renderjob;
+
+/*
+ * Render the waves of 'jobs' as a2_RenderWave() would, in parallel on
+ * A2_POFFLINETHREADS threads. Jobs that use the waves of other jobs are held
+ * back until those have been rendered. Results are returned in the 'result'
+ * fields of the jobs.
+ */
+A2_errors a2_RenderWaveJobs(A2_interface *i, A2_renderjob *jobs,
+		unsigned njobs);
+
+
+/*---------------------------------------------------------
+	Wave render cache
+---------------------------------------------------------*/
+
+/*
+ * Calculate the cache key for 'job'. Returns A2_NOTFOUND if there is no cache
+ * directory set.
+ */
+A2_errors a2_WaveCacheKey(A2_interface *i, A2_renderjob *job, uint64_t *key);
+
+/*
+ * Load the cache file for 'key' into the new, unprepared 'wave', if there is
+ * one. The wave is prepared and ready for use if A2_OK is returned.
+ */
+A2_errors a2_WaveCacheLoad(A2_interface *i, uint64_t key, A2_handle wave);
+
+/* Write 'wave' to the cache file for 'key' */
+A2_errors a2_WaveCacheStore(A2_interface *i, uint64_t key, A2_handle wave);
+
+
 /*---------------------------------------------------------
 	Error handling
 ---------------------------------------------------------*/
@@ -0,0 +1,604 @@
+/*
+ * native.c - Audiality 2 native code modules
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Native code modules are generated by translating VM code into C, one C
+ * function per VM function, with a label for every instruction. Branches
+ * become gotos, and arithmetics, comparisons and argument pushes are done in
+ * place. Instructions that interact with the engine (timing, unit control,
+ * voice management, calls etc) are left to the VM, by returning their PC.
+ * Instructions that may fail (division by zero, too many arguments, VM
+ * overload) are also left to the VM, so that errors are handled the same way
+ * in both cases.
+ *
+ * The VM code is included in the module, and a native function is only used
+ * if the code it was generated from matches the loaded code. Operands of
+ * instructions that are left to the VM are ignored, as they may contain
+ * handles, which depend on the order in which objects are created.
+ *
+ * Only a limited subset of the instruction set is handled natively; see
+ * A2_NATIVEINSTRUCTIONS. That is local branches and loops, plain register
+ * arithmetics, comparisons and boolean operators, argument pushes, and the
+ * PUSH2 and *RJZ superinstructions. Notably, P2DR, RAND and the *C control
+ * register write variants are left to the VM, so code that writes unit
+ * controls directly gains little.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internals.h"
+
+#ifdef A2_HAVE_DLOPEN
+#include <dlfcn.h>
+#endif
+
+
+/*
+ * Return the next program of bank or program 'h', starting at index '*n', or
+ * NULL if there are no more programs.
+ */
+static A2_program *a2_NativeProgram(A2_state *st, A2_handle h, unsigned *n)
+{
+	A2_bank *b = a2_GetBank(st, h);
+	if(!b)
+		return (*n)++ ? NULL : a2_GetProgram(st, h);
+	while(*n < b->deps.nitems)
+	{
+		A2_program *p = a2_GetProgram(st, b->deps.items[(*n)++]);
+		if(p)
+			return p;
+	}
+	return NULL;
+}
+
+
+/*
+ * Returns 1 if 'op' is implemented by native code, so that operands need to
+ * match for native code to be valid.
+ *
+ * NOTE: A2_NATIVEINSTRUCTIONS must match a2_NativeFunction()!
+ */
+static int a2_NativeOp(A2_opcodes op)
+{
+#define	A2_NI(x)	case OP_##x:
+	switch(op)
+	{
+	  A2_NATIVEINSTRUCTIONS
+		return 1;
+	  default:
+		return 0;
+	}
+#undef	A2_NI
+}
+
+
+static inline A2_opcodes a2_NativeOpcode(const uint32_t *code, unsigned pc)
+{
+	return ((const A2_instruction *)(code + pc))->opcode;
+}
+
+
+/*---------------------------------------------------------
+	C code generator
+---------------------------------------------------------*/
+
+/* Print 32 bit integer constant (-2147483648 is not an int literal in C!) */
+static void a2_NativeInt(FILE *f, int32_t v)
+{
+	if(v == INT32_MIN)
+		fprintf(f, "(-2147483647 - 1)");
+	else
+		fprintf(f, "%d", v);
+}
+
+/*
+ * Start instruction at 'pc'. If 'bail' is specified, the VM takes over
+ * whenever that condition is true.
+ */
+static void a2_NativeBegin(FILE *f, unsigned pc, const char *bail)
+{
+	fprintf(f, "  L%u:\tif(nc->inscount <= 1", pc);
+	if(bail)
+		fprintf(f, " || %s", bail);
+	fprintf(f, ")\n\t\treturn %u;\n\t--nc->inscount;\n", pc);
+}
+
+/* Conditional branch to 'target', or back to the VM for invalid targets */
+static void a2_NativeBranch(FILE *f, const char *cond, int target,
+		const uint8_t *valid, unsigned size)
+{
+	if(cond)
+		fprintf(f, "\tif(%s)\n\t", cond);
+	if((target >= 0) && ((unsigned)target < size) && valid[target])
+		fprintf(f, "\tgoto L%d;\n", target);
+	else
+		fprintf(f, "\treturn %d;\n", target);
+}
+
+/*
+ * Returns the number of instructions of 'fn' that are handled by native code.
+ * '*regs' is set to 1 if any of those instructions access VM registers.
+ */
+static unsigned a2_NativeScan(A2_function *fn, int *regs)
+{
+	unsigned pc, count = 0;
+	*regs = 0;
+	for(pc = 0; pc < fn->size; pc += a2_InsSize(a2_NativeOpcode(fn->code,
+			pc)))
+		switch(a2_NativeOpcode(fn->code, pc))
+		{
+		  case OP_JUMP:
+		  case OP_PUSH:
+		  case OP_PUSH2:
+			++count;
+			break;
+		  default:
+			if(!a2_NativeOp(a2_NativeOpcode(fn->code, pc)))
+				break;
+			++count;
+			*regs = 1;
+			break;
+		}
+	return count;
+}
+
+static A2_errors a2_NativeFunction(FILE *f, A2_function *fn, unsigned id)
+{
+	unsigned pc;
+	int regs;
+	char buf[64];
+	uint8_t *valid;
+	if(!a2_NativeScan(fn, &regs))
+		return A2_OK;	/* Nothing to gain! */
+	if(!(valid = calloc(fn->size, 1)))
+		return A2_OOMEMORY;
+	for(pc = 0; pc < fn->size; pc += a2_InsSize(a2_NativeOpcode(fn->code,
+			pc)))
+		valid[pc] = 1;
+
+	fprintf(f, "static const uint32_t a2n_code%u[] = {", id);
+	for(pc = 0; pc < fn->size; ++pc)
+		fprintf(f, "%s0x%08x,", pc % 6 ? " " : "\n\t", fn->code[pc]);
+	fprintf(f, "\n};\n\n");
+
+	fprintf(f, "static unsigned a2n_func%u(A2_nativecontext *nc, "
+			"unsigned pc)\n{\n", id);
+	if(regs)
+		fprintf(f, "\tint *r = nc->r;\n");
+	fprintf(f, "\tswitch(pc)\n\t{\n");
+	for(pc = 0; pc < fn->size; ++pc)
+		if(valid[pc])
+			fprintf(f, "\t  case %u: goto L%u;\n", pc, pc);
+	fprintf(f, "\t  default: return pc;\n\t}\n");
+
+	for(pc = 0; pc < fn->size; pc += a2_InsSize(a2_NativeOpcode(fn->code,
+			pc)))
+	{
+		A2_instruction *ins = (A2_instruction *)(fn->code + pc);
+		int a1 = ins->a1;
+		int a2 = ins->a2;
+		int target = (int)pc + (int16_t)ins->a2;
+		switch((A2_opcodes)ins->opcode)
+		{
+		  /* Local flow control */
+		  case OP_JUMP:
+			a2_NativeBegin(f, pc, NULL);
+			a2_NativeBranch(f, NULL, target, valid, fn->size);
+			break;
+		  case OP_LOOP:
+			a2_NativeBegin(f, pc, NULL);
+			snprintf(buf, sizeof(buf), "(r[%d] -= 65536) > 0", a1);
+			a2_NativeBranch(f, buf, target, valid, fn->size);
+			break;
+		  case OP_JZ:
+			a2_NativeBegin(f, pc, NULL);
+			snprintf(buf, sizeof(buf), "!r[%d]", a1);
+			a2_NativeBranch(f, buf, target, valid, fn->size);
+			break;
+		  case OP_JNZ:
+			a2_NativeBegin(f, pc, NULL);
+			snprintf(buf, sizeof(buf), "r[%d]", a1);
+			a2_NativeBranch(f, buf, target, valid, fn->size);
+			break;
+		  case OP_JG:
+			a2_NativeBegin(f, pc, NULL);
+			snprintf(buf, sizeof(buf), "r[%d] > 0", a1);
+			a2_NativeBranch(f, buf, target, valid, fn->size);
+			break;
+		  case OP_JL:
+			a2_NativeBegin(f, pc, NULL);
+			snprintf(buf, sizeof(buf), "r[%d] < 0", a1);
+			a2_NativeBranch(f, buf, target, valid, fn->size);
+			break;
+		  case OP_JGE:
+			a2_NativeBegin(f, pc, NULL);
+			snprintf(buf, sizeof(buf), "r[%d] >= 0", a1);
+			a2_NativeBranch(f, buf, target, valid, fn->size);
+			break;
+		  case OP_JLE:
+			a2_NativeBegin(f, pc, NULL);
+			snprintf(buf, sizeof(buf), "r[%d] <= 0", a1);
+			a2_NativeBranch(f, buf, target, valid, fn->size);
+			break;
+
+		  /* Arithmetics */
+		  case OP_SUBR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] -= r[%d];\n", a1, a2);
+			break;
+		  case OP_DIVR:
+			snprintf(buf, sizeof(buf), "!r[%d]", a2);
+			a2_NativeBegin(f, pc, buf);
+			fprintf(f, "\tr[%d] = ((int64_t)r[%d] << 16) / r[%d];\n",
+					a1, a1, a2);
+			break;
+		  case OP_NEGR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = -r[%d];\n", a1, a2);
+			break;
+		  case OP_LOAD:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = ", a1);
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, ";\n");
+			break;
+		  case OP_LOADR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = r[%d];\n", a1, a2);
+			break;
+		  case OP_ADD:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] += ", a1);
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, ";\n");
+			break;
+		  case OP_ADDR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] += r[%d];\n", a1, a2);
+			break;
+		  case OP_MUL:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (int64_t)r[%d] * ", a1, a1);
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, " >> 16;\n");
+			break;
+		  case OP_MULR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (int64_t)r[%d] * r[%d] >> 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_MOD:
+			if(!ins->a3)
+				goto vm;
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] %%= ", a1);
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, ";\n");
+			break;
+		  case OP_MODR:
+			snprintf(buf, sizeof(buf), "!r[%d]", a2);
+			a2_NativeBegin(f, pc, buf);
+			fprintf(f, "\tr[%d] %%= r[%d];\n", a1, a2);
+			break;
+		  case OP_QUANT:
+			if(!ins->a3)
+				goto vm;
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = r[%d] / ", a1, a1);
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, " * ");
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, ";\n");
+			break;
+		  case OP_QUANTR:
+			snprintf(buf, sizeof(buf), "!r[%d]", a2);
+			a2_NativeBegin(f, pc, buf);
+			fprintf(f, "\tr[%d] = r[%d] / r[%d] * r[%d];\n",
+					a1, a1, a2, a2);
+			break;
+
+		  /* Comparison and boolean operators */
+		  case OP_GR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] > r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_LR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] < r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_GER:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] >= r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_LER:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] <= r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_EQR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] == r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_NER:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] != r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_ANDR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] && r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_ORR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] || r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_XORR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (!r[%d] != !r[%d]) << 16;\n",
+					a1, a1, a2);
+			break;
+		  case OP_NOTR:
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (!r[%d]) << 16;\n", a1, a2);
+			break;
+
+		  /* Subvoice arguments */
+		  case OP_PUSH:
+			a2_NativeBegin(f, pc, "(nc->cargc >= A2_MAXARGS)");
+			fprintf(f, "\tnc->cargv[nc->cargc++] = ");
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, ";\n");
+			break;
+		  case OP_PUSHR:
+			a2_NativeBegin(f, pc, "(nc->cargc >= A2_MAXARGS)");
+			fprintf(f, "\tnc->cargv[nc->cargc++] = r[%d];\n", a1);
+			break;
+
+		  /* Superinstructions */
+		  case OP_PUSH2:
+			a2_NativeBegin(f, pc, "(nc->cargc + 2 > A2_MAXARGS)");
+			fprintf(f, "\tnc->cargv[nc->cargc++] = ");
+			a2_NativeInt(f, ins->a3);
+			fprintf(f, ";\n\tnc->cargv[nc->cargc++] = ");
+			a2_NativeInt(f, (int32_t)fn->code[pc + 2]);
+			fprintf(f, ";\n");
+			break;
+		  case OP_GRJZ:
+		  case OP_LRJZ:
+		  case OP_GERJZ:
+		  case OP_LERJZ:
+		  case OP_EQRJZ:
+		  case OP_NERJZ:
+		  {
+			static const char *const cmp[] = {
+				">", "<", ">=", "<=", "==", "!="
+			};
+			a2_NativeBegin(f, pc, NULL);
+			fprintf(f, "\tr[%d] = (r[%d] %s r[%d]) << 16;\n", a1, a1,
+					cmp[ins->opcode - OP_GRJZ], a2);
+			snprintf(buf, sizeof(buf), "!r[%d]", a1);
+			a2_NativeBranch(f, buf, (int)pc + ins->a3, valid,
+					fn->size);
+			break;
+		  }
+
+		  /* Everything else is handled by the VM */
+		  default:
+		  vm:
+			fprintf(f, "  L%u:\treturn %u;\n", pc, pc);
+			break;
+		}
+	}
+	fprintf(f, "\treturn %u;\n}\n\n", fn->size);
+	free(valid);
+	return A2_OK;
+}
+
+
+A2_errors a2_WriteNative(A2_interface *i, A2_handle h, FILE *stream)
+{
+	A2_interface_i *ii = (A2_interface_i *)i;
+	A2_state *st = ii->state;
+	A2_program *p;
+	A2_bank *b = a2_GetBank(st, h);
+	unsigned n = 0, id = 0, count = 0, j;
+	if(!b && !a2_GetProgram(st, h))
+		return A2_WRONGTYPE;
+
+	fprintf(stream, "/*\n * Native code module");
+	if(b)
+		fprintf(stream, " for \"%s\"", b->name);
+	fprintf(stream, "\n *\n * Generated by Audiality 2 - do not edit!\n"
+			" */\n\n#include \"a2_vm.h\"\n\n");
+
+	while((p = a2_NativeProgram(st, h, &n)))
+		for(j = 0; j < p->nfuncs; ++j)
+		{
+			A2_errors res = a2_NativeFunction(stream, p->funcs + j,
+					id++);
+			if(res)
+				return res;
+		}
+
+	/* Functions without native code are left out, but still numbered */
+	fprintf(stream, "static const A2_nativeentry a2n_entries[] = {\n");
+	for(id = 0, n = 0; (p = a2_NativeProgram(st, h, &n)); )
+		for(j = 0; j < p->nfuncs; ++j, ++id)
+		{
+			int regs;
+			if(!a2_NativeScan(p->funcs + j, &regs))
+				continue;
+			fprintf(stream, "\t{ a2n_code%u, %u, a2n_func%u },\n",
+					id, p->funcs[j].size, id);
+			++count;
+		}
+	fprintf(stream, "\t{ NULL, 0, NULL }\n};\n\n");
+
+	fprintf(stream, "const A2_nativemodule %s = {\n", A2_NATIVESYMBOL);
+	fprintf(stream, "\t%d,\t/* A2_NATIVEVERSION */\n", A2_NATIVEVERSION);
+	fprintf(stream, "\t%d,\t/* Number of VM opcodes */\n", A2_OPCODES);
+	fprintf(stream, "\t%u,\n\ta2n_entries\n};\n", count);
+	if(ferror(stream))
+		return A2_WRITE;
+	return A2_OK;
+}
+
+
+/*---------------------------------------------------------
+	Loading
+---------------------------------------------------------*/
+
+#ifdef A2_HAVE_DLOPEN
+/* Check if native code generated from 'ncode' is valid for 'fn' */
+static int a2_NativeMatch(const uint32_t *ncode, unsigned nsize,
+		A2_function *fn)
+{
+	unsigned pc, j;
+	if(nsize != fn->size)
+		return 0;
+	for(pc = 0; pc < fn->size; pc += j)
+	{
+		A2_opcodes op = a2_NativeOpcode(fn->code, pc);
+		if(a2_NativeOpcode(ncode, pc) != op)
+			return 0;
+		j = a2_InsSize(op);
+		if(pc + j > fn->size)
+			return 0;
+		if(a2_NativeOp(op) && memcmp(ncode + pc, fn->code + pc,
+				j * sizeof(uint32_t)))
+			return 0;
+	}
+	return 1;
+}
+#endif
+
+A2_errors a2_LoadNative(A2_state *st, A2_handle bank, const char *fn)
+{
+#ifdef A2_HAVE_DLOPEN
+	A2_interface *i = &st->interfaces->interface;
+	const A2_nativemodule *m;
+	A2_nativelib *nl;
+	A2_program *p;
+	unsigned n = 0, matched = 0;
+	const char *ext = strrchr(fn, '.');
+	const char *slash = strrchr(fn, '/');
+	char *path;
+	void *handle;
+
+	/* "<path>/<name>.a2s" ==> "<path>/<name>.a2n" */
+	if(!ext || (slash && (ext < slash)))
+		ext = fn + strlen(fn);
+	if(!(path = malloc(2 + (ext - fn) + 4 + 1)))
+		return A2_OOMEMORY;
+	strcpy(path, slash ? "" : "./");
+	strncat(path, fn, ext - fn);
+	strcat(path, ".a2n");
+
+	if(!(handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)))
+	{
+		free(path);
+		return A2_NOTFOUND;	/* No native code - not an error! */
+	}
+	m = (const A2_nativemodule *)dlsym(handle, A2_NATIVESYMBOL);
+	if(!m || (m->version != A2_NATIVEVERSION) ||
+			(m->opcodes != A2_OPCODES))
+	{
+		A2_LOG_WARN(i, "Native code module \"%s\" does not match this "
+				"engine version!", path);
+		dlclose(handle);
+		free(path);
+		return A2_WRONGFORMAT;
+	}
+
+	/* Attach native functions where the VM code matches exactly */
+	while((p = a2_NativeProgram(st, bank, &n)))
+	{
+		unsigned j, k;
+		for(j = 0; j < p->nfuncs; ++j)
+		{
+			A2_function *f = p->funcs + j;
+			for(k = 0; k < m->nentries; ++k)
+			{
+				const A2_nativeentry *e = m->entries + k;
+				if(!a2_NativeMatch(e->code, e->size, f))
+					continue;
+				f->native = e->func;
+				p->native = 1;
+				++matched;
+				break;
+			}
+		}
+	}
+	if(!matched)
+	{
+		if(m->nentries)
+			A2_LOG_WARN(i, "Native code module \"%s\" is out of "
+					"date!", path);
+		dlclose(handle);
+		free(path);
+		return A2_NOTFOUND;
+	}
+	free(path);
+
+	if(!(nl = malloc(sizeof(A2_nativelib))))
+	{
+		/* Can't keep track of it, so we can't use it either! */
+		n = 0;
+		while((p = a2_NativeProgram(st, bank, &n)))
+		{
+			unsigned j;
+			for(j = 0; j < p->nfuncs; ++j)
+				p->funcs[j].native = NULL;
+			p->native = 0;
+		}
+		dlclose(handle);
+		return A2_OOMEMORY;
+	}
+	nl->handle = handle;
+	nl->next = st->ss->nativelibs;
+	st->ss->nativelibs = nl;
+	return A2_OK;
+#else
+	return A2_NOTIMPLEMENTED;
+#endif
+}
+
+
+void a2_CloseNative(A2_sharedstate *ss)
+{
+	while(ss->nativelibs)
+	{
+		A2_nativelib *nl = ss->nativelibs;
+		ss->nativelibs = nl->next;
+#ifdef A2_HAVE_DLOPEN
+		dlclose(nl->handle);
+#endif
+		free(nl);
+	}
+}
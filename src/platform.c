@@ -21,6 +21,9 @@
  */
 
 #include <stdlib.h>
+#ifndef _WIN32
+# include <unistd.h>
+#endif
 #include "platform.h"
 
 #ifdef _WIN32
@@ -41,6 +44,66 @@ char *strndup(const char *s, size_t size)
 #endif
 
 
+/*---------------------------------------------------------
+	Threads
+---------------------------------------------------------*/
+
+#ifdef _WIN32
+static DWORD WINAPI a2_thread_entry(LPVOID data)
+{
+	A2_thread *t = (A2_thread *)data;
+	t->func(t->userdata);
+	return 0;
+}
+#else
+static void *a2_thread_entry(void *data)
+{
+	A2_thread *t = (A2_thread *)data;
+	t->func(t->userdata);
+	return NULL;
+}
+#endif
+
+
+A2_errors a2_ThreadStart(A2_thread *t, A2_threadfunc func, void *userdata)
+{
+	t->func = func;
+	t->userdata = userdata;
+#ifdef _WIN32
+	if(!(t->thread = CreateThread(NULL, 0, a2_thread_entry, t, 0, NULL)))
+		return A2_DEVICEOPEN;
+#else
+	if(pthread_create(&t->thread, NULL, a2_thread_entry, t))
+		return A2_DEVICEOPEN;
+#endif
+	return A2_OK;
+}
+
+
+void a2_ThreadJoin(A2_thread *t)
+{
+#ifdef _WIN32
+	WaitForSingleObject(t->thread, INFINITE);
+	CloseHandle(t->thread);
+#else
+	pthread_join(t->thread, NULL);
+#endif
+}
+
+
+unsigned a2_CPUCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+#endif
+}
+
+
 /*---------------------------------------------------------
 	Timing
 ---------------------------------------------------------*/
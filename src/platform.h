@@ -23,6 +23,7 @@
 #ifndef A2_PLATFORM_H
 #define A2_PLATFORM_H
 
+#include <stdlib.h>
 #include "audiality2.h"
 
 #ifdef _WIN32
@@ -34,14 +35,19 @@
 # define STRICT
 # include <windows.h>
 # include <mmsystem.h>
+# include <malloc.h>
 #elif defined(__MACOSX__)
 # include <libkern/OSAtomic.h>
+# include <dispatch/dispatch.h>
 # include <sched.h>
+# include <pthread.h>
+# include <errno.h>
 #else
 # include <sched.h>
 # include <sys/time.h>
 # include <sys/wait.h>
 # include <pthread.h>
+# include <semaphore.h>
 # include <errno.h>
 #endif
 
@@ -50,6 +56,37 @@ char *strndup(const char *s, size_t size);
 #endif
 
 
+/*---------------------------------------------------------
+	Aligned memory allocation
+---------------------------------------------------------*/
+
+/*
+ * Allocate 'size' bytes, aligned to 'align' bytes, which must be a power of
+ * two, and a multiple of sizeof(void *). Returns NULL on failure. Memory from
+ * a2_AlignedAlloc() must be released with a2_AlignedFree()!
+ */
+static inline void *a2_AlignedAlloc(size_t size, size_t align)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, align);
+#else
+	void *p;
+	if(posix_memalign(&p, align, size))
+		return NULL;
+	return p;
+#endif
+}
+
+static inline void a2_AlignedFree(void *p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+
 /*---------------------------------------------------------
 	Atomics
 ---------------------------------------------------------*/
@@ -165,6 +202,136 @@ static inline void a2_MutexClose(A2_mutex *mtx)
 #endif	/* _WIN32 */
 
 
+/*---------------------------------------------------------
+	Semaphore
+---------------------------------------------------------*/
+
+/*
+ * NOTE: a2_SemPost() never blocks, and is safe to use in realtime contexts, as
+ *       long as no higher priority thread is waiting on the semaphore.
+ */
+typedef struct A2_sem
+{
+#ifdef _WIN32
+	HANDLE			sem;
+#elif defined(__MACOSX__)
+	dispatch_semaphore_t	sem;
+#else
+	sem_t			sem;
+#endif
+} A2_sem;
+
+
+/*
+ * WIN32 implementation
+ */
+#ifdef _WIN32
+static inline A2_errors a2_SemOpen(A2_sem *sem)
+{
+	if(!(sem->sem = CreateSemaphore(NULL, 0, 0x7fffffff, NULL)))
+		return A2_DEVICEOPEN;
+	return A2_OK;
+}
+
+static inline void a2_SemWait(A2_sem *sem)
+{
+	WaitForSingleObject(sem->sem, INFINITE);
+}
+
+static inline void a2_SemPost(A2_sem *sem)
+{
+	ReleaseSemaphore(sem->sem, 1, NULL);
+}
+
+static inline void a2_SemClose(A2_sem *sem)
+{
+	CloseHandle(sem->sem);
+}
+
+
+/*
+ * Mac OS X implementation (no unnamed POSIX semaphores there)
+ */
+#elif defined(__MACOSX__)
+static inline A2_errors a2_SemOpen(A2_sem *sem)
+{
+	if(!(sem->sem = dispatch_semaphore_create(0)))
+		return A2_DEVICEOPEN;
+	return A2_OK;
+}
+
+static inline void a2_SemWait(A2_sem *sem)
+{
+	dispatch_semaphore_wait(sem->sem, DISPATCH_TIME_FOREVER);
+}
+
+static inline void a2_SemPost(A2_sem *sem)
+{
+	dispatch_semaphore_signal(sem->sem);
+}
+
+static inline void a2_SemClose(A2_sem *sem)
+{
+	dispatch_release(sem->sem);
+}
+
+
+/*
+ * POSIX implementation
+ */
+#else
+static inline A2_errors a2_SemOpen(A2_sem *sem)
+{
+	if(sem_init(&sem->sem, 0, 0))
+		return A2_DEVICEOPEN;
+	return A2_OK;
+}
+
+static inline void a2_SemWait(A2_sem *sem)
+{
+	while(sem_wait(&sem->sem) && (errno == EINTR))
+		;
+}
+
+static inline void a2_SemPost(A2_sem *sem)
+{
+	sem_post(&sem->sem);
+}
+
+static inline void a2_SemClose(A2_sem *sem)
+{
+	sem_destroy(&sem->sem);
+}
+#endif
+
+
+/*---------------------------------------------------------
+	Threads
+---------------------------------------------------------*/
+
+typedef void (*A2_threadfunc)(void *userdata);
+
+typedef struct A2_thread
+{
+#ifdef _WIN32
+	HANDLE			thread;
+#else
+	pthread_t		thread;
+#endif
+	A2_threadfunc		func;
+	void			*userdata;
+} A2_thread;
+
+/* Start a thread running 'func(userdata)' */
+A2_errors a2_ThreadStart(A2_thread *t, A2_threadfunc func, void *userdata);
+
+/* Wait for thread 't' to terminate */
+void a2_ThreadJoin(A2_thread *t);
+
+/* Number of CPU cores available */
+unsigned a2_CPUCount(void);
+
+
 /*---------------------------------------------------------
 	CPU yield
 ---------------------------------------------------------*/
@@ -59,6 +59,12 @@ A2_errors a2_GetStateProperty(A2_interface *i, A2_properties p, int *v)
 	  case A2_POFFLINEBUFFER:
 		*v = st->ss->offlinebuffer;
 		return A2_OK;
+	  case A2_POFFLINETHREADS:
+		*v = st->ss->offlinethreads;
+		return A2_OK;
+	  case A2_PWARMVOICES:
+		*v = st->ss->warmvoices;
+		return A2_OK;
 	  case A2_PSILENCELEVEL:
 		*v = st->ss->silencelevel;
 		return A2_OK;
@@ -71,6 +77,9 @@ A2_errors a2_GetStateProperty(A2_interface *i, A2_properties p, int *v)
 	  case A2_PLOGLEVELS:
 		*v = ii->loglevels;
 		return A2_OK;
+	  case A2_PWORKERS:
+		*v = st->config->workers;
+		return A2_OK;
 
 	/*
 	 * FIXME:
@@ -250,6 +259,15 @@ A2_errors a2_GetProperty(A2_interface *i, A2_handle h, A2_properties p, int *v)
 		*v = a2_Space(i, h);
 		return A2_OK;
 
+	  case A2_PNATIVE:
+	  {
+		A2_program *prg = a2_GetProgram(st, h);
+		if(!prg)
+			return A2_WRONGTYPE;
+		*v = prg->native;
+		return A2_OK;
+	  }
+
 	  default:
 		return A2_NOTFOUND;
 	}
@@ -282,6 +300,16 @@ A2_errors a2_SetStateProperty(A2_interface *i, A2_properties p, int v)
 	  case A2_POFFLINEBUFFER:
 		st->ss->offlinebuffer = v;
 		return A2_OK;
+	  case A2_POFFLINETHREADS:
+		st->ss->offlinethreads = v;
+		return A2_OK;
+	  case A2_PWARMVOICES:
+		if(v < 0)
+			v = 0;
+		else if(v > A2_MAXWARM)
+			v = A2_MAXWARM;
+		st->ss->warmvoices = v;
+		return A2_OK;
 	  case A2_PSILENCELEVEL:
 		st->ss->silencelevel = v;
 		return A2_OK;
@@ -300,6 +328,8 @@ A2_errors a2_SetStateProperty(A2_interface *i, A2_properties p, int v)
 	  case A2_PLOGLEVELS:
 		ii->loglevels = v;
 		return A2_OK;
+	  case A2_PWORKERS:
+		return A2_READONLY;
 
 	  /* A2_PSTATISTICS */
 	  case A2_PACTIVEVOICES:
@@ -356,6 +386,15 @@ A2_errors a2_SetProperty(A2_interface *i, A2_handle h, A2_properties p, int v)
 	  case A2_PPOSITION:
 		return a2_SetPosition(i, h, v);
 
+	  case A2_PNATIVE:
+	  {
+		A2_program *prg = a2_GetProgram(st, h);
+		if(!prg)
+			return A2_WRONGTYPE;
+		prg->native = (v != 0);
+		return A2_OK;
+	  }
+
 	  default:
 		return A2_NOTFOUND;
 	}
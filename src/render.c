@@ -20,7 +20,87 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
-#include "audiality2.h"
+#include <stdlib.h>
+#include "internals.h"
+
+/*
+ * Open an off-line substate for rendering. Substate setup and cleanup touch
+ * the parent state, and objects shared with other substates, so callers must
+ * hold the 'offlinemtx' lock of the shared state.
+ */
+static A2_errors a2_open_offline(A2_interface *i, unsigned samplerate,
+		A2_property *props, A2_interface **ssi, A2_driver **drv,
+		A2_config **cfg)
+{
+	int offlinebuffer;
+	a2_GetStateProperty(i, A2_POFFLINEBUFFER, &offlinebuffer);
+	if(!(*drv = a2_NewDriver(A2_AUDIODRIVER, "buffer")))
+		return a2_LastError();
+	if(!(*cfg = a2_OpenConfig(samplerate, offlinebuffer, 1, A2_AUTOCLOSE)))
+		return a2_LastError();
+	if(a2_AddDriver(*cfg, *drv))
+		return a2_LastError();
+	if(!(*ssi = a2_SubState(i, *cfg)))
+		return a2_LastError();
+
+	/* Parse the property table, if one was provided */
+	if(props)
+		a2_SetStateProperties(*ssi, props);
+	return A2_OK;
+}
+
+static void a2_close_offline(A2_sharedstate *ss, A2_interface *ssi)
+{
+	a2_MutexLock(&ss->offlinemtx);
+	a2_Close(ssi);
+	a2_MutexUnlock(&ss->offlinemtx);
+}
+
+
+/* Open off-line substate for rendering, and start 'program' in it */
+static A2_handle a2_render_start(A2_interface *i, unsigned samplerate,
+		A2_property *props, A2_handle program, unsigned argc,
+		int *argv, A2_interface **ssi, A2_driver **drv,
+		A2_config **cfg)
+{
+	A2_sharedstate *ss = ((A2_interface_i *)i)->state->ss;
+	A2_errors res;
+	A2_handle h = -1;
+	a2_MutexLock(&ss->offlinemtx);
+	if(!(res = a2_open_offline(i, samplerate, props, ssi, drv, cfg)))
+		if((h = a2_Starta(*ssi, a2_RootVoice(*ssi), program,
+				argc, argv)) < 0)
+			a2_Close(*ssi);
+	a2_MutexUnlock(&ss->offlinemtx);
+	if(res)
+		return -res;
+	return h;
+}
+
+
+/* Stop the program 'h' and close the substate. Returns any realtime error. */
+static A2_errors a2_render_stop(A2_interface *i, A2_interface *ssi,
+		A2_handle h)
+{
+	A2_errors res = a2_LastRTError(ssi);
+	a2_TimestampReset(ssi);
+	a2_Send(ssi, h, 1);
+	a2_Release(ssi, h);
+	a2_close_offline(((A2_interface_i *)i)->state->ss, ssi);
+	return res;
+}
+
+
+/* Check if rendering is done, after 'frames' frames */
+static int a2_render_done(unsigned frames, unsigned length, unsigned lastpeak,
+		int silencewindow, int silencegrace)
+{
+	if(length)
+		return frames >= length;
+	else
+		return (frames >= silencegrace) && (lastpeak >= silencewindow);
+}
+
 
 /*
  * Run 'program' off-line with the specified arguments, rendering at
@@ -43,29 +123,14 @@ int a2_Render(A2_interface *i,
 	A2_interface *ssi;
 	int frames = 0;
 	unsigned lastpeak = 0; /* Frames since last peak > abs(silencelevel) */
-	int offlinebuffer, silencelevel, silencewindow, silencegrace;
+	int silencelevel, silencewindow, silencegrace;
 
-	a2_GetStateProperty(i, A2_POFFLINEBUFFER, &offlinebuffer);
 	a2_GetStateProperty(i, A2_PSILENCELEVEL, &silencelevel);
 	a2_GetStateProperty(i, A2_PSILENCEWINDOW, &silencewindow);
 	a2_GetStateProperty(i, A2_PSILENCEGRACE, &silencegrace);
 
-	/* Open off-line substate for rendering */
-	if(!(drv = a2_NewDriver(A2_AUDIODRIVER, "buffer")))
-		return -a2_LastError();
-	if(!(cfg = a2_OpenConfig(samplerate, offlinebuffer, 1, A2_AUTOCLOSE)))
-		return -a2_LastError();
-	if(drv && a2_AddDriver(cfg, drv))
-		return -a2_LastError();
-	if(!(ssi = a2_SubState(i, cfg)))
-		return -a2_LastError();
-
-	/* Parse the property table, if one was provided */
-	if(props)
-		a2_SetStateProperties(ssi, props);
-
-	/* Start program! */
-	if((h = a2_Starta(ssi, a2_RootVoice(ssi), program, argc, argv)) < 0)
+	if((h = a2_render_start(i, samplerate, props, program, argc, argv,
+			&ssi, &drv, &cfg)) < 0)
 		return h;
 
 	/* Render... */
@@ -80,7 +145,7 @@ int a2_Render(A2_interface *i,
 			break;
 		if((res = a2_Run(ssi, frag)) < 0)
 		{
-			a2_Close(ssi);
+			a2_render_stop(i, ssi, h);
 			return res;
 		}
 		if(!length)
@@ -94,36 +159,334 @@ int a2_Render(A2_interface *i,
 		if((res = a2_Write(i, stream, A2_I24, buf,
 				frag * sizeof(int32_t))))
 		{
-			a2_Close(ssi);
+			a2_render_stop(i, ssi, h);
 			return -res;
 		}
 		frames += frag;
-		if(length)
+		if(a2_render_done(frames, length, lastpeak, silencewindow,
+				silencegrace))
+			break;
+	}
+
+	if((res = a2_render_stop(i, ssi, h)))
+		return -res;
+	else
+		return frames;
+}
+
+
+/*
+ * Like a2_Render(), but having the substate write 16 bit data directly into a
+ * new level 0 buffer for the unprepared wave 'w', which is then prepared via
+ * a2_PrepareWave(), bypassing the stream API. This avoids the intermediate
+ * buffers and extra conversion passes.
+ */
+static int a2_render_direct(A2_interface *i, A2_wave *w,
+		unsigned samplerate, unsigned length, A2_property *props,
+		A2_handle program, unsigned argc, int *argv)
+{
+	int res;
+	A2_handle h;
+	A2_driver *drv;
+	A2_config *cfg;
+	A2_interface *ssi;
+	A2_state *sst;
+	int16_t *buf;
+	unsigned size;
+	unsigned frames = 0;
+	int silencelevel, silencewindow, silencegrace;
+
+	a2_GetStateProperty(i, A2_PSILENCELEVEL, &silencelevel);
+	a2_GetStateProperty(i, A2_PSILENCEWINDOW, &silencewindow);
+	a2_GetStateProperty(i, A2_PSILENCEGRACE, &silencegrace);
+
+	/* If we don't know the length, start with one second, and grow. */
+	size = length ? length : samplerate;
+	if(!(buf = (int16_t *)malloc((A2_WAVEPRE + size + A2_WAVEPOST) *
+			sizeof(int16_t))))
+		return -A2_OOMEMORY;
+
+	if((h = a2_render_start(i, samplerate, props, program, argc, argv,
+			&ssi, &drv, &cfg)) < 0)
+	{
+		free(buf);
+		return h;
+	}
+	sst = ((A2_interface_i *)ssi)->state;
+	sst->silencelevel = silencelevel;
+	sst->lastpeak = 0;
+
+	/* Render... */
+	while(1)
+	{
+		unsigned frag = cfg->buffer;
+		if(length && (frag > length - frames))
+			frag = length - frames;
+		if(!frag)
+			break;
+		if(frames + frag > size)
 		{
-			if(frames >= length)
-				break;
+			int16_t *nbuf;
+			size *= 2;
+			if(!(nbuf = (int16_t *)realloc(buf, (A2_WAVEPRE +
+					size + A2_WAVEPOST) * sizeof(int16_t))))
+			{
+				a2_render_stop(i, ssi, h);
+				free(buf);
+				return -A2_OOMEMORY;
+			}
+			buf = nbuf;
 		}
-		else
+		sst->renderout = buf + A2_WAVEPRE + frames;
+		if((res = a2_Run(ssi, frag)) < 0)
 		{
-			if((frames >= silencegrace) &&
-					(lastpeak >= silencewindow))
-				break;
+			a2_render_stop(i, ssi, h);
+			free(buf);
+			return res;
 		}
+		frames += frag;
+		if(a2_render_done(frames, length, sst->lastpeak,
+				silencewindow, silencegrace))
+			break;
 	}
+	sst->renderout = NULL;
 
-	res = a2_LastRTError(ssi);
+	if((res = a2_render_stop(i, ssi, h)))
+	{
+		free(buf);
+		return -res;
+	}
 
-	a2_TimestampReset(ssi);
-	a2_Send(ssi, h, 1);
-	a2_Release(ssi, h);
+	/* Trim, if we grew the buffer */
+	if(frames < size)
+	{
+		int16_t *nbuf = (int16_t *)realloc(buf, (A2_WAVEPRE + frames +
+				A2_WAVEPOST) * sizeof(int16_t));
+		if(nbuf)
+			buf = nbuf;
+	}
+	if((res = a2_PrepareWave(w, buf, frames)))
+		return -res;
+	return frames;
+}
 
-	/* Close substate */
-	a2_Close(ssi);
 
-	if(res)
+/*---------------------------------------------------------
+	Wave rendering
+---------------------------------------------------------*/
+
+/* Render state of an A2_renderjob */
+typedef struct A2_jobstate
+{
+	A2_handletab	refs;		/* Objects used by the job */
+	A2_handle	stream;		/* Stream to the wave, while rendering */
+	A2_wave		*wave;		/* Target, when rendering directly */
+	uint64_t	key;		/* Render cache key */
+	int		cached;		/* Use the render cache */
+	int		done;		/* Rendered, loaded from cache, or failed */
+} A2_jobstate;
+
+typedef struct A2_renderbatch
+{
+	A2_interface	*interface;
+	A2_renderjob	*jobs;
+	A2_jobstate	*js;
+	unsigned	*run;		/* Jobs to render in the current pass */
+} A2_renderbatch;
+
+typedef struct A2_refscan
+{
+	A2_state	*state;
+	A2_handletab	*refs;
+} A2_refscan;
+
+
+/*
+ * a2_TranslateHandles() callback that adds 'h', and everything used by 'h',
+ * to the handle table of 'userdata'.
+ */
+static int a2_render_ref(void *userdata, A2_handle h)
+{
+	A2_refscan *rs = (A2_refscan *)userdata;
+	A2_program *p;
+	unsigned j;
+	int res;
+	if(a2ht_FindItem(rs->refs, h) >= 0)
+		return h;
+	if((res = a2ht_AddItem(rs->refs, h)) < 0)
+		return res;
+	if(!(p = a2_GetProgram(rs->state, h)))
+		return h;
+	for(j = 0; j < p->nfuncs; ++j)
+		if((res = a2_TranslateHandles(p, j, p->funcs[j].code,
+				p->funcs[j].argdefs, a2_render_ref, rs)))
+			return -res;
+	return h;
+}
+
+
+static A2_errors a2_render_scan(A2_state *st, A2_renderjob *j,
+		A2_jobstate *js)
+{
+	A2_refscan rs;
+	unsigned k;
+	int res;
+	rs.state = st;
+	rs.refs = &js->refs;
+	if((res = a2_render_ref(&rs, j->program)) < 0)
 		return -res;
+
+	/* Anything that looks like a handle might be one! */
+	for(k = 0; k < j->argc; ++k)
+		if(!(j->argv[k] & 0xffff) && (j->argv[k] > 0))
+			if((res = a2_render_ref(&rs, j->argv[k] >> 16)) < 0)
+				return -res;
+	return A2_OK;
+}
+
+
+/*
+ * Load the wave from the render cache, or set up for rendering into it;
+ * directly if possible, otherwise via a stream. Returns 1 if the job is to be
+ * rendered.
+ */
+static int a2_render_begin(A2_interface *i, A2_renderjob *j, A2_jobstate *js)
+{
+	uint64_t t = a2_GetMicros();
+	A2_wave *w = a2_GetWave(i, j->wave);
+	int res = 0;
+	js->cached = (a2_WaveCacheKey(i, j, &js->key) == A2_OK);
+	if(js->cached && (a2_WaveCacheLoad(i, js->key, j->wave) == A2_OK))
+		j->result = w->d.wave.size[0];
+	else if(w && !(w->flags & A2_NORMALIZE))
+	{
+		js->wave = w;
+		res = 1;
+	}
+	else if((js->stream = a2_OpenStream(i, j->wave, 0, 0, 0)) < 0)
+		j->result = js->stream;
 	else
-		return frames;
+		res = 1;
+	j->rendertime += a2_GetMicros() - t;
+	return res;
+}
+
+
+/* Worker callback */
+static void a2_render_job(void *userdata, unsigned item)
+{
+	A2_renderbatch *rb = (A2_renderbatch *)userdata;
+	unsigned k = rb->run[item];
+	A2_renderjob *j = rb->jobs + k;
+	uint64_t t = a2_GetMicros();
+	if(rb->js[k].wave)
+		j->result = a2_render_direct(rb->interface, rb->js[k].wave,
+				j->samplerate, j->length, j->props,
+				j->program, j->argc, j->argv);
+	else
+		j->result = a2_Render(rb->interface, rb->js[k].stream,
+				j->samplerate, j->length, j->props,
+				j->program, j->argc, j->argv);
+	j->rendertime += a2_GetMicros() - t;
+}
+
+
+/* Close the stream, preparing the wave, and add it to the render cache */
+static void a2_render_end(A2_interface *i, A2_renderjob *j, A2_jobstate *js)
+{
+	A2_errors res;
+	uint64_t t = a2_GetMicros();
+	if(!js->wave && (res = a2_Release(i, js->stream)) &&
+			(j->result >= 0))
+		j->result = -res;
+	j->rendertime += a2_GetMicros() - t;
+	if((j->result >= 0) && js->cached &&
+			(res = a2_WaveCacheStore(i, js->key, j->wave)))
+		A2_LOG_WARN(i, "Could not write wave render cache file; %s",
+				a2_ErrorString(res));
+}
+
+
+A2_errors a2_RenderWaveJobs(A2_interface *i, A2_renderjob *jobs,
+		unsigned njobs)
+{
+	A2_state *st = ((A2_interface_i *)i)->state;
+	A2_renderbatch rb;
+	A2_workers *wk = NULL;
+	A2_errors res = A2_OK;
+	unsigned k, m, nrun, left;
+	unsigned threads = st->ss->offlinethreads;
+	rb.interface = i;
+	rb.jobs = jobs;
+	rb.js = (A2_jobstate *)calloc(njobs, sizeof(A2_jobstate));
+	rb.run = (unsigned *)malloc(njobs * sizeof(unsigned));
+	if(!rb.js || !rb.run)
+	{
+		free(rb.js);
+		free(rb.run);
+		return A2_OOMEMORY;
+	}
+
+	/* Find out which jobs need the waves of other jobs */
+	for(k = 0; (k < njobs) && !res; ++k)
+	{
+		jobs[k].result = 0;
+		jobs[k].rendertime = 0;
+		res = a2_render_scan(st, jobs + k, rb.js + k);
+	}
+
+	/* One thread per core, unless told otherwise */
+	if(!threads)
+		threads = a2_CPUCount();
+	if(threads > njobs)
+		threads = njobs;
+	if(!res && (threads > 1))
+		wk = a2_OpenWorkers(threads - 1); /* If this fails, we run serially */
+
+	for(left = njobs; left && !res; left -= nrun)
+	{
+		/* Pick the jobs that don't need waves that are not done yet */
+		for(nrun = k = 0; k < njobs; ++k)
+		{
+			if(rb.js[k].done)
+				continue;
+			for(m = 0; m < njobs; ++m)
+				if((m != k) && !rb.js[m].done &&
+						(a2ht_FindItem(&rb.js[k].refs,
+						jobs[m].wave) >= 0))
+					break;
+			if(m == njobs)
+				rb.run[nrun++] = k;
+		}
+
+		/* Circular dependencies! Just go ahead with what's left. */
+		if(!nrun)
+			for(k = 0; k < njobs; ++k)
+				if(!rb.js[k].done)
+					rb.run[nrun++] = k;
+
+		/* Cache lookups and streams are dealt with here; API side */
+		for(m = k = 0; k < nrun; ++k)
+		{
+			unsigned x = rb.run[k];
+			rb.js[x].done = 1;
+			if(a2_render_begin(i, jobs + x, rb.js + x))
+				rb.run[m++] = x;
+		}
+
+		a2_RunWorkers(wk, a2_render_job, &rb, m);
+
+		for(k = 0; k < m; ++k)
+			a2_render_end(i, jobs + rb.run[k], rb.js + rb.run[k]);
+	}
+
+	if(wk)
+		a2_CloseWorkers(wk);
+	for(k = 0; k < njobs; ++k)
+		a2ht_Cleanup(&rb.js[k].refs);
+	free(rb.js);
+	free(rb.run);
+	return res;
 }
 
 
@@ -141,37 +504,83 @@ int a2_Render(A2_interface *i,
  *
  * Returns the handle of the rendered wave, or a negated A2_errors error code.
  */
-A2_handle a2_RenderWave(A2_interface *i,
-		A2_wavetypes wt, unsigned period, int flags,
-		unsigned samplerate, unsigned length, A2_property *props,
-		A2_handle program, unsigned argc, int *argv)
+A2_errors a2_RenderWaves(A2_interface *i, A2_waverender *jobs, unsigned njobs)
 {
-	int res;
-	A2_handle wh, sh;
-	if(!period)
-		period = samplerate / A2_MIDDLEC;
-	if((wh = a2_NewWave(i, wt, period, flags)) < 0)
-		return wh;
-	if((sh = a2_OpenStream(i, wh, 0, 0, 0)) < 0)
-	{
-		a2_Release(i, wh);
-		return sh;
-	}
+	A2_renderjob *rj;
+	A2_errors res = A2_OK;
+	unsigned k, nwaves;
+	if(!njobs)
+		return A2_OK;
+	for(k = 0; k < njobs; ++k)
+		if(jobs[k].argc > A2_MAXARGS)
+			return A2_MANYARGS;
+	if(!(rj = (A2_renderjob *)calloc(njobs, sizeof(A2_renderjob))))
+		return A2_OOMEMORY;
 
-	res = a2_Render(i, sh, samplerate, length, props,
-			program, argc, argv);
-	if(res < 0)
+	for(nwaves = 0; nwaves < njobs; ++nwaves)
 	{
-		a2_Release(i, sh);
-		a2_Release(i, wh);
-		return res;
+		A2_waverender *w = jobs + nwaves;
+		A2_renderjob *j = rj + nwaves;
+		unsigned period = w->period;
+		if(!period)
+			period = w->samplerate / A2_MIDDLEC;
+		if((j->wave = a2_NewWave(i, w->type, period, w->flags)) < 0)
+		{
+			res = -j->wave;
+			break;
+		}
+		j->samplerate = w->samplerate;
+		j->length = w->length;
+		j->props = w->props;
+		j->program = w->program;
+		j->argc = w->argc;
+		if(w->argc)
+			memcpy(j->argv, w->argv, w->argc * sizeof(int));
 	}
 
-	if((res = a2_Release(i, sh)))
+	if(!res)
+		res = a2_RenderWaveJobs(i, rj, njobs);
+
+	for(k = 0; k < njobs; ++k)
 	{
-		a2_Release(i, wh);
-		return -res;
+		A2_waverender *w = jobs + k;
+		A2_renderjob *j = rj + k;
+		if(res || (j->result < 0))
+		{
+			if(k < nwaves)
+				a2_Release(i, j->wave);
+			w->wave = res ? -res : j->result;
+			w->frames = 0;
+		}
+		else
+		{
+			w->wave = j->wave;
+			w->frames = j->result;
+		}
+		w->rendertime = j->rendertime;
 	}
+	free(rj);
+	return res;
+}
+
 
-	return wh;
+A2_handle a2_RenderWave(A2_interface *i,
+		A2_wavetypes wt, unsigned period, int flags,
+		unsigned samplerate, unsigned length, A2_property *props,
+		A2_handle program, unsigned argc, int *argv)
+{
+	A2_errors res;
+	A2_waverender job;
+	job.type = wt;
+	job.period = period;
+	job.flags = flags;
+	job.samplerate = samplerate;
+	job.length = length;
+	job.props = props;
+	job.program = program;
+	job.argc = argc;
+	job.argv = argv;
+	if((res = a2_RenderWaves(i, &job, 1)))
+		return -res;
+	return job.wave;
 }
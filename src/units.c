@@ -111,12 +111,11 @@ A2_handle a2_RegisterUnit(A2_interface *i, const A2_unitdesc *ud)
 			return -A2_IODONTMATCH;
 		}
 	}
-	if(ud->instancesize > sizeof(A2_block))
+	if(ud->instancesize > A2_BLOCK_SIZE)
 	{
 		A2_LOG_ERR(i, "Unit '%s' instance struct (%d bytes) is too "
 				"large! Max supported size: %d bytes",
-				ud->name, ud->instancesize,
-				(int)sizeof(A2_block));
+				ud->name, ud->instancesize, A2_BLOCK_SIZE);
 		return -A2_OOMEMORY;
 	}
 
@@ -163,8 +163,8 @@ static void dc_Process2Add(A2_unit *u, unsigned offset, unsigned frames)
 }
 
 
-static A2_errors dc_Initialize(A2_unit *u, A2_vmstate *vms,
-		void *statedata, unsigned flags)
+static A2_errors dc_Reset(A2_unit *u, A2_vmstate *vms, void *statedata,
+		unsigned flags)
 {
 	A2_dc *dc = dc_cast(u);
 	int *ur = u->registers;
@@ -176,7 +176,13 @@ static A2_errors dc_Initialize(A2_unit *u, A2_vmstate *vms,
 	/* Initialize VM registers */
 	ur[A2DCR_VALUE] = 0;
 	ur[A2DCR_MODE] = A2DCRM_LINEAR << 16;
+	return A2_OK;
+}
+
 
+static A2_errors dc_Initialize(A2_unit *u, A2_vmstate *vms,
+		void *statedata, unsigned flags)
+{
 	/* Install Process callback */
 	if(flags & A2_PROCADD)
 		switch(u->noutputs)
@@ -191,7 +197,7 @@ static A2_errors dc_Initialize(A2_unit *u, A2_vmstate *vms,
 		  case 2: u->Process = dc_Process2; break;
 		}
 
-	return A2_OK;
+	return dc_Reset(u, vms, statedata, flags);
 }
 
 
@@ -264,24 +270,29 @@ static const A2_constdesc constants[] =
 	{ NULL,	0				}
 };
 
-const A2_unitdesc a2_dc_unitdesc =
+const A2_unitdescx a2_dc_unitdesc =
 {
-	"dc",			/* name */
+	{
+		"dc",			/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		regs,			/* registers */
+		NULL,			/* coutputs */
 
-	regs,			/* registers */
-	NULL,			/* coutputs */
+		constants,		/* constants */
 
-	constants,		/* constants */
+		0, 0,			/* [min,max]inputs */
+		1, A2DC_MAXOUTPUTS,	/* [min,max]outputs */
 
-	0, 0,			/* [min,max]inputs */
-	1, A2DC_MAXOUTPUTS,	/* [min,max]outputs */
+		sizeof(A2_dc),		/* instancesize */
+		dc_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_dc),		/* instancesize */
-	dc_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		NULL,			/* OpenState */
+		NULL			/* CloseState */
+	},
 
-	NULL,			/* OpenState */
-	NULL			/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	dc_Reset		/* Reset */
 };
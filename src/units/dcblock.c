@@ -120,22 +120,31 @@ static void dcb_CutOff(A2_unit *u, int v, unsigned start, unsigned dur)
 	dcb->f1 = dcb_pitch2coeff(dcb);
 }
 
-static A2_errors dcb_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+static A2_errors dcb_Reset(A2_unit *u, A2_vmstate *vms, void *statedata,
 		unsigned flags)
 {
-	A2_config *cfg = (A2_config *)statedata;
 	A2_dcblock *dcb = dcb_cast(u);
 	int *ur = u->registers;
 	int c;
 
-	dcb->samplerate = cfg->samplerate;
-	dcb->transpose = vms->r + R_TRANSPOSE;
-
 	ur[A2DCBR_CUTOFF] = -5 << 16;	/* 8.175813 Hz */
 	dcb_CutOff(u, ur[A2DCBR_CUTOFF], 0, 0);
 
 	for(c = 0; c < u->ninputs; ++c)
 		dcb->d1[c] = dcb->d2[c] = 0;
+	return A2_OK;
+}
+
+
+static A2_errors dcb_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+		unsigned flags)
+{
+	A2_config *cfg = (A2_config *)statedata;
+	A2_dcblock *dcb = dcb_cast(u);
+
+	dcb->samplerate = cfg->samplerate;
+	dcb->transpose = vms->r + R_TRANSPOSE;
+
 	if(flags & A2_PROCADD)
 		switch(u->ninputs)
 		{
@@ -149,7 +158,7 @@ static A2_errors dcb_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 		  case 2: u->Process = dcb_Process22; break;
 		}
 
-	return A2_OK;
+	return dcb_Reset(u, vms, statedata, flags);
 }
 
 
@@ -166,25 +175,30 @@ static const A2_crdesc regs[] =
 	{ NULL,	NULL			}
 };
 
-const A2_unitdesc a2_dcblock_unitdesc =
+const A2_unitdescx a2_dcblock_unitdesc =
 {
-	"dcblock",		/* name */
+	{
+		"dcblock",		/* name */
+
+		A2_MATCHIO | A2_UNITDESCX,
 
-	A2_MATCHIO,
+		regs,			/* registers */
+		NULL,			/* coutputs */
 
-	regs,			/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		1, 2,			/* [min,max]inputs */
+		1, 2,			/* [min,max]outputs */
 
-	1, 2,			/* [min,max]inputs */
-	1, 2,			/* [min,max]outputs */
+		sizeof(A2_dcblock),	/* instancesize */
+		dcb_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_dcblock),	/* instancesize */
-	dcb_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
 
+		dcb_OpenState,		/* OpenState */
+		NULL			/* CloseState */
+	},
 
-	dcb_OpenState,		/* OpenState */
-	NULL			/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	dcb_Reset		/* Reset */
 };
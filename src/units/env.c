@@ -227,13 +227,11 @@ static void env_Target(A2_unit *u, int v, unsigned start, unsigned dur)
 }
 
 
-static A2_errors env_Initialize(A2_unit *u, A2_vmstate *vms,
-		void *statedata, unsigned flags)
+static A2_errors env_Reset(A2_unit *u, A2_vmstate *vms, void *statedata,
+		unsigned flags)
 {
 	A2_env *env = env_cast(u);
-	A2_config *cfg = (A2_config *)statedata;
 	int *ci = u->registers;
-	env->msdur = cfg->samplerate * 65.536f + .5f;
 
 	/* Internal state initialization */
 	a2_InitRamper(&env->ramper, 0);
@@ -252,6 +250,15 @@ static A2_errors env_Initialize(A2_unit *u, A2_vmstate *vms,
 }
 
 
+static A2_errors env_Initialize(A2_unit *u, A2_vmstate *vms,
+		void *statedata, unsigned flags)
+{
+	A2_config *cfg = (A2_config *)statedata;
+	env_cast(u)->msdur = cfg->samplerate * 65.536f + .5f;
+	return env_Reset(u, vms, statedata, flags);
+}
+
+
 static A2_errors env_InitLUTs(void)
 {
 	int i, j;
@@ -358,24 +365,29 @@ static const A2_constdesc constants[] =
 	{ NULL,	0				}
 };
 
-const A2_unitdesc a2_env_unitdesc =
+const A2_unitdescx a2_env_unitdesc =
 {
-	"env",			/* name */
+	{
+		"env",			/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		cregs,			/* registers */
+		couts,			/* coutputs */
 
-	cregs,			/* registers */
-	couts,			/* coutputs */
+		constants,		/* constants */
 
-	constants,		/* constants */
+		0, 0,			/* [min,max]inputs */
+		0, 0,			/* [min,max]outputs */
 
-	0, 0,			/* [min,max]inputs */
-	0, 0,			/* [min,max]outputs */
+		sizeof(A2_env),		/* instancesize */
+		env_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_env),		/* instancesize */
-	env_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		env_OpenState,		/* OpenState */
+		env_CloseState		/* CloseState */
+	},
 
-	env_OpenState,		/* OpenState */
-	env_CloseState		/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	env_Reset		/* Reset */
 };
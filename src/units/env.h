@@ -25,6 +25,6 @@
 
 #include "a2_units.h"
 
-extern const A2_unitdesc a2_env_unitdesc;
+extern const A2_unitdescx a2_env_unitdesc;
 
 #endif /* A2_ENV_H */
@@ -21,10 +21,23 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "fbdelay.h"
+#include "platform.h"
 
-/*FIXME: Select buffer size based on sample rate and maximum delay allowed! */
-#define A2FBD_BUFSIZE	131072
+/* Maximum delay time (ms); buffer size is rounded up to a power of two */
+#define A2FBD_MAXDELAY	2500
+
+/*
+ * Number of clean buffers to keep around for realtime states. The housekeeper
+ * refills the pool to this level, and frees clean buffers beyond
+ * A2FBD_MAXFREE, down to this level again.
+ */
+#define A2FBD_PREALLOC	4
+#define A2FBD_MAXFREE	8
+
+/* Maximum number of buffers kept in the pool */
+#define A2FBD_POOLSIZE	64
 
 /* Control register frame enumeration */
 typedef enum A2FBD_cregisters
@@ -38,10 +51,44 @@ typedef enum A2FBD_cregisters
 	A2FBDR_RGAIN
 } A2FBD_cregisters;
 
+/* Delay buffer pool slot states */
+typedef enum A2FBD_slotstates
+{
+	A2FBD_EMPTY = 0,	/* No buffer */
+	A2FBD_FREE,		/* Clean buffer, ready for use */
+	A2FBD_DIRTY,		/* Returned buffer, to be cleared */
+	A2FBD_BUSY		/* Being updated by a thread */
+} A2FBD_slotstates;
+
+typedef struct A2FBD_slot
+{
+	A2_atomic	state;
+	int32_t		*buffer;
+	unsigned	used;		/* Frames to clear, if dirty */
+} A2FBD_slot;
+
+/*
+ * Shared state data. Units are initialized in the realtime context, and with
+ * voice processing lanes, on multiple threads concurrently, so buffers are
+ * grabbed and returned through the slot states, without locks.
+ *
+ * Once the housekeeping thread of a realtime state has taken over, returned
+ * buffers are left dirty for it to clear, and it keeps the pool topped up.
+ */
+typedef struct A2FBD_state
+{
+	int		samplerate;
+	unsigned	bufsize;	/* Power of two (sample frames) */
+	A2_atomic	housekept;	/* Housekeeper clears and refills */
+	A2FBD_slot	slots[A2FBD_POOLSIZE];
+} A2FBD_state;
+
 typedef struct A2_fbdelay
 {
 	A2_unit		header;
+	A2FBD_state	*state;
 	int		samplerate;
+	unsigned	bufmask;
 
 	/* Parameters */
 	int		fbdelay;	/* Timings (sample frames) */
@@ -65,7 +112,7 @@ static inline A2_fbdelay *fbdelay_cast(A2_unit *u)
 }
 
 
-#define	WI(x)	((fbd->bufpos - (x)) & (A2FBD_BUFSIZE - 1))
+#define	WI(x)	((fbd->bufpos - (x)) & fbd->bufmask)
 static inline void fbdelay_process(A2_unit *u, unsigned offset,
 		unsigned frames, int add, int stereoin, int stereoout)
 {
@@ -167,25 +214,128 @@ static void fbdelay_Process11(A2_unit *u, unsigned offset, unsigned frames)
 }
 
 
+/*
+ * Grab a clean buffer pair from the pool. If the pool is empty, allocate a new
+ * one. (That is not realtime safe, but better than failing.)
+ */
+static int32_t *fbdelay_alloc(A2FBD_state *fbs)
+{
+	int i;
+	int32_t *buf;
+	for(i = 0; i < A2FBD_POOLSIZE; ++i)
+	{
+		A2FBD_slot *sl = fbs->slots + i;
+		if(!a2_AtomicCAS(&sl->state, A2FBD_FREE, A2FBD_BUSY))
+			continue;
+		buf = sl->buffer;
+		sl->buffer = NULL;
+		a2_AtomicCAS(&sl->state, A2FBD_BUSY, A2FBD_EMPTY);
+		return buf;
+	}
+	return (int32_t *)calloc(fbs->bufsize * 2, sizeof(int32_t));
+}
+
+/* Clear the used part of a buffer pair */
+static void fbdelay_clear(A2FBD_state *fbs, int32_t *buf, unsigned used)
+{
+	if(used > fbs->bufsize)
+		used = fbs->bufsize;
+	memset(buf, 0, used * sizeof(int32_t));
+	memset(buf + fbs->bufsize, 0, used * sizeof(int32_t));
+}
+
+/*
+ * Return a buffer pair to the pool, or free it if the pool is full. Unless the
+ * housekeeper is looking after the pool, the buffer is cleared right away.
+ */
+static void fbdelay_free(A2FBD_state *fbs, int32_t *buf, unsigned used)
+{
+	int i;
+	int state = A2FBD_FREE;
+	if(a2_AtomicAdd(&fbs->housekept, 0))
+		state = A2FBD_DIRTY;
+	else
+		fbdelay_clear(fbs, buf, used);
+	for(i = 0; i < A2FBD_POOLSIZE; ++i)
+	{
+		A2FBD_slot *sl = fbs->slots + i;
+		if(!a2_AtomicCAS(&sl->state, A2FBD_EMPTY, A2FBD_BUSY))
+			continue;
+		sl->buffer = buf;
+		sl->used = used;
+		a2_AtomicCAS(&sl->state, A2FBD_BUSY, state);
+		return;
+	}
+	free(buf);
+}
+
+
+void a2_fbdelay_Housekeeping(void *statedata)
+{
+	A2FBD_state *fbs = (A2FBD_state *)statedata;
+	int i, nfree = 0, trim;
+	a2_AtomicCAS(&fbs->housekept, 0, 1);
+
+	/* Clear returned buffers */
+	for(i = 0; i < A2FBD_POOLSIZE; ++i)
+	{
+		A2FBD_slot *sl = fbs->slots + i;
+		if(a2_AtomicCAS(&sl->state, A2FBD_DIRTY, A2FBD_BUSY))
+		{
+			fbdelay_clear(fbs, sl->buffer, sl->used);
+			a2_AtomicCAS(&sl->state, A2FBD_BUSY, A2FBD_FREE);
+		}
+		if(a2_AtomicAdd(&sl->state, 0) == A2FBD_FREE)
+			++nfree;
+	}
+
+	/* Refill, or trim after bursts */
+	trim = nfree > A2FBD_MAXFREE;
+	for(i = 0; i < A2FBD_POOLSIZE; ++i)
+	{
+		A2FBD_slot *sl = fbs->slots + i;
+		if(nfree < A2FBD_PREALLOC)
+		{
+			int32_t *buf;
+			if(!a2_AtomicCAS(&sl->state, A2FBD_EMPTY, A2FBD_BUSY))
+				continue;
+			buf = (int32_t *)calloc(fbs->bufsize * 2,
+					sizeof(int32_t));
+			sl->buffer = buf;
+			a2_AtomicCAS(&sl->state, A2FBD_BUSY,
+					buf ? A2FBD_FREE : A2FBD_EMPTY);
+			if(!buf)
+				return;
+			++nfree;
+		}
+		else if(trim && (nfree > A2FBD_PREALLOC))
+		{
+			if(!a2_AtomicCAS(&sl->state, A2FBD_FREE, A2FBD_BUSY))
+				continue;
+			free(sl->buffer);
+			sl->buffer = NULL;
+			a2_AtomicCAS(&sl->state, A2FBD_BUSY, A2FBD_EMPTY);
+			--nfree;
+		}
+		else
+			return;
+	}
+}
+
+
 static A2_errors fbdelay_Initialize(A2_unit *u, A2_vmstate *vms,
 		void *statedata, unsigned flags)
 {
-	A2_config *cfg = (A2_config *)statedata;
+	A2FBD_state *fbs = (A2FBD_state *)statedata;
 	A2_fbdelay *fbd = fbdelay_cast(u);
 	int *ur = u->registers;
 
-	fbd->samplerate = cfg->samplerate;
-
-/*FIXME: Select buffer size based on sample rate and maximum delay allowed! */
-	fbd->lbuf = calloc(A2FBD_BUFSIZE, sizeof(int32_t));
-	fbd->rbuf = calloc(A2FBD_BUFSIZE, sizeof(int32_t));
-	if(!fbd->lbuf || !fbd->rbuf)
-	{
-/*FIXME: Use realtime safe memory manager! */
-		free(fbd->lbuf);
-		free(fbd->rbuf);
+	fbd->state = fbs;
+	fbd->samplerate = fbs->samplerate;
+	fbd->bufmask = fbs->bufsize - 1;
+	if(!(fbd->lbuf = fbdelay_alloc(fbs)))
 		return A2_OOMEMORY;
-	}
+	fbd->rbuf = fbd->lbuf + fbs->bufsize;
 	fbd->bufpos = 0;
 
 	ur[A2FBDR_FBDELAY] = 400 << 16;
@@ -222,9 +372,7 @@ static A2_errors fbdelay_Initialize(A2_unit *u, A2_vmstate *vms,
 static void fbdelay_Deinitialize(A2_unit *u)
 {
 	A2_fbdelay *fbd = fbdelay_cast(u);
-/*FIXME: Use realtime safe memory manager! */
-	free(fbd->lbuf);
-	free(fbd->rbuf);
+	fbdelay_free(fbd->state, fbd->lbuf, fbd->bufpos);
 }
 
 
@@ -267,9 +415,41 @@ static void fbdelay_RGain(A2_unit *u, int v, unsigned start, unsigned dur)
 }
 
 
+static void fbdelay_CloseState(void *statedata)
+{
+	A2FBD_state *fbs = (A2FBD_state *)statedata;
+	int i;
+	for(i = 0; i < A2FBD_POOLSIZE; ++i)
+		free(fbs->slots[i].buffer);
+	free(fbs);
+}
+
+
 static A2_errors fbdelay_OpenState(A2_config *cfg, void **statedata)
 {
-	*statedata = cfg;
+	int i;
+	unsigned maxdelay = (uint64_t)cfg->samplerate * A2FBD_MAXDELAY / 1000;
+	A2FBD_state *fbs = (A2FBD_state *)calloc(1, sizeof(A2FBD_state));
+	if(!fbs)
+		return A2_OOMEMORY;
+	fbs->samplerate = cfg->samplerate;
+	for(fbs->bufsize = 1; fbs->bufsize <= maxdelay; fbs->bufsize <<= 1)
+		;
+
+	/* Off-line states don't need this, and we don't want to waste memory */
+	if(cfg->flags & A2_REALTIME)
+		for(i = 0; i < A2FBD_PREALLOC; ++i)
+		{
+			A2FBD_slot *sl = fbs->slots + i;
+			if(!(sl->buffer = (int32_t *)calloc(fbs->bufsize * 2,
+					sizeof(int32_t))))
+			{
+				fbdelay_CloseState(fbs);
+				return A2_OOMEMORY;
+			}
+			sl->state = A2FBD_FREE;
+		}
+	*statedata = fbs;
 	return A2_OK;
 }
 
@@ -305,5 +485,5 @@ const A2_unitdesc a2_fbdelay_unitdesc =
 	fbdelay_Deinitialize,	/* Deinitialize */
 
 	fbdelay_OpenState,	/* OpenState */
-	NULL			/* CloseState */
+	fbdelay_CloseState	/* CloseState */
 };
@@ -27,4 +27,11 @@
 
 extern const A2_unitdesc a2_fbdelay_unitdesc;
 
+/*
+ * Clear returned delay buffers, and refill or trim the buffer pool of a
+ * realtime state. Called from the housekeeping thread. Until the first call,
+ * instances clear their buffers themselves as they're released.
+ */
+void a2_fbdelay_Housekeeping(void *statedata);
+
 #endif /* A2_FBDELAY_H */
@@ -177,17 +177,13 @@ static void f12_HP(A2_unit *u, int v, unsigned start, unsigned dur)
 }
 
 
-static A2_errors f12_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+static A2_errors f12_Reset(A2_unit *u, A2_vmstate *vms, void *statedata,
 		unsigned flags)
 {
-	A2_config *cfg = (A2_config *)statedata;
 	A2_filter12 *f12 = f12_cast(u);
 	int *ur = u->registers;
 	int c;
 
-	f12->samplerate = cfg->samplerate;
-	f12->transpose = vms->r + R_TRANSPOSE;
-
 	ur[A2F12R_CUTOFF] = 0;
 	ur[A2F12R_Q] = 0;
 	ur[A2F12R_LP] = 65536;
@@ -204,6 +200,19 @@ static A2_errors f12_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 
 	for(c = 0; c < u->ninputs; ++c)
 		f12->d1[c] = f12->d2[c] = 0;
+	return A2_OK;
+}
+
+
+static A2_errors f12_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+		unsigned flags)
+{
+	A2_config *cfg = (A2_config *)statedata;
+	A2_filter12 *f12 = f12_cast(u);
+
+	f12->samplerate = cfg->samplerate;
+	f12->transpose = vms->r + R_TRANSPOSE;
+
 	if(flags & A2_PROCADD)
 		switch(u->ninputs)
 		{
@@ -217,7 +226,7 @@ static A2_errors f12_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 		  case 2: u->Process = f12_Process22; break;
 		}
 
-	return A2_OK;
+	return f12_Reset(u, vms, statedata, flags);
 }
 
 
@@ -238,24 +247,29 @@ static const A2_crdesc regs[] =
 	{ NULL,	NULL			}
 };
 
-const A2_unitdesc a2_filter12_unitdesc =
+const A2_unitdescx a2_filter12_unitdesc =
 {
-	"filter12",		/* name */
+	{
+		"filter12",		/* name */
+
+		A2_MATCHIO | A2_UNITDESCX,
 
-	A2_MATCHIO,
+		regs,			/* registers */
+		NULL,			/* coutputs */
 
-	regs,			/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		1, 2,			/* [min,max]inputs */
+		1, 2,			/* [min,max]outputs */
 
-	1, 2,			/* [min,max]inputs */
-	1, 2,			/* [min,max]outputs */
+		sizeof(A2_filter12),	/* instancesize */
+		f12_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_filter12),	/* instancesize */
-	f12_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		f12_OpenState,		/* OpenState */
+		NULL			/* CloseState */
+	},
 
-	f12_OpenState,		/* OpenState */
-	NULL			/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	f12_Reset		/* Reset */
 };
@@ -50,6 +50,30 @@
 #  define	A2FM4_OVERSAMPLE_BITS	2
 #endif
 
+/*
+ * Use a polynomial sine approximation instead of the interpolated table. This
+ * vectorizes fully, as there are no table lookups, but it is less accurate;
+ * the worst case error is around -68 dB, vs -83 dB for the table.
+ */
+#undef	A2FM_POLYSINE
+
+/* Polynomial sine coefficients; 32767 * { pi/2, 5/2 - pi, pi/2 - 3/2 } */
+#define	A2FM_PS1	51470
+#define	A2FM_PS3	-21023
+#define	A2FM_PS5	2320
+
+/* Output frames per operator block */
+#define	A2FM_BLOCK	16
+
+/* Size of subsample buffers for one block */
+#define	A2FM_BLOCKSUBS	(A2FM_BLOCK << A2FM4_OVERSAMPLE_BITS)
+
+/* This file doesn't see config.h, so we check for SSE2 directly */
+#ifdef __SSE2__
+#  define	A2FM_SSE2
+#  include <emmintrin.h>
+#endif
+
 /* Control register frame enumeration */
 typedef enum A2FM_cregisters
 {
@@ -108,20 +132,110 @@ static int sinerc = 0;
 static int16_t *sine = NULL;
 
 
-static inline int32_t fm_osc(A2_fmosc *o, int mod)
+/* Raw sine value for phase 'ph' (8:24 fixp, 1.0/period) */
+static inline int fm_sine(unsigned ph)
 {
-	int fb = (int64_t)(o->last) * o->fb.value >> 17;
-	unsigned ph = (o->phase + mod + fb) >> (24 - 8 - A2FM_WAVEPERIOD_BITS);
-#ifdef A2_LOFI
-	o->last = sine[(ph >> 8) & A2FM_WAVEPERIOD_MASK];
+#ifdef A2FM_POLYSINE
+	int s = ph & 0x7fffff;
+	int z, z2, p;
+	if(s > 0x400000)
+		s = 0x800000 - s;
+	z = s >> 7;		/* [0, 32768] <==> [0, pi/2] */
+	z2 = z * z >> 15;
+	p = A2FM_PS3 + (z2 * A2FM_PS5 >> 15);
+	p = A2FM_PS1 + (z2 * p >> 15);
+	p = z * p >> 15;
+	return (ph & 0x800000) ? -p : p;
 #else
+	ph >>= 24 - 8 - A2FM_WAVEPERIOD_BITS;
+# ifdef A2_LOFI
+	return sine[(ph >> 8) & A2FM_WAVEPERIOD_MASK];
+# else
 	/* We don't go beyond linear here, so "standard" == A2_HIFI. */
-	o->last = a2_Lerp(sine, ph & ((A2FM_WAVEPERIOD << 8) - 1));
+	return a2_Lerp(sine, ph & ((A2FM_WAVEPERIOD << 8) - 1));
+# endif
 #endif
-	return (int64_t)(o->last) * o->a.value >> 16;
 }
 
 
+#ifdef A2FM_SSE2
+# ifdef A2FM_POLYSINE
+/* 32 bit multiply, keeping the low 32 bits, like plain C int math */
+static inline __m128i fm_mullo(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+			_mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(
+			_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/* fm_sine() for four phases at once */
+static inline __m128i fm_sine4(unsigned *ph)
+{
+	__m128i p = _mm_loadu_si128((__m128i *)ph);
+	__m128i s = _mm_and_si128(p, _mm_set1_epi32(0x7fffff));
+	__m128i fold = _mm_cmpgt_epi32(s, _mm_set1_epi32(0x400000));
+	__m128i neg = _mm_cmpeq_epi32(_mm_and_si128(p,
+			_mm_set1_epi32(0x800000)), _mm_set1_epi32(0x800000));
+	__m128i z, z2, v;
+	s = _mm_or_si128(_mm_and_si128(fold,
+			_mm_sub_epi32(_mm_set1_epi32(0x800000), s)),
+			_mm_andnot_si128(fold, s));
+	z = _mm_srli_epi32(s, 7);
+	z2 = _mm_srai_epi32(fm_mullo(z, z), 15);
+	v = _mm_add_epi32(_mm_set1_epi32(A2FM_PS3), _mm_srai_epi32(
+			fm_mullo(z2, _mm_set1_epi32(A2FM_PS5)), 15));
+	v = _mm_add_epi32(_mm_set1_epi32(A2FM_PS1), _mm_srai_epi32(
+			fm_mullo(z2, v), 15));
+	v = _mm_srai_epi32(fm_mullo(z, v), 15);
+	return _mm_sub_epi32(_mm_xor_si128(v, neg), neg);
+}
+# else
+/*
+ * fm_sine() for four phases at once. Each pair of table entries is fetched
+ * with a single 32 bit load, and interpolated with one 16 bit multiply-add.
+ */
+static inline __m128i fm_sine4(unsigned *ph)
+{
+	__m128i p = _mm_srli_epi32(_mm_loadu_si128((__m128i *)ph),
+			24 - 8 - A2FM_WAVEPERIOD_BITS);
+#  ifdef A2_LOFI
+	__m128i x = _mm_setzero_si128();
+#  else
+	__m128i x = _mm_and_si128(p, _mm_set1_epi32(0xff));
+#  endif
+	__m128i w = _mm_or_si128(_mm_sub_epi32(_mm_set1_epi32(256), x),
+			_mm_slli_epi32(x, 16));
+	int32_t d[4];
+	int i;
+	for(i = 0; i < 4; ++i)
+		memcpy(d + i, sine + ((ph[i] >> (24 - A2FM_WAVEPERIOD_BITS)) &
+				A2FM_WAVEPERIOD_MASK), sizeof(int32_t));
+	return _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((__m128i *)d),
+			w), 8);
+}
+# endif
+
+/*
+ * (int64_t)v * a >> 16 for four values at once, where 'v' is in the int16_t
+ * range. The 32 bit 'a' is split into 16 bit halves, so this can be done with
+ * 16 bit multiply-adds, without any loss of precision.
+ */
+static inline __m128i fm_amp4(__m128i v, int *amp)
+{
+	__m128i a = _mm_loadu_si128((__m128i *)amp);
+	__m128i ah = _mm_and_si128(_mm_srai_epi32(a, 16),
+			_mm_set1_epi32(0xffff));
+	__m128i al = _mm_xor_si128(_mm_and_si128(a, _mm_set1_epi32(0xffff)),
+			_mm_set1_epi32(0x8000));
+	__m128i lo = _mm_add_epi32(_mm_madd_epi16(v, al),
+			_mm_slli_epi32(v, 15));
+	return _mm_add_epi32(_mm_madd_epi16(v, ah), _mm_srai_epi32(lo, 16));
+}
+#endif
+
 static inline void fm_run_pitch(A2_fmosc *o, unsigned frames, int detune)
 {
 	int newpitch;
@@ -146,14 +260,219 @@ static inline A2_fm *fm_cast(A2_unit *u)
 }
 
 
-/* Calculate one (sub)sample; chain and parallel structures. */
-static inline int fm_sample(A2_fm *fm, int osbits, int operators, int parallel)
+static inline int fm_nofb(A2_fmosc *o)
+{
+	return !o->fb.value && !o->fb.delta;
+}
+
+
+static inline int32_t fm_osc(A2_fmosc *o, int mod)
+{
+	int fb = (int64_t)(o->last) * o->fb.value >> 17;
+	o->last = fm_sine(o->phase + mod + fb);
+	return (int64_t)(o->last) * o->a.value >> 16;
+}
+
+
+/*
+ * Run operator 'o', which must not have any feedback, over a block of
+ * 'frames' output frames, with 2^osbits subsamples per frame. 'mod' is the
+ * modulation input, or NULL for none, and the output is written to, or added
+ * to ('add') 'out'. 'mod' may be 'out'.
+ *
+ * As there is no recursion, this can calculate several subsamples at once.
+ */
+static inline void fm_op(A2_fmosc *o, int *mod, int *out, unsigned frames,
+		int osbits, int add)
+{
+	unsigned ph[A2FM_BLOCKSUBS];
+	int amp[A2FM_BLOCKSUBS];
+	unsigned oversample = 1 << osbits;
+	unsigned n = frames << osbits;
+	unsigned phase = o->phase;
+	unsigned dphase = o->dphase >> osbits;
+	int a = o->a.value;
+	unsigned s, os, k = 0;
+
+	/* Phase and amplitude of every subsample */
+	for(s = 0; s < frames; ++s)
+	{
+		for(os = 0; os < oversample; ++os, ++k)
+		{
+			ph[k] = phase + (mod ? mod[k] : 0);
+			amp[k] = a;
+			phase += dphase;
+		}
+		a += o->a.delta;
+		/* Fix the rounding error buildup! */
+		phase += o->dphase & (oversample - 1);
+	}
+	o->phase = phase;
+	o->a.value = a;
+
+	k = 0;
+#ifdef A2FM_SSE2
+	for( ; k + 4 <= n; k += 4)
+	{
+		__m128i v = fm_amp4(fm_sine4(ph + k), amp + k);
+		if(add)
+			v = _mm_add_epi32(v, _mm_loadu_si128(
+					(__m128i *)(out + k)));
+		_mm_storeu_si128((__m128i *)(out + k), v);
+	}
+#endif
+	for( ; k < n; ++k)
+	{
+		int v = (int64_t)fm_sine(ph[k]) * amp[k] >> 16;
+		if(add)
+			out[k] += v;
+		else
+			out[k] = v;
+	}
+	o->last = fm_sine(ph[n - 1]);
+}
+
+/*
+ * Like fm_op(), but for the 'count' operators listed in 'ops', which may have
+ * feedback, connected in series, in the listed order.
+ *
+ * Feedback operators need the previous output for every subsample, so these
+ * are run one subsample at a time. Running them all in the same loop leaves
+ * the CPU something to do while waiting for each feedback loop.
+ */
+static inline void fm_ops(A2_fm *fm, const int *ops, int count, int *mod,
+		int *out, unsigned frames, int osbits)
+{
+	A2_fmosc o[A2FM_MAX_OPERATORS];	/* Local; 'out' can't alias it */
+	unsigned oversample = 1 << osbits;
+	unsigned s, os, k = 0;
+	int i;
+	for(i = 0; i < count; ++i)
+		o[i] = fm->op[ops[i]];
+	for(s = 0; s < frames; ++s)
+	{
+		for(os = 0; os < oversample; ++os, ++k)
+		{
+			int v = mod ? mod[k] : 0;
+			for(i = 0; i < count; ++i)
+			{
+				v = fm_osc(&o[i], v);
+				o[i].phase += o[i].dphase >> osbits;
+			}
+			out[k] = v;
+		}
+		for(i = 0; i < count; ++i)
+		{
+			a2_RunRamper(&o[i].a, 1);
+			a2_RunRamper(&o[i].fb, 1);
+			/* Fix the rounding error buildup! */
+			o[i].phase += o[i].dphase & (oversample - 1);
+		}
+	}
+	for(i = 0; i < count; ++i)
+		fm->op[ops[i]] = o[i];
+}
+
+/*
+ * Run the operators listed in 'ops' in series. Operators without feedback are
+ * run one at a time over the whole block, and runs of operators with feedback
+ * are passed to fm_ops().
+ */
+static inline void fm_series(A2_fm *fm, const int *ops, int count,
+		int *mod, int *out, unsigned frames, int osbits)
+{
+	while(count)
+	{
+		int n = 1;
+		if(fm_nofb(&fm->op[*ops]))
+			fm_op(&fm->op[*ops], mod, out, frames, osbits, 0);
+		else
+		{
+			while((n < count) && !fm_nofb(&fm->op[ops[n]]))
+				++n;
+			fm_ops(fm, ops, n, mod, out, frames, osbits);
+		}
+		ops += n;
+		count -= n;
+		mod = out;
+	}
+}
+
+/*
+ * Process one block of up to A2FM_BLOCK frames. Operators are run over the
+ * whole block, modulators first, so the modulation input of every operator is
+ * known for the whole block by the time the operator is run.
+ *
+ * NOTE: The parallel structures are only run this way without feedback!
+ *
+ *	parallel == 0	Chain structure
+ *	parallel == 1	Parallel modulators
+ *	parallel == 2	Chains + ring modulator (2 and 4 operators only!)
+ */
+static inline void fm_block(A2_fm *fm, int32_t *out, unsigned frames,
+		int osbits, int operators, int parallel, int add)
+{
+	int v[A2FM_BLOCKSUBS];
+	unsigned oversample = 1 << osbits;
+	unsigned s, os, k;
+	int i;
+	if(parallel == 2)
+	{
+		int v1[A2FM_BLOCKSUBS];
+		if(operators == 4)
+		{
+			fm_op(&fm->op[2], NULL, v, frames, osbits, 0);
+			fm_op(&fm->op[0], v, v, frames, osbits, 0);
+			fm_op(&fm->op[3], NULL, v1, frames, osbits, 0);
+			fm_op(&fm->op[1], v1, v1, frames, osbits, 0);
+		}
+		else
+		{
+			fm_op(&fm->op[0], NULL, v, frames, osbits, 0);
+			fm_op(&fm->op[1], NULL, v1, frames, osbits, 0);
+		}
+		for(k = 0; k < frames << osbits; ++k)
+			v[k] = (int64_t)v[k] * v1[k] >> 23;	/* RM */
+	}
+	else if(parallel)
+	{
+		for(i = operators - 1; i > 0; --i)
+			fm_op(&fm->op[i], NULL, v, frames, osbits,
+					i < operators - 1);
+		fm_op(&fm->op[0], v, v, frames, osbits, 0);
+	}
+	else
+	{
+		int ops[A2FM_MAX_OPERATORS];
+		for(i = 0; i < operators; ++i)
+			ops[i] = operators - 1 - i;
+		fm_series(fm, ops, operators, NULL, v, frames, osbits);
+	}
+
+	/* Decimate */
+	for(s = 0, k = 0; s < frames; ++s)
+	{
+		int vsum = 0;
+		for(os = 0; os < oversample; ++os)
+			vsum += v[k++];
+		if(add)
+			out[s] += vsum >> osbits;
+		else
+			out[s] = vsum >> osbits;
+	}
+}
+
+/*
+ * Calculate one (sub)sample; parallel structure. (The chain structure is
+ * always run by fm_block().)
+ */
+static inline int fm_sample(A2_fm *fm, int osbits, int operators)
 {
 	int i;
 	int v = 0;
 	for(i = operators - 1; i >= 0; --i)
 	{
-		if(i && parallel)
+		if(i)
 			v += fm_osc(&fm->op[i], 0);
 		else
 			v = fm_osc(&fm->op[i], v);
@@ -196,18 +515,39 @@ static inline void fm_process(A2_unit *u, unsigned offset, unsigned frames,
 {
 	A2_fm *fm = fm_cast(u);
 	int i;
-	unsigned s;
+	unsigned s, n;
 	unsigned oversample = 1 << osbits;
 	unsigned end = offset + frames;
 	int32_t *out = u->outputs[0];
 	int detune = 0;
+	int nofb = 1;
 	for(i = 0; i < operators; ++i)
 	{
 		a2_PrepareRamper(&fm->op[i].a, frames);
 		a2_PrepareRamper(&fm->op[i].fb, frames);
 		fm_run_pitch(&fm->op[i], frames, detune);
 		detune = fm->op[0].p.value;
+		nofb &= fm_nofb(&fm->op[i]);
 	}
+
+	if(!parallel || nofb)
+	{
+		for(s = offset; s < end; s += n)
+		{
+			n = end - s;
+			if(n > A2FM_BLOCK)
+				n = A2FM_BLOCK;
+			fm_block(fm, out + s, n, osbits, operators, parallel,
+					add);
+		}
+		return;
+	}
+
+	/*
+	 * Parallel structures with feedback are run one subsample at a time,
+	 * all operators together, as the feedback loops would otherwise leave
+	 * the CPU idle most of the time.
+	 */
 	for(s = offset; s < end; ++s)
 	{
 		int os;
@@ -216,8 +556,7 @@ static inline void fm_process(A2_unit *u, unsigned offset, unsigned frames,
 			if(parallel == 2)
 				vsum += fm_sample_rm(fm, osbits, operators);
 			else
-				vsum += fm_sample(fm, osbits, operators,
-						parallel);
+				vsum += fm_sample(fm, osbits, operators);
 		for(i = 0; i < operators; ++i)
 		{
 			a2_RunRamper(&fm->op[i].a, 1);
@@ -336,24 +675,13 @@ static inline void fm_set_phase(A2_fm *fm, int ph, unsigned sst)
 }
 
 
-static A2_errors fm_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+static A2_errors fm_Reset(A2_unit *u, A2_vmstate *vms, void *statedata,
 		unsigned flags)
 {
-	int i, structure;
-	A2_config *cfg = (A2_config *)statedata;
+	int i;
 	A2_fm *fm = fm_cast(u);
 
-	/* So... Don't rename these units, OK!? :-) */
-	structure = fm->nops = u->descriptor->name[2] - '0';
-	if(u->descriptor->name[3] == 'p')
-		structure += 4;
-	else if(u->descriptor->name[3] == 'r')
-		structure += 8;
-
 	/* Internal state initialization */
-	fm->basepitch = cfg->basepitch;
-	fm->transpose = vms->r + R_TRANSPOSE;
-
 	for(i = 0; i < fm->nops; ++i)
 	{
 		a2_InitRamper(&fm->op[i].a, 0);
@@ -373,6 +701,26 @@ static A2_errors fm_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 	u->registers[A2FMR_PHASE] = 0;
 	memset(u->registers + A2FMR_PITCH0, 0,
 			sizeof(int) * A2FMR_OP_SIZE * fm->nops);
+	return A2_OK;
+}
+
+
+static A2_errors fm_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+		unsigned flags)
+{
+	int structure;
+	A2_config *cfg = (A2_config *)statedata;
+	A2_fm *fm = fm_cast(u);
+
+	/* So... Don't rename these units, OK!? :-) */
+	structure = fm->nops = u->descriptor->name[2] - '0';
+	if(u->descriptor->name[3] == 'p')
+		structure += 4;
+	else if(u->descriptor->name[3] == 'r')
+		structure += 8;
+
+	fm->basepitch = cfg->basepitch;
+	fm->transpose = vms->r + R_TRANSPOSE;
 
 	/* Install Process callback */
 	if(flags & A2_PROCADD)
@@ -404,7 +752,7 @@ static A2_errors fm_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 		  case 12:	u->Process = fm4r_Process;	break;
 		}
 
-	return A2_OK;
+	return fm_Reset(u, vms, statedata, flags);
 }
 
 
@@ -529,26 +877,31 @@ static const A2_crdesc fm1_regs[] =
 	{ NULL,	NULL				}
 };
 
-const A2_unitdesc a2_fm1_unitdesc =
+const A2_unitdescx a2_fm1_unitdesc =
 {
-	"fm1",			/* name */
+	{
+		"fm1",			/* name */
 
-	0,			/* flags */
+		A2_UNITDESCX,		/* flags */
 
-	fm1_regs,		/* registers */
-	NULL,			/* coutputs */
+		fm1_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	NULL,			/* constants */
+		NULL,			/* constants */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
+
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
 
 
@@ -576,26 +929,31 @@ static const A2_crdesc fm2_regs[] =
 	{ NULL,	NULL				}
 };
 
-const A2_unitdesc a2_fm2_unitdesc =
+const A2_unitdescx a2_fm2_unitdesc =
 {
-	"fm2",			/* name */
+	{
+		"fm2",			/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		fm2_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	fm2_regs,		/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
 
 
@@ -628,26 +986,31 @@ static const A2_crdesc fm3_regs[] =
 	{ NULL,	NULL				}
 };
 
-const A2_unitdesc a2_fm3_unitdesc =
+const A2_unitdescx a2_fm3_unitdesc =
 {
-	"fm3",			/* name */
+	{
+		"fm3",			/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		fm3_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	fm3_regs,		/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
 
 
@@ -685,26 +1048,31 @@ static const A2_crdesc fm4_regs[] =
 	{ NULL,	NULL				}
 };
 
-const A2_unitdesc a2_fm4_unitdesc =
+const A2_unitdescx a2_fm4_unitdesc =
 {
-	"fm4",			/* name */
+	{
+		"fm4",			/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		fm4_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	fm4_regs,		/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
 
 
@@ -716,26 +1084,31 @@ const A2_unitdesc a2_fm4_unitdesc =
 
 ---------------------------------------------------------*/
 
-const A2_unitdesc a2_fm3p_unitdesc =
+const A2_unitdescx a2_fm3p_unitdesc =
 {
-	"fm3p",			/* name */
+	{
+		"fm3p",			/* name */
 
-	0,			/* flags */
+		A2_UNITDESCX,		/* flags */
 
-	fm3_regs,		/* registers */
-	NULL,			/* coutputs */
+		fm3_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	NULL,			/* constants */
+		NULL,			/* constants */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
+
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
 
 
@@ -749,26 +1122,31 @@ const A2_unitdesc a2_fm3p_unitdesc =
 
 ---------------------------------------------------------*/
 
-const A2_unitdesc a2_fm4p_unitdesc =
+const A2_unitdescx a2_fm4p_unitdesc =
 {
-	"fm4p",			/* name */
+	{
+		"fm4p",			/* name */
 
-	0,			/* flags */
+		A2_UNITDESCX,		/* flags */
 
-	fm4_regs,		/* registers */
-	NULL,			/* coutputs */
+		fm4_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	NULL,			/* constants */
+		NULL,			/* constants */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
+
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
 
 
@@ -780,26 +1158,31 @@ const A2_unitdesc a2_fm4p_unitdesc =
 
 ---------------------------------------------------------*/
 
-const A2_unitdesc a2_fm2r_unitdesc =
+const A2_unitdescx a2_fm2r_unitdesc =
 {
-	"fm2r",			/* name */
+	{
+		"fm2r",			/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		fm2_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	fm2_regs,		/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
 
 
@@ -811,24 +1194,29 @@ const A2_unitdesc a2_fm2r_unitdesc =
 
 ---------------------------------------------------------*/
 
-const A2_unitdesc a2_fm4r_unitdesc =
+const A2_unitdescx a2_fm4r_unitdesc =
 {
-	"fm4r",			/* name */
+	{
+		"fm4r",			/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		fm4_regs,		/* registers */
+		NULL,			/* coutputs */
 
-	fm4_regs,		/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		sizeof(A2_fm),		/* instancesize */
+		fm_Initialize,		/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_fm),		/* instancesize */
-	fm_Initialize,		/* Initialize */
-	NULL,			/* Deinitialize */
+		fm_OpenState,		/* OpenState */
+		fm_CloseState		/* CloseState */
+	},
 
-	fm_OpenState,		/* OpenState */
-	fm_CloseState		/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	fm_Reset		/* Reset */
 };
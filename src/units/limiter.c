@@ -153,20 +153,27 @@ static void limiter_Process22(A2_unit *u, unsigned offset, unsigned frames)
 }
 
 
-static A2_errors limiter_Initialize(A2_unit *u, A2_vmstate *vms,
+static A2_errors limiter_Reset(A2_unit *u, A2_vmstate *vms,
 		void *statedata, unsigned flags)
 {
-	A2_config *cfg = (A2_config *)statedata;
 	A2_limiter *lim = limiter_cast(u);
 	int *ur = u->registers;
 
 	ur[A2LR_RELEASE] = 64 << 16;
 	ur[A2LR_THRESHOLD] = 1 << 16;
 
-	lim->samplerate = cfg->samplerate;
-	lim->release = (ur[A2LR_RELEASE] << 8) / cfg->samplerate;
+	lim->release = (ur[A2LR_RELEASE] << 8) / lim->samplerate;
 	lim->threshold = (unsigned)(ur[A2LR_THRESHOLD] << 8);
 	lim->peak = 32768 << 8;
+	return A2_OK;
+}
+
+
+static A2_errors limiter_Initialize(A2_unit *u, A2_vmstate *vms,
+		void *statedata, unsigned flags)
+{
+	A2_config *cfg = (A2_config *)statedata;
+	limiter_cast(u)->samplerate = cfg->samplerate;
 
 	if(flags & A2_PROCADD)
 		switch(u->ninputs)
@@ -181,7 +188,7 @@ static A2_errors limiter_Initialize(A2_unit *u, A2_vmstate *vms,
 		  case 2: u->Process = limiter_Process22; break;
 		}
 
-	return A2_OK;
+	return limiter_Reset(u, vms, statedata, flags);
 }
 
 
@@ -214,24 +221,29 @@ static const A2_crdesc regs[] =
 	{ NULL,	NULL				}
 };
 
-const A2_unitdesc a2_limiter_unitdesc =
+const A2_unitdescx a2_limiter_unitdesc =
 {
-	"limiter",		/* name */
+	{
+		"limiter",		/* name */
+
+		A2_MATCHIO | A2_UNITDESCX,	/* flags */
 
-	A2_MATCHIO,		/* flags */
+		regs,			/* registers */
+		NULL,			/* coutputs */
 
-	regs,			/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		1, A2L_MAXCHANNELS,	/* [min,max]inputs */
+		1, A2L_MAXCHANNELS,	/* [min,max]outputs */
 
-	1, A2L_MAXCHANNELS,	/* [min,max]inputs */
-	1, A2L_MAXCHANNELS,	/* [min,max]outputs */
+		sizeof(A2_limiter),	/* instancesize */
+		limiter_Initialize,	/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_limiter),	/* instancesize */
-	limiter_Initialize,	/* Initialize */
-	NULL,			/* Deinitialize */
+		limiter_OpenState,	/* OpenState */
+		NULL			/* CloseState */
+	},
 
-	limiter_OpenState,	/* OpenState */
-	NULL			/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	limiter_Reset		/* Reset */
 };
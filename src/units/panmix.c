@@ -249,8 +249,8 @@ static void panmix_Process22(A2_unit *u, unsigned offset, unsigned frames)
 }
 
 
-static A2_errors panmix_Initialize(A2_unit *u, A2_vmstate *vms,
-		void *statedata, unsigned flags)
+static A2_errors panmix_Reset(A2_unit *u, A2_vmstate *vms, void *statedata,
+		unsigned flags)
 {
 	A2_panmix *pm = panmix_cast(u);
 	int *ur = u->registers;
@@ -262,7 +262,13 @@ static A2_errors panmix_Initialize(A2_unit *u, A2_vmstate *vms,
 	/* Initialize VM registers */
 	ur[A2PMR_VOL] = 65536;
 	ur[A2PMR_PAN] = 0;
+	return A2_OK;
+}
+
 
+static A2_errors panmix_Initialize(A2_unit *u, A2_vmstate *vms,
+		void *statedata, unsigned flags)
+{
 	/* Install Process callback */
 	if(flags & A2_PROCADD)
 		switch(((u->ninputs - 1) << 1) + (u->noutputs - 1))
@@ -280,7 +286,7 @@ static A2_errors panmix_Initialize(A2_unit *u, A2_vmstate *vms,
 		  case 2: u->Process = panmix_Process21; break;
 		  case 3: u->Process = panmix_Process22; break;
 		}
-	return A2_OK;
+	return panmix_Reset(u, vms, statedata, flags);
 }
 
 
@@ -310,24 +316,29 @@ static const A2_constdesc constants[] =
 	{ NULL,	0				}
 };
 
-const A2_unitdesc a2_panmix_unitdesc =
+const A2_unitdescx a2_panmix_unitdesc =
 {
-	"panmix",		/* name */
+	{
+		"panmix",		/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		regs,			/* registers */
+		NULL,			/* coutputs */
 
-	regs,			/* registers */
-	NULL,			/* coutputs */
+		constants,		/* constants */
 
-	constants,		/* constants */
+		1, A2PM_MAXINPUTS,	/* [min,max]inputs */
+		1, A2PM_MAXOUTPUTS,	/* [min,max]outputs */
 
-	1, A2PM_MAXINPUTS,	/* [min,max]inputs */
-	1, A2PM_MAXOUTPUTS,	/* [min,max]outputs */
+		sizeof(A2_panmix),	/* instancesize */
+		panmix_Initialize,	/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_panmix),	/* instancesize */
-	panmix_Initialize,	/* Initialize */
-	NULL,			/* Deinitialize */
+		NULL,			/* OpenState */
+		NULL			/* CloseState */
+	},
 
-	NULL,			/* OpenState */
-	NULL			/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	panmix_Reset		/* Reset */
 };
@@ -25,6 +25,6 @@
 
 #include "a2_units.h"
 
-extern const A2_unitdesc a2_panmix_unitdesc;
+extern const A2_unitdescx a2_panmix_unitdesc;
 
 #endif /* A2_PANMIX_H */
@@ -130,7 +130,7 @@ static void waveshaper_Process22(A2_unit *u, unsigned offset, unsigned frames)
 }
 
 
-static A2_errors waveshaper_Initialize(A2_unit *u, A2_vmstate *vms,
+static A2_errors waveshaper_Reset(A2_unit *u, A2_vmstate *vms,
 		void *statedata, unsigned flags)
 {
 	A2_waveshaper *ws = waveshaper_cast(u);
@@ -139,7 +139,13 @@ static A2_errors waveshaper_Initialize(A2_unit *u, A2_vmstate *vms,
 	a2_InitRamper(&ws->amount, 0);
 
 	ur[A2WSR_AMOUNT] = 0;
+	return A2_OK;
+}
 
+
+static A2_errors waveshaper_Initialize(A2_unit *u, A2_vmstate *vms,
+		void *statedata, unsigned flags)
+{
 	if(flags & A2_PROCADD)
 		switch(u->ninputs)
 		{
@@ -153,7 +159,7 @@ static A2_errors waveshaper_Initialize(A2_unit *u, A2_vmstate *vms,
 		  case 2: u->Process = waveshaper_Process22; break;
 		}
 
-	return A2_OK;
+	return waveshaper_Reset(u, vms, statedata, flags);
 }
 
 
@@ -170,24 +176,29 @@ static const A2_crdesc regs[] =
 };
 
 
-const A2_unitdesc a2_waveshaper_unitdesc =
+const A2_unitdescx a2_waveshaper_unitdesc =
 {
-	"waveshaper",		/* name */
+	{
+		"waveshaper",		/* name */
+
+		A2_MATCHIO | A2_UNITDESCX,	/* flags */
 
-	A2_MATCHIO,		/* flags */
+		regs,			/* registers */
+		NULL,			/* coutputs */
 
-	regs,			/* registers */
-	NULL,			/* coutputs */
+		NULL,			/* constants */
 
-	NULL,			/* constants */
+		1, A2WS_MAXCHANNELS,	/* [min,max]inputs */
+		1, A2WS_MAXCHANNELS,	/* [min,max]outputs */
 
-	1, A2WS_MAXCHANNELS,	/* [min,max]inputs */
-	1, A2WS_MAXCHANNELS,	/* [min,max]outputs */
+		sizeof(A2_waveshaper),	/* instancesize */
+		waveshaper_Initialize,	/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_waveshaper),	/* instancesize */
-	waveshaper_Initialize,	/* Initialize */
-	NULL,			/* Deinitialize */
+		NULL,			/* OpenState */
+		NULL			/* CloseState */
+	},
 
-	NULL,			/* OpenState */
-	NULL			/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	waveshaper_Reset	/* Reset */
 };
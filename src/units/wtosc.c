@@ -23,27 +23,55 @@
 #include <string.h>
 #include "wtosc.h"
 #include "internals.h"
+#ifdef A2_SSE2
+# include <emmintrin.h>
+#endif
 
-/* NOTE: These all return doubled amplitude samples! */
-#ifdef A2_HIFI
-/* Hermite interpolation with 2x oversampling */
-static inline int wtosc_Inter(int16_t *d, unsigned ph, unsigned dph)
-{
-	return a2_Hermite(d, ph) + a2_Hermite(d, ph + (dph >> 1));
-}
-#elif (defined A2_LOFI)
-/* Linear interpolation */
-static inline int wtosc_Inter(int16_t *d, unsigned ph, unsigned dph)
+/* Interpolation modes ('quality' register) */
+typedef enum A2O_quality
 {
-	return a2_Lerp(d, ph) << 1;
-}
+	A2OQ_NEAREST = 0,	/* Nearest sample */
+	A2OQ_LINEAR,		/* Linear interpolation, 2x oversampling */
+	A2OQ_HERMITE,		/* Cubic Hermite, 2x oversampling */
+	A2OQ_HERMITE2,		/* As HERMITE, but reusing coefficients */
+	A2OQ__COUNT,
+
+	/* Internal; HERMITE/HERMITE2 with A2_FAST waves */
+	A2OQ_HERMITECF = A2OQ__COUNT,
+	A2OQ__PROCS
+} A2O_quality;
+
+#ifdef A2_HIFI
+#  define	A2OQ_DEFAULT	A2OQ_HERMITE
 #else
-/* Linear interpolation with 2x oversampling */
-static inline int wtosc_Inter(int16_t *d, unsigned ph, unsigned dph)
+#  define	A2OQ_DEFAULT	A2OQ_LINEAR
+#endif
+
+/*
+ * NOTE: These all return doubled amplitude samples!
+ *
+ * 'd' is the int16_t sample data, except for A2OQ_HERMITECF, where it is the
+ * a2_Hermite2c() coefficient records of an A2_FAST wave.
+ */
+static inline int wtosc_Inter(A2O_quality q, void *d, unsigned ph,
+		unsigned dph)
 {
-	return a2_Lerp(d, ph) + a2_Lerp(d, ph + (dph >> 1));
+	int16_t *sd = (int16_t *)d;
+	int32_t *cf = (int32_t *)d;
+	unsigned ph2 = ph + (dph >> 1);
+	switch(q)
+	{
+	  case A2OQ_NEAREST:
+		return sd[(ph + 128) >> 8] << 1;
+	  case A2OQ_LINEAR:
+		return a2_Lerp(sd, ph) + a2_Lerp(sd, ph2);
+	  case A2OQ_HERMITECF:
+		return a2_Hermite2(cf + (ph >> 8) * 4, ph) +
+				a2_Hermite2(cf + (ph2 >> 8) * 4, ph2);
+	  default:
+		return a2_Hermite(sd, ph) + a2_Hermite(sd, ph2);
+	}
 }
-#endif
 
 /*
  * Maximum supported number of sample frames in a wave.
@@ -60,22 +88,27 @@ typedef enum A2O_cregisters
 	A2OR_WAVE = 0,
 	A2OR_PITCH,
 	A2OR_AMPLITUDE,
-	A2OR_PHASE
+	A2OR_PHASE,
+	A2OR_QUALITY
 } A2O_cregisters;
 
 typedef struct A2_wtosc
 {
 	A2_unit		header;
 	unsigned	flags;		/* Init flags (for wave changing) */
+	A2O_quality	quality;	/* Interpolation mode */
 	unsigned	dphase;		/* Increment (8:24 fixp, 1.0/period) */
 	uint64_t	phase;		/* Phase (48:24 fixp, 1.0/sample) */
 	int		noise;		/* Current noise sample (S&H) */
 	int		p_ramping;	/* Previous state of 'p' ramper */
 	int		basepitch;	/* Pitch of middle C (1.0/octave) */
+	int		mip;		/* Current mip level, or -1 if unknown */
+	uint64_t	mipdph;		/* Phase increment at mip level 'mip' */
 	A2_ramper	p;		/* Linear pitch ramper */
 	A2_ramper	a;		/* Amplitude ramper */
 	A2_wave		*wave;		/* Current waveform */
 	A2_interface	*interface;	/* For changing waves */
+	uint32_t	*noisestate;	/* Noise generator state */
 	int		*transpose;	/* Needed for pitch calculations */
 } A2_wtosc;
 
@@ -86,12 +119,13 @@ static inline A2_wtosc *wtosc_cast(A2_unit *u)
 }
 
 
-static inline void wtosc_run_pitch(A2_wtosc *o, unsigned frames)
+/* Returns 1 if 'dphase' was recalculated, otherwise 0 */
+static inline int wtosc_run_pitch(A2_wtosc *o, unsigned frames)
 {
 	unsigned lastv;
 	a2_PrepareRamper(&o->p, frames);
 	if(o->dphase && (!o->p.timer && !o->p_ramping))
-		return;	/* No update needed */
+		return 0;	/* No update needed */
 
 	/* Use halfway value while still ramping */
 	lastv = o->p.value;
@@ -102,6 +136,7 @@ static inline void wtosc_run_pitch(A2_wtosc *o, unsigned frames)
 
 	/* Calculate new phase delta */
 	o->dphase = a2_P2I((lastv + o->p.value) >> 9);
+	return 1;
 }
 
 
@@ -132,8 +167,7 @@ static inline void wtosc_noise(A2_unit *u, unsigned offset, unsigned frames,
 	A2_wtosc *o = wtosc_cast(u);
 	unsigned s, end = offset + frames;
 	int32_t *out = u->outputs[0];
-	A2_state *st = ((A2_interface_i *)o->interface)->state;
-	uint32_t *nstate = &st->noisestate;
+	uint32_t *nstate = o->noisestate;
 	wtosc_run_pitch(o, frames);
 	a2_PrepareRamper(&o->a, frames);
 
@@ -182,10 +216,183 @@ static inline int wtosc_check_unloaded(A2_unit *u, A2_wave *w)
 	return 1;
 }
 
+#ifdef A2_SSE2
+/* 32 bit multiply, keeping the low 32 bits, like plain C int math */
+static inline __m128i wtosc_mullo(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+			_mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/* Four a2_Hermite() evaluations at once; bit exact with the scalar version */
+static inline __m128i wtosc_Hermite4(int16_t *d, unsigned *ph)
+{
+	__m128i r0 = _mm_loadl_epi64((__m128i *)(d + (ph[0] >> 8) - 1));
+	__m128i r1 = _mm_loadl_epi64((__m128i *)(d + (ph[1] >> 8) - 1));
+	__m128i r2 = _mm_loadl_epi64((__m128i *)(d + (ph[2] >> 8) - 1));
+	__m128i r3 = _mm_loadl_epi64((__m128i *)(d + (ph[3] >> 8) - 1));
+	__m128i t01 = _mm_unpacklo_epi16(r0, r1);
+	__m128i t23 = _mm_unpacklo_epi16(r2, r3);
+	__m128i lo = _mm_unpacklo_epi32(t01, t23);
+	__m128i hi = _mm_unpackhi_epi32(t01, t23);
+	__m128i dm1 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16);
+	__m128i d0 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16);
+	__m128i d1 = _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16);
+	__m128i d2 = _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16);
+	__m128i x = _mm_slli_epi32(_mm_and_si128(_mm_loadu_si128(
+			(__m128i *)ph), _mm_set1_epi32(0xff)), 7);
+	__m128i c = _mm_srai_epi32(_mm_sub_epi32(d1, dm1), 1);
+	__m128i t = _mm_sub_epi32(d0, d1);
+	__m128i a = _mm_srai_epi32(_mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(
+			_mm_add_epi32(t, t), t), d2), dm1), 1);
+	__m128i b = _mm_sub_epi32(_mm_add_epi32(_mm_sub_epi32(dm1, d0), c), a);
+	a = _mm_srai_epi32(wtosc_mullo(a, x), 15);
+	a = _mm_srai_epi32(wtosc_mullo(_mm_add_epi32(a, b), x), 15);
+	return _mm_add_epi32(d0, _mm_srai_epi32(wtosc_mullo(
+			_mm_add_epi32(a, c), x), 15));
+}
+
+/* Four a2_Hermite2() evaluations at once, using A2_FAST coefficient records */
+static inline __m128i wtosc_Hermite4cf(int32_t *cf, unsigned *ph)
+{
+	__m128i r0 = _mm_loadu_si128((__m128i *)(cf + (ph[0] >> 8) * 4));
+	__m128i r1 = _mm_loadu_si128((__m128i *)(cf + (ph[1] >> 8) * 4));
+	__m128i r2 = _mm_loadu_si128((__m128i *)(cf + (ph[2] >> 8) * 4));
+	__m128i r3 = _mm_loadu_si128((__m128i *)(cf + (ph[3] >> 8) * 4));
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+	__m128i x = _mm_slli_epi32(_mm_and_si128(_mm_loadu_si128(
+			(__m128i *)ph), _mm_set1_epi32(0xff)), 7);
+	__m128i v = _mm_srai_epi32(wtosc_mullo(_mm_unpackhi_epi64(t0, t1), x),
+			15);
+	v = _mm_add_epi32(v, _mm_unpacklo_epi64(t2, t3));
+	v = _mm_add_epi32(_mm_srai_epi32(wtosc_mullo(v, x), 15),
+			_mm_unpackhi_epi64(t2, t3));
+	return _mm_add_epi32(_mm_srai_epi32(wtosc_mullo(v, x), 15),
+			_mm_unpacklo_epi64(t0, t1));
+}
+
+#endif
+
+/* wtosc_Inter() for four consecutive output samples */
+static inline void wtosc_Inter4(A2O_quality q, void *d, uint64_t ph,
+		unsigned dph, int *v)
+{
+	int i;
+#ifdef A2_SSE2
+	if((q == A2OQ_HERMITE) || (q == A2OQ_HERMITECF))
+	{
+		unsigned p[8];
+		for(i = 0; i < 4; ++i)
+		{
+			p[i] = (ph + (uint64_t)dph * i) >> 16;
+			p[i + 4] = p[i] + (dph >> 17);
+		}
+		if(q == A2OQ_HERMITECF)
+			_mm_storeu_si128((__m128i *)v, _mm_add_epi32(
+					wtosc_Hermite4cf((int32_t *)d, p),
+					wtosc_Hermite4cf((int32_t *)d, p + 4)));
+		else
+			_mm_storeu_si128((__m128i *)v, _mm_add_epi32(
+					wtosc_Hermite4((int16_t *)d, p),
+					wtosc_Hermite4((int16_t *)d, p + 4)));
+		return;
+	}
+#endif
+	for(i = 0; i < 4; ++i)
+		v[i] = wtosc_Inter(q, d, (ph + (uint64_t)dph * i) >> 16,
+				dph >> 16);
+}
+
+/*
+ * A2OQ_HERMITE2 version of wtosc_do_span(). Hermite coefficients are
+ * calculated once per wave sample, and reused for as long as the phase stays
+ * within that sample, which saves a lot of work when playing waves below
+ * their native rate. The output is identical to that of A2OQ_HERMITE.
+ */
+static inline uint64_t wtosc_do_span_h2(A2_wtosc *o, int16_t *d, int32_t *out,
+		unsigned frames, uint64_t ph, unsigned dph, int add)
+{
+	int a = o->a.value;
+	int da = o->a.delta;
+	int32_t cf[2][4];
+	unsigned ci[2] = { ~0U, ~0U };
+	unsigned s;
+	for(s = 0; s < frames; ++s, a += da)
+	{
+		unsigned p[2];
+		int v, i;
+		p[0] = ph >> 16;
+		p[1] = p[0] + (dph >> 17);
+		for(i = 0; i < 2; ++i)
+			if((p[i] >> 8) != ci[i])
+			{
+				ci[i] = p[i] >> 8;
+				a2_Hermite2c(d + ci[i], cf[i]);
+			}
+		v = a2_Hermite2(cf[0], p[0]) + a2_Hermite2(cf[1], p[1]);
+		if(add)
+			out[s] += (int64_t)v * a >> (16 + 1);
+		else
+			out[s] = (int64_t)v * a >> (16 + 1);
+		ph += dph;
+	}
+	o->a.value = a;
+	return ph;
+}
+
+/*
+ * Render a span of 'frames' samples that is known not to need any loop or end
+ * checks. Interpolation is done four samples at a time, and the amplitude ramp
+ * is applied to each block of four samples in a separate pass.
+ *
+ * Returns the final state of the phase accumulator.
+ */
+static inline uint64_t wtosc_do_span(A2_wtosc *o, A2O_quality q, void *d,
+		int32_t *out, unsigned frames, uint64_t ph, unsigned dph,
+		int add)
+{
+	int a = o->a.value;
+	int da = o->a.delta;
+	unsigned s = 0;
+	if(q == A2OQ_HERMITE2)
+		return wtosc_do_span_h2(o, (int16_t *)d, out, frames, ph,
+				dph, add);
+	for( ; s + 4 <= frames; s += 4)
+	{
+		int v[4];
+		int i;
+		wtosc_Inter4(q, d, ph, dph, v);
+		for(i = 0; i < 4; ++i, a += da)
+			if(add)
+				out[s + i] += (int64_t)v[i] * a >> (16 + 1);
+			else
+				out[s + i] = (int64_t)v[i] * a >> (16 + 1);
+		ph += (uint64_t)dph * 4;
+	}
+	for( ; s < frames; ++s, a += da)
+	{
+		int v = wtosc_Inter(q, d, ph >> 16, dph >> 16);
+		if(add)
+			out[s] += (int64_t)v * a >> (16 + 1);
+		else
+			out[s] = (int64_t)v * a >> (16 + 1);
+		ph += dph;
+	}
+	o->a.value = a;
+	return ph;
+}
+
 /*
  * Inner loop inline.
  *	o	Oscillator struct
- *	d	Wave data
+ *	q	Interpolation mode
+ *	d	Wave data (see wtosc_Inter())
  *	out	Output buffer
  *	offset	Start index in output buffer
  *	frames	Number of output samples to render
@@ -195,68 +402,80 @@ static inline int wtosc_check_unloaded(A2_unit *u, A2_wave *w)
  *	looped	(flag) Wave is looped (ignored if wsize == 0)
  *	wsize	Size of wave. Pass 0 to disable loop/end checks.
  *
+ * The fragment is split into spans that don't cross the end of the wave, so
+ * that the loop/end logic only runs once per span, rather than once per sample.
+ *
  * Returns the final state of the phase accumulator.
  */
-static inline uint64_t wtosc_do_fragment(A2_wtosc *o, int16_t *d, int32_t *out,
-		unsigned offset, unsigned frames, uint64_t ph, unsigned dph,
-		int add, int looped, unsigned wsize)
+static inline uint64_t wtosc_do_fragment(A2_wtosc *o, A2O_quality q,
+		void *d, int32_t *out, unsigned offset, unsigned frames,
+		uint64_t ph, unsigned dph, int add, int looped, unsigned wsize)
 {
-	unsigned s;
-	unsigned end = offset + frames;
-	for(s = offset; s < end; ++s)
+	uint64_t wend = (uint64_t)wsize << 24;
+	out += offset;
+	if(!wsize)
+		return wtosc_do_span(o, q, d, out, frames, ph, dph, add);
+	while(frames)
 	{
-		int v;
-		if(wsize)
+		uint64_t n;
+		if(looped)
 		{
-			if(looped)
-			{
-				ph %= (uint64_t)wsize << 24;
-			}
-			else if((ph >> 24) >= wsize)
-			{
-				/*
-				 * End of wave! Clear the rest of the output
-				 * buffer, unless we're in adding mode.
-				 */
-				if(!add)
-					memset(out + s, 0,
-						(end - s) * sizeof(int));
-				break;
-			}
+			ph %= wend;
 		}
-		v = wtosc_Inter(d, ph >> 16, dph >> 16);
-		if(add)
-			out[s] += (int64_t)v * o->a.value >> (16 + 1);
-		else
-			out[s] = (int64_t)v * o->a.value >> (16 + 1);
-		ph += dph;
-		a2_RunRamper(&o->a, 1);
+		else if(ph >= wend)
+		{
+			/*
+			 * End of wave! Clear the rest of the output buffer,
+			 * unless we're in adding mode.
+			 */
+			if(!add)
+				memset(out, 0, frames * sizeof(int));
+			break;
+		}
+
+		/* Number of samples until we reach the end of the wave */
+		n = dph ? (wend - ph + dph - 1) / dph : frames;
+		if(n > frames)
+			n = frames;
+		ph = wtosc_do_span(o, q, d, out, n, ph, dph, add);
+		out += n;
+		frames -= n;
 	}
 	return ph;
 }
 
 
-static inline void wtosc_wavetable(A2_unit *u, unsigned offset,
-		unsigned frames, int add)
+/* Select mip level for the current wave and pitch, and cache the results */
+static inline void wtosc_select_mip(A2_wtosc *o)
 {
-	A2_wtosc *o = wtosc_cast(u);
-	unsigned mm, dph;
-	uint64_t ph;
-	int32_t *out = u->outputs[0];
 	A2_wave *w = o->wave;
-	if(wtosc_check_unloaded(u, w))
-		return;
-
-	wtosc_run_pitch(o, frames);
-	dph = ((o->dphase + 255) >> 8) * w->period;
-	a2_PrepareRamper(&o->a, frames);
-	/* FIXME: Cache, or do something smarter... */
+	unsigned mm;
+	unsigned dph = ((o->dphase + 255) >> 8) * w->period;
 	for(mm = 0; (dph > (A2_MAXPHINC << 8)) &&
 			(mm < A2_MIPLEVELS - 1); ++mm)
 		dph >>= 1;
-	ph = o->phase >> mm;
-	dph = (uint64_t)o->dphase * w->period >> mm;
+	o->mip = mm;
+	o->mipdph = (uint64_t)o->dphase * w->period >> mm;
+}
+
 
+/* Wave data for mip level 'mm', as expected by wtosc_Inter() */
+static inline void *wtosc_wavedata(A2_wave *w, A2O_quality q, unsigned mm)
+{
+	if(q == A2OQ_HERMITECF)
+		return w->d.wave.coeffs[mm] + A2_WAVEPRE * 4;
+	else
+		return w->d.wave.data[mm] + A2_WAVEPRE;
+}
+
+
+/* Render 'frames' samples from mip level 'mm', with phase increment 'dph' */
+static inline void wtosc_render_mip(A2_wtosc *o, A2O_quality q,
+		int32_t *out, unsigned offset, unsigned frames, unsigned mm,
+		uint64_t dph, int add)
+{
+	A2_wave *w = o->wave;
+	uint64_t ph = o->phase >> mm;
 	if(w->flags & A2_LOOPED)
 	{
 		ph %= (uint64_t)w->d.wave.size[mm] << 24;
@@ -273,39 +492,89 @@ static inline void wtosc_wavetable(A2_unit *u, unsigned offset,
 		/* Pitch out of range! Output silence. */
 		if(!add)
 			memset(out + offset, 0, frames * sizeof(int));
-		ph += (uint64_t)dph * frames;
+		ph += dph * frames;
 		o->phase = ph << mm;
 		a2_RunRamper(&o->a, frames);
 	}
 	else
 	{
-		o->phase = wtosc_do_fragment(o,
-				w->d.wave.data[mm] + A2_WAVEPRE, out,
-				offset, frames, ph, dph, add, 0, 0) << mm;
+		o->phase = wtosc_do_fragment(o, q,
+				wtosc_wavedata(w, q, mm), out,
+				offset, frames, ph, (unsigned)dph, add, 0, 0) << mm;
 	}
 }
 
 
-static void wtosc_WavetableAdd(A2_unit *u, unsigned offset, unsigned frames)
+/*
+ * Crossfade from mip level 'from' to the current mip level over one fragment,
+ * to avoid clicks when a pitch sweep crosses a mip level boundary.
+ *
+ * Only a level that can still play the current pitch can be faded out, so
+ * this only happens when moving down. When moving up, we just switch, as the
+ * old level would be silent, and the higher one has less high end anyway.
+ */
+static inline void wtosc_mip_xfade(A2_wtosc *o, A2O_quality q,
+		int32_t *out, unsigned offset, unsigned frames, unsigned from,
+		int add)
 {
-	wtosc_wavetable(u, offset, frames, 1);
+	int32_t ob[A2_MAXFRAG], nb[A2_MAXFRAG];
+	A2_ramper a = o->a;
+	uint64_t phase = o->phase;
+	uint64_t fromdph = (uint64_t)o->dphase * o->wave->period >> from;
+	unsigned s, xf, dxf;
+	if((fromdph > (A2_MAXPHINC << 16)) ||
+			(o->mipdph > (A2_MAXPHINC << 16)))
+	{
+		wtosc_render_mip(o, q, out, offset, frames, o->mip, o->mipdph,
+				add);
+		return;
+	}
+	wtosc_render_mip(o, q, ob, 0, frames, from, fromdph, 0);
+	o->a = a;
+	o->phase = phase;
+	wtosc_render_mip(o, q, nb, 0, frames, o->mip, o->mipdph, 0);
+	out += offset;
+	dxf = (1 << 16) / frames;
+	for(s = 0, xf = 0; s < frames; ++s, xf += dxf)
+	{
+		int v = ob[s] + (((int64_t)nb[s] - ob[s]) * xf >> 16);
+		if(add)
+			out[s] += v;
+		else
+			out[s] = v;
+	}
 }
 
 
-static void wtosc_Wavetable(A2_unit *u, unsigned offset, unsigned frames)
+static inline void wtosc_wavetable(A2_unit *u, unsigned offset,
+		unsigned frames, int add, A2O_quality q)
 {
-	wtosc_wavetable(u, offset, frames, 0);
+	A2_wtosc *o = wtosc_cast(u);
+	int32_t *out = u->outputs[0];
+	int lastmip = o->mip;
+	if(wtosc_check_unloaded(u, o->wave))
+		return;
+
+	/* Only pitch and wave changes affect the mip level */
+	if(wtosc_run_pitch(o, frames) || (lastmip < 0))
+		wtosc_select_mip(o);
+	a2_PrepareRamper(&o->a, frames);
+	if((lastmip >= 0) && (lastmip != o->mip))
+		wtosc_mip_xfade(o, q, out, offset, frames, lastmip, add);
+	else
+		wtosc_render_mip(o, q, out, offset, frames, o->mip, o->mipdph,
+				add);
 }
 
 
 static inline void wtosc_wavetable_no_mip(A2_unit *u, unsigned offset,
-		unsigned frames, int add)
+		unsigned frames, int add, A2O_quality q)
 {
 	A2_wtosc *o = wtosc_cast(u);
 	uint64_t dph;
 	int32_t *out = u->outputs[0];
 	A2_wave *w = o->wave;
-	int16_t *d = w->d.wave.data[0] + A2_WAVEPRE;
+	void *d = wtosc_wavedata(w, q, 0);
 	if(wtosc_check_unloaded(u, w))
 		return;
 
@@ -330,11 +599,13 @@ static inline void wtosc_wavetable_no_mip(A2_unit *u, unsigned offset,
 		 * above the output sample rate, and are muted above that.)
 		 */
 		if(w->flags & A2_LOOPED)
-			o->phase = wtosc_do_fragment(o, d, out, offset, frames,
+			o->phase = wtosc_do_fragment(o, q, d, out, offset,
+					frames,
 					o->phase, dph,
 					add, 1, w->d.wave.size[0]);
 		else
-			o->phase = wtosc_do_fragment(o, d, out, offset, frames,
+			o->phase = wtosc_do_fragment(o, q, d, out, offset,
+					frames,
 					o->phase, dph,
 					add, 0, w->d.wave.size[0]);
 	}
@@ -343,7 +614,7 @@ static inline void wtosc_wavetable_no_mip(A2_unit *u, unsigned offset,
 		/* This inner loop won't check, so we need to check first! */
 		if(w->flags & A2_LOOPED)
 		{
-			o->phase %= w->d.wave.size[0] << 24;
+			o->phase %= (uint64_t)w->d.wave.size[0] << 24;
 		}
 		else if((o->phase >> 24) > (w->d.wave.size[0] + A2_WAVEPRE))
 		{
@@ -351,23 +622,83 @@ static inline void wtosc_wavetable_no_mip(A2_unit *u, unsigned offset,
 				memset(out + offset, 0, frames * sizeof(int));
 			return;		/* All played! */
 		}
-		o->phase = wtosc_do_fragment(o, d, out, offset, frames,
+		o->phase = wtosc_do_fragment(o, q, d, out, offset, frames,
 				o->phase, dph,
 				add, 0, 0);
 	}
 }
 
 
-static void wtosc_WavetableNoMipAdd(A2_unit *u, unsigned offset,
-		unsigned frames)
-{
-	wtosc_wavetable_no_mip(u, offset, frames, 1);
+/* Process callbacks for one interpolation mode */
+#define	WTOSC_PROCESS(q, name)						\
+static void wtosc_Wavetable##name##Add(A2_unit *u, unsigned offset,	\
+		unsigned frames)					\
+{									\
+	wtosc_wavetable(u, offset, frames, 1, q);			\
+}									\
+static void wtosc_Wavetable##name(A2_unit *u, unsigned offset,		\
+		unsigned frames)					\
+{									\
+	wtosc_wavetable(u, offset, frames, 0, q);			\
+}									\
+static void wtosc_WavetableNoMip##name##Add(A2_unit *u,		\
+		unsigned offset, unsigned frames)			\
+{									\
+	wtosc_wavetable_no_mip(u, offset, frames, 1, q);		\
+}									\
+static void wtosc_WavetableNoMip##name(A2_unit *u, unsigned offset,	\
+		unsigned frames)					\
+{									\
+	wtosc_wavetable_no_mip(u, offset, frames, 0, q);		\
 }
 
+WTOSC_PROCESS(A2OQ_NEAREST, Nearest)
+WTOSC_PROCESS(A2OQ_LINEAR, Linear)
+WTOSC_PROCESS(A2OQ_HERMITE, Hermite)
+WTOSC_PROCESS(A2OQ_HERMITE2, Hermite2)
+WTOSC_PROCESS(A2OQ_HERMITECF, HermiteCF)
 
-static void wtosc_WavetableNoMip(A2_unit *u, unsigned offset, unsigned frames)
+#undef	WTOSC_PROCESS
+
+/* Wavetable Process callbacks, indexed as [quality][mipmapped][adding] */
+static const A2_process_cb wtosc_wtprocs[A2OQ__PROCS][2][2] =
 {
-	wtosc_wavetable_no_mip(u, offset, frames, 0);
+	{
+		{ wtosc_WavetableNoMipNearest, wtosc_WavetableNoMipNearestAdd },
+		{ wtosc_WavetableNearest, wtosc_WavetableNearestAdd }
+	},
+	{
+		{ wtosc_WavetableNoMipLinear, wtosc_WavetableNoMipLinearAdd },
+		{ wtosc_WavetableLinear, wtosc_WavetableLinearAdd }
+	},
+	{
+		{ wtosc_WavetableNoMipHermite, wtosc_WavetableNoMipHermiteAdd },
+		{ wtosc_WavetableHermite, wtosc_WavetableHermiteAdd }
+	},
+	{
+		{ wtosc_WavetableNoMipHermite2,
+				wtosc_WavetableNoMipHermite2Add },
+		{ wtosc_WavetableHermite2, wtosc_WavetableHermite2Add }
+	},
+	{
+		{ wtosc_WavetableNoMipHermiteCF,
+				wtosc_WavetableNoMipHermiteCFAdd },
+		{ wtosc_WavetableHermiteCF, wtosc_WavetableHermiteCFAdd }
+	}
+};
+
+
+/* Install the wavetable Process callback for the current wave and quality */
+static inline void wtosc_set_wtprocess(A2_unit *u)
+{
+	A2_wtosc *o = wtosc_cast(u);
+	A2O_quality q = o->quality;
+	if(((q == A2OQ_HERMITE) || (q == A2OQ_HERMITE2)) &&
+			o->wave->d.wave.coeffs[0])
+		q = A2OQ_HERMITECF;
+	u->Process = wtosc_wtprocs[q]
+			[o->wave->type == A2_WMIPWAVE]
+			[(o->flags & A2_PROCADD) != 0];
 }
 
 
@@ -387,17 +718,15 @@ static inline void wtosc_set_phase(A2_wtosc *o, int ph, unsigned sst)
 }
 
 
-static A2_errors wtosc_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+static A2_errors wtosc_Reset(A2_unit *u, A2_vmstate *vms, void *statedata,
 		unsigned flags)
 {
-	A2_config *cfg = (A2_config *)statedata;
 	A2_wtosc *o = wtosc_cast(u);
 	int *ur = u->registers;
 
 	/* Internal state initialization */
-	o->interface = cfg->interface;
-	o->basepitch = cfg->basepitch;
-	o->transpose = vms->r + R_TRANSPOSE;
+	o->noisestate = a2_voice_from_vms(vms)->noisestate;
+	o->mip = -1;
 	o->noise = 0;
 	o->wave = NULL;
 	a2_InitRamper(&o->a, 0);
@@ -411,9 +740,10 @@ static A2_errors wtosc_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 	ur[A2OR_PITCH] = 0;
 	ur[A2OR_AMPLITUDE] = 0;
 	ur[A2OR_PHASE] = 0;
+	ur[A2OR_QUALITY] = A2OQ_DEFAULT << 16;
 
 	/* Install Process callback (Can change at run-time as needed!) */
-	o->flags = flags;
+	o->quality = A2OQ_DEFAULT;
 	if(flags & A2_PROCADD)
 		u->Process = wtosc_OffAdd;
 	else
@@ -423,6 +753,19 @@ static A2_errors wtosc_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 }
 
 
+static A2_errors wtosc_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
+		unsigned flags)
+{
+	A2_config *cfg = (A2_config *)statedata;
+	A2_wtosc *o = wtosc_cast(u);
+	o->interface = cfg->interface;
+	o->basepitch = cfg->basepitch;
+	o->transpose = vms->r + R_TRANSPOSE;
+	o->flags = flags;
+	return wtosc_Reset(u, vms, statedata, flags);
+}
+
+
 static A2_errors wtosc_OpenState(A2_config *cfg, void **statedata)
 {
 	*statedata = cfg;
@@ -435,6 +778,7 @@ static void wtosc_Wave(A2_unit *u, int v, unsigned start, unsigned dur)
 	A2_wtosc *o = wtosc_cast(u);
 	A2_wavetypes wt = A2_WOFF;
 	v >>= 16;
+	o->mip = -1;
 	if((o->wave = a2_GetWave(o->interface, v)))
 		wt = o->wave->type;
 	switch(wt)
@@ -468,16 +812,8 @@ static void wtosc_Wave(A2_unit *u, int v, unsigned start, unsigned dur)
 			u->Process = wtosc_Noise;
 		break;
 	  case A2_WWAVE:
-		if(o->flags & A2_PROCADD)
-			u->Process = wtosc_WavetableNoMipAdd;
-		else
-			u->Process = wtosc_WavetableNoMip;
-		break;
 	  case A2_WMIPWAVE:
-		if(o->flags & A2_PROCADD)
-			u->Process = wtosc_WavetableAdd;
-		else
-			u->Process = wtosc_Wavetable;
+		wtosc_set_wtprocess(u);
 		break;
 	}
 }
@@ -504,33 +840,65 @@ static void wtosc_Phase(A2_unit *u, int v, unsigned start, unsigned dur)
 }
 
 
+static void wtosc_Quality(A2_unit *u, int v, unsigned start, unsigned dur)
+{
+	A2_wtosc *o = wtosc_cast(u);
+	v >>= 16;
+	if(v < 0)
+		v = 0;
+	else if(v >= A2OQ__COUNT)
+		v = A2OQ__COUNT - 1;
+	o->quality = v;
+
+	/* Switch Process callback right away, if we're playing a wave */
+	if(o->wave && ((o->wave->type == A2_WWAVE) ||
+			(o->wave->type == A2_WMIPWAVE)))
+		wtosc_set_wtprocess(u);
+}
+
+
 static const A2_crdesc regs[] =
 {
 	{ "w",		wtosc_Wave		},	/* A2OR_WAVE */
 	{ "p",		wtosc_Pitch		},	/* A2OR_PITCH */
 	{ "a",		wtosc_Amplitude		},	/* A2OR_AMPLITUDE */
 	{ "phase",	wtosc_Phase		},	/* A2OR_PHASE */
+	{ "quality",	wtosc_Quality		},	/* A2OR_QUALITY */
 	{ NULL,	NULL				}
 };
 
-const A2_unitdesc a2_wtosc_unitdesc =
+static const A2_constdesc constants[] =
 {
-	"wtosc",		/* name */
+	{ "NEAREST",	A2OQ_NEAREST << 16	},
+	{ "LERP",	A2OQ_LINEAR << 16	},
+	{ "HERMITE",	A2OQ_HERMITE << 16	},
+	{ "HERMITE2",	A2OQ_HERMITE2 << 16	},
+	{ NULL,	0				}
+};
+
+const A2_unitdescx a2_wtosc_unitdesc =
+{
+	{
+		"wtosc",		/* name */
+
+		A2_UNITDESCX,		/* flags */
 
-	0,			/* flags */
+		regs,			/* registers */
+		NULL,			/* coutputs */
 
-	regs,			/* registers */
-	NULL,			/* coutputs */
+		constants,		/* constants */
 
-	NULL,			/* constants */
+		0,	0,		/* [min,max]inputs */
+		1,	1,		/* [min,max]outputs */
 
-	0,	0,		/* [min,max]inputs */
-	1,	1,		/* [min,max]outputs */
+		sizeof(A2_wtosc),	/* instancesize */
+		wtosc_Initialize,	/* Initialize */
+		NULL,			/* Deinitialize */
 
-	sizeof(A2_wtosc),	/* instancesize */
-	wtosc_Initialize,	/* Initialize */
-	NULL,			/* Deinitialize */
+		wtosc_OpenState,	/* OpenState */
+		NULL			/* CloseState */
+	},
 
-	wtosc_OpenState,	/* OpenState */
-	NULL			/* CloseState */
+	sizeof(A2_unitdescx),	/* size */
+	wtosc_Reset		/* Reset */
 };
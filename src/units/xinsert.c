@@ -89,7 +89,7 @@ static inline void xi_process(A2_unit *u, unsigned o, unsigned f, int add)
 		else
 			obufp[i] = obufs[i];
 		if(!add)
-			memset(obufp[i], 0, sizeof(int32_t) * A2_MAXFRAG);
+			memset(obufp[i] + o, 0, sizeof(int32_t) * f);
 	}
 
 	for(xic = xi->clients; xic; xic = xic->next)
@@ -189,7 +189,7 @@ static A2_errors xi_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 	A2_voice *v = a2_voice_from_vms(vms);
 
 	/* Initialize private fields */
-	xi->state = (A2_state *)statedata;
+	xi->state = a2_VoiceState((A2_state *)statedata, v);
 	xi->flags = flags;
 	xi->clients = NULL;
 	xi->voice = v->handle;
@@ -139,7 +139,7 @@ static A2_errors xsrc_Initialize(A2_unit *u, A2_vmstate *vms, void *statedata,
 	A2_voice *v = a2_voice_from_vms(vms);
 
 	/* Initialize private fields */
-	xi->state = (A2_state *)statedata;
+	xi->state = a2_VoiceState((A2_state *)statedata, v);
 	xi->flags = flags;
 	xi->clients = NULL;
 	xi->voice = v->handle;
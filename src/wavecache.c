@@ -0,0 +1,472 @@
+/*
+ * wavecache.c - Audiality 2 on-disk cache for rendered waves
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Waves rendered by a2_RenderWave() are stored in the cache directory set with
+ * a2_SetWaveCache(), named after a 64 bit FNV-1a hash of everything that
+ * affects the result; the wave parameters, the render parameters, and the
+ * render program, including the contents of any objects it refers to, such as
+ * other programs, waves, units and strings.
+ *
+ * File layout (all values 32 bit, native byte order, unless noted):
+ *	"A2W\0"
+ *	A2_WAVECACHEVERSION
+ *	Key (64 bits)
+ *	Wave type, flags, period
+ *	Number of mip levels, followed by the levels as:
+ *		Size (excluding padding)
+ *		int16_t data[A2_WAVEPRE + size + A2_WAVEPOST]
+ *
+ * Files are written under a temporary name and then renamed, so that readers
+ * never see partially written files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "internals.h"
+
+#define	A2_WAVECACHEVERSION	1
+
+typedef struct A2_wchash
+{
+	A2_interface	*interface;
+	A2_state	*state;
+	uint64_t	hash;
+	A2_handletab	visited;	/* Objects hashed so far */
+	A2_errors	status;		/* First error, if any */
+} A2_wchash;
+
+static const char a2wc_magic[4] = { 'A', '2', 'W', 0 };
+
+
+A2_errors a2_SetWaveCache(A2_interface *i, const char *path)
+{
+	A2_interface_i *ii = (A2_interface_i *)i;
+	A2_sharedstate *ss = ii->state->ss;
+	char *p = NULL;
+	if(path && !(p = strdup(path)))
+		return A2_OOMEMORY;
+	free(ss->wavecache);
+	ss->wavecache = p;
+	return A2_OK;
+}
+
+
+/*---------------------------------------------------------
+	Cache key
+---------------------------------------------------------*/
+
+static void a2wc_Hash(A2_wchash *wh, const void *data, size_t size)
+{
+	const unsigned char *d = (const unsigned char *)data;
+	size_t i;
+	for(i = 0; i < size; ++i)
+		wh->hash = (wh->hash ^ d[i]) * 1099511628211ULL;
+}
+
+static void a2wc_Hash32(A2_wchash *wh, uint32_t v)
+{
+	a2wc_Hash(wh, &v, sizeof(v));
+}
+
+static void a2wc_HashString(A2_wchash *wh, const char *s)
+{
+	a2wc_Hash32(wh, strlen(s));
+	a2wc_Hash(wh, s, strlen(s));
+}
+
+
+static void a2wc_HashObject(A2_wchash *wh, A2_handle h);
+
+/* a2_TranslateHandles() callback; hash the object, and zero the operand */
+static int a2wc_HashOperand(void *userdata, A2_handle h)
+{
+	a2wc_HashObject((A2_wchash *)userdata, h);
+	return 0;
+}
+
+
+/*
+ * Hash function 'func' of 'p', with the handles in the code replaced by the
+ * contents of the objects they refer to.
+ */
+static A2_errors a2wc_HashFunction(A2_wchash *wh, A2_program *p, unsigned func)
+{
+	A2_function *fn = p->funcs + func;
+	int argdefs[A2_MAXARGS];
+	A2_errors res;
+	unsigned *code = malloc(fn->size * sizeof(unsigned));
+	if(!code)
+		return A2_OOMEMORY;
+	memcpy(code, fn->code, fn->size * sizeof(unsigned));
+	memcpy(argdefs, fn->argdefs, sizeof(argdefs));
+	if((res = a2_TranslateHandles(p, func, code, argdefs,
+			a2wc_HashOperand, wh)))
+	{
+		free(code);
+		return res;
+	}
+	a2wc_Hash32(wh, fn->size);
+	a2wc_Hash32(wh, fn->argv);
+	a2wc_Hash32(wh, fn->argc);
+	a2wc_Hash32(wh, fn->topreg);
+	a2wc_Hash(wh, argdefs, sizeof(argdefs));
+	a2wc_Hash(wh, code, fn->size * sizeof(unsigned));
+	free(code);
+	return A2_OK;
+}
+
+
+static A2_errors a2wc_HashProgram(A2_wchash *wh, A2_program *p)
+{
+	A2_structitem *si;
+	A2_errors res;
+	unsigned j;
+	a2wc_Hash(wh, p->eps, sizeof(p->eps));
+	a2wc_Hash32(wh, p->vflags);
+	a2wc_Hash32(wh, p->buffers);
+	a2wc_Hash32(wh, p->nfuncs);
+	for(j = 0; j < p->nfuncs; ++j)
+		if((res = a2wc_HashFunction(wh, p, j)))
+			return res;
+	for(si = p->units; si; si = si->next)
+	{
+		a2wc_HashString(wh, wh->state->ss->units[si->kind]->name);
+		a2wc_Hash32(wh, si->p.unit.flags);
+		a2wc_Hash32(wh, si->p.unit.ninputs);
+		a2wc_Hash32(wh, si->p.unit.noutputs);
+	}
+	for(si = p->wires; si; si = si->next)
+	{
+		a2wc_Hash32(wh, si->kind);
+		a2wc_Hash32(wh, si->p.wire.from_unit);
+		a2wc_Hash32(wh, si->p.wire.from_output);
+		a2wc_Hash32(wh, si->p.wire.to_register);
+	}
+	return A2_OK;
+}
+
+
+static void a2wc_HashWave(A2_wchash *wh, A2_wave *w)
+{
+	a2wc_Hash32(wh, w->type);
+	a2wc_Hash32(wh, w->flags);
+	a2wc_Hash32(wh, w->period);
+	switch(w->type)
+	{
+	  case A2_WWAVE:
+	  case A2_WMIPWAVE:
+		/* Mip levels and padding are derived from level 0 */
+		a2wc_Hash32(wh, w->d.wave.size[0]);
+		a2wc_Hash(wh, w->d.wave.data[0] + A2_WAVEPRE,
+				w->d.wave.size[0] * sizeof(int16_t));
+		break;
+	  default:
+		break;
+	}
+}
+
+
+/*
+ * Hash the contents of object 'h'. Objects that have already been hashed are
+ * hashed as references, so that recursive programs don't recurse forever.
+ */
+static void a2wc_HashObject(A2_wchash *wh, A2_handle h)
+{
+	RCHM_handleinfo *hi;
+	int j = a2ht_FindItem(&wh->visited, h);
+	if(j >= 0)
+	{
+		a2wc_Hash32(wh, ~0);
+		a2wc_Hash32(wh, j);
+		return;
+	}
+	a2ht_AddItem(&wh->visited, h);
+	if(!(hi = rchm_Get(&wh->state->ss->hm, h)) || !hi->typecode)
+	{
+		a2wc_Hash32(wh, h);
+		return;
+	}
+	a2wc_Hash32(wh, hi->typecode);
+	switch((A2_otypes)hi->typecode)
+	{
+	  case A2_TPROGRAM:
+	  {
+		A2_errors res = a2wc_HashProgram(wh, (A2_program *)hi->d.data);
+		if(res && !wh->status)
+			wh->status = res;
+		break;
+	  }
+	  case A2_TWAVE:
+		a2wc_HashWave(wh, (A2_wave *)hi->d.data);
+		break;
+	  case A2_TUNIT:
+		a2wc_HashString(wh,
+				a2_GetUnitDescriptor(wh->interface, h)->name);
+		break;
+	  case A2_TSTRING:
+		a2wc_HashString(wh, a2_String(wh->interface, h));
+		break;
+	  case A2_TCONSTANT:
+	  {
+		double v = a2_Value(wh->interface, h);
+		a2wc_Hash(wh, &v, sizeof(v));
+		break;
+	  }
+	  default:
+		a2wc_Hash32(wh, h);
+		break;
+	}
+}
+
+
+A2_errors a2_WaveCacheKey(A2_interface *i, A2_renderjob *job, uint64_t *key)
+{
+	A2_wchash wh;
+	A2_sharedstate *ss;
+	A2_property *props;
+	A2_wave *w;
+	unsigned j;
+	memset(&wh, 0, sizeof(wh));
+	wh.interface = i;
+	wh.state = ((A2_interface_i *)i)->state;
+	ss = wh.state->ss;
+	if(!ss->wavecache)
+		return A2_NOTFOUND;
+	if((a2_TypeOf(i, job->program) != A2_TPROGRAM) ||
+			!(w = a2_GetWave(i, job->wave)))
+		return A2_WRONGTYPE;
+	wh.hash = 14695981039346656037ULL;
+	a2wc_Hash32(&wh, A2_WAVECACHEVERSION);
+	a2wc_Hash32(&wh, A2_VERSION);
+	a2wc_Hash32(&wh, A2_OPCODES);
+	a2wc_Hash32(&wh, w->type);
+	a2wc_Hash32(&wh, w->period);
+	a2wc_Hash32(&wh, w->flags & ~A2_UNPREPARED);
+	a2wc_Hash32(&wh, job->samplerate);
+	a2wc_Hash32(&wh, job->length);
+	a2wc_Hash32(&wh, ss->offlinebuffer);
+	a2wc_Hash32(&wh, ss->silencelevel);
+	a2wc_Hash32(&wh, ss->silencewindow);
+	a2wc_Hash32(&wh, ss->silencegrace);
+	for(props = job->props; props && props->property; ++props)
+	{
+		a2wc_Hash32(&wh, props->property);
+		a2wc_Hash32(&wh, props->value);
+	}
+
+	/*
+	 * We can't tell handles from numbers in arguments, so we hash the
+	 * contents of anything that looks like a handle, to be safe.
+	 */
+	a2wc_Hash32(&wh, job->argc);
+	for(j = 0; j < job->argc; ++j)
+	{
+		int a = job->argv[j];
+		a2wc_Hash32(&wh, a);
+		if(!(a & 0xffff) && (a > 0))
+			switch(a2_TypeOf(i, a >> 16))
+			{
+			  case A2_TPROGRAM:
+			  case A2_TWAVE:
+			  case A2_TSTRING:
+			  case A2_TCONSTANT:
+				a2wc_HashObject(&wh, a >> 16);
+				break;
+			  default:
+				break;
+			}
+	}
+
+	a2wc_HashObject(&wh, job->program);
+	a2ht_Cleanup(&wh.visited);
+	*key = wh.hash;
+	return wh.status;
+}
+
+
+/*---------------------------------------------------------
+	Cache files
+---------------------------------------------------------*/
+
+static char *a2wc_FileName(A2_sharedstate *ss, uint64_t key)
+{
+	size_t len = strlen(ss->wavecache) + 32;
+	char *fn = malloc(len);
+	if(!fn)
+		return NULL;
+	snprintf(fn, len, "%s/%016llx.a2w", ss->wavecache,
+			(unsigned long long)key);
+	return fn;
+}
+
+
+static int a2wc_Levels(A2_wave *w)
+{
+	switch(w->type)
+	{
+	  case A2_WWAVE:
+		return 1;
+	  case A2_WMIPWAVE:
+		return A2_MIPLEVELS;
+	  default:
+		return 0;
+	}
+}
+
+
+static A2_errors a2wc_Read(FILE *f, A2_wave *w, uint64_t key)
+{
+	char magic[4];
+	uint32_t hdr[5];
+	uint64_t k;
+	unsigned size0 = 0;
+	int j;
+	if((fread(magic, sizeof(magic), 1, f) != 1) ||
+			(fread(&hdr[0], sizeof(uint32_t), 1, f) != 1) ||
+			(fread(&k, sizeof(k), 1, f) != 1) ||
+			(fread(&hdr[1], sizeof(uint32_t), 4, f) != 4))
+		return A2_READ;
+	if(memcmp(magic, a2wc_magic, sizeof(magic)) ||
+			(hdr[0] != A2_WAVECACHEVERSION) || (k != key))
+		return A2_OUTOFDATE;
+	if((hdr[1] != w->type) ||
+			(hdr[2] != (w->flags & ~A2_UNPREPARED)) ||
+			(hdr[3] != w->period) || (hdr[4] != a2wc_Levels(w)))
+		return A2_BADFORMAT;
+	for(j = 0; j < hdr[4]; ++j)
+	{
+		uint32_t size;
+		if(fread(&size, sizeof(size), 1, f) != 1)
+			return A2_READ;
+		if(!j)
+			size0 = size;
+		else if(size != (size0 + (1 << j) - 1) >> j)
+			return A2_BADFORMAT;
+		size += A2_WAVEPRE + A2_WAVEPOST;
+		if(!(w->d.wave.data[j] = malloc(size * sizeof(int16_t))))
+			return A2_OOMEMORY;
+		if(fread(w->d.wave.data[j], sizeof(int16_t), size, f) != size)
+			return A2_READ;
+		w->d.wave.size[j] = size - A2_WAVEPRE - A2_WAVEPOST;
+	}
+	return A2_OK;
+}
+
+
+A2_errors a2_WaveCacheLoad(A2_interface *i, uint64_t key, A2_handle wave)
+{
+	A2_sharedstate *ss = ((A2_interface_i *)i)->state->ss;
+	A2_wave *w = a2_GetWave(i, wave);
+	A2_errors res;
+	FILE *f;
+	int j;
+	char *fn;
+	if(!w || !(w->flags & A2_UNPREPARED))
+		return A2_WRONGTYPE;
+	if(!(fn = a2wc_FileName(ss, key)))
+		return A2_OOMEMORY;
+	f = fopen(fn, "rb");
+	free(fn);
+	if(!f)
+		return A2_NOTFOUND;
+	res = a2wc_Read(f, w, key);
+	fclose(f);
+	if(!res)
+		res = a2_PrepareCoeffs(w);
+	if(res)
+	{
+		/* Leave the wave as we found it, so it can be rendered */
+		for(j = 0; j < A2_MIPLEVELS; ++j)
+		{
+			free(w->d.wave.data[j]);
+			w->d.wave.data[j] = NULL;
+			free(w->d.wave.coeffs[j]);
+			w->d.wave.coeffs[j] = NULL;
+			w->d.wave.size[j] = 0;
+		}
+		return res;
+	}
+	w->flags &= ~A2_UNPREPARED;
+	return A2_OK;
+}
+
+
+A2_errors a2_WaveCacheStore(A2_interface *i, uint64_t key, A2_handle wave)
+{
+	A2_sharedstate *ss = ((A2_interface_i *)i)->state->ss;
+	A2_wave *w = a2_GetWave(i, wave);
+	A2_errors res = A2_OK;
+	size_t len;
+	char *fn, *tmp;
+	FILE *f;
+	int j;
+	if(!w)
+		return A2_WRONGTYPE;
+	if(!(fn = a2wc_FileName(ss, key)))
+		return A2_OOMEMORY;
+	len = strlen(fn) + 32;
+	if(!(tmp = malloc(len)))
+	{
+		free(fn);
+		return A2_OOMEMORY;
+	}
+	snprintf(tmp, len, "%s.%d.%d.tmp", fn, (int)getpid(), wave);
+	if(!(f = fopen(tmp, "wb")))
+	{
+		free(tmp);
+		free(fn);
+		return A2_OPEN;
+	}
+	{
+		uint32_t v = A2_WAVECACHEVERSION;
+		uint32_t hdr[4] = {
+			w->type, w->flags & ~A2_UNPREPARED, w->period,
+			a2wc_Levels(w)
+		};
+		if((fwrite(a2wc_magic, sizeof(a2wc_magic), 1, f) != 1) ||
+				(fwrite(&v, sizeof(v), 1, f) != 1) ||
+				(fwrite(&key, sizeof(key), 1, f) != 1) ||
+				(fwrite(hdr, sizeof(hdr), 1, f) != 1))
+			res = A2_WRITE;
+	}
+	for(j = 0; !res && (j < a2wc_Levels(w)); ++j)
+	{
+		uint32_t size = w->d.wave.size[j];
+		size_t n = A2_WAVEPRE + size + A2_WAVEPOST;
+		if((fwrite(&size, sizeof(size), 1, f) != 1) ||
+				(fwrite(w->d.wave.data[j], sizeof(int16_t), n,
+				f) != n))
+			res = A2_WRITE;
+	}
+	if(fclose(f) && !res)
+		res = A2_WRITE;
+	if(!res && rename(tmp, fn))
+		res = A2_WRITE;
+	if(res)
+		remove(tmp);
+	free(tmp);
+	free(fn);
+	return res;
+}
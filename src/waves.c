@@ -55,8 +55,31 @@ static int a2_sample_size(A2_sampleformats fmt)
 }
 
 
-/* Allocate buffers for 'length' samples at mip level 0 */
-static A2_errors a2_wave_alloc(A2_wave *w, unsigned length)
+/* Allocate Hermite coefficient buffers for mip levels [0, 'miplevels') */
+static A2_errors a2_coeffs_alloc(A2_wave *w, int miplevels)
+{
+	int i;
+	if(!(w->flags & A2_FAST))
+		return A2_OK;
+	for(i = 0; i < miplevels; ++i)
+	{
+		A2_wave_wave *ww = &w->d.wave;
+		int size = A2_WAVEPRE + ww->size[i] + A2_WAVEPOST;
+		if(ww->coeffs[i])
+			continue;
+		ww->coeffs[i] = (int32_t *)malloc(size * 4 * sizeof(int32_t));
+		if(!ww->coeffs[i])
+			return A2_OOMEMORY;
+	}
+	return A2_OK;
+}
+
+
+/*
+ * Allocate buffers for 'length' samples at mip level 0, starting at mip level
+ * 'first'.
+ */
+static A2_errors a2_wave_alloc(A2_wave *w, unsigned length, int first)
 {
 	int i, miplevels;
 	switch(w->type)
@@ -70,7 +93,7 @@ static A2_errors a2_wave_alloc(A2_wave *w, unsigned length)
 	  default:
 		return A2_OK;
 	}
-	for(i = 0; i < miplevels; ++i)
+	for(i = first; i < miplevels; ++i)
 	{
 		A2_wave_wave *ww = &w->d.wave;
 		int size = (length + (1 << i) - 1) >> i;
@@ -83,7 +106,7 @@ static A2_errors a2_wave_alloc(A2_wave *w, unsigned length)
 		if(!ww->data[i])
 			return A2_OOMEMORY;
 	}
-	return A2_OK;
+	return a2_coeffs_alloc(w, miplevels);
 }
 
 
@@ -105,6 +128,25 @@ static void a2_fix_pad(A2_wave *w, unsigned miplevel)
 	}
 }
 
+/*
+ * Calculate the a2_Hermite2c() coefficients for every sample of mip level
+ * 'miplevel' of an A2_FAST wave. Records that would need samples from outside
+ * the buffer are never used by the interpolators, and are just cleared.
+ */
+static void a2_calc_coeffs(A2_wave *w, unsigned miplevel)
+{
+	int32_t *cf = w->d.wave.coeffs[miplevel];
+	int16_t *d = w->d.wave.data[miplevel];
+	unsigned size = A2_WAVEPRE + w->d.wave.size[miplevel] + A2_WAVEPOST;
+	unsigned s;
+	if(!cf)
+		return;
+	memset(cf, 0, 4 * sizeof(int32_t));
+	for(s = 1; s < size - 2; ++s)
+		a2_Hermite2c(d + s, cf + s * 4);
+	memset(cf + (size - 2) * 4, 0, 2 * 4 * sizeof(int32_t));
+}
+
 static void a2_render_mipmaps(A2_wave *w)
 {
 	int i;
@@ -113,6 +155,7 @@ static void a2_render_mipmaps(A2_wave *w)
 	  case A2_WWAVE:
 	  case A2_WMIPWAVE:
 		a2_fix_pad(w, 0);
+		a2_calc_coeffs(w, 0);
 		if(w->type == A2_WMIPWAVE)
 			break;
 	  default:
@@ -127,6 +170,7 @@ static void a2_render_mipmaps(A2_wave *w)
 			d[s] = (((int)sd[s * 2] << 1) + sd[s * 2 - 1] +
 					sd[s * 2 + 1]) >> 2;
 		a2_fix_pad(w, i);
+		a2_calc_coeffs(w, i);
 	}
 #if 0
 	printf("-------------\n");
@@ -516,7 +560,7 @@ static A2_errors a2_wave_stream_flush(A2_stream *str)
 	A2_errors res = A2_OK;
 	if(w->flags & A2_UNPREPARED)
 	{
-		res = a2_wave_alloc(w, a2_calc_upload_length(str));
+		res = a2_wave_alloc(w, a2_calc_upload_length(str), 0);
 		if(res == A2_OK)
 			res = a2_apply_upload_buffers(str);
 		a2_postprocess(w);
@@ -528,6 +572,38 @@ static A2_errors a2_wave_stream_flush(A2_stream *str)
 
 
 
+A2_errors a2_PrepareWave(A2_wave *w, int16_t *data, unsigned length)
+{
+	A2_errors res;
+	if(!(w->flags & A2_UNPREPARED) || (w->flags & A2_NORMALIZE) ||
+			((w->type != A2_WWAVE) && (w->type != A2_WMIPWAVE)))
+	{
+		free(data);
+		return A2_WRONGTYPE;
+	}
+	w->d.wave.data[0] = data;
+	w->d.wave.size[0] = length;
+	if((res = a2_wave_alloc(w, length, 1)))
+		return res;
+	a2_postprocess(w);
+	w->flags &= ~A2_UNPREPARED;
+	a2_render_mipmaps(w);
+	return A2_OK;
+}
+
+
+A2_errors a2_PrepareCoeffs(A2_wave *w)
+{
+	A2_errors res;
+	int i, miplevels = w->type == A2_WMIPWAVE ? A2_MIPLEVELS : 1;
+	if((res = a2_coeffs_alloc(w, miplevels)))
+		return res;
+	for(i = 0; i < miplevels; ++i)
+		a2_calc_coeffs(w, i);
+	return A2_OK;
+}
+
+
 /* OpenStream() method for A2_TWAVE objects */
 static A2_errors a2_wave_stream_open(A2_stream *str, A2_handle h)
 {
@@ -579,7 +655,7 @@ A2_handle a2_UploadWave(A2_interface *i,
 		gain = a2_normalize_gain(fmt, data, size);
 	else
 		gain = 1.0f;
-	if((res = a2_wave_alloc(w, size)) ||
+	if((res = a2_wave_alloc(w, size, 0)) ||
 			(res = a2_do_write(w, 0, gain, fmt, data, size)))
 	{
 		a2_Release(i, h);
@@ -656,7 +732,7 @@ A2_errors a2_InitWaves(A2_interface *i, A2_handle bank)
 	for(s = 0; s < A2_WAVEPERIOD; ++s)
 		buf[s] = s * 65534 / A2_WAVEPERIOD - 32767;
 	h = a2_upload_export(i, bank, "saw", A2_WMIPWAVE, A2_WAVEPERIOD,
-			A2_LOOPED, A2_I16, buf, sizeof(buf));
+			A2_LOOPED | A2_FAST, A2_I16, buf, sizeof(buf));
 	if(h < 0)
 		return -h;
 
@@ -666,7 +742,7 @@ A2_errors a2_InitWaves(A2_interface *i, A2_handle bank)
 				buf[s + A2_WAVEPERIOD / 4] =
 				s * 65534 * 2 / A2_WAVEPERIOD - 32767;
 	h = a2_upload_export(i, bank, "triangle", A2_WMIPWAVE, A2_WAVEPERIOD,
-			A2_LOOPED, A2_I16, buf, sizeof(buf));
+			A2_LOOPED | A2_FAST, A2_I16, buf, sizeof(buf));
 	if(h < 0)
 		return -h;
 
@@ -674,28 +750,28 @@ A2_errors a2_InitWaves(A2_interface *i, A2_handle bank)
 	for(s = 0; s < A2_WAVEPERIOD; ++s)
 		buf[s] = sin(s * 2.0f * M_PI / A2_WAVEPERIOD) * 32767.0f;
 	h = a2_upload_export(i, bank, "sine", A2_WMIPWAVE, A2_WAVEPERIOD,
-			A2_LOOPED, A2_I16, buf, sizeof(buf));
+			A2_LOOPED | A2_FAST, A2_I16, buf, sizeof(buf));
 	if(h < 0)
 		return -h;
 
 	for(s = A2_WAVEPERIOD / 2; s < A2_WAVEPERIOD; ++s)
 		buf[s] = -buf[s];
 	h = a2_upload_export(i, bank, "asine", A2_WMIPWAVE, A2_WAVEPERIOD,
-			A2_LOOPED, A2_I16, buf, sizeof(buf));
+			A2_LOOPED | A2_FAST, A2_I16, buf, sizeof(buf));
 	if(h < 0)
 		return -h;
 
 	for(s = A2_WAVEPERIOD / 2; s < A2_WAVEPERIOD; ++s)
 		buf[s] = 0;
 	h = a2_upload_export(i, bank, "hsine", A2_WMIPWAVE, A2_WAVEPERIOD,
-			A2_LOOPED, A2_I16, buf, sizeof(buf));
+			A2_LOOPED | A2_FAST, A2_I16, buf, sizeof(buf));
 	if(h < 0)
 		return -h;
 
 	for(s = 0; s < A2_WAVEPERIOD / 4; ++s)
 		buf[s + A2_WAVEPERIOD / 2] = buf[s];
 	h = a2_upload_export(i, bank, "qsine", A2_WMIPWAVE, A2_WAVEPERIOD,
-			A2_LOOPED, A2_I16, buf, sizeof(buf));
+			A2_LOOPED | A2_FAST, A2_I16, buf, sizeof(buf));
 	if(h < 0)
 		return -h;
 
@@ -739,11 +815,15 @@ static RCHM_errors a2_wave_destructor(RCHM_handleinfo *hi, void *ti, RCHM_handle
 	  case A2_WWAVE:
 	  	a2_discard_wave(st, w);
 		free(w->d.wave.data[0]);
+		free(w->d.wave.coeffs[0]);
 		break;
 	  case A2_WMIPWAVE:
 	  	a2_discard_wave(st, w);
 		for(i = 0; i < A2_MIPLEVELS; ++i)
+		{
 			free(w->d.wave.data[i]);
+			free(w->d.wave.coeffs[i]);
+		}
 		break;
 	}
 	return RCHM_OK;
@@ -0,0 +1,186 @@
+/*
+ * workers.c - Audiality 2 worker thread pool
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdlib.h>
+#include "internals.h"
+
+/*
+ * The current job is published through a single atomic word, holding job
+ * generation, item count and next item to claim, so that threads can join
+ * jobs and claim items without taking any locks. An item is only claimed if
+ * the word is unchanged since the job fields were read.
+ */
+#define	A2_WK_ITEMBITS	8
+#define	A2_WK_ITEMMASK	((1 << A2_WK_ITEMBITS) - 1)
+#define	A2_WK_GENSHIFT	(A2_WK_ITEMBITS * 2)
+
+struct A2_workers
+{
+	A2_sem		wake;		/* Posted once per worker wanted */
+	A2_sem		finished;	/* Posted by worker finishing a job */
+	A2_thread	*threads;
+	unsigned	nthreads;
+	A2_atomic	quit;
+
+	/* Current job */
+	A2_atomic	job;		/* Generation | item count | next item */
+	A2_workfunc	func;
+	void		*userdata;
+	A2_atomic	done;		/* Number of items completed */
+};
+
+
+/*
+ * Claim and run items until there are none left in the current job. Items are
+ * handed out in order, but whoever gets there first takes the next one, so a
+ * slow item doesn't hold up the rest of the job.
+ *
+ * Returns 1 if the calling thread completed the last item of the job.
+ */
+static int a2_worker_claim(A2_workers *wk)
+{
+	int last = 0;
+	while(1)
+	{
+		unsigned job = a2_AtomicAdd(&wk->job, 0);
+		A2_workfunc func = wk->func;
+		void *userdata = wk->userdata;
+		unsigned item = job & A2_WK_ITEMMASK;
+		unsigned nitems = (job >> A2_WK_ITEMBITS) & A2_WK_ITEMMASK;
+		if(item >= nitems)
+			return last;
+		if(!a2_AtomicCAS(&wk->job, job, job + 1))
+			continue;	/* Someone beat us to it, or new job */
+		func(userdata, item);
+		if(a2_AtomicAdd(&wk->done, 1) == nitems - 1)
+			last = 1;
+	}
+}
+
+
+static void a2_worker_thread(void *userdata)
+{
+	A2_workers *wk = (A2_workers *)userdata;
+	while(1)
+	{
+		a2_SemWait(&wk->wake);
+		if(a2_AtomicAdd(&wk->quit, 0))
+			break;
+		if(a2_worker_claim(wk))
+			a2_SemPost(&wk->finished);
+	}
+}
+
+
+A2_workers *a2_OpenWorkers(unsigned nthreads)
+{
+	unsigned i;
+	A2_workers *wk = (A2_workers *)calloc(1, sizeof(A2_workers));
+	if(!wk)
+		return NULL;
+	if(!(wk->threads = (A2_thread *)calloc(nthreads, sizeof(A2_thread))))
+	{
+		free(wk);
+		return NULL;
+	}
+	if(a2_SemOpen(&wk->wake))
+	{
+		free(wk->threads);
+		free(wk);
+		return NULL;
+	}
+	if(a2_SemOpen(&wk->finished))
+	{
+		a2_SemClose(&wk->wake);
+		free(wk->threads);
+		free(wk);
+		return NULL;
+	}
+	for(i = 0; i < nthreads; ++i)
+	{
+		if(a2_ThreadStart(&wk->threads[i], a2_worker_thread, wk))
+		{
+			a2_CloseWorkers(wk);
+			return NULL;
+		}
+		++wk->nthreads;
+	}
+	return wk;
+}
+
+
+void a2_CloseWorkers(A2_workers *wk)
+{
+	unsigned i;
+	a2_AtomicAdd(&wk->quit, 1);
+	for(i = 0; i < wk->nthreads; ++i)
+		a2_SemPost(&wk->wake);
+	for(i = 0; i < wk->nthreads; ++i)
+		a2_ThreadJoin(&wk->threads[i]);
+	a2_SemClose(&wk->finished);
+	a2_SemClose(&wk->wake);
+	free(wk->threads);
+	free(wk);
+}
+
+
+void a2_RunWorkers(A2_workers *wk, A2_workfunc func, void *userdata,
+		unsigned nitems)
+{
+	unsigned i, job, wanted;
+
+	/*
+	 * Not worth waking anyone up for a single item! Jobs that don't fit
+	 * in the job word are processed by the calling thread as well.
+	 */
+	if(!wk || (nitems < 2) || (nitems > A2_WK_ITEMMASK))
+	{
+		for(i = 0; i < nitems; ++i)
+			func(userdata, i);
+		return;
+	}
+
+	/*
+	 * Post the job. All items of the previous job have been claimed, so
+	 * the job word only changes here until we publish the new one.
+	 */
+	wk->func = func;
+	wk->userdata = userdata;
+	wk->done = 0;
+	job = a2_AtomicAdd(&wk->job, 0);
+	job = (((job >> A2_WK_GENSHIFT) + 1) << A2_WK_GENSHIFT) |
+			(nitems << A2_WK_ITEMBITS);
+	while(!a2_AtomicCAS(&wk->job, wk->job, job))
+		;
+	wanted = nitems - 1;
+	if(wanted > wk->nthreads)
+		wanted = wk->nthreads;
+	for(i = 0; i < wanted; ++i)
+		a2_SemPost(&wk->wake);
+
+	/*
+	 * Lend a hand, and unless we completed the last item ourselves, wait
+	 * for whoever is working on it to tell us when it's done.
+	 */
+	if(!a2_worker_claim(wk))
+		a2_SemWait(&wk->finished);
+}
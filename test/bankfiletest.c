@@ -0,0 +1,246 @@
+/*
+ * bankfiletest.c - Check saving and loading precompiled bank files
+ *
+ *	Compiles a bank that imports a chain of other banks, saves it as a bank
+ *	file, and moves it together with the scripts. The loaded bank file must
+ *	render the same as the script, and must not be used with other
+ *	compiler flags, or after an indirectly imported script is changed.
+ *	Bank files with corrupt operands must be rejected, or play safely.
+ *
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "checks.h"
+
+#define	FRAMES	88200	/* 2 s */
+#define	CORRUPTFRAMES	8192
+
+/* Magic, file version, engine version, opcodes, flags, source size, hash */
+#define	HEADERWORDS	7
+
+static const char *scripts[] = {
+	"bankfile.a2s",
+	"bankfileimport.a2s",
+	"bankfileimport2.a2s",
+	NULL
+};
+
+static char fn[1024];
+
+static const char *path(const char *dir, const char *sub, const char *name)
+{
+	snprintf(fn, sizeof(fn), "%s/%s/%s", dir, sub, name);
+	return fn;
+}
+
+
+/* Read bank file 'bfn' into 'buf', returning the size in bytes */
+static size_t readfile(const char *bfn, char *buf, size_t max)
+{
+	size_t n;
+	FILE *f;
+	if(!(f = fopen(bfn, "rb")))
+		chk_Fail(bfn, A2_OPEN);
+	n = fread(buf, 1, max, f);
+	chk_Assert(feof(f), "Bank file larger than expected");
+	fclose(f);
+	return n;
+}
+
+
+static void writefile(const char *bfn, const char *buf, size_t n)
+{
+	FILE *f;
+	if(!(f = fopen(bfn, "wb")))
+		chk_Fail(bfn, A2_OPEN);
+	if(fwrite(buf, 1, n, f) != n)
+		chk_Fail(bfn, A2_WRITE);
+	fclose(f);
+}
+
+
+/*
+ * Put out of range values in the a1 and a2 fields of each word after the header
+ * of bank file 'bfn' in turn, which hits register, branch, function, entry
+ * point and channel count operands, amongst other things. Any variants that
+ * load must play without VM errors taking the engine down. (Run this under
+ * Valgrind or ASan to catch out of bounds accesses as well.)
+ */
+static void corrupt(CHK_engine *e, const char *bfn)
+{
+	static const uint32_t masks[] = { 0x0000ff00, 0x7fff0000, 0 };
+	static char buf[65536], bad[65536];
+	size_t pos, n = readfile(bfn, buf, sizeof(buf));
+	int m;
+	for(m = 0; masks[m]; ++m)
+		for(pos = HEADERWORDS * 4; pos + 4 <= n; pos += 4)
+		{
+			A2_handle h, sh;
+			uint32_t w;
+			memcpy(bad, buf, n);
+			memcpy(&w, bad + pos, 4);
+			w |= masks[m];
+			memcpy(bad + pos, &w, 4);
+			writefile(bfn, bad, n);
+			chk_Open(e, 0, A2_SILENT);
+			if((h = a2_LoadCompiled(e->iface, bfn, 0)) >= 0)
+			{
+				if((sh = a2_Get(e->iface, h, "Song")) >= 0)
+					a2_Play(e->iface, a2_RootVoice(e->iface),
+							sh);
+				chk_Render(e, CORRUPTFRAMES, 0);
+			}
+			a2_Close(e->iface);
+		}
+	writefile(bfn, buf, n);
+}
+
+
+static void copy(const char *from, const char *to, const char *extra)
+{
+	char buf[4096];
+	size_t n;
+	FILE *in, *out;
+	if(!(in = fopen(from, "rb")))
+		chk_Fail(from, A2_OPEN);
+	if(!(out = fopen(to, "wb")))
+		chk_Fail(to, A2_OPEN);
+	while((n = fread(buf, 1, sizeof(buf), in)))
+		if(fwrite(buf, 1, n, out) != n)
+			chk_Fail(to, A2_WRITE);
+	if(extra)
+		fputs(extra, out);
+	fclose(in);
+	fclose(out);
+}
+
+
+/* Create the directories 'dir'/a and 'dir'/b, with no files in them */
+static void setup(const char *dir)
+{
+	const char *subs[] = { "a", "b", NULL };
+	int i, j;
+	for(i = 0; subs[i]; ++i)
+	{
+		snprintf(fn, sizeof(fn), "%s/%s", dir, subs[i]);
+		if(mkdir(fn, 0777) && (errno != EEXIST))
+			chk_Fail(fn, A2_WRITE);
+		for(j = 0; scripts[j]; ++j)
+		{
+			unlink(path(dir, subs[i], scripts[j]));
+			unlink(path(dir, subs[i], "bankfile.a2b"));
+		}
+	}
+}
+
+
+/* Render the song of bank 'bank' and return the hash */
+static uint64_t render(CHK_engine *e, A2_handle bank)
+{
+	A2_handle h;
+	if(bank < 0)
+		chk_Fail("Loading bank", -bank);
+	if((h = a2_Get(e->iface, bank, "Song")) < 0)
+		chk_Fail("Song", -h);
+	a2_Play(e->iface, a2_RootVoice(e->iface), h);
+	return chk_Render(e, FRAMES, 0);
+}
+
+
+/* Load bank file 'fn' and return the result */
+static A2_handle load(CHK_engine *e, const char *bfn, unsigned flags)
+{
+	chk_Open(e, 0, flags);
+	return a2_LoadCompiled(e->iface, bfn, 0);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	CHK_engine e;
+	A2_handle h;
+	A2_errors res;
+	uint64_t ref, hash;
+	char src[256], dst[1024];
+	const char *dir = argc > 1 ? argv[1] : "bankfile";
+	int i;
+	setup(dir);
+	for(i = 0; scripts[i]; ++i)
+	{
+		snprintf(src, sizeof(src), "data/%s", scripts[i]);
+		copy(src, path(dir, "a", scripts[i]), NULL);
+	}
+
+	/* Compile, render and save */
+	chk_Open(&e, 0, 0);
+	h = a2_Load(e.iface, path(dir, "a", "bankfile.a2s"), A2_NOCOMPILED);
+	ref = render(&e, h);
+	chk_Assert(ref != chk_Render(&e, FRAMES, 0), "Song is silent");
+	if((res = a2_SaveBank(e.iface, h, path(dir, "a", "bankfile.a2b"))))
+		chk_Fail("a2_SaveBank()", res);
+	a2_Close(e.iface);
+
+	/* Move everything, so that imports must be found next to the file */
+	for(i = 0; scripts[i]; ++i)
+	{
+		snprintf(dst, sizeof(dst), "%s/b/%s", dir, scripts[i]);
+		if(rename(path(dir, "a", scripts[i]), dst))
+			chk_Fail(dst, A2_WRITE);
+	}
+	snprintf(dst, sizeof(dst), "%s/b/bankfile.a2b", dir);
+	if(rename(path(dir, "a", "bankfile.a2b"), dst))
+		chk_Fail(dst, A2_WRITE);
+
+	/* Load and render the bank file */
+	hash = render(&e, load(&e, dst, 0));
+	a2_Close(e.iface);
+	chk_Assert(hash == ref, "Bank file renders differently from script");
+
+	/* Other compiler flags must bypass the bank file */
+	h = load(&e, dst, A2_NOOPTIMIZE);
+	a2_Close(e.iface);
+	chk_Assert(h == -A2_OUTOFDATE,
+			"Bank file used with other compiler flags");
+
+	/* Corrupt bank files must be rejected, or at least be safe to play */
+	corrupt(&e, dst);
+
+	/* Changing an indirectly imported script must bypass the bank file */
+	copy("data/bankfileimport2.a2s", path(dir, "b", "bankfileimport2.a2s"),
+			"// Changed\n");
+	h = load(&e, dst, 0);
+	a2_Close(e.iface);
+	chk_Assert(h == -A2_OUTOFDATE,
+			"Bank file used with changed imported script");
+
+	/* a2_Load() must fall back to compiling the script */
+	chk_Open(&e, 0, 0);
+	hash = render(&e, a2_Load(e.iface, path(dir, "b", "bankfile.a2s"), 0));
+	a2_Close(e.iface);
+	chk_Assert(hash == ref, "Recompiled bank renders differently");
+
+	printf("Bank file round-trip OK\n");
+	return 0;
+}
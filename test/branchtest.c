@@ -0,0 +1,113 @@
+/*
+ * branchtest.c - Check VM flow control, and branch range limits
+ *
+ *	Runs the flow control checks in data/branches.a2s, and then checks
+ *	long forward and backward branches, in code generated here. Branches
+ *	beyond the range of the relative branch offsets, and functions too
+ *	large for the VM, must be rejected by the compiler.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checks.h"
+
+#define	BRANCHCHECKS	10	/* Number of checks in data/branches.a2s */
+#define	NEARFILLER	10000	/* Filler instructions; in range */
+#define	FARFILLER	20000	/* Filler instructions; out of range */
+#define	HUGEFILLER	40000	/* Filler instructions; too large function */
+
+
+/*
+ * Generate a program that branches forward, and then backward, over 'filler'
+ * instructions. (The filler code is never executed, as the VM would not run
+ * that many instructions back-to-back.)
+ */
+static char *farcode(unsigned filler)
+{
+	static const char *head =
+			"import \"data/checks.a2s\"\n"
+			"export Far()\n"
+			"{\n"
+			"\t!x 0; !y 0\n"
+			".top\t+x 1\n"
+			"\tif x > 5 {\n";
+	static const char *fill = "\t\t+y 1\n";
+	static const char *tail =
+			"\t}\n"
+			"\tif x < 2 { jump top }\n"
+			"\tCheck (x + y) 2\n"
+			"\td 10\n"
+			"}\n";
+	char *code = malloc(strlen(head) + filler * strlen(fill) +
+			strlen(tail) + 1);
+	char *p = code;
+	unsigned i;
+	if(!code)
+		chk_Fail("malloc()", A2_OOMEMORY);
+	p += sprintf(p, "%s", head);
+	for(i = 0; i < filler; ++i)
+		p += sprintf(p, "%s", fill);
+	sprintf(p, "%s", tail);
+	return code;
+}
+
+
+/* Compile the program from farcode(), and return the resulting handle */
+static A2_handle loadfar(CHK_engine *e, unsigned filler)
+{
+	char *code = farcode(filler);
+	A2_handle h = a2_LoadString(e->iface, code, "far");
+	free(code);
+	return h;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	CHK_engine e;
+	A2_handle h;
+	int res;
+
+	chk_Open(&e, 0, 0);
+	h = chk_Get(&e, "data/branches.a2s", "Branches");
+	res = chk_Results(&e, h, BRANCHCHECKS);
+	printf("branches: %d\n", res);
+	chk_Assert(res < 0, "flow control check failed");
+	a2_Close(e.iface);
+
+	chk_Open(&e, 0, 0);
+	if((h = loadfar(&e, NEARFILLER)) < 0)
+		chk_Fail("a2_LoadString(near)", -h);
+	if((h = a2_Get(e.iface, h, "Far")) < 0)
+		chk_Fail("a2_Get(Far)", -h);
+	res = chk_Results(&e, h, 1);
+	printf("near: %d\n", res);
+	chk_Assert(res < 0, "long branches failed");
+	h = loadfar(&e, FARFILLER);
+	printf("far: %s\n", h < 0 ? a2_ErrorString(-h) : "compiled");
+	chk_Assert(h == -A2_BADJUMP, "out of range branch was not rejected");
+	h = loadfar(&e, HUGEFILLER);
+	printf("huge: %s\n", h < 0 ? a2_ErrorString(-h) : "compiled");
+	chk_Assert(h == -A2_LARGEFUNC, "too large function was not rejected");
+	a2_Close(e.iface);
+	return 0;
+}
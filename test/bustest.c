@@ -0,0 +1,126 @@
+/*
+ * bustest.c - Check that replacing bus writes do not change the output
+ *
+ *	Plays a song directly, and through 'inline' units, with and without
+ *	worker threads, and checks that the output is bit-exact in all cases.
+ *	Also checks that the output returns to exact silence once the song
+ *	has ended, so no bus keeps stale data when nothing writes to it. (Held
+ *	keeps running its 'inline' unit for a while after the song.)
+ *
+ *	With overlapping copies of the song, the 'inline' units process the song
+ *	in blocks that are split at the events of their voices, which changes
+ *	how filter sweeps are interpolated. Those renders are compared with each
+ *	other, and with themselves with worker threads, rather than with Direct.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	COPIES		3	/* Overlapping copies for the thread checks */
+#define	FRAMES		(44100 * 5 / 2)	/* Song, including the tails */
+#define	SILENCE		(44100 / 2)	/* Silence after the song */
+
+/*
+ * Programs from INLINED on run the song in the same voice structure, so they
+ * render overlapping copies exactly like the first one of them.
+ */
+#define	INLINED		2
+static const char *programs[] = {
+	"Direct", "Held", "Inline", "Nested", "Mixed", NULL
+};
+
+
+/* Render the remaining output, returning 1 if it's all exact zeros */
+static int silent(CHK_engine *e, unsigned frames)
+{
+	int silence = 1;
+	while(frames)
+	{
+		int c, res;
+		unsigned s, n = frames < e->config->buffer ?
+				frames : e->config->buffer;
+		if((res = a2_Run(e->iface, n)) < 0)
+			chk_Fail("a2_Run()", -res);
+		for(c = 0; c < e->config->channels; ++c)
+			for(s = 0; s < n; ++s)
+				if(e->audio->buffers[c][s])
+					silence = 0;
+		frames -= n;
+	}
+	return silence;
+}
+
+
+/*
+ * Play 'copies' overlapping copies of 'program'. With more than one copy,
+ * there are several root subvoices to spread over the worker threads.
+ */
+static uint64_t render(const char *program, unsigned workers, int copies)
+{
+	CHK_engine e;
+	A2_handle h;
+	uint64_t hash;
+	int i;
+	chk_Open(&e, workers, A2_TREERNG);
+	h = chk_Get(&e, "data/buses.a2s", program);
+	for(i = 0; i < copies; ++i)
+	{
+		A2_handle vh = a2_Start(e.iface, a2_RootVoice(e.iface), h);
+		if(vh < 0)
+			chk_Fail("a2_Start()", -vh);
+		a2_TimestampBump(e.iface, a2_ms2Timestamp(e.iface, 100));
+	}
+	hash = chk_Render(&e, FRAMES, 0);
+	chk_Assert(silent(&e, SILENCE), "output not silent after the song");
+	a2_Close(e.iface);
+	printf("%s, workers: %u, copies: %d, hash: %016llx\n", program,
+			workers, copies, (unsigned long long)hash);
+	return hash;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	int i;
+	uint64_t ref = render(programs[0], 0, 1);
+	uint64_t iref = render(programs[INLINED], 0, COPIES);
+	for(i = 0; programs[i]; ++i)
+	{
+		if(i)
+			chk_Assert(render(programs[i], 0, 1) == ref,
+					"output differs from Direct");
+		chk_Assert(render(programs[i], 2, 1) == ref,
+				"output differs from Direct");
+		if(i < INLINED)
+			chk_Assert(render(programs[i], 2, COPIES) ==
+					render(programs[i], 0, COPIES),
+					"output differs with worker threads");
+		else
+		{
+			if(i > INLINED)
+				chk_Assert(render(programs[i], 0, COPIES) ==
+						iref, "output differs from Inline");
+			chk_Assert(render(programs[i], 2, COPIES) == iref,
+					"output differs from Inline");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * checks.c - Helpers for the non-interactive behavior checks
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "checks.h"
+
+#define	CHK_RATE	44100
+#define	CHK_BUFFER	1024
+#define	CHK_CHANNELS	2
+#define	CHK_SLOT	(CHK_RATE / 100)	/* 10 ms result slots */
+
+
+void chk_Fail(const char *what, A2_errors err)
+{
+	fprintf(stderr, "FAILED: %s: %s\n", what, a2_ErrorString(err));
+	exit(100);
+}
+
+
+void chk_Assert(int cond, const char *what)
+{
+	if(cond)
+		return;
+	fprintf(stderr, "FAILED: %s\n", what);
+	exit(101);
+}
+
+
+void chk_Open(CHK_engine *e, unsigned workers, int flags)
+{
+	A2_driver *drv;
+	if(!(drv = a2_NewDriver(A2_AUDIODRIVER, "buffer")))
+		chk_Fail("a2_NewDriver()", a2_LastError());
+	if(!(e->config = a2_OpenConfig(CHK_RATE, CHK_BUFFER, CHK_CHANNELS,
+			A2_TIMESTAMP | A2_AUTOCLOSE | flags)))
+		chk_Fail("a2_OpenConfig()", a2_LastError());
+	if(a2_AddDriver(e->config, drv))
+		chk_Fail("a2_AddDriver()", a2_LastError());
+	e->config->workers = workers;
+	if(!(e->iface = a2_Open(e->config)))
+		chk_Fail("a2_Open()", a2_LastError());
+	e->audio = (A2_audiodriver *)drv;
+	a2_TimestampReset(e->iface);
+}
+
+
+A2_handle chk_Get(CHK_engine *e, const char *file, const char *name)
+{
+	A2_handle h, oh;
+	if((h = a2_Load(e->iface, file, 0)) < 0)
+		chk_Fail(file, -h);
+	if((oh = a2_Get(e->iface, h, name)) < 0)
+		chk_Fail(name, -oh);
+	return oh;
+}
+
+
+uint64_t chk_Render(CHK_engine *e, unsigned frames, uint64_t hash)
+{
+	if(!hash)
+		hash = 1469598103934665603ULL;	/* FNV-1a offset basis */
+	while(frames)
+	{
+		int c, res;
+		unsigned s, n = frames < CHK_BUFFER ? frames : CHK_BUFFER;
+		if((res = a2_Run(e->iface, n)) < 0)
+			chk_Fail("a2_Run()", -res);
+		a2_PumpMessages(e->iface);
+		for(c = 0; c < e->config->channels; ++c)
+			for(s = 0; s < n; ++s)
+			{
+				hash ^= (uint32_t)e->audio->buffers[c][s];
+				hash *= 1099511628211ULL;
+			}
+		frames -= n;
+	}
+	return hash;
+}
+
+
+int chk_Results(CHK_engine *e, A2_handle program, unsigned count)
+{
+	A2_handle vh;
+	unsigned frame = 0;
+	unsigned slot = 0;
+	if((vh = a2_Start(e->iface, a2_RootVoice(e->iface), program)) < 0)
+		chk_Fail("a2_Start()", -vh);
+	while(slot <= count)
+	{
+		int res;
+		if((res = a2_Run(e->iface, CHK_BUFFER)) < 0)
+			chk_Fail("a2_Run()", -res);
+		a2_PumpMessages(e->iface);
+		while(slot <= count)
+		{
+			int32_t v;
+			unsigned s = slot * CHK_SLOT + CHK_SLOT / 2;
+			if(s >= frame + CHK_BUFFER)
+				break;
+			v = e->audio->buffers[0][s - frame];
+			if((slot < count) && (v <= 0))
+				return slot;
+			if((slot == count) && v)
+				return slot;
+			++slot;
+		}
+		frame += CHK_BUFFER;
+	}
+	return -1;
+}
@@ -0,0 +1,67 @@
+/*
+ * checks.h - Helpers for the non-interactive behavior checks
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef	A2_CHECKS_H
+#define	A2_CHECKS_H
+
+#include <stdint.h>
+#include "audiality2.h"
+#include "a2_drivers.h"
+
+/* A master state rendering into a 'buffer' audio driver */
+typedef struct CHK_engine
+{
+	A2_interface	*iface;
+	A2_config	*config;
+	A2_audiodriver	*audio;
+} CHK_engine;
+
+/* Print 'what' along with the error 'err', and exit with a non-zero code */
+void chk_Fail(const char *what, A2_errors err);
+
+/* Print 'what' and exit with a non-zero code, unless 'cond' is true */
+void chk_Assert(int cond, const char *what);
+
+/*
+ * Open a master state with a 'buffer' audio driver, 'workers' worker threads,
+ * and additional A2_config flags 'flags'.
+ */
+void chk_Open(CHK_engine *e, unsigned workers, int flags);
+
+/* Load 'file', and return a handle to the exported object 'name' */
+A2_handle chk_Get(CHK_engine *e, const char *file, const char *name);
+
+/*
+ * Render 'frames' sample frames, returning a hash of the output. If 'hash' is
+ * non-zero, it's the value returned by a previous call, which is continued.
+ */
+uint64_t chk_Render(CHK_engine *e, unsigned frames, uint64_t hash);
+
+/*
+ * Start 'program', which reports 'count' results through Check() from
+ * data/checks.a2s, one every 10 ms, and render until they are all in. Returns
+ * the index of the first check that failed or did not report, 'count' if
+ * there were more results than expected, or -1 if all checks passed.
+ */
+int chk_Results(CHK_engine *e, A2_handle program, unsigned count);
+
+#endif /* A2_CHECKS_H */
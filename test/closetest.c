@@ -0,0 +1,59 @@
+/*
+ * closetest.c - Check closing states while voices are playing
+ *
+ *	Starts a number of voices, renders a little, and then closes the
+ *	state with the voices still playing, with and without workers. Most
+ *	useful with a memory checker, such as Valgrind or ASan.
+ *
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	COPIES	6
+#define	FRAMES	(44100 / 2)
+
+static void run(unsigned workers)
+{
+	CHK_engine e;
+	A2_handle songh;
+	int i;
+	chk_Open(&e, workers, 0);
+	songh = chk_Get(&e, "data/a2jingle.a2s", "Song");
+	for(i = 0; i < COPIES; ++i)
+	{
+		A2_handle vh = a2_Start(e.iface, a2_RootVoice(e.iface), songh);
+		if(vh < 0)
+			chk_Fail("a2_Start()", -vh);
+		a2_TimestampBump(e.iface, 37);
+	}
+	chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	printf("workers: %u, closed while playing\n", workers);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	run(0);
+	run(2);
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * eventtest.c - Check that events are handled in timestamp order
+ *
+ *	Sends timestamped messages to a voice in order, in reverse order, and
+ *	in shuffled order, with and without extra messages that have the same
+ *	timestamps, and checks that the output is bit-exact in all cases. The
+ *	voice outputs the argument of the latest message, so this also checks
+ *	that messages with the same timestamp are handled in the order they
+ *	were sent, by checking that sending the extra messages last does
+ *	change the output.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	MESSAGES	64
+#define	FRAMES		(44100 * 3 / 2)
+
+typedef enum CHK_order
+{
+	ORDER_FORWARD = 0,	/* In timestamp order */
+	ORDER_REVERSE,		/* Latest first */
+	ORDER_SHUFFLED,		/* Mixed up */
+	ORDER_PAIRS,		/* Mixed up, each after a dummy, same timestamp */
+	ORDER_DUMMYLAST		/* Like ORDER_PAIRS, but the dummy goes last */
+} CHK_order;
+
+static const char *ordernames[] = {
+	"forward", "reverse", "shuffled", "pairs", "dummy last"
+};
+
+
+/* Timestamp of message 'i', relative to the start of the voice */
+static double msgtime(unsigned i)
+{
+	return 3.0 + i * 17.3;
+}
+
+
+/* Argument of message 'i' */
+static float msgvalue(unsigned i)
+{
+	return (int)(i % 7 - 3) * .1f + .05f;
+}
+
+
+/* Send message 'i', at time 'base' + msgtime(i) */
+static void send(CHK_engine *e, A2_handle vh, A2_timestamp base, unsigned i,
+		float value)
+{
+	A2_errors res;
+	a2_TimestampSet(e->iface, base + a2_ms2Timestamp(e->iface,
+			msgtime(i)));
+	if((res = a2_Send(e->iface, vh, 2, value)))
+		chk_Fail("a2_Send()", res);
+}
+
+
+/* Start the listener, send the messages in order 'order', and render */
+static uint64_t render(CHK_order order)
+{
+	CHK_engine e;
+	A2_handle h, vh;
+	A2_timestamp base;
+	uint64_t hash;
+	unsigned i, n;
+	chk_Open(&e, 0, 0);
+	h = chk_Get(&e, "data/events.a2s", "Listener");
+	base = a2_TimestampGet(e.iface);
+	if((vh = a2_Start(e.iface, a2_RootVoice(e.iface), h)) < 0)
+		chk_Fail("a2_Start()", -vh);
+	for(i = 0; i < MESSAGES; ++i)
+	{
+		switch(order)
+		{
+		  case ORDER_FORWARD:
+			n = i;
+			break;
+		  case ORDER_REVERSE:
+			n = MESSAGES - 1 - i;
+			break;
+		  default:
+			n = (i * 37 + 11) % MESSAGES;	/* (Permutation) */
+			break;
+		}
+		if(order == ORDER_PAIRS)
+			send(&e, vh, base, n, -1.0f);
+		send(&e, vh, base, n, msgvalue(n));
+		if(order == ORDER_DUMMYLAST)
+			send(&e, vh, base, n, -1.0f);
+	}
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	printf("%s: %016llx\n", ordernames[order], (unsigned long long)hash);
+	return hash;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	CHK_order order;
+	uint64_t ref = render(ORDER_FORWARD);
+	for(order = ORDER_REVERSE; order <= ORDER_PAIRS; ++order)
+		chk_Assert(render(order) == ref,
+				"output depends on the order of sending");
+	chk_Assert(render(ORDER_DUMMYLAST) != ref,
+			"messages with the same timestamp were reordered");
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * fbdelaytest.c - Check fbdelay buffer pool housekeeping
+ *
+ *	Plays a burst of overlapping echoes on a realtime state, and checks
+ *	that the engine doesn't allocate delay buffers itself, and that
+ *	recycled buffers are clean.
+ *
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "checks.h"
+
+#define	WARMUP		20
+#define	BURST		8
+#define	ECHOFRAGS	16
+#define	LONGFRAGS	140
+
+/* Anything this large is a delay buffer */
+#define	BIGALLOC	65536
+
+static pthread_t engine_thread;
+static int in_engine = 0;
+static unsigned engine_allocs = 0;
+
+/*
+ * Count large allocations made from the engine thread. glibc specific, but so
+ * is the rest of this.
+ */
+extern void *__libc_calloc(size_t nmemb, size_t size);
+
+void *calloc(size_t nmemb, size_t size)
+{
+	if(in_engine && (nmemb * size >= BIGALLOC) &&
+			pthread_equal(pthread_self(), engine_thread))
+		++engine_allocs;
+	return __libc_calloc(nmemb, size);
+}
+
+/* Start 'program' right away, whatever the timing */
+/* Render 'n' fragments, giving the housekeeper time to do its thing */
+static uint64_t render(CHK_engine *e, unsigned n, uint64_t hash)
+{
+	while(n--)
+	{
+		in_engine = 1;
+		hash = chk_Render(e, 1024, hash);
+		in_engine = 0;
+		a2_Sleep(10);
+	}
+	return hash;
+}
+
+
+/*
+ * Start 'program'. We render faster than realtime, so the message arrives
+ * "late", and is handled at the start of the next fragment.
+ */
+static void play(CHK_engine *e, A2_handle program)
+{
+	a2_Play(e->iface, a2_RootVoice(e->iface), program);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	CHK_engine e;
+	A2_handle echoh, longh;
+	uint64_t ref, again;
+	int i;
+	engine_thread = pthread_self();
+	chk_Open(&e, 0, A2_REALTIME | A2_RTSILENT);
+	echoh = chk_Get(&e, "data/fbdelay.a2s", "Echo");
+	longh = chk_Get(&e, "data/fbdelay.a2s", "LongEcho");
+
+	/* Let the housekeeper take over the pool */
+	render(&e, WARMUP, 0);
+
+	/* One echo, from a buffer that's never been used */
+	play(&e, echoh);
+	ref = render(&e, ECHOFRAGS, 0);
+
+	/*
+	 * Overlapping echoes; more than there are preallocated buffers, and
+	 * long enough to wrap around in their buffers, so none of them are
+	 * clean when returned.
+	 */
+	for(i = 0; i < BURST; ++i)
+	{
+		play(&e, longh);
+		render(&e, 1, 0);
+	}
+	render(&e, LONGFRAGS, 0);
+
+	/* One more, which gets a recycled buffer */
+	play(&e, echoh);
+	again = render(&e, ECHOFRAGS, 0);
+
+	a2_Close(e.iface);
+	printf("Delay buffers allocated by the engine: %u\n", engine_allocs);
+	chk_Assert(!engine_allocs, "Engine allocated delay buffers");
+	chk_Assert(ref == again, "Recycled delay buffer was not clean");
+	return 0;
+}
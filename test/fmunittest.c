@@ -0,0 +1,120 @@
+/*
+ * fmunittest.c - Check the block-wise and SIMD FM kernels
+ *
+ *	Builds a second copy of the FM units with SSE2 disabled, and registers
+ *	them as 'fm1scalar' etc. Sweeps played without feedback, with feedback
+ *	on the carrier, on the modulators, and on all operators, must render
+ *	exactly the same with both sets of units. The feedback is ramped out
+ *	during each note, so every unit also switches from running operators
+ *	one subsample at a time, to running them in blocks.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* The scalar FM units, built right here under other descriptor names */
+#undef	__SSE2__
+#define	a2_fm1_unitdesc		a2_fm1_scalar_unitdesc
+#define	a2_fm2_unitdesc		a2_fm2_scalar_unitdesc
+#define	a2_fm3_unitdesc		a2_fm3_scalar_unitdesc
+#define	a2_fm4_unitdesc		a2_fm4_scalar_unitdesc
+#define	a2_fm3p_unitdesc	a2_fm3p_scalar_unitdesc
+#define	a2_fm4p_unitdesc	a2_fm4p_scalar_unitdesc
+#define	a2_fm2r_unitdesc	a2_fm2r_scalar_unitdesc
+#define	a2_fm4r_unitdesc	a2_fm4r_scalar_unitdesc
+#include "fm.c"
+#undef	a2_fm1_unitdesc
+#undef	a2_fm2_unitdesc
+#undef	a2_fm3_unitdesc
+#undef	a2_fm4_unitdesc
+#undef	a2_fm3p_unitdesc
+#undef	a2_fm4p_unitdesc
+#undef	a2_fm2r_unitdesc
+#undef	a2_fm4r_unitdesc
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	FRAMES		(44100 * 4 + 4410)
+
+static const A2_unitdescx *scalarunits[] = {
+	&a2_fm1_scalar_unitdesc,
+	&a2_fm2_scalar_unitdesc,
+	&a2_fm3_scalar_unitdesc,
+	&a2_fm4_scalar_unitdesc,
+	&a2_fm3p_scalar_unitdesc,
+	&a2_fm4p_scalar_unitdesc,
+	&a2_fm2r_scalar_unitdesc,
+	&a2_fm4r_scalar_unitdesc,
+	NULL
+};
+
+static A2_unitdescx scalardescs[sizeof(scalarunits) / sizeof(scalarunits[0])];
+static char scalarnames[sizeof(scalarunits) / sizeof(scalarunits[0])][16];
+
+
+/*
+ * Render 'program' from data/fmunits.a2s, with feedback depth 'f' on operator
+ * 0, and 'g' on the other operators.
+ */
+static uint64_t render(const char *program, float f, float g)
+{
+	CHK_engine e;
+	A2_handle h;
+	A2_errors res;
+	uint64_t hash;
+	int i;
+	chk_Open(&e, 0, 0);
+	for(i = 0; scalarunits[i]; ++i)
+	{
+		if((h = a2_RegisterUnit(e.iface, &scalardescs[i].d)) < 0)
+			chk_Fail("a2_RegisterUnit()", -h);
+		if((res = a2_Export(e.iface, A2_ROOTBANK, h, NULL)))
+			chk_Fail("a2_Export()", res);
+	}
+	h = chk_Get(&e, "data/fmunits.a2s", program);
+	if((h = a2_Start(e.iface, a2_RootVoice(e.iface), h, f, g)) < 0)
+		chk_Fail("a2_Start()", -h);
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	printf("%s, feedback: %g, %g, hash: %016llx\n", program, f, g,
+			(unsigned long long)hash);
+	return hash;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	int i;
+	for(i = 0; scalarunits[i]; ++i)
+	{
+		scalardescs[i] = *scalarunits[i];
+		snprintf(scalarnames[i], sizeof(scalarnames[i]), "%sscalar",
+				scalarunits[i]->d.name);
+		scalardescs[i].d.name = scalarnames[i];
+	}
+
+	for(i = 0; i < 4; ++i)
+	{
+		float f = i & 1 ? 0.3f : 0.0f;
+		float g = i & 2 ? 0.3f : 0.0f;
+		chk_Assert(render("Builtin", f, g) == render("Scalar", f, g),
+				"FM units differ from the scalar build");
+	}
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * frametest.c - Check voice register frames
+ *
+ *	Runs the checks in data/frames.a2s, where voices with register frames
+ *	of very different sizes spawn each other and receive messages, with
+ *	and without worker threads.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	FRAMECHECKS	4	/* Number of checks in data/frames.a2s */
+
+
+int main(int argc, const char *argv[])
+{
+	unsigned workers;
+	for(workers = 0; workers <= 2; workers += 2)
+	{
+		CHK_engine e;
+		int res;
+		chk_Open(&e, workers, 0);
+		res = chk_Results(&e, chk_Get(&e, "data/frames.a2s", "Frames"),
+				FRAMECHECKS);
+		printf("workers: %u, frames: %d\n", workers, res);
+		chk_Assert(res < 0, "register frame check failed");
+		a2_Close(e.iface);
+	}
+	return 0;
+}
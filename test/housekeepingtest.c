@@ -0,0 +1,142 @@
+/*
+ * housekeepingtest.c - Check that pool housekeeping keeps realtime pools full
+ *
+ *	Plays notes on a realtime state with a tiny initial block pool,
+ *	leaving some size classes empty, and counts the allocations made by
+ *	the engine itself while processing audio. Once the housekeeping thread
+ *	has caught up, all memory should come from the pools.
+ *
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "checks.h"
+
+#define	BLOCKPOOL	8
+#define	WARMUP		20
+#define	FRAGMENTS	250
+
+static pthread_t engine_thread;
+static int in_engine = 0;
+static unsigned engine_allocs = 0;
+
+
+static void *hkt_RTAlloc(A2_sysdriver *driver, unsigned size)
+{
+	if(in_engine && pthread_equal(pthread_self(), engine_thread))
+		++engine_allocs;
+	return malloc(size);
+}
+
+static void hkt_RTFree(A2_sysdriver *driver, void *block)
+{
+	free(block);
+}
+
+static A2_errors hkt_Open(A2_driver *driver)
+{
+	A2_sysdriver *sd = (A2_sysdriver *)driver;
+	sd->RTAlloc = hkt_RTAlloc;
+	sd->RTFree = hkt_RTFree;
+	return A2_OK;
+}
+
+static void hkt_Close(A2_driver *driver)
+{
+}
+
+static A2_driver *hkt_NewDriver(A2_drivertypes type, const char *name)
+{
+	A2_sysdriver *sd = (A2_sysdriver *)calloc(1, sizeof(A2_sysdriver));
+	if(!sd)
+		return NULL;
+	sd->driver.type = A2_SYSDRIVER;
+	sd->driver.name = "housekeepingtest";
+	sd->driver.flags = A2_THREADSAFE;
+	sd->driver.Open = hkt_Open;
+	sd->driver.Close = hkt_Close;
+	return &sd->driver;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	A2_driver *sd;
+	A2_audiodriver *ad;
+	A2_config *cfg;
+	A2_interface *iface;
+	A2_handle noteh, fnoteh, h;
+	int i;
+	A2_errors err;
+	engine_thread = pthread_self();
+
+	/* Realtime state, with us running the engine */
+	if((err = a2_RegisterDriver(A2_SYSDRIVER, "housekeepingtest",
+			hkt_NewDriver)))
+		chk_Fail("a2_RegisterDriver()", err);
+	if(!(sd = a2_NewDriver(A2_SYSDRIVER, "housekeepingtest")))
+		chk_Fail("a2_NewDriver()", a2_LastError());
+	if(!(ad = (A2_audiodriver *)a2_NewDriver(A2_AUDIODRIVER, "buffer")))
+		chk_Fail("a2_NewDriver()", a2_LastError());
+	if(!(cfg = a2_OpenConfig(44100, 1024, 2, A2_REALTIME | A2_AUTOCLOSE)))
+		chk_Fail("a2_OpenConfig()", a2_LastError());
+	cfg->blockpool = BLOCKPOOL;
+	if(a2_AddDriver(cfg, &ad->driver) || a2_AddDriver(cfg, sd))
+		chk_Fail("a2_AddDriver()", a2_LastError());
+	if(!(iface = a2_Open(cfg)))
+		chk_Fail("a2_Open()", a2_LastError());
+	if((h = a2_Load(iface, "data/housekeeping.a2s", 0)) < 0)
+		chk_Fail("a2_Load()", -h);
+	if((noteh = a2_Get(iface, h, "Note")) < 0)
+		chk_Fail("a2_Get()", -noteh);
+	if((fnoteh = a2_Get(iface, h, "FilteredNote")) < 0)
+		chk_Fail("a2_Get()", -fnoteh);
+
+	/*
+	 * Give the housekeeper plenty of time between fragments, so that we're
+	 * only testing which pools it looks after; not how fast it is. The
+	 * first WARMUP fragments are silent, so that the housekeeper gets to
+	 * fill the pools before anything is played.
+	 */
+	for(i = 0; i < FRAGMENTS; ++i)
+	{
+		int res;
+		if(i >= WARMUP)
+		{
+			if(!(i % 4))
+				a2_Play(iface, a2_RootVoice(iface), noteh);
+			else if(!(i % 2))
+				a2_Play(iface, a2_RootVoice(iface), fnoteh);
+			in_engine = 1;
+		}
+		if((res = a2_Run(iface, 1024)) < 0)
+			chk_Fail("a2_Run()", -res);
+		in_engine = 0;
+		a2_PumpMessages(iface);
+		a2_Sleep(10);
+	}
+	a2_Close(iface);
+	a2_UnregisterDriver("housekeepingtest");
+	printf("Allocations in the engine after warmup: %u\n", engine_allocs);
+	chk_Assert(!engine_allocs, "Engine allocated memory after warmup");
+	return 0;
+}
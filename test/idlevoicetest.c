@@ -0,0 +1,120 @@
+/*
+ * idlevoicetest.c - Check that skipping idle voices does not change the output
+ *
+ *	Renders a song of group voices that sleep across many fragments, and a
+ *	voice that is woken up by messages from the API, and checks that the
+ *	output is bit-exact compared to the same song with the delays chopped
+ *	up, so that no voice is ever skipped. Also checks that a voice that
+ *	has been idle for many fragments wakes up on the exact sample frame.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	FRAMES		(44100 * 4)
+#define	MESSAGES	12
+#define	LATEFRAME	(44100 * 600 / 1000)	/* Late wakes up after 600 ms */
+
+
+/*
+ * Render the song, with 'busy' passed to the programs. If 'start' is 0,
+ * nothing is started, for a reference of silence.
+ */
+static uint64_t render(unsigned workers, int start, int busy)
+{
+	CHK_engine e;
+	A2_handle songh, listenerh, vh;
+	uint64_t hash;
+	int i;
+	chk_Open(&e, workers, 0);
+	songh = chk_Get(&e, "data/idlevoices.a2s", "Song");
+	listenerh = chk_Get(&e, "data/idlevoices.a2s", "Listener");
+	if(start)
+	{
+		if((vh = a2_Start(e.iface, a2_RootVoice(e.iface), songh,
+				busy)) < 0)
+			chk_Fail("a2_Start(Song)", -vh);
+		if((vh = a2_Start(e.iface, a2_RootVoice(e.iface), listenerh,
+				busy)) < 0)
+			chk_Fail("a2_Start(Listener)", -vh);
+		for(i = 0; i < MESSAGES; ++i)
+		{
+			A2_errors res;
+			a2_TimestampBump(e.iface, 97 + i * 31);
+			if((res = a2_Send(e.iface, vh, 2, .05 * (i + 1))))
+				chk_Fail("a2_Send()", res);
+		}
+	}
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	printf("workers: %u, start: %d, busy: %d, hash: %016llx\n", workers,
+			start, busy, (unsigned long long)hash);
+	return hash;
+}
+
+
+/*
+ * Start a voice that sleeps across many fragments before starting a note, and
+ * return the sample frame where its output starts.
+ */
+static unsigned onset(unsigned workers)
+{
+	CHK_engine e;
+	A2_handle h, vh;
+	unsigned s, frame = 0;
+	chk_Open(&e, workers, 0);
+	h = chk_Get(&e, "data/idlevoices.a2s", "Late");
+	if((vh = a2_Start(e.iface, a2_RootVoice(e.iface), h)) < 0)
+		chk_Fail("a2_Start(Late)", -vh);
+	while(frame < FRAMES)
+	{
+		unsigned n = e.config->buffer;
+		int res;
+		if((res = a2_Run(e.iface, n)) < 0)
+			chk_Fail("a2_Run()", -res);
+		for(s = 0; s < n; ++s)
+			if(e.audio->buffers[0][s])
+				break;
+		if(s < n)
+			break;
+		frame += n;
+	}
+	a2_Close(e.iface);
+	printf("workers: %u, onset: %u\n", workers, frame + s);
+	return frame + s;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	unsigned workers;
+	for(workers = 0; workers <= 2; workers += 2)
+	{
+		uint64_t ref = render(workers, 1, 1);
+		chk_Assert(ref != render(workers, 0, 0),
+				"busy voices produced no output");
+		chk_Assert(render(workers, 1, 0) == ref,
+				"idle voices differ from busy voices");
+		chk_Assert(onset(workers) == LATEFRAME,
+				"idle voice woke up at the wrong time");
+	}
+	return 0;
+}
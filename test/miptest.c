@@ -0,0 +1,85 @@
+/*
+ * miptest.c - Check mip level switching of wavetable oscillators
+ *
+ *	Renders sine waves sweeping up and down across several mip level
+ *	boundaries, and checks that the output level stays constant.
+ *
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	BLOCK		64
+#define	SKIP		(44100 / 20)
+#define	DURATION	(44100 * 2)
+#define	TOLERANCE	0.01
+
+int main(int argc, const char *argv[])
+{
+	CHK_engine e;
+	A2_handle songh, vh;
+	double ref = 0.0f, min = 1.0f, max = 0.0f, peak = 0.0f, last = 0.0f;
+	unsigned f, s, halves = 0;
+	chk_Open(&e, 0, 0);
+	songh = chk_Get(&e, "data/mipsweep.a2s", "Song");
+	if((vh = a2_Start(e.iface, a2_RootVoice(e.iface), songh)) < 0)
+		chk_Fail("a2_Start()", -vh);
+	a2_Release(e.iface, vh);
+
+	/*
+	 * Skip the attack, then check the peak level of every half period. At
+	 * these frequencies, that's within a fraction of a percent of the
+	 * amplitude of the sine.
+	 */
+	chk_Render(&e, SKIP, 0);
+	for(f = 0; f < DURATION; f += BLOCK)
+	{
+		chk_Render(&e, BLOCK, 0);
+		for(s = 0; s < BLOCK; ++s)
+		{
+			double v = e.audio->buffers[0][s] / 16777216.0f;
+			if((v < 0.0f) != (last < 0.0f))
+			{
+				/* Zero crossing; check the previous half */
+				if(++halves == 2)
+					ref = peak;	/* First complete half */
+				else if(halves > 2)
+				{
+					if(peak / ref < min)
+						min = peak / ref;
+					if(peak / ref > max)
+						max = peak / ref;
+				}
+				peak = 0.0f;
+			}
+			if(v > peak)
+				peak = v;
+			else if(-v > peak)
+				peak = -v;
+			last = v;
+		}
+	}
+	a2_Close(e.iface);
+	printf("level: %.4f .. %.4f\n", min, max);
+	chk_Assert(min > 1.0f - TOLERANCE, "Level dips during sweep");
+	chk_Assert(max < 1.0f + TOLERANCE, "Level bumps during sweep");
+	return 0;
+}
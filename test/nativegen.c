@@ -0,0 +1,60 @@
+/*
+ * nativegen.c - Write native code module source for nativetest
+ *
+ *	Usage: nativegen <script> <output>
+ *
+ *	Loads 'script', and writes C source for a native code module for it
+ *	to 'output'. The build turns that into a module next to a copy of the
+ *	script, for nativetest to check.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "checks.h"
+
+
+int main(int argc, const char *argv[])
+{
+	CHK_engine e;
+	A2_handle h;
+	A2_errors res;
+	FILE *f;
+	if(argc != 3)
+	{
+		fprintf(stderr, "Usage: nativegen <script> <output>\n");
+		return 1;
+	}
+	chk_Open(&e, 0, A2_NOCOMPILED);
+	if((h = a2_Load(e.iface, argv[1], 0)) < 0)
+		chk_Fail(argv[1], -h);
+	if(!(f = fopen(argv[2], "w")))
+	{
+		fprintf(stderr, "Could not create \"%s\"!\n", argv[2]);
+		return 1;
+	}
+	res = a2_WriteNative(e.iface, h, f);
+	if(fclose(f) && !res)
+		res = A2_WRITE;
+	if(res)
+		chk_Fail("a2_WriteNative()", res);
+	a2_Close(e.iface);
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * nativetest.c - Check native code modules against the VM
+ *
+ *	Usage: nativetest <dir>
+ *
+ *	Loads the copy of nativetest.a2s in 'dir', which has a native code
+ *	module next to it, and checks that the module is only picked up with
+ *	the A2_NATIVE flag, and that the output is the same with and without
+ *	the native code.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "checks.h"
+
+#define	FRAMES	(44100 * 4)
+
+
+static uint64_t render(const char *script, int flags)
+{
+	CHK_engine e;
+	A2_handle songh, toneh;
+	int native, tnative;
+	uint64_t hash;
+	A2_errors res;
+	chk_Open(&e, 0, flags);
+	songh = chk_Get(&e, script, "Song");
+	toneh = chk_Get(&e, script, "Tone");
+	if((res = a2_GetProperty(e.iface, songh, A2_PNATIVE, &native)) ||
+			(res = a2_GetProperty(e.iface, toneh, A2_PNATIVE,
+			&tnative)))
+		chk_Fail("a2_GetProperty(A2_PNATIVE)", res);
+	if(flags & A2_NATIVE)
+		chk_Assert(native && tnative, "Native code not loaded");
+	else
+		chk_Assert(!native && !tnative,
+				"Native code loaded without A2_NATIVE");
+	a2_Play(e.iface, a2_RootVoice(e.iface), songh);
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	return hash;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	char script[1024];
+	uint64_t vm, native;
+	if(argc != 2)
+	{
+		fprintf(stderr, "Usage: nativetest <dir>\n");
+		return 1;
+	}
+	snprintf(script, sizeof(script), "%s/nativetest.a2s", argv[1]);
+	vm = render(script, 0);
+	native = render(script, A2_NATIVE);
+	printf("VM: %016llx, native: %016llx\n", (unsigned long long)vm,
+			(unsigned long long)native);
+	chk_Assert(vm == native, "Native code output differs from the VM");
+	return 0;
+}
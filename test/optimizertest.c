@@ -0,0 +1,86 @@
+/*
+ * optimizertest.c - Check that the peephole optimizer does not change behavior
+ *
+ *	Runs the checks in data/peephole.a2s with and without A2_NOOPTIMIZE,
+ *	and then renders a few songs both ways, checking that the output is
+ *	bit-exact.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	PEEPHOLECHECKS	7	/* Number of checks in data/peephole.a2s */
+#define	FRAMES		(44100 * 4)
+
+static const char *songs[] = {
+	"data/a2jingle.a2s",
+	"data/dctest.a2s",
+	"data/envtest.a2s",
+	"data/envtest2.a2s",
+	"data/evilnoises.a2s",
+	"data/fmtest3.a2s",
+	"data/k2intro.a2s",
+	"data/noisephase.a2s",
+	"data/pitchenvtest.a2s",
+	"data/rendertest.a2s",
+	"data/warmvoices.a2s",
+	NULL
+};
+
+
+/* Render a few seconds of 'song', with additional config flags 'flags' */
+static uint64_t render(const char *song, int flags)
+{
+	CHK_engine e;
+	A2_handle h, vh;
+	uint64_t hash;
+	chk_Open(&e, 0, flags);
+	h = chk_Get(&e, song, "Song");
+	if((vh = a2_Start(e.iface, a2_RootVoice(e.iface), h)) < 0)
+		chk_Fail("a2_Start()", -vh);
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	return hash;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	int i, res;
+	for(i = 0; i <= 1; ++i)
+	{
+		CHK_engine e;
+		chk_Open(&e, 0, i ? A2_NOOPTIMIZE : 0);
+		res = chk_Results(&e, chk_Get(&e, "data/peephole.a2s",
+				"Peephole"), PEEPHOLECHECKS);
+		printf("peephole%s: %d\n", i ? " (A2_NOOPTIMIZE)" : "", res);
+		chk_Assert(res < 0, "peephole check failed");
+		a2_Close(e.iface);
+	}
+	for(i = 0; songs[i]; ++i)
+	{
+		uint64_t hash = render(songs[i], 0);
+		printf("%s: %016llx\n", songs[i], (unsigned long long)hash);
+		chk_Assert(render(songs[i], A2_NOOPTIMIZE) == hash,
+				"optimized output differs from A2_NOOPTIMIZE");
+	}
+	return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * sysdrivertest.c - Check the realtime memory allocators of system drivers
+ *
+ *	Allocates and frees blocks of all sizes used by the engine through
+ *	the system drivers, and checks that they are cache line aligned. Then
+ *	hammers the allocators from several threads at once, checking that
+ *	no block is handed out to more than one thread at a time.
+ *
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "checks.h"
+
+#define	MAXSIZE		4096
+#define	ALIGNMENT	64
+
+#define	THREADS		4
+#define	ROUNDS		2000
+#define	HELD		32
+
+static const char *drivers[] = { "malloc", "arena", NULL };
+
+typedef struct STRESS_thread
+{
+	pthread_t	thread;
+	A2_sysdriver	*sd;
+	unsigned	id;
+	unsigned	rnd;
+	int		failed;
+} STRESS_thread;
+
+static unsigned stress_rand(STRESS_thread *t)
+{
+	t->rnd = t->rnd * 1103515245 + 12345;
+	return t->rnd >> 16;
+}
+
+static int stress_check(unsigned char *block, unsigned size, unsigned id)
+{
+	unsigned i;
+	for(i = 0; i < size; ++i)
+		if(block[i] != (unsigned char)id)
+			return 0;
+	return 1;
+}
+
+/*
+ * Keep HELD blocks of random sizes filled with our id, replacing one at a
+ * time, and check that nobody else scribbles on them.
+ */
+static void *stress_thread(void *userdata)
+{
+	STRESS_thread *t = (STRESS_thread *)userdata;
+	unsigned char *blocks[HELD];
+	unsigned sizes[HELD];
+	unsigned i, r;
+	memset(blocks, 0, sizeof(blocks));
+	for(r = 0; r < ROUNDS * HELD; ++r)
+	{
+		i = stress_rand(t) % HELD;
+		if(blocks[i])
+		{
+			if(!stress_check(blocks[i], sizes[i], t->id))
+				t->failed = 1;
+			t->sd->RTFree(t->sd, blocks[i]);
+		}
+		sizes[i] = stress_rand(t) % MAXSIZE + 1;
+		if(!(blocks[i] = t->sd->RTAlloc(t->sd, sizes[i])))
+		{
+			t->failed = 1;
+			break;
+		}
+		memset(blocks[i], t->id, sizes[i]);
+	}
+	for(i = 0; i < HELD; ++i)
+		if(blocks[i])
+		{
+			if(!stress_check(blocks[i], sizes[i], t->id))
+				t->failed = 1;
+			t->sd->RTFree(t->sd, blocks[i]);
+		}
+	return NULL;
+}
+
+static void stress_driver(A2_sysdriver *sd)
+{
+	STRESS_thread threads[THREADS];
+	unsigned i;
+	for(i = 0; i < THREADS; ++i)
+	{
+		threads[i].sd = sd;
+		threads[i].id = i + 1;
+		threads[i].rnd = i * 12345 + 1;
+		threads[i].failed = 0;
+		if(pthread_create(&threads[i].thread, NULL, stress_thread,
+				threads + i))
+			chk_Fail("pthread_create()", A2_INTERNAL);
+	}
+	for(i = 0; i < THREADS; ++i)
+	{
+		pthread_join(threads[i].thread, NULL);
+		chk_Assert(!threads[i].failed, "Block shared between threads");
+	}
+}
+
+
+static void check_driver(const char *name)
+{
+	static void *blocks[MAXSIZE];
+	A2_config *cfg;
+	A2_driver *drv;
+	A2_sysdriver *sd;
+	A2_interface *iface;
+	unsigned size;
+	if(!(drv = a2_NewDriver(A2_SYSDRIVER, name)))
+		chk_Fail(name, a2_LastError());
+	if(!(cfg = a2_OpenConfig(44100, 1024, 2, A2_AUTOCLOSE)))
+		chk_Fail("a2_OpenConfig()", a2_LastError());
+	if(a2_AddDriver(cfg, drv))
+		chk_Fail("a2_AddDriver()", a2_LastError());
+	if(a2_AddDriver(cfg, a2_NewDriver(A2_AUDIODRIVER, "buffer")))
+		chk_Fail("a2_AddDriver()", a2_LastError());
+	if(!(iface = a2_Open(cfg)))
+		chk_Fail("a2_Open()", a2_LastError());
+	sd = (A2_sysdriver *)a2_GetDriver(cfg, A2_SYSDRIVER);
+	chk_Assert(sd == (A2_sysdriver *)drv, "Wrong system driver");
+
+	for(size = 1; size < MAXSIZE; ++size)
+	{
+		if(!(blocks[size] = sd->RTAlloc(sd, size)))
+			chk_Fail("RTAlloc()", A2_OOMEMORY);
+		memset(blocks[size], size, size);
+		chk_Assert(!((size_t)blocks[size] & (ALIGNMENT - 1)),
+				"Misaligned block");
+	}
+	for(size = 1; size < MAXSIZE; ++size)
+		sd->RTFree(sd, blocks[size]);
+
+	if(sd->driver.flags & A2_THREADSAFE)
+		stress_driver(sd);
+
+	a2_Close(iface);
+	printf("%s: ok\n", name);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	int i;
+	for(i = 0; drivers[i]; ++i)
+		check_driver(drivers[i]);
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * warmvoicetest.c - Check that recycling voices does not change the output
+ *
+ *	Renders a song full of short, retriggered notes with voice recycling
+ *	disabled, with a single slot warm voice cache, which is constantly
+ *	evicted, and with a larger one, and checks that the output is
+ *	bit-exact in all cases.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	COPIES	3
+#define	FRAMES	(44100 * 2)
+
+/* Start a few overlapping copies of the song */
+static A2_handle start(CHK_engine *e)
+{
+	A2_handle bank, songh;
+	int i;
+	if((bank = a2_Load(e->iface, "data/warmvoices.a2s", 0)) < 0)
+		chk_Fail("a2_Load()", -bank);
+	if((songh = a2_Get(e->iface, bank, "Song")) < 0)
+		chk_Fail("a2_Get()", -songh);
+	for(i = 0; i < COPIES; ++i)
+	{
+		A2_handle vh = a2_Start(e->iface, a2_RootVoice(e->iface),
+				songh);
+		if(vh < 0)
+			chk_Fail("a2_Start()", -vh);
+		a2_Release(e->iface, vh);
+		a2_TimestampBump(e->iface, 111);
+	}
+	return bank;
+}
+
+
+/* Render the song with a warm voice cache of 'warm' voices */
+static uint64_t render(unsigned workers, int warm)
+{
+	CHK_engine e;
+	A2_errors res;
+	uint64_t hash;
+	chk_Open(&e, workers, 0);
+	if((res = a2_SetStateProperty(e.iface, A2_PWARMVOICES, warm)))
+		chk_Fail("a2_SetStateProperty()", res);
+	start(&e);
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	printf("workers: %u, warm voices: %d, hash: %016llx\n", workers, warm,
+			(unsigned long long)hash);
+	return hash;
+}
+
+
+/*
+ * Unload the song while it's playing, so that programs with voices in the
+ * warm voice caches go away. (This needs a realtime state, where objects are
+ * released via the engine, so the output is not checked here.)
+ */
+static void unload(unsigned workers)
+{
+	CHK_engine e;
+	A2_handle bank;
+	A2_errors res;
+	chk_Open(&e, workers, A2_REALTIME);
+	bank = start(&e);
+	chk_Render(&e, FRAMES / 2, 0);
+	if((res = a2_Release(e.iface, bank)))
+		chk_Fail("a2_Release()", res);
+	chk_Render(&e, FRAMES / 2, 0);
+	a2_Close(e.iface);
+}
+
+
+int main(int argc, const char *argv[])
+{
+	unsigned workers;
+	for(workers = 0; workers <= 2; workers += 2)
+	{
+		uint64_t ref = render(workers, 0);
+		chk_Assert(render(workers, 1) == ref,
+				"1 warm voice differs from no recycling");
+		chk_Assert(render(workers, 16) == ref,
+				"16 warm voices differ from no recycling");
+		unload(workers);
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * wavecachetest.c - Check loading rendered waves from the wave cache
+ *
+ *	Renders an A2_FAST wave with the wave cache disabled, and then twice
+ *	with the cache enabled; once storing the wave in the cache, and once
+ *	loading it from there. All three must have identical mip levels and
+ *	Hermite coefficients.
+ *
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "checks.h"
+
+/* Remove any wave cache files from directory 'path' */
+static void clear_cache(const char *path)
+{
+	char fn[1024];
+	struct dirent *de;
+	DIR *d = opendir(path);
+	if(!d)
+		chk_Fail(path, A2_NOTFOUND);
+	while((de = readdir(d)))
+	{
+		size_t len = strlen(de->d_name);
+		if((len < 4) || strcmp(de->d_name + len - 4, ".a2w"))
+			continue;
+		snprintf(fn, sizeof(fn), "%s/%s", path, de->d_name);
+		unlink(fn);
+	}
+	closedir(d);
+}
+
+
+static A2_wave *load(CHK_engine *e, const char *cache)
+{
+	A2_handle h;
+	A2_wave *w;
+	A2_errors res;
+	chk_Open(e, 0, 0);
+	if((res = a2_SetWaveCache(e->iface, cache)))
+		chk_Fail("a2_SetWaveCache()", res);
+	h = chk_Get(e, "data/wavecache.a2s", "CachedWave");
+	if(!(w = a2_GetWave(e->iface, h)))
+		chk_Fail("a2_GetWave()", a2_LastError());
+	return w;
+}
+
+
+static void compare(A2_wave *w, A2_wave *ref, const char *what)
+{
+	int i;
+	chk_Assert(w->type == A2_WMIPWAVE, what);
+	for(i = 0; i < A2_MIPLEVELS; ++i)
+	{
+		unsigned size = A2_WAVEPRE + ref->d.wave.size[i] + A2_WAVEPOST;
+		chk_Assert(w->d.wave.size[i] == ref->d.wave.size[i], what);
+		chk_Assert(!memcmp(w->d.wave.data[i], ref->d.wave.data[i],
+				size * sizeof(int16_t)), what);
+		chk_Assert(w->d.wave.coeffs[i] != NULL, what);
+		chk_Assert(!memcmp(w->d.wave.coeffs[i], ref->d.wave.coeffs[i],
+				size * 4 * sizeof(int32_t)), what);
+	}
+}
+
+
+int main(int argc, const char *argv[])
+{
+	CHK_engine re, e;
+	A2_wave *ref, *w;
+	const char *cache = argc > 1 ? argv[1] : "wavecache";
+	clear_cache(cache);
+
+	/* Reference, with no cache */
+	ref = load(&re, NULL);
+	chk_Assert(ref->d.wave.coeffs[0] != NULL, "No coefficients rendered");
+
+	/* Render and store */
+	w = load(&e, cache);
+	compare(w, ref, "Wave differs when storing to cache");
+	a2_Close(e.iface);
+
+	/* Load from cache */
+	w = load(&e, cache);
+	compare(w, ref, "Wave differs when loading from cache");
+	a2_Close(e.iface);
+
+	a2_Close(re.iface);
+	printf("Cached wave matches rendered wave\n");
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * workerstest.c - Check that output does not depend on worker count
+ *
+ *	Renders several overlapping instances of a song that uses random
+ *	numbers and noise, with different numbers of worker threads, and
+ *	checks that the output is bit-exact in all cases. A2_TREERNG makes
+ *	the single threaded render use the same random number generators as
+ *	the threaded ones.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	COPIES	6
+#define	FRAMES	(44100 * 4)
+
+static uint64_t render(unsigned workers)
+{
+	CHK_engine e;
+	A2_handle songh;
+	uint64_t hash;
+	int i;
+	chk_Open(&e, workers, A2_TREERNG);
+	songh = chk_Get(&e, "data/a2jingle.a2s", "Song");
+	for(i = 0; i < COPIES; ++i)
+	{
+		A2_handle vh = a2_Start(e.iface, a2_RootVoice(e.iface), songh);
+		if(vh < 0)
+			chk_Fail("a2_Start()", -vh);
+		a2_Release(e.iface, vh);
+		a2_TimestampBump(e.iface, 37);
+	}
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	printf("workers: %u, hash: %016llx\n", workers,
+			(unsigned long long)hash);
+	return hash;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	uint64_t ref = render(0);
+	chk_Assert(render(1) == ref, "1 worker differs from no workers");
+	chk_Assert(render(4) == ref, "4 workers differ from no workers");
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * wtosctest.c - Check the SIMD 'wtosc' kernels against the scalar code
+ *
+ *	Builds a second copy of the 'wtosc' unit with A2_SSE2 disabled, and
+ *	registers it as 'wtoscscalar'. Sweeps over mipmapped, looped and
+ *	one-shot waves, played with every interpolation mode, must render
+ *	exactly the same with both units.
+ *
+ *	Also checks the 'quality' register: HERMITE2 must render exactly like
+ *	HERMITE, while the other modes must all differ. Leaving 'quality' out
+ *	must give the A2_HIFI/A2_LOFI default, setting it before the wave must
+ *	work the same as after, and values out of range must be clamped.
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* The scalar 'wtosc', built right here under another descriptor name */
+#undef	__SSE2__
+#define	a2_wtosc_unitdesc	a2_wtosc_scalar_unitdesc
+#include "wtosc.c"
+#undef	a2_wtosc_unitdesc
+
+#include <stdio.h>
+#include "checks.h"
+
+#define	WAVELEN		16384
+#define	WAVEPERIOD	100
+#define	FRAMES		(44100 * 2)
+
+static const char *qualities[A2OQ__COUNT] = {
+	"NEAREST", "LERP", "HERMITE", "HERMITE2"
+};
+
+static A2_unitdescx scalardesc;
+
+
+/* Upload a triangle wave with some noise on it, as a non-A2_FAST wave */
+static A2_handle upload(CHK_engine *e, int flags)
+{
+	static int16_t buf[WAVELEN];
+	uint32_t rnd = 1;
+	A2_handle h;
+	int s;
+	for(s = 0; s < WAVELEN; ++s)
+	{
+		int t = s % WAVEPERIOD;
+		rnd = rnd * 1664525 + 1013904223;
+		buf[s] = (t < WAVEPERIOD / 2 ? t : WAVEPERIOD - t) * 1200 -
+				30000 + (int)(rnd >> 22) - 512;
+	}
+	if((h = a2_UploadWave(e->iface, A2_WWAVE, WAVEPERIOD, flags, A2_I16,
+			buf, sizeof(buf))) < 0)
+		chk_Fail("a2_UploadWave()", -h);
+	return h;
+}
+
+
+/* Render 'program' from data/wtosc.a2s with 'quality', or just silence */
+static uint64_t render(const char *program, int quality)
+{
+	CHK_engine e;
+	A2_handle h;
+	A2_errors res;
+	uint64_t hash;
+	chk_Open(&e, 0, 0);
+	if((h = a2_RegisterUnit(e.iface, &scalardesc.d)) < 0)
+		chk_Fail("a2_RegisterUnit()", -h);
+	if((res = a2_Export(e.iface, A2_ROOTBANK, h, NULL)))
+		chk_Fail("a2_Export()", res);
+	if(program)
+	{
+		A2_handle lw = upload(&e, A2_LOOPED);
+		A2_handle ow = upload(&e, 0);
+		A2_handle vh;
+		h = chk_Get(&e, "data/wtosc.a2s", program);
+		if((vh = a2_Start(e.iface, a2_RootVoice(e.iface), h, quality,
+				lw, ow)) < 0)
+			chk_Fail("a2_Start()", -vh);
+	}
+	hash = chk_Render(&e, FRAMES, 0);
+	a2_Close(e.iface);
+	return hash;
+}
+
+
+int main(int argc, const char *argv[])
+{
+	int q, q2;
+	uint64_t silence, hashes[A2OQ__COUNT];
+	scalardesc = a2_wtosc_scalar_unitdesc;
+	scalardesc.d.name = "wtoscscalar";
+	silence = render(NULL, 0);
+	for(q = 0; q < A2OQ__COUNT; ++q)
+	{
+		uint64_t ref = render("Scalar", q);
+		printf("%s, hash: %016llx\n", qualities[q],
+				(unsigned long long)ref);
+		chk_Assert(ref != silence, "scalar output is silent");
+		chk_Assert(render("Osc", q) == ref,
+				"'wtosc' differs from the scalar build");
+		chk_Assert(render("Early", q) == ref,
+				"'quality' before the wave changes the output");
+		hashes[q] = ref;
+	}
+	chk_Assert(hashes[A2OQ_HERMITE2] == hashes[A2OQ_HERMITE],
+			"HERMITE2 differs from HERMITE");
+	for(q = 0; q < A2OQ_HERMITE; ++q)
+		for(q2 = q + 1; q2 <= A2OQ_HERMITE; ++q2)
+			chk_Assert(hashes[q] != hashes[q2],
+					"interpolation modes render the same");
+	chk_Assert(render("Default", 0) == hashes[A2OQ_DEFAULT],
+			"the default quality is not A2OQ_DEFAULT");
+	chk_Assert(render("Osc", -1) == hashes[0],
+			"negative quality not clamped");
+	chk_Assert(render("Osc", A2OQ__COUNT + 3) ==
+			hashes[A2OQ__COUNT - 1], "too high quality not clamped");
+	return 0;
+}